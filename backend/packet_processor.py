@@ -1,9 +1,10 @@
 from typing import Optional, AsyncIterator, Union
 from bson import Binary
 from crypto_auth import CryptoAuth, UnsignedPacketError
-from schemas import IrPacket, IrPacketRequestSchema, IrPacketObject, Station, PacketType, PACKET_HASH_LEN
+from schemas import IrPacket, IrPacketRequestSchema, IrPacketObject, Station, PacketType, PACKET_HASH_LEN, IR_TTL_ACK_BY_ID
 from config import Config
 from hashlib import sha3_256
+import zlib
 from database import db, redis_client
 import uuid
 import typing
@@ -204,6 +205,18 @@ class PacketProcessor:
         return sha3_256(data).digest()[:PACKET_HASH_LEN]
 
 
+    @staticmethod
+    def packet_ack_id(ir_packet: IrPacketRequestSchema) -> bytes:
+        """
+        Get the packet ID badges match acks by, instead of the hash, if they
+        set IR_TTL_ACK_BY_ID: the CRC-32 of the packet in little-endian, the
+        ttl byte and the size. See IrController::PrepareSlot().
+        """
+        data = bytes(ir_packet.data)
+
+        return zlib.crc32(data).to_bytes(4, 'little') + bytes([data[0], len(data)])
+
+
     async def handle_acknowledgment(self, ir_packet: IrPacketRequestSchema, station: Station) -> bool:
         # Handle acknowledgment from the base station.
         # This is where we would update the database or perform any other necessary actions.
@@ -223,14 +236,25 @@ class PacketProcessor:
 
             return True
 
+        if packet_type == PacketType.kAcknowledgeBatch:
+            # Base stations batch the acks to badges, a badge never sends
+            # one. Heard from a neighbouring base station, don't ack it.
+            return True
+
         return False
 
 
     async def ack(self, ir_packet: IrPacketRequestSchema, station: Station) -> None:
         # Send an acknowledgment packet to the badge through the base station.
+        # The ttl byte tells the badge we know packet IDs, so that it can skip
+        # hashing its packets.
+        if ir_packet.data[0] & IR_TTL_ACK_BY_ID:
+            hv = PacketProcessor.packet_ack_id(ir_packet)
+        else:
+            hv = PacketProcessor.packet_hash(ir_packet)
         ack_packet = IrPacket(
             packet_id=ir_packet.packet_id,
-            data=b"\x00" + PacketType.kAcknowledge.value.to_bytes(1, 'big') + PacketProcessor.packet_hash(ir_packet),
+            data=IR_TTL_ACK_BY_ID.to_bytes(1, 'big') + PacketType.kAcknowledge.value.to_bytes(1, 'big') + hv,
             station_id=station.station_id,
             to_stn=False
         )
@@ -35,6 +35,10 @@ PyObjectId = Annotated[ObjectId, _ObjectIdPydanticAnnotation]
 PyBinary = Annotated[bytes, BeforeValidator(bytes)]
 
 PACKET_HASH_LEN = 6
+# Set in the ttl byte of a badge packet, the packet is acked by
+# PacketProcessor.packet_ack_id() instead of its hash. Set in an ack, the
+# base station knows packet IDs.
+IR_TTL_ACK_BY_ID = 0x80
 IR_USERNAME_LEN = 4
 TAMA_DATA_LEN = 6
 MESSAGE_LEN = 24
@@ -55,6 +59,7 @@ class PacketType(Enum):
     kRequestScore = 11
     kSavePet = 12
     kRestorePet = 13
+    kAcknowledgeBatch = 14
 
 
 class IrPacket(BaseModel):
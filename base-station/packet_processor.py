@@ -5,10 +5,46 @@ import traceback
 from config import Config
 from packet_recorder import PacketRecorder
 
+# Same as packet_type, PACKET_HASH_LEN and AcknowledgeBatchPacket in
+# fw/Core/Hitcon/Logic/IrController.h.
+PACKET_TYPE_ACKNOWLEDGE = 3
+PACKET_TYPE_ACKNOWLEDGE_BATCH = 14
+PACKET_HASH_LEN = 6
+ACK_BATCH_HASH_LEN = 4
+ACK_BATCH_MAX = 6
+
 def station_key_to_id(station_key: str) -> str:
     station_id = '.'.join(station_key.split('.')[0:2])
     return station_id
 
+def is_ack(packet_data: bytes) -> bool:
+    return (len(packet_data) == 2 + PACKET_HASH_LEN and
+            packet_data[1] == PACKET_TYPE_ACKNOWLEDGE)
+
+def batch_acks(packets):
+    """Merge the acks among (packet_data, packet_id) into batch acks.
+
+    Every ack is a transmission of its own on a busy channel, a batch ack
+    acknowledges up to ACK_BATCH_MAX packets from any badge at once. A lone
+    ack is left as is.
+    """
+    acks = [p for p in packets if is_ack(p[0])]
+    if len(acks) < 2:
+        return packets
+    ret = [p for p in packets if not is_ack(p[0])]
+    for i in range(0, len(acks), ACK_BATCH_MAX):
+        batch = acks[i:i + ACK_BATCH_MAX]
+        if len(batch) == 1:
+            ret.append(batch[0])
+            continue
+        # Same ttl byte as the acks, it tells whether we know packet IDs.
+        data = bytes([batch[0][0][0], PACKET_TYPE_ACKNOWLEDGE_BATCH,
+                      len(batch)])
+        for packet_data, _ in batch:
+            data += packet_data[2:2 + ACK_BATCH_HASH_LEN]
+        ret.append((data, batch[0][1]))
+    return ret
+
 class PacketProcessor:
     def __init__(self, config: Config):
         self.backend = None
@@ -36,20 +72,22 @@ class PacketProcessor:
         while True:
             try:
                 packets = await self.backend.get_next_tx_packet(station_key=station_key)
-                duplicate_count = 0
+                new_packets = []
                 for packet_data, packet_id in packets:
                     if (packet_id, station_id) in self.seen_packet_ids:
                         print(f"[TX] Ignoring duplicate packet {packet_id}, {station_id}")
-                        duplicate_count += 1
                     else:
                         print(f"[TX] Queuing packet {packet_id}, {station_id}")
                         await self.recorder.record_packet(packet_data, "TX", packet_id, station_id=station_id)
-                        if is_cross_board:
-                            await self._tx_queue_xb.put((packet_data, packet_id, is_cross_board))
-                        else:
-                            await self._tx_queue_ir.put((packet_data, packet_id, is_cross_board))
+                        new_packets.append((packet_data, packet_id))
                         self.seen_packet_ids.add((packet_id, station_id))
-                if len(packets)-duplicate_count == 0:
+                if is_cross_board:
+                    for packet_data, packet_id in new_packets:
+                        await self._tx_queue_xb.put((packet_data, packet_id, is_cross_board))
+                else:
+                    for packet_data, packet_id in batch_acks(new_packets):
+                        await self._tx_queue_ir.put((packet_data, packet_id, is_cross_board))
+                if len(new_packets) == 0:
                     await asyncio.sleep(2.0)
             except Exception as e:
                 traceback.print_exc()
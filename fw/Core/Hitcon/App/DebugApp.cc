@@ -2,6 +2,8 @@
 #include <Logic/Display/display.h>
 #include <Logic/ImuLogic.h>
 #include <Logic/IrController.h>
+#include <Service/IrService.h>
+#include <Service/Sched/Profiler.h>
 #include <Service/Sched/Scheduler.h>
 #include <Service/Sched/SysTimer.h>
 #include <Service/Sched/Task.h>
@@ -19,7 +21,12 @@ void ByteToHex(uint8_t value, char* out) {
 }  // namespace
 
 DebugAccelApp g_debug_accel_app;
+DebugIdleApp g_debug_idle_app;
 IrRetxDebugApp g_ir_retx_debug_app;
+IrMacDebugApp g_ir_mac_debug_app;
+#ifdef SCHED_PROFILING
+SchedProfileDebugApp g_sched_profile_debug_app;
+#endif
 DebugApp g_debug_app;
 
 #pragma GCC diagnostic push
@@ -75,13 +82,64 @@ void DebugAccelApp::MainTaskFn(void* unused) {
   display_set_mode_text(disp_buff_);
 }
 
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpmf-conversions"
+DebugIdleApp::DebugIdleApp()
+    : main_task_(850, (task_callback_t)&DebugIdleApp::MainTaskFn, this, 1000),
+      main_task_scheduled_(false), running_(false) {}
+#pragma GCC diagnostic pop
+
+void DebugIdleApp::OnEntry() {
+  running_ = true;
+  EnsureQueued();
+}
+
+void DebugIdleApp::OnExit() { running_ = false; }
+
+void DebugIdleApp::OnButton(button_t button) {
+  switch (button) {
+    case BUTTON_BACK:
+    case BUTTON_LONG_BACK:
+      badge_controller.BackToMenu(this);
+      break;
+    default:
+      break;
+  }
+}
+
+void DebugIdleApp::EnsureQueued() {
+  if (!main_task_scheduled_ && running_) {
+    main_task_.SetWakeTime(SysTimer::GetTime() + 1000);
+    scheduler.Queue(&main_task_, nullptr);
+    main_task_scheduled_ = true;
+  }
+}
+
+void DebugIdleApp::MainTaskFn(void* unused) {
+  main_task_scheduled_ = false;
+  if (!running_) {
+    return;
+  }
+  EnsureQueued();
+
+  // Format: "I87%"
+  disp_buff_[0] = 'I';
+  unsigned len = uint_to_chr(&disp_buff_[1], sizeof(disp_buff_) - 2,
+                             static_cast<int>(scheduler.GetIdlePercent()));
+  disp_buff_[1 + len] = '%';
+  disp_buff_[2 + len] = 0;
+  display_set_mode_text(disp_buff_);
+}
+
 IrRetxDebugApp::IrRetxDebugApp()
     : MenuApp(nullptr, 0) {}  // We'll set actual entries in OnEntry
 
 void IrRetxDebugApp::OnEntry() {
   // Build packet entries - iterate through all slots and collect active ones
   int menu_index = 1;
-  for (int slot = 0; slot < 4 && menu_index < MAX_MENU_ENTRIES; slot++) {
+  for (size_t slot = 0;
+       slot < hitcon::ir::RETX_QUEUE_SIZE && menu_index < MAX_MENU_ENTRIES;
+       slot++) {
     uint8_t status = hitcon::ir::irController.GetSlotStatusForDebug(slot);
 
     // Show any slot that is not unused (same criteria as
@@ -142,4 +200,98 @@ void IrRetxDebugApp::OnEntry() {
 
 void IrRetxDebugApp::OnExit() { MenuApp::OnExit(); }
 
+IrMacDebugApp::IrMacDebugApp() : MenuApp(nullptr, 0) {}
+
+void IrMacDebugApp::OnEntry() {
+  const ir::IrMac& mac = ir::irService.mac;
+  const ir::IrMac::Stats& stats = mac.GetStats();
+  const struct {
+    char tag;
+    uint32_t value;
+  } counters[] = {
+      {'A', stats.attempts},     {'C', stats.collisions},
+      {'D', stats.deferrals},    {'K', stats.acks},
+      {'T', stats.ack_timeouts}, {'B', stats.backoff_ticks},
+  };
+
+  // Format: "MAC E2"
+  char* header = menu_texts_[0];
+  header[0] = 'M';
+  header[1] = 'A';
+  header[2] = 'C';
+  header[3] = ' ';
+  header[4] = 'E';
+  header[5] = uint_to_chr_hex_nibble(mac.BackoffExponent());
+  header[6] = '\0';
+
+  // Format: "D:1234"
+  int menu_index = 1;
+  for (const auto& counter : counters) {
+    char* line = menu_texts_[menu_index++];
+    line[0] = counter.tag;
+    line[1] = ':';
+    uint_to_chr(&line[2], MENU_ENTRY_LEN - 2, counter.value);
+  }
+
+  for (int i = 0; i < menu_index; i++) {
+    menu_entries_[i].name = menu_texts_[i];
+    menu_entries_[i].app = nullptr;
+    menu_entries_[i].func = nullptr;
+  }
+  AdjustMenuPointer(menu_entries_, menu_index, true);
+  MenuApp::OnEntry();
+}
+
+void IrMacDebugApp::OnExit() { MenuApp::OnExit(); }
+
+#ifdef SCHED_PROFILING
+SchedProfileDebugApp::SchedProfileDebugApp() : MenuApp(nullptr, 0) {}
+
+void SchedProfileDebugApp::OnEntry() {
+  // Pick the tasks with the longest single run, they're the ones holding up
+  // everyone else.
+  bool picked[Profiler::kSlots] = {false};
+  int menu_index = 1;
+  for (; menu_index < MAX_MENU_ENTRIES; menu_index++) {
+    int best = -1;
+    for (unsigned i = 0; i < profiler.size(); i++) {
+      if (picked[i]) continue;
+      if (best < 0 || profiler.Get(i).maxCycles > profiler.Get(best).maxCycles)
+        best = i;
+    }
+    if (best < 0) break;
+    picked[best] = true;
+    const Profiler::TaskProfile& p = profiler.Get(best);
+
+    // Format: "169:812L3"
+    char* line = menu_texts_[menu_index];
+    unsigned len = uint_to_chr(line, 4, p.task->GetPrio());
+    line[len++] = ':';
+    len += uint_to_chr(&line[len], 7, Profiler::CyclesToUs(p.maxCycles));
+    line[len++] = 'L';
+    len += uint_to_chr(&line[len], 6, p.lateStarts);
+    line[len] = '\0';
+  }
+
+  // Format: "T24D0"
+  char* header = menu_texts_[0];
+  unsigned len = 0;
+  header[len++] = 'T';
+  len += uint_to_chr(&header[len], 3, profiler.size());
+  header[len++] = 'D';
+  len += uint_to_chr(&header[len], 10, profiler.GetDropped());
+  header[len] = '\0';
+
+  for (int i = 0; i < menu_index; i++) {
+    menu_entries_[i].name = menu_texts_[i];
+    menu_entries_[i].app = nullptr;
+    menu_entries_[i].func = nullptr;
+  }
+  AdjustMenuPointer(menu_entries_, menu_index, true);
+  MenuApp::OnEntry();
+}
+
+void SchedProfileDebugApp::OnExit() { MenuApp::OnExit(); }
+#endif  // SCHED_PROFILING
+
 }  // namespace hitcon
@@ -33,11 +33,36 @@ class DebugAccelApp : public App {
 
 extern DebugAccelApp g_debug_accel_app;
 
+// =========== Idle Debug App ===========
+
+// Shows how much of the last second the scheduler spent idle.
+class DebugIdleApp : public App {
+ public:
+  DebugIdleApp();
+  virtual ~DebugIdleApp() = default;
+
+  void OnEntry() override;
+  void OnExit() override;
+  void OnButton(button_t button) override;
+
+ private:
+  hitcon::service::sched::DelayedTask main_task_;
+  bool main_task_scheduled_;
+  bool running_;
+  char disp_buff_[8];
+
+  void MainTaskFn(void *unused);
+  void EnsureQueued();
+};
+
+extern DebugIdleApp g_debug_idle_app;
+
 // =========== IrRetx Debug App ===========
 
 class IrRetxDebugApp : public MenuApp {
  public:
-  static constexpr int MAX_MENU_ENTRIES = 5;  // 1 header + max 4 packets
+  // 1 header + a packet per retransmit slot
+  static constexpr int MAX_MENU_ENTRIES = 1 + ir::RETX_QUEUE_SIZE;
   static constexpr int MENU_ENTRY_LEN = 16;
 
   IrRetxDebugApp();  // Updated constructor initialization
@@ -58,11 +83,71 @@ class IrRetxDebugApp : public MenuApp {
 
 extern IrRetxDebugApp g_ir_retx_debug_app;
 
+// =========== IR MAC Debug App ===========
+
+// IrMac::GetStats() since boot, a counter per line: attempts, collisions,
+// deferrals, acks, ack timeouts and backoff ticks, under the current
+// backoff exponent.
+class IrMacDebugApp : public MenuApp {
+ public:
+  static constexpr int MAX_MENU_ENTRIES = 7;  // 1 header + 6 counters
+  static constexpr int MENU_ENTRY_LEN = 14;
+
+  IrMacDebugApp();
+  virtual ~IrMacDebugApp() = default;
+
+  void OnEntry() override;
+  void OnExit() override;
+
+  void OnButtonMode() override {};
+  void OnButtonBack() override { badge_controller.BackToMenu(this); }
+  void OnButtonLongBack() override { badge_controller.BackToMenu(this); }
+
+ private:
+  char menu_texts_[MAX_MENU_ENTRIES][MENU_ENTRY_LEN];
+  menu_entry_t menu_entries_[MAX_MENU_ENTRIES];
+};
+
+extern IrMacDebugApp g_ir_mac_debug_app;
+
+#ifdef SCHED_PROFILING
+// =========== Sched Profile Debug App ===========
+
+// Lists the tasks with the longest runs, one "prio:max_us L late_starts"
+// line each, under a "T<tasks> D<dropped>" header.
+class SchedProfileDebugApp : public MenuApp {
+ public:
+  static constexpr int MAX_MENU_ENTRIES = 9;  // 1 header + top 8 tasks
+  static constexpr int MENU_ENTRY_LEN = 20;
+
+  SchedProfileDebugApp();
+  virtual ~SchedProfileDebugApp() = default;
+
+  void OnEntry() override;
+  void OnExit() override;
+
+  void OnButtonMode() override {};
+  void OnButtonBack() override { badge_controller.BackToMenu(this); }
+  void OnButtonLongBack() override { badge_controller.BackToMenu(this); }
+
+ private:
+  char menu_texts_[MAX_MENU_ENTRIES][MENU_ENTRY_LEN];
+  menu_entry_t menu_entries_[MAX_MENU_ENTRIES];
+};
+
+extern SchedProfileDebugApp g_sched_profile_debug_app;
+#endif  // SCHED_PROFILING
+
 // =========== Main Debug App ===========
 
 constexpr menu_entry_t debug_menu_entries[] = {
     {"Accel", &g_debug_accel_app, nullptr},
+    {"Idle", &g_debug_idle_app, nullptr},
+#ifdef SCHED_PROFILING
+    {"Sched", &g_sched_profile_debug_app, nullptr},
+#endif
     {"Pkt Stat", &g_ir_retx_debug_app, nullptr},
+    {"IR MAC", &g_ir_mac_debug_app, nullptr},
     {"Force Retx", &g_ir_force_retx_app, nullptr}};
 
 constexpr size_t debug_menu_entries_len =
@@ -1,4 +1,5 @@
 #include <Logic/EcLogic.h>
+#include <Logic/EcModMul.h>
 #include <Logic/RandomPool.h>
 #include <Service/HashService.h>
 #include <Service/PerBoardData.h>
@@ -22,43 +23,37 @@ namespace internal {
 static constexpr uint64_t UINT64_MSB = 1ULL << 63;
 
 // Hardcoded curve parameters
-static const EllipticCurve g_curve(0x5e924cd447a56b, 0x892f0a953f589b);
-static const EcPoint g_generator({0x9a77dc33b36acc, 0xbcffb098340493},
-                                 {0x279be90a95dbdd, 0xbcffb098340493});
+static constexpr EllipticCurve g_curve(0x5e924cd447a56b, 0x892f0a953f589b);
+static constexpr uint64_t g_fieldPrime = 0xbcffb098340493;
+static constexpr uint64_t g_generatorX = 0x9a77dc33b36acc;
+static constexpr uint64_t g_generatorY = 0x279be90a95dbdd;
+static const EcPoint g_generator({g_generatorX, g_fieldPrime},
+                                 {g_generatorY, g_fieldPrime});
 static const uint64_t g_curveOrder = 0xbcffb09c43733d;
 // TODO: use GetPerBoardSecret to set the private key
-static const EcPoint g_serverPubKey({0x05cb6b63de507e, 0xbcffb098340493},
-                                    {0x4df751a1388b25, 0xbcffb098340493});
-
-constexpr inline uint64_t modneg(const uint64_t x, const uint64_t m) {
-  return m - (x % m);
-}
-
-constexpr inline uint64_t modadd(const uint64_t a, const uint64_t b,
-                                 const uint64_t m) {
-  if (a > UINT64_MAX - b)
-    return modneg((modneg(a, m) + modneg(b, m)) % m, m);
-  else
-    return (a + b) % m;
-}
-
-constexpr inline uint64_t modsub(const uint64_t a, const uint64_t b,
-                                 const uint64_t m) {
-  if (a >= b)
-    return a - b;
-  else
-    return a + m - b;
+static constexpr uint64_t g_serverPubKeyX = 0x05cb6b63de507e;
+static constexpr uint64_t g_serverPubKeyY = 0x4df751a1388b25;
+static const EcPoint g_serverPubKey({g_serverPubKeyX, g_fieldPrime},
+                                    {g_serverPubKeyY, g_fieldPrime});
+// The moduli ModMulService sees, the field and the group order.
+static constexpr MontModulus g_fieldMont(g_fieldPrime);
+static constexpr MontModulus g_orderMont(g_curveOrder);
+
+static const MontModulus *montModulus(uint64_t m) {
+  if (m == g_fieldMont.m) return &g_fieldMont;
+  if (m == g_orderMont.m) return &g_orderMont;
+  return nullptr;
 }
 
 ModNum::ModNum(uint64_t val, uint64_t mod) : val(val), mod(mod) {}
 
-ModNum ModNum::operator=(const ModNum &other) {
+ModNum &ModNum::operator=(const ModNum &other) {
   val = other.val;
   mod = other.mod;
   return *this;
 }
 
-ModNum ModNum::operator=(const uint64_t other) {
+ModNum &ModNum::operator=(const uint64_t other) {
   val = other % mod;
   return *this;
 }
@@ -84,8 +79,6 @@ bool ModNum::operator==(const ModNum &other) const {
 
 bool ModNum::operator==(const uint64_t other) const { return val == other; }
 
-ModMulService g_mod_mul_service;
-
 ModMulService::ModMulService()
     : routineTask(804, (callback_t)&ModMulService::routineFunc, this),
       finalizeTask(804, (callback_t)&ModMulService::finalize, this) {}
@@ -99,9 +92,20 @@ void ModMulService::start(uint64_t a, uint64_t b, uint64_t m,
   context.m = m;
   context.res = 0;
   context.i = 0;
+  const MontModulus *mod = montModulus(m);
+  if (mod) {
+    // A handful of multiplications, done right away rather than over four
+    // routineFunc() runs.
+    if (a >= m) a %= m;
+    if (b >= m) b %= m;
+    context.res = modMul(a, b, *mod);
+    scheduler.Queue(&finalizeTask, nullptr);
+    return;
+  }
   scheduler.Queue(&routineTask, nullptr);
 }
 
+// Shift-and-add for any other modulus.
 void ModMulService::routineFunc() {
   do {
     context.res = modadd(context.res, context.res, context.m);
@@ -118,12 +122,11 @@ void ModMulService::routineFunc() {
 
 void ModMulService::finalize() { callback(callbackArg1, &context.res); }
 
-ModDivService g_mod_div_service;
-
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-ModDivService::ModDivService()
-    : routineTask(803, (callback_t)&ModDivService::routineFunc, this),
+ModDivService::ModDivService(ModMulService &modMul)
+    : modMul(modMul),
+      routineTask(803, (callback_t)&ModDivService::routineFunc, this),
       finalizeTask(803, (callback_t)&ModDivService::finalize, this) {}
 #pragma GCC diagnostic pop
 
@@ -146,8 +149,8 @@ void ModDivService::routineFunc() {
   if (context.pr == 1) {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-    g_mod_mul_service.start(context.a, context.px, context.m,
-                            (callback_t)&ModDivService::preFinalize, this);
+    modMul.start(context.a, context.px, context.m,
+                 (callback_t)&ModDivService::preFinalize, this);
 #pragma GCC diagnostic pop
     return;
   }
@@ -155,8 +158,8 @@ void ModDivService::routineFunc() {
   context.r = context.ppr % context.pr;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-  g_mod_mul_service.start(context.q, context.px, context.m,
-                          (callback_t)&ModDivService::onModMulDone, this);
+  modMul.start(context.q, context.px, context.m,
+               (callback_t)&ModDivService::onModMulDone, this);
 #pragma GCC diagnostic pop
 }
 
@@ -180,13 +183,11 @@ void ModDivService::finalize() {
   callback(callbackArg1, &res);
 }
 
-EllipticCurve::EllipticCurve(const uint64_t A, const uint64_t B) : A(A), B(B) {}
-
 EcPoint::EcPoint() : x{0, 0}, y{0, 0}, isInf(true) {}
 
 EcPoint::EcPoint(const ModNum &x, const ModNum &y) : x(x), y(y), isInf(false) {}
 
-EcPoint EcPoint::operator=(const EcPoint &other) {
+EcPoint &EcPoint::operator=(const EcPoint &other) {
   isInf = other.isInf;
   x = other.x;
   y = other.y;
@@ -242,12 +243,13 @@ bool EcPoint::getCompactForm(uint8_t *buffer, size_t len) const {
 
 PointAddContext::PointAddContext() : l(0, 1) {}
 
-PointAddService g_point_add_service;
-
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-PointAddService::PointAddService()
-    : routineTask(802, (callback_t)&PointAddService::routineFunc, this),
+PointAddService::PointAddService(ModMulService &modMul,
+                                 ModDivService &modDiv)
+    : modMul(modMul),
+      modDiv(modDiv),
+      routineTask(802, (callback_t)&PointAddService::routineFunc, this),
       finalizeTask(802, (callback_t)&PointAddService::finalize, this),
       genXTask(802, (callback_t)&PointAddService::genXStep1, this),
       genYTask(802, (callback_t)&PointAddService::genYStep1, this) {}
@@ -277,8 +279,8 @@ void PointAddService::routineFunc() {
     // Original formula is 3 * x^2 + A, we calculate x^2 here by doing x * x
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-    g_mod_mul_service.start(context.a.x.val, context.a.x.val, context.a.x.mod,
-                            (callback_t)&PointAddService::onLtopDone, this);
+    modMul.start(context.a.x.val, context.a.x.val, context.a.x.mod,
+                 (callback_t)&PointAddService::onLtopDone, this);
 #pragma GCC diagnostic pop
   } else {
     // intersect directly
@@ -286,8 +288,8 @@ void PointAddService::routineFunc() {
     ModNum l_bot = context.b.x - context.a.x;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-    g_mod_div_service.start(l_top.val, l_bot.val, l_top.mod,
-                            (callback_t)&PointAddService::onDivDone, this);
+    modDiv.start(l_top.val, l_bot.val, l_top.mod,
+                 (callback_t)&PointAddService::onDivDone, this);
 #pragma GCC diagnostic pop
   }
 }
@@ -301,8 +303,8 @@ void PointAddService::onLtopDone(uint64_t *l_top) {
   ModNum l_bot = context.a.y + context.a.y;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-  g_mod_div_service.start(_l_top.val, l_bot.val, _l_top.mod,
-                          (callback_t)&PointAddService::onDivDone, this);
+  modDiv.start(_l_top.val, l_bot.val, _l_top.mod,
+               (callback_t)&PointAddService::onDivDone, this);
 #pragma GCC diagnostic pop
 }
 
@@ -314,8 +316,8 @@ void PointAddService::onDivDone(ModNum *l) {
 void PointAddService::genXStep1() {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-  g_mod_mul_service.start(context.l.val, context.l.val, context.l.mod,
-                          (callback_t)&PointAddService::genXStep2, this);
+  modMul.start(context.l.val, context.l.val, context.l.mod,
+               (callback_t)&PointAddService::genXStep2, this);
 #pragma GCC diagnostic pop
 }
 
@@ -328,9 +330,8 @@ void PointAddService::genXStep2(uint64_t *lPow2) {
 void PointAddService::genYStep1() {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-  g_mod_mul_service.start(context.l.val, (context.a.x - context.res.x).val,
-                          context.l.mod,
-                          (callback_t)&PointAddService::genYStep2, this);
+  modMul.start(context.l.val, (context.a.x - context.res.x).val,
+               context.l.mod, (callback_t)&PointAddService::genYStep2, this);
 #pragma GCC diagnostic pop
 }
 
@@ -342,54 +343,288 @@ void PointAddService::genYStep2(uint64_t *lDx) {
 
 void PointAddService::finalize() { callback(callbackArg1, &context.res); }
 
-PointMultContext::PointMultContext() : p(g_generator), res(g_generator) {}
+// Field arithmetic on Montgomery form values.
+static constexpr inline uint64_t fmul(uint64_t a, uint64_t b) {
+  return montMul(a, b, g_fieldMont);
+}
+
+static constexpr inline uint64_t fadd(uint64_t a, uint64_t b) {
+  return modaddReduced(a, b, g_fieldMont.m);
+}
+
+static constexpr inline uint64_t fsub(uint64_t a, uint64_t b) {
+  return modsub(a, b, g_fieldMont.m);
+}
+
+static constexpr uint64_t g_curveAMont = toMont(g_curve.A, g_fieldMont);
+
+// p = 2 * p.
+// https://hyperelliptic.org/EFD/g1p/auto-shortw-jacobian.html#doubling-dbl-2007-bl
+static void jacobianDouble(JacobianPoint &p) {
+  if (p.Z == 0) return;
+  const uint64_t xx = fmul(p.X, p.X);
+  const uint64_t yy = fmul(p.Y, p.Y);
+  const uint64_t yyyy = fmul(yy, yy);
+  const uint64_t zz = fmul(p.Z, p.Z);
+  // s = 4 * X * YY
+  uint64_t s = fmul(p.X, yy);
+  s = fadd(s, s);
+  s = fadd(s, s);
+  // m = 3 * XX + A * ZZ^2
+  const uint64_t m =
+      fadd(fadd(fadd(xx, xx), xx), fmul(g_curveAMont, fmul(zz, zz)));
+  const uint64_t x = fsub(fmul(m, m), fadd(s, s));
+  uint64_t yyyy8 = fadd(yyyy, yyyy);
+  yyyy8 = fadd(yyyy8, yyyy8);
+  yyyy8 = fadd(yyyy8, yyyy8);
+  const uint64_t yz = fmul(p.Y, p.Z);
+  p.Y = fsub(fmul(m, fsub(s, x)), yyyy8);
+  p.X = x;
+  p.Z = fadd(yz, yz);
+}
+
+// p = p + q.
+// https://hyperelliptic.org/EFD/g1p/auto-shortw-jacobian.html#addition-madd
+static void jacobianAddAffine(JacobianPoint &p, const AffinePoint &q) {
+  if (p.Z == 0) {
+    p = {q.x, q.y, g_fieldMont.one};
+    return;
+  }
+  const uint64_t z1z1 = fmul(p.Z, p.Z);
+  const uint64_t u2 = fmul(q.x, z1z1);
+  const uint64_t s2 = fmul(q.y, fmul(p.Z, z1z1));
+  const uint64_t h = fsub(u2, p.X);
+  const uint64_t r = fsub(s2, p.Y);
+  if (h == 0) {
+    // The same x, p is q or -q.
+    if (r == 0)
+      jacobianDouble(p);
+    else
+      p.Z = 0;
+    return;
+  }
+  const uint64_t hh = fmul(h, h);
+  const uint64_t hhh = fmul(h, hh);
+  const uint64_t v = fmul(p.X, hh);
+  const uint64_t x3 = fsub(fsub(fmul(r, r), hhh), fadd(v, v));
+  p.Y = fsub(fmul(r, fsub(v, x3)), fmul(p.Y, hhh));
+  p.X = x3;
+  p.Z = fmul(p.Z, h);
+}
+
+// Affine arithmetic for the tables, only ever run at compile time.
+static constexpr uint64_t finv(uint64_t a) {
+  // a^(p - 2)
+  uint64_t res = g_fieldMont.one;
+  for (uint64_t e = g_fieldMont.m - 2; e; e >>= 1) {
+    if (e & 1) res = fmul(res, a);
+    a = fmul(a, a);
+  }
+  return res;
+}
 
-PointMultService g_point_mult_service;
+// a + b, neither the identity nor -b.
+static constexpr AffinePoint affineAdd(const AffinePoint &a,
+                                       const AffinePoint &b) {
+  uint64_t l = 0;
+  if (a.x == b.x) {
+    const uint64_t xx = fmul(a.x, a.x);
+    l = fmul(fadd(fadd(fadd(xx, xx), xx), g_curveAMont),
+             finv(fadd(a.y, a.y)));
+  } else {
+    l = fmul(fsub(b.y, a.y), finv(fsub(b.x, a.x)));
+  }
+  const uint64_t x = fsub(fsub(fmul(l, l), a.x), b.x);
+  return {x, fsub(fmul(l, fsub(a.x, x)), a.y)};
+}
+
+template <size_t N>
+struct PointTable {
+  AffinePoint p[N];
+};
+
+// The wNAF width for the points with a table, digits are odd and within
+// +-2^(w - 1), and the table holds p, 3p, 5p, ...
+static constexpr int kNafWidth = 5;
+static constexpr size_t kNafTableSize = 1 << (kNafWidth - 2);
+// Just p, digits are +-1.
+static constexpr int kNafWidthNoTable = 2;
+
+static constexpr PointTable<kNafTableSize> makeOddMultiples(uint64_t x,
+                                                           uint64_t y) {
+  PointTable<kNafTableSize> table = {};
+  table.p[0] = {toMont(x, g_fieldMont), toMont(y, g_fieldMont)};
+  const AffinePoint p2 = affineAdd(table.p[0], table.p[0]);
+  for (size_t i = 1; i < kNafTableSize; i++) {
+    table.p[i] = affineAdd(table.p[i - 1], p2);
+  }
+  return table;
+}
+
+// The comb takes the 64 bits of the scalar as 4 rows of 16, and a column at
+// a time. Entry b - 1 is the sum of 2^(16 i) G for the bits i set in b.
+static constexpr int kCombRows = 4;
+static constexpr int kCombColumns = 16;
+
+static constexpr PointTable<(1 << kCombRows) - 1> makeComb(uint64_t x,
+                                                          uint64_t y) {
+  AffinePoint rows[kCombRows] = {};
+  rows[0] = {toMont(x, g_fieldMont), toMont(y, g_fieldMont)};
+  for (int i = 1; i < kCombRows; i++) {
+    rows[i] = rows[i - 1];
+    for (int j = 0; j < kCombColumns; j++) {
+      rows[i] = affineAdd(rows[i], rows[i]);
+    }
+  }
+  PointTable<(1 << kCombRows) - 1> table = {};
+  for (int b = 1; b < (1 << kCombRows); b++) {
+    bool first = true;
+    for (int i = 0; i < kCombRows; i++) {
+      if (!((b >> i) & 1)) continue;
+      table.p[b - 1] = first ? rows[i] : affineAdd(table.p[b - 1], rows[i]);
+      first = false;
+    }
+  }
+  return table;
+}
+
+// In flash.
+static constexpr PointTable<(1 << kCombRows) - 1> g_generatorComb =
+    makeComb(g_generatorX, g_generatorY);
+static constexpr PointTable<kNafTableSize> g_generatorOdd =
+    makeOddMultiples(g_generatorX, g_generatorY);
+static constexpr PointTable<kNafTableSize> g_serverPubKeyOdd =
+    makeOddMultiples(g_serverPubKeyX, g_serverPubKeyY);
+
+// The width w NAF of k into naf, returns the number of digits.
+static uint8_t toNaf(uint64_t k, int w, int8_t *naf) {
+  // Bit 64 of k, k - d can carry into it.
+  uint64_t high = 0;
+  uint8_t len = 0;
+  while (k || high) {
+    int d = 0;
+    if (k & 1) {
+      d = k & ((1 << w) - 1);
+      if (d >= (1 << (w - 1))) d -= 1 << w;
+      const uint64_t next = k - d;
+      if (d < 0 && next < k) high = 1;
+      k = next;
+    }
+    naf[len++] = d;
+    k = (k >> 1) | (high << 63);
+    high = 0;
+  }
+  return len;
+}
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-PointMultService::PointMultService()
-    : routineTask(801, (task_callback_t)&PointMultService::routineFunc,
+PointMultService::PointMultService(ModDivService &modDiv)
+    : modDiv(modDiv),
+      routineTask(801, (task_callback_t)&PointMultService::routineFunc,
                   (void *)this) {}
 #pragma GCC diagnostic pop
 
 void PointMultService::routineFunc() {
-  if (context.i == 128) {
+  // A column or digit each run, but the ones before the first addition are
+  // free.
+  while (context.i) {
+    --context.i;
+    jacobianDouble(context.sum);
+    if (context.comb) {
+      int b = 0;
+      for (int i = 0; i < kCombRows; i++) {
+        b |= ((context.times >> (i * kCombColumns + context.i)) & 1) << i;
+      }
+      if (b) jacobianAddAffine(context.sum, context.table[0][b - 1]);
+    } else {
+      for (uint8_t t = 0; t < context.terms; t++) {
+        const int d = context.naf[t][context.i];
+        if (d > 0) {
+          jacobianAddAffine(context.sum, context.table[t][(d - 1) / 2]);
+        } else if (d < 0) {
+          const AffinePoint &p = context.table[t][(-d - 1) / 2];
+          jacobianAddAffine(context.sum, {p.x, fsub(0, p.y)});
+        }
+      }
+    }
+    if (context.sum.Z) break;
+  }
+  if (context.i) {
+    scheduler.Queue(&routineTask, this);
+  } else if (context.sum.Z == 0) {
+    context.res = EcPoint();
     callback(callbackArg1, &context.res);
   } else {
-    if (context.i & 1) {
+    // The one inversion, 1 / Z.
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-      if (context.times & UINT64_MSB)
-        g_point_add_service.start(context.p, context.res,
-                                  (callback_t)&PointMultService::onAddDone,
-                                  this);
-      else
-        scheduler.Queue(&routineTask, this);
+    modDiv.start(1, fromMont(context.sum.Z, g_fieldMont),
+                 g_fieldMont.m, (callback_t)&PointMultService::onInvDone, this);
 #pragma GCC diagnostic pop
-      context.times <<= 1;
-    } else {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wpmf-conversions"
-      g_point_add_service.start(context.res, context.res,
-                                (callback_t)&PointMultService::onAddDone, this);
-#pragma GCC diagnostic pop
-    }
-    ++context.i;
   }
 }
 
-void PointMultService::onAddDone(EcPoint *res) {
-  context.res = *res;
-  scheduler.Queue(&routineTask, this);
+void PointMultService::onInvDone(ModNum *zInv) {
+  const uint64_t zi = toMont(zInv->val, g_fieldMont);
+  const uint64_t zi2 = fmul(zi, zi);
+  const uint64_t x = fromMont(fmul(context.sum.X, zi2), g_fieldMont);
+  const uint64_t y =
+      fromMont(fmul(context.sum.Y, fmul(zi2, zi)), g_fieldMont);
+  context.res = EcPoint(ModNum(x, g_fieldMont.m), ModNum(y, g_fieldMont.m));
+  callback(callbackArg1, &context.res);
+}
+
+void PointMultService::setTerm(const EcPoint &p, uint64_t times) {
+  if (p.identity() || times == 0) return;
+  // Every point is on the one curve.
+  my_assert(p.x.mod == g_fieldMont.m);
+  const uint8_t t = context.terms++;
+  int w = kNafWidth;
+  if (p == g_generator) {
+    context.table[t] = g_generatorOdd.p;
+  } else if (p == g_serverPubKey) {
+    context.table[t] = g_serverPubKeyOdd.p;
+  } else {
+    context.point[t] = {toMont(p.x.val, g_fieldMont),
+                        toMont(p.y.val, g_fieldMont)};
+    context.table[t] = &context.point[t];
+    w = kNafWidthNoTable;
+  }
+  memset(context.naf[t], 0, sizeof(context.naf[t]));
+  const uint8_t len = toNaf(times, w, context.naf[t]);
+  if (len > context.i) context.i = len;
 }
 
 void PointMultService::start(const EcPoint &p, uint64_t times,
                              callback_t callback, void *callbackArg1) {
-  context.p = p;
-  context.times = times;
+  if (p == g_generator && times) {
+    context.terms = 1;
+    context.comb = true;
+    context.table[0] = g_generatorComb.p;
+    context.times = times;
+    context.i = kCombColumns;
+  } else {
+    context.terms = 0;
+    context.comb = false;
+    context.i = 0;
+    setTerm(p, times);
+  }
+  context.sum = {0, 0, 0};
+  this->callback = callback;
+  this->callbackArg1 = callbackArg1;
+  scheduler.Queue(&routineTask, this);
+}
+
+void PointMultService::start(const EcPoint &p, uint64_t pTimes,
+                             const EcPoint &q, uint64_t qTimes,
+                             callback_t callback, void *callbackArg1) {
+  context.terms = 0;
+  context.comb = false;
   context.i = 0;
-  context.res = EcPoint();
+  setTerm(p, pTimes);
+  setTerm(q, qTimes);
+  context.sum = {0, 0, 0};
   this->callback = callback;
   this->callbackArg1 = callbackArg1;
   scheduler.Queue(&routineTask, this);
@@ -413,30 +648,41 @@ EcContext::EcContext()
     : r(0, g_curveOrder), s(0, g_curveOrder), u1(0, g_curveOrder),
       u2(0, g_curveOrder) {}
 
-bool EcLogic::StartSign(uint8_t const *message, uint32_t len,
-                        callback_t callback, void *callbackArg1) {
-  if (busy) return false;
-  if (!publicKeyReady) return false;
+namespace internal {
+
+EcEngine::EcEngine()
+    : modDiv(modMul), pointAdd(modMul, modDiv), pointMult(modDiv) {}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpmf-conversions"
+EcOperation::EcOperation()
+    : genRandTask(800, (callback_t)&EcOperation::genRand, this),
+      finalizeTask(800, (callback_t)&EcOperation::finalizeSign, this) {}
+#pragma GCC diagnostic pop
+
+bool EcOperation::StartSign(uint8_t const *message, uint32_t len,
+                            uint64_t privateKey, callback_t callback,
+                            void *callbackArg1) {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-  if (!g_hash_service.StartHash(message, len,
-                                (callback_t)&EcLogic::onSignHashFinish, this))
+  if (!g_hash_service.StartHash(
+          message, len, (callback_t)&EcOperation::onSignHashFinish, this))
     return false;
 #pragma GCC diagnostic pop
   busy = true;
+  this->privateKey = privateKey;
   this->callback = callback;
   this->callback_arg1 = callbackArg1;
   return true;
 }
 
-bool EcLogic::StartVerify(uint8_t const *message, uint32_t len,
-                          uint8_t *signature, callback_t callback,
-                          void *callbackArg1) {
-  if (busy) return false;
+bool EcOperation::StartVerify(uint8_t const *message, uint32_t len,
+                              uint8_t *signature, callback_t callback,
+                              void *callbackArg1) {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-  if (!g_hash_service.StartHash(message, len,
-                                (callback_t)&EcLogic::onVerifyHashFinish, this))
+  if (!g_hash_service.StartHash(
+          message, len, (callback_t)&EcOperation::onVerifyHashFinish, this))
     return false;
 #pragma GCC diagnostic pop
   busy = true;
@@ -449,35 +695,54 @@ bool EcLogic::StartVerify(uint8_t const *message, uint32_t len,
   return true;
 }
 
-void EcLogic::onSignHashFinish(HashResult *hashResult) {
-  context.z =
-      reinterpret_cast<uint64_t *>(hashResult->digest)[0] % g_curveOrder;
+void EcOperation::StartPubkey(uint64_t privateKey, callback_t callback,
+                              void *callbackArg1) {
+  busy = true;
+  this->callback = callback;
+  this->callback_arg1 = callbackArg1;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpmf-conversions"
+  engine.pointMult.start(g_generator, privateKey,
+                         (callback_t)&EcOperation::finalizePubkey, this);
+#pragma GCC diagnostic pop
+}
+
+void EcOperation::onSignHashFinish(HashResult *hashResult) {
+  // The digest needn't be aligned.
+  memcpy(&context.z, hashResult->digest, sizeof(context.z));
+  context.z %= g_curveOrder;
   scheduler.Queue(&genRandTask, this);
 }
 
-void EcLogic::onVerifyHashFinish(HashResult *HashResult) {
-  context.z =
-      reinterpret_cast<uint64_t *>(HashResult->digest)[0] % g_curveOrder;
+void EcOperation::onVerifyHashFinish(HashResult *HashResult) {
+  memcpy(&context.z, HashResult->digest, sizeof(context.z));
+  context.z %= g_curveOrder;
+  if (context.r == 0 || context.s == 0) {
+    // Not a signature, and s has no inverse.
+    callback(callback_arg1, (void *)false);
+    busy = false;
+    return;
+  }
   // u1 = z / s
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-  g_mod_div_service.start(context.z, context.s.val, g_curveOrder,
-                          (callback_t)&EcLogic::onU1Generated, this);
+  engine.modDiv.start(context.z, context.s.val, g_curveOrder,
+                      (callback_t)&EcOperation::onU1Generated, this);
 #pragma GCC diagnostic pop
 }
 
-void EcLogic::genRand() {
+void EcOperation::genRand() {
   context.k = ((uint64_t)(g_fast_random_pool.GetRandom())) << 32 |
               g_fast_random_pool.GetRandom();
   // r = k * G
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-  g_point_mult_service.start(g_generator, context.k,
-                             (callback_t)&EcLogic::onRGenerated, this);
+  engine.pointMult.start(g_generator, context.k,
+                         (callback_t)&EcOperation::onRGenerated, this);
 #pragma GCC diagnostic pop
 }
 
-void EcLogic::onRGenerated(EcPoint *p) {
+void EcOperation::onRGenerated(EcPoint *p) {
   context.r = p->xval();
   if (context.r == 0)
     scheduler.Queue(&genRandTask, this);
@@ -486,23 +751,23 @@ void EcLogic::onRGenerated(EcPoint *p) {
     // We start by calculating r * d
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-    g_mod_mul_service.start(privateKey, context.r.val, context.r.mod,
-                            (callback_t)&EcLogic::genS, this);
+    engine.modMul.start(privateKey, context.r.val, context.r.mod,
+                        (callback_t)&EcOperation::genS, this);
 #pragma GCC diagnostic pop
   }
 }
 
-void EcLogic::genS(uint64_t *pkR) {
+void EcOperation::genS(uint64_t *pkR) {
   ModNum a = context.z + ModNum(*pkR, context.r.mod);
   // s = (z + r * d) / k
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-  g_mod_div_service.start(a.val, context.k, a.mod,
-                          (callback_t)&EcLogic::onSGenerated, this);
+  engine.modDiv.start(a.val, context.k, a.mod,
+                      (callback_t)&EcOperation::onSGenerated, this);
 #pragma GCC diagnostic pop
 }
 
-void EcLogic::onSGenerated(ModNum *s) {
+void EcOperation::onSGenerated(ModNum *s) {
   context.s = *s;
   if (context.s == 0)
     scheduler.Queue(&genRandTask, this);
@@ -510,57 +775,35 @@ void EcLogic::onSGenerated(ModNum *s) {
     scheduler.Queue(&finalizeTask, this);
 }
 
-void EcLogic::finalizeSign() {
+void EcOperation::finalizeSign() {
   tmpSignature.r = context.r.val;
   tmpSignature.s = context.s.val;
   callback(callback_arg1, &tmpSignature);
   busy = false;
 }
 
-void EcLogic::onU1Generated(ModNum *u1) {
+void EcOperation::onU1Generated(ModNum *u1) {
   context.u1 = *u1;
   // u2 = r / s
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-  g_mod_div_service.start(context.r.val, context.s.val, g_curveOrder,
-                          (callback_t)&EcLogic::onU2Generated, this);
+  engine.modDiv.start(context.r.val, context.s.val, g_curveOrder,
+                      (callback_t)&EcOperation::onU2Generated, this);
 #pragma GCC diagnostic pop
 }
 
-void EcLogic::onU2Generated(ModNum *u2) {
+void EcOperation::onU2Generated(ModNum *u2) {
   context.u2 = *u2;
-  // normally, the next step is P = u1 * G + u2 * pub
-  // but we do it separately:
-  // m = u1 * G
-  // n = u2 * pub
-  // P = m + n
+  // P = u1 * G + u2 * pub, the doublings shared between the two.
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-  g_point_mult_service.start(g_generator, context.u1.val,
-                             (callback_t)&EcLogic::onMGenerated, this);
+  engine.pointMult.start(g_generator, context.u1.val, g_serverPubKey,
+                         context.u2.val,
+                         (callback_t)&EcOperation::finalizeVerify, this);
 #pragma GCC diagnostic pop
 }
 
-void EcLogic::onMGenerated(EcPoint *m) {
-  context.m = *m;
-  // n = u2 * pub
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wpmf-conversions"
-  g_point_mult_service.start(g_serverPubKey, context.u2.val,
-                             (callback_t)&EcLogic::onNGenerated, this);
-#pragma GCC diagnostic pop
-}
-
-void EcLogic::onNGenerated(EcPoint *n) {
-  // P = m + n
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wpmf-conversions"
-  g_point_add_service.start(context.m, *n, (callback_t)&EcLogic::finalizeVerify,
-                            this);
-#pragma GCC diagnostic pop
-}
-
-void EcLogic::finalizeVerify(EcPoint *P) {
+void EcOperation::finalizeVerify(EcPoint *P) {
   // P == identity -> signature is invalid
   // otherwise, check if r == P.x
   callback(callback_arg1,
@@ -568,6 +811,40 @@ void EcLogic::finalizeVerify(EcPoint *P) {
   busy = false;
 }
 
+void EcOperation::finalizePubkey(EcPoint *p) {
+  callback(callback_arg1, p);
+  busy = false;
+}
+
+}  // namespace internal
+
+EcLogic::EcLogic() {}
+
+EcOperation *EcLogic::freeOperation() {
+  for (EcOperation &operation : operations) {
+    if (!operation.busy) return &operation;
+  }
+  return nullptr;
+}
+
+bool EcLogic::StartSign(uint8_t const *message, uint32_t len,
+                        callback_t callback, void *callbackArg1) {
+  if (!publicKeyReady) return false;
+  EcOperation *operation = freeOperation();
+  if (!operation) return false;
+  return operation->StartSign(message, len, privateKey, callback,
+                              callbackArg1);
+}
+
+bool EcLogic::StartVerify(uint8_t const *message, uint32_t len,
+                          uint8_t *signature, callback_t callback,
+                          void *callbackArg1) {
+  EcOperation *operation = freeOperation();
+  if (!operation) return false;
+  return operation->StartVerify(message, len, signature, callback,
+                                callbackArg1);
+}
+
 void EcLogic::onPubkeyDone(EcPoint *p) {
   // Ensure the derived point is not the point at infinity
   // A private key of 0 or a multiple of the curve order would result in
@@ -587,20 +864,16 @@ const uint8_t *EcLogic::GetPublicKey() {
   return nullptr;
 }
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wpmf-conversions"
-EcLogic::EcLogic()
-    : genRandTask(800, (callback_t)&EcLogic::genRand, this),
-      finalizeTask(800, (callback_t)&EcLogic::finalizeSign, this) {}
-#pragma GCC diagnostic pop
-
 void EcLogic::SetPrivateKey(uint64_t privkey) {
   privateKey = privkey;
   privateKey = privateKey % g_curveOrder;
+  EcOperation *operation = freeOperation();
+  // Set once at boot, before anything's signed or verified.
+  my_assert(operation);
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-  g_point_mult_service.start(g_generator, privateKey,
-                             (callback_t)&EcLogic::onPubkeyDone, this);
+  operation->StartPubkey(privateKey, (callback_t)&EcLogic::onPubkeyDone,
+                         this);
 #pragma GCC diagnostic pop
 }
 
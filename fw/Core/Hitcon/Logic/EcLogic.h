@@ -11,6 +11,9 @@ namespace hitcon {
 
 namespace ecc {
 
+// Signs and verifies that can run at once, each with its own services.
+constexpr size_t EC_LOGIC_CONTEXTS = 2;
+
 namespace internal {
 
 class ModNum {
@@ -18,9 +21,10 @@ class ModNum {
 
  public:
   ModNum(uint64_t val, uint64_t mod);
+  ModNum(const ModNum &other) = default;
 
-  ModNum operator=(const uint64_t other);
-  ModNum operator=(const ModNum &other);
+  ModNum &operator=(const uint64_t other);
+  ModNum &operator=(const ModNum &other);
   ModNum operator-() const;
   ModNum operator+(const ModNum &other) const;
   ModNum operator-(const ModNum &other) const;
@@ -55,8 +59,6 @@ class ModMulService {
   ModMulContext context;
 };
 
-extern ModMulService g_mod_mul_service;
-
 /**
  * Context for performing res = (a / b) mod m.
  * Algorithm is taken from here:
@@ -75,9 +77,10 @@ class ModDivService {
  public:
   void start(uint64_t a, uint64_t b, uint64_t m, callback_t callback,
              void *callbackArg1);
-  ModDivService();
+  explicit ModDivService(ModMulService &modMul);
 
  private:
+  ModMulService &modMul;
   callback_t callback;
   void *callbackArg1;
   ModDivContext context;
@@ -89,20 +92,20 @@ class ModDivService {
   void onModMulDone(uint64_t *x);
 };
 
-extern ModDivService g_mod_div_service;
-
 struct EllipticCurve {
-  EllipticCurve(const uint64_t A, const uint64_t B);
+  constexpr EllipticCurve(const uint64_t A, const uint64_t B) : A(A), B(B) {}
   const uint64_t A, B;
 };
 
 class EcPoint {
   friend class PointAddService;
+  friend class PointMultService;
 
  public:
   EcPoint();
   EcPoint(const ModNum &x, const ModNum &y);
-  EcPoint operator=(const EcPoint &other);
+  EcPoint(const EcPoint &other) = default;
+  EcPoint &operator=(const EcPoint &other);
   EcPoint operator-() const;
   bool operator==(const EcPoint &other) const;
   /**
@@ -145,9 +148,11 @@ class PointAddService {
  public:
   void start(const EcPoint &a, const EcPoint &b, callback_t callback,
              void *callbackArg1);
-  PointAddService();
+  PointAddService(ModMulService &modMul, ModDivService &modDiv);
 
  private:
+  ModMulService &modMul;
+  ModDivService &modDiv;
   callback_t callback;
   void *callbackArg1;
   PointAddContext context;
@@ -165,38 +170,79 @@ class PointAddService {
   void finalize();
 };
 
-extern PointAddService g_point_add_service;
+/**
+ * A point in Jacobian coordinates, (X / Z^2, Y / Z^3) in affine ones, with X,
+ * Y and Z in Montgomery form mod the field. Z == 0 is the identity. Doubling
+ * and adding an affine point take no inversion.
+ */
+struct JacobianPoint {
+  uint64_t X, Y, Z;
+};
+
+/**
+ * An affine point with x and y in Montgomery form mod the field.
+ */
+struct AffinePoint {
+  uint64_t x, y;
+};
 
 /**
- * Context for res = p * times.
- * We do this similarly to modular exponentiation, where we iterate through 64
- * bits and do a point addition according to each bit.
+ * Context for res = p * times, or p * times + q * qTimes.
+ * The generator alone takes a comb: a table of the sums of 2^(16 i) G, and
+ * 16 doublings with an addition each. Otherwise the scalars are in wNAF and
+ * take tables of odd multiples, made at compile time for the generator and
+ * the server's public key, and just the point for any other. Two terms
+ * share the doublings, Shamir's trick. The sum is kept in Jacobian
+ * coordinates, with a single inversion at the end to get res.
  */
 struct PointMultContext {
-  EcPoint p;
+  // The comb, or each term's odd multiples.
+  const AffinePoint *table[2];
+  // The table of a point without one of its own.
+  AffinePoint point[2];
+  // wNAF digits, least significant first, up to 65 of them for 64 bits.
+  int8_t naf[2][65];
+  uint8_t terms;
+  bool comb;
+  // The scalar for the comb.
   uint64_t times;
+  JacobianPoint sum;
   EcPoint res;
-  // The iterator.
+  // Comb columns or digits left.
   uint8_t i;
-  PointMultContext();
 };
 
 class PointMultService {
  public:
   void start(const EcPoint &p, uint64_t times, callback_t callback,
              void *callbackArg1);
-  PointMultService();
+  // p * pTimes + q * qTimes.
+  void start(const EcPoint &p, uint64_t pTimes, const EcPoint &q,
+             uint64_t qTimes, callback_t callback, void *callbackArg1);
+  explicit PointMultService(ModDivService &modDiv);
 
  private:
+  ModDivService &modDiv;
   callback_t callback;
   void *callbackArg1;
   PointMultContext context;
   service::sched::Task routineTask;
+  void setTerm(const EcPoint &p, uint64_t times);
   void routineFunc();
-  void onAddDone(EcPoint *res);
+  void onInvDone(ModNum *zInv);
 };
 
-extern PointMultService g_point_mult_service;
+/**
+ * The services a sign or verify runs on, wired to each other. Each service
+ * does one thing at a time, so operations at once need an engine each.
+ */
+struct EcEngine {
+  ModMulService modMul;
+  ModDivService modDiv;
+  PointAddService pointAdd;
+  PointMultService pointMult;
+  EcEngine();
+};
 
 struct EcContext {
   // hash of the message
@@ -208,8 +254,6 @@ struct EcContext {
   uint64_t k;
   /* --- Verifying context --- */
   ModNum u1, u2;
-  // temporal storage for a point
-  EcPoint m;
   EcContext();
 };
 
@@ -237,6 +281,63 @@ struct Signature {
   void fromBuffer(const uint8_t *buffer);
 };
 
+namespace internal {
+
+/**
+ * A sign or verify, or the public key, on an engine of its own.
+ */
+class EcOperation {
+ public:
+  EcOperation();
+
+  bool StartSign(uint8_t const *message, uint32_t len, uint64_t privateKey,
+                 callback_t callback, void *callbackArg1);
+  bool StartVerify(uint8_t const *message, uint32_t len,
+                   uint8_t *signature, callback_t callback,
+                   void *callbackArg1);
+  // The callback gets the EcPoint, privateKey * G.
+  void StartPubkey(uint64_t privateKey, callback_t callback,
+                   void *callbackArg1);
+
+  /**
+   * Set from a start till the callback returns.
+   */
+  bool busy = false;
+
+ private:
+  EcEngine engine;
+  EcContext context;
+  uint64_t privateKey;
+  /**
+   * Temporary storage of signature.
+   * For the signing process, the data only lives since the signature completes
+   * (at the end of doSign) till the callback returns. For the verification
+   * process, the data lives since StartVerify is called till the callback
+   * returns.
+   */
+  ecc::Signature tmpSignature;
+
+  void genRand();
+  void onSignHashFinish(hitcon::hash::HashResult *hashResult);
+  void onVerifyHashFinish(hitcon::hash::HashResult *hashResult);
+  void onRGenerated(EcPoint *p);
+  void genS(uint64_t *pkR);
+  void onSGenerated(ModNum *s);
+  void finalizeSign();
+  void onU1Generated(ModNum *u1);
+  void onU2Generated(ModNum *u2);
+  void finalizeVerify(EcPoint *P);
+  void finalizePubkey(EcPoint *p);
+
+  callback_t callback;
+  void *callback_arg1;
+
+  service::sched::Task genRandTask;
+  service::sched::Task finalizeTask;
+};
+
+}  // namespace internal
+
 class EcLogic {
  public:
   EcLogic();
@@ -247,6 +348,7 @@ class EcLogic {
    * @param privkey: The private key.
    *
    * Note that this will automatically start the computation of public key.
+   * It takes one of the EC_LOGIC_CONTEXTS until that's done.
    */
   void SetPrivateKey(uint64_t privkey);
 
@@ -261,24 +363,25 @@ class EcLogic {
   const uint8_t *GetPublicKey();
 
   /**
-   * Start the signing process and mark this API as busy.
+   * Start the signing process on one of the EC_LOGIC_CONTEXTS.
    *
    * @param message:      the message to sign. The contents should be intact
    *                      until sign finishes.
    * @param len:          length of message.
    * @param callback:     callback function to call when the sign is complete.
    *                      The second argument to callback is a pointer to
-   *                      tmpSignature.
+   *                      the signature, valid during the callback.
    * @param callbackArg1: The first argument to the callback. Normally a
    *                      pointer to "this" if the callback is a method, and
    *                      nullptr if the callback is a function.
-   * @return              whether the job is successfully queued.
+   * @return              whether the job is successfully queued, false if
+   *                      all contexts are busy.
    */
   bool StartSign(uint8_t const *message, uint32_t len, callback_t callback,
                  void *callbackArg1);
 
   /**
-   * Start the verification process and mark this API as busy.
+   * Start the verification process on one of the EC_LOGIC_CONTEXTS.
    * This will only verify the signature against the server public key.
    *
    * @param message:      the message to verify. The contents should be intact
@@ -294,31 +397,17 @@ class EcLogic {
    * @param callbackArg1: The first argument to the callback. Normally a
    *                      pointer to "this" if the callback is a method, and
    *                      nullptr if the callback is a function.
-   * @return              whether the job is successfully queued.
+   * @return              whether the job is successfully queued, false if
+   *                      all contexts are busy.
    */
   bool StartVerify(uint8_t const *message, uint32_t len, uint8_t *signature,
                    callback_t callback, void *callbackArg1);
 
  private:
-  /**
-   * Indicates whether a sign / verify operation is running.
-   * If a task is active, this flag is set to true, and further requests to sign
-   * / verify will fail. If neither sign nor verify is running, this flag should
-   * be set to false.
-   */
-  bool busy = false;
-  /**
-   * Temporary storage of the random value used for sig generation.
-   */
-  uint64_t tmpRandValue;
-  /**
-   * Temporary storage of signature.
-   * For the signing process, the data only lives since the signature completes
-   * (at the end of doSign) till the callback returns. For the verification
-   * process, the data lives since StartVerify is called till the callback
-   * returns.
-   */
-  ecc::Signature tmpSignature;
+  internal::EcOperation operations[EC_LOGIC_CONTEXTS];
+
+  // A context that isn't busy, or nullptr.
+  internal::EcOperation *freeOperation();
 
   /**
    * The private key.
@@ -331,28 +420,7 @@ class EcLogic {
   uint8_t publicKey[ECC_PUBKEY_SIZE];
   uint8_t publicKeyReady = 0;
 
-  hitcon::ecc::internal::EcContext context;
-
-  void genRand();
-  void onSignHashFinish(hitcon::hash::HashResult *hashResult);
-  void onVerifyHashFinish(hitcon::hash::HashResult *hashResult);
-  void onRGenerated(internal::EcPoint *p);
-  void genS(uint64_t *pkR);
-  void onSGenerated(internal::ModNum *s);
-  void finalizeSign();
-  void onU1Generated(internal::ModNum *u1);
-  void onU2Generated(internal::ModNum *u2);
-  void onMGenerated(internal::EcPoint *m);
-  void onNGenerated(internal::EcPoint *n);
-  void finalizeVerify(internal::EcPoint *P);
-
   void onPubkeyDone(internal::EcPoint *p);
-
-  callback_t callback;
-  void *callback_arg1;
-
-  service::sched::Task genRandTask;
-  service::sched::Task finalizeTask;
 };
 
 extern EcLogic g_ec_logic;
@@ -0,0 +1,167 @@
+#ifndef LOGIC_EC_MOD_MUL_H_
+#define LOGIC_EC_MOD_MUL_H_
+
+#include <stdint.h>
+
+namespace hitcon {
+
+namespace ecc {
+
+namespace internal {
+
+// Montgomery multiplication for the curve's 56 bit moduli, with R = 2^64.
+// A product is two Montgomery multiplications, abR^-1 and then that times
+// R^2, so ModNum values stay in the normal form. PointMultService keeps its
+// coordinates in Montgomery form, aR mod m, and takes one each. It's all
+// constexpr, for the point tables made at compile time.
+// On the host the products are __uint128_t, on the Cortex-M3 they're built
+// from 32x32->64 UMULLs.
+
+// Use the constant time multiplications and final subtraction. UMULL on the
+// Cortex-M3 finishes early on small operands, so the constant time products
+// are made of 16x16->32 MULs instead, which always take a cycle. It's only
+// the modular multiplication though, PointMultService still branches on the
+// bits of the scalar.
+constexpr bool EC_MODMUL_CONSTANT_TIME = false;
+
+#ifdef __SIZEOF_INT128__
+constexpr bool EC_MODMUL_HAS_UINT128 = true;
+#else
+constexpr bool EC_MODMUL_HAS_UINT128 = false;
+#endif
+
+constexpr inline uint64_t modneg(const uint64_t x, const uint64_t m) {
+  return m - (x % m);
+}
+
+constexpr inline uint64_t modadd(const uint64_t a, const uint64_t b,
+                                 const uint64_t m) {
+  if (a > UINT64_MAX - b)
+    return modneg((modneg(a, m) + modneg(b, m)) % m, m);
+  else
+    return (a + b) % m;
+}
+
+constexpr inline uint64_t modsub(const uint64_t a, const uint64_t b,
+                                 const uint64_t m) {
+  if (a >= b)
+    return a - b;
+  else
+    return a + m - b;
+}
+
+// a + b mod m for a and b below m, without modadd()'s remainder.
+constexpr inline uint64_t modaddReduced(const uint64_t a, const uint64_t b,
+                                       const uint64_t m) {
+  return a >= m - b ? a - (m - b) : a + b;
+}
+
+struct MontModulus {
+  // Odd and below 2^62, so that a product before the final subtraction
+  // stays below 2m < 2^64.
+  uint64_t m;
+  // -m^-1 mod 2^64.
+  uint64_t mNegInv;
+  // R mod m, 1 in Montgomery form.
+  uint64_t one;
+  // R^2 mod m.
+  uint64_t r2;
+
+  constexpr explicit MontModulus(uint64_t m)
+      : m(m), mNegInv(0), one(0), r2(1) {
+    // Newton's iteration, m is its own inverse mod 2^3 and every round
+    // doubles the bits that are right.
+    uint64_t inv = m;
+    for (int i = 0; i < 5; i++) inv *= 2 - m * inv;
+    mNegInv = 0 - inv;
+    for (int i = 0; i < 128; i++) {
+      if (i == 64) one = r2;
+      r2 <<= 1;
+      if (r2 >= m) r2 -= m;
+    }
+  }
+};
+
+constexpr inline uint64_t mul32(uint32_t a, uint32_t b,
+                                bool constantTime) {
+  if (!constantTime) return static_cast<uint64_t>(a) * b;
+  const uint32_t al = a & 0xFFFF, ah = a >> 16;
+  const uint32_t bl = b & 0xFFFF, bh = b >> 16;
+  const uint64_t mid = static_cast<uint64_t>(al * bh) + ah * bl;
+  return (static_cast<uint64_t>(ah * bh) << 32) + (mid << 16) + al * bl;
+}
+
+// a * b, the high half in *hi.
+constexpr inline uint64_t mul64(uint64_t a, uint64_t b, uint64_t *hi,
+                                bool constantTime, bool limbs) {
+#ifdef __SIZEOF_INT128__
+  if (!limbs) {
+    const __uint128_t t = static_cast<__uint128_t>(a) * b;
+    *hi = t >> 64;
+    return t;
+  }
+#endif
+  const uint32_t a0 = a, a1 = a >> 32, b0 = b, b1 = b >> 32;
+  const uint64_t p00 = mul32(a0, b0, constantTime);
+  const uint64_t p01 = mul32(a0, b1, constantTime);
+  const uint64_t p10 = mul32(a1, b0, constantTime);
+  const uint64_t p11 = mul32(a1, b1, constantTime);
+  // Can't overflow, (2^32 - 1)^2 + 2 * (2^32 - 1) < 2^64.
+  const uint64_t mid = (p00 >> 32) + static_cast<uint32_t>(p01) +
+                       static_cast<uint32_t>(p10);
+  *hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+  return (mid << 32) | static_cast<uint32_t>(p00);
+}
+
+// The low half of a * b, only a 32x32->64 and two 32x32->32 on the badge.
+constexpr inline uint64_t mullo64(uint64_t a, uint64_t b, bool constantTime,
+                                  bool limbs) {
+  if (EC_MODMUL_HAS_UINT128 && !limbs) return a * b;
+  const uint32_t a0 = a, a1 = a >> 32, b0 = b, b1 = b >> 32;
+  return mul32(a0, b0, constantTime) +
+         (static_cast<uint64_t>(a0 * b1 + a1 * b0) << 32);
+}
+
+// a * b * R^-1 mod m, for a and b below m. limbs takes the 32 bit path on
+// the host too.
+constexpr inline uint64_t montMul(uint64_t a, uint64_t b,
+                                  const MontModulus &mod,
+                                  bool constantTime = EC_MODMUL_CONSTANT_TIME,
+                                  bool limbs = !EC_MODMUL_HAS_UINT128) {
+  uint64_t th = 0, uh = 0;
+  const uint64_t tl = mul64(a, b, &th, constantTime, limbs);
+  const uint64_t u = mullo64(tl, mod.mNegInv, constantTime, limbs);
+  mul64(u, mod.m, &uh, constantTime, limbs);
+  // The low halves add up to 2^64, or to 0 if tl is 0.
+  const uint64_t res = th + uh + ((tl | (0 - tl)) >> 63);
+  if (!constantTime) return res >= mod.m ? res - mod.m : res;
+  // res < 2m < 2^63, so the MSB is the borrow.
+  const uint64_t d = res - mod.m;
+  return d + (mod.m & (0 - (d >> 63)));
+}
+
+// a * b mod m, for a and b below m.
+constexpr inline uint64_t modMul(uint64_t a, uint64_t b,
+                                 const MontModulus &mod,
+                                 bool constantTime = EC_MODMUL_CONSTANT_TIME,
+                                 bool limbs = !EC_MODMUL_HAS_UINT128) {
+  return montMul(montMul(a, b, mod, constantTime, limbs), mod.r2, mod,
+                 constantTime, limbs);
+}
+
+// a in Montgomery form, aR mod m.
+constexpr inline uint64_t toMont(uint64_t a, const MontModulus &mod) {
+  return montMul(a, mod.r2, mod);
+}
+
+constexpr inline uint64_t fromMont(uint64_t a, const MontModulus &mod) {
+  return montMul(a, 1, mod);
+}
+
+}  // namespace internal
+
+}  // namespace ecc
+
+}  // namespace hitcon
+
+#endif  // LOGIC_EC_MOD_MUL_H_
@@ -9,6 +9,7 @@
 #include <Logic/IrController.h>
 #include <Logic/RandomPool.h>
 #include <Logic/XBoardLogic.h>
+#include <Logic/crc32.h>
 #include <Service/HashService.h>
 #include <Service/IrService.h>
 #include <Service/Sched/Scheduler.h>
@@ -28,6 +29,10 @@ namespace {
 
 static char SURPRISE_NAME[] = "You got pwned!";
 
+// Ack timeouts in a row, without an ack from a base station that knows
+// packet IDs in between, before going back to hashing packets.
+constexpr uint8_t kAckByIdMaxTimeouts = 8;
+
 }  // anonymous namespace
 
 IrController irController;
@@ -36,7 +41,9 @@ IrController irController;
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
 IrController::IrController()
     : routine_task(950, (callback_t)&IrController::RoutineTask, this, 1000),
-      broadcast_task(800, (callback_t)&IrController::BroadcastIr, this) {}
+      broadcast_task(800, (callback_t)&IrController::BroadcastIr, this) {
+  for (size_t i = 0; i < RETX_ACK_INDEX_SIZE; i++) ack_index_[i] = -1;
+}
 #pragma GCC diagnostic pop
 
 void IrController::ShowText(char* text) {
@@ -78,7 +85,11 @@ void IrController::OnPacketReceived(void* arg) {
       ShowText(data->opaq.show_msg.msg);
     }
   } else if (data->type == packet_type::kAcknowledge) {
+    if (data->ttl & IR_TTL_ACK_BY_ID) OnAckByIdSupported();
     OnAcknowledgePacket(&data->opaq.acknowledge);
+  } else if (data->type == packet_type::kAcknowledgeBatch) {
+    if (data->ttl & IR_TTL_ACK_BY_ID) OnAckByIdSupported();
+    OnAcknowledgeBatchPacket(&data->opaq.acknowledge_batch);
   } else if (data->type == packet_type::kScoreAnnounce) {
     const uint8_t* user = g_game_controller.GetUsername();
     if (user &&
@@ -98,20 +109,57 @@ void IrController::OnPacketReceived(void* arg) {
   }
 }
 
+void IrController::OnAckByIdSupported() {
+  ack_by_id_ = true;
+  ack_by_id_timeouts_ = 0;
+}
+
 void IrController::OnAcknowledgePacket(AcknowledgePacket* pckt) {
-  for (int i = 0; i < RETX_QUEUE_SIZE; i++) {
-    uint8_t status = queued_packets_[i].status;
-    if ((status & kRetransmitStatusMask) == kRetransmitStatusWaitTxSlot ||
-        (status & kRetransmitStatusMask) == kRetransmitStatusWaitAck) {
-      if (memcmp(queued_packets_[i].hash, pckt->packet_hash, PACKET_HASH_LEN) ==
-          0) {
-        AckTag ack = queued_packets_[i].ack_tag;
-        OnAcknowledgeTag(ack);
-        // Received, no longer need to retransmit.
-        queued_packets_[i].status =
-            (queued_packets_[i].status & (~kRetransmitStatusMask));
-      }
+  OnAcknowledgeHash(pckt->packet_hash, PACKET_HASH_LEN);
+}
+
+void IrController::OnAcknowledgeBatchPacket(AcknowledgeBatchPacket* pckt) {
+  size_t count = pckt->count;
+  if (count > ACK_BATCH_MAX) count = ACK_BATCH_MAX;
+  for (size_t i = 0; i < count; i++) {
+    OnAcknowledgeHash(pckt->packet_hash[i], ACK_BATCH_HASH_LEN);
+  }
+}
+
+void IrController::OnAcknowledgeHash(const uint8_t* hash, size_t len) {
+  // Only slots waiting for the tx slot or an ack are in the index.
+  int i = ack_index_[hash[0] % RETX_ACK_INDEX_SIZE];
+  while (i != -1) {
+    int next = queued_packets_[i].ack_next;
+    if (memcmp(queued_packets_[i].hash, hash, len) == 0) {
+      AckTag ack = queued_packets_[i].ack_tag;
+      OnAcknowledgeTag(ack);
+      if (!SendsToXboard()) irService.mac.OnAck();
+      // Received, no longer need to retransmit.
+      RemoveFromAckIndex(i);
+      queued_packets_[i].status =
+          (queued_packets_[i].status & (~kRetransmitStatusMask));
     }
+    i = next;
+  }
+}
+
+void IrController::AddToAckIndex(int slot) {
+  int8_t& head =
+      ack_index_[queued_packets_[slot].hash[0] % RETX_ACK_INDEX_SIZE];
+  queued_packets_[slot].ack_next = head;
+  head = slot;
+}
+
+void IrController::RemoveFromAckIndex(int slot) {
+  int8_t* link =
+      &ack_index_[queued_packets_[slot].hash[0] % RETX_ACK_INDEX_SIZE];
+  while (*link != -1) {
+    if (*link == slot) {
+      *link = queued_packets_[slot].ack_next;
+      return;
+    }
+    link = &queued_packets_[*link].ack_next;
   }
 }
 
@@ -126,7 +174,20 @@ void IrController::OnAcknowledgeTag(AckTag tag) {
   }
 }
 
-int IrController::prob_f(int lf) { return v[0] * lf * lf + v[1] * lf + v[2]; }
+void IrController::SetProbParams(uint8_t a, uint8_t b, uint8_t c) {
+  irService.mac.SetPersistence(a, b, c);
+}
+
+bool IrController::SendsToXboard() {
+  return g_xboard_logic.GetConnectState() ==
+         UsartConnectState::ConnectBaseStn2025;
+}
+
+void IrController::SetRetransmitTiming(uint16_t base, uint16_t jitter) {
+  my_assert(jitter / 2 <= base);
+  retx_wait_base_ = base;
+  retx_wait_jitter_ = jitter;
+}
 
 void IrController::RoutineTask(void* unused) {
   // remove generating random number
@@ -141,14 +202,96 @@ void IrController::OnPacketHashResult(void* arg_ptr) {
   memcpy(&(queued_packets_[current_hashing_slot].hash[0]), hash_result->digest,
          PACKET_HASH_LEN);
   my_assert(PACKET_HASH_LEN <= hash_result->size);
+  AddToAckIndex(current_hashing_slot);
   uint8_t status = queued_packets_[current_hashing_slot].status;
   // Update status to Waiting for IrController's tx slot
   status = (status & (~kRetransmitStatusMask)) | kRetransmitStatusWaitTxSlot;
   queued_packets_[current_hashing_slot].status =
       status;  // Update the struct member
+  int slot = current_hashing_slot;
   current_hashing_slot = -1;
+  // No need to wait for the next RoutineTask().
+  if (irLogic.AvailableToSend()) current_tx_slot = -1;
+  TransmitSlot(slot);
+  for (int i = 0; i < static_cast<int>(RETX_QUEUE_SIZE); i++) {
+    if ((queued_packets_[i].status & kRetransmitStatusMask) ==
+        kRetransmitStatusWaitHashAvail) {
+      StartSlotHash(i);
+      break;
+    }
+  }
 }
 
+bool IrController::StartSlotHash(int slot) {
+  if (current_hashing_slot != -1) return false;
+  RetransmittableIrPacket& pckt = queued_packets_[slot];
+  // Start hashing the payload.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpmf-conversions"
+  bool ret = hitcon::hash::g_hash_service.StartHash(
+      pckt.data, pckt.size, (callback_t)&IrController::OnPacketHashResult,
+      this);
+#pragma GCC diagnostic pop
+  // If ret is false, hash service was busy, will try again next RoutineTask
+  // cycle.
+  if (!ret) return false;
+  // Hashing started successfully. Update status to Waiting for hash
+  // processor to finish.
+  pckt.status =
+      (pckt.status & ~kRetransmitStatusMask) | kRetransmitStatusWaitHashDone;
+  current_hashing_slot = slot;  // Mark this slot as being currently hashed.
+  return true;
+}
+
+void IrController::PrepareSlot(int slot) {
+  RetransmittableIrPacket& pckt = queued_packets_[slot];
+  uint8_t retries = pckt.status & kRetransmitLimitMask;
+  if (!ack_by_id_) {
+    pckt.data[0] = 0;
+    pckt.status = kRetransmitStatusWaitHashAvail | retries;
+    // HashService queues it if it's busy with others.
+    StartSlotHash(slot);
+    return;
+  }
+  // The ID is known right away, the packet can go out without waiting for
+  // the hash service.
+  pckt.data[0] = IR_TTL_ACK_BY_ID | (tx_seq_++ & IR_TTL_SEQ_MASK);
+  uint32_t crc = crc32(pckt.data, pckt.size);
+  static_assert(PACKET_HASH_LEN == sizeof(crc) + 2);
+  memcpy(pckt.hash, &crc, sizeof(crc));
+  pckt.hash[4] = pckt.data[0];
+  pckt.hash[5] = pckt.size;
+  pckt.status = kRetransmitStatusWaitTxSlot | retries;
+  AddToAckIndex(slot);
+}
+
+bool IrController::TransmitSlot(int slot) {
+  if (current_tx_slot != -1) return false;
+  RetransmittableIrPacket& pckt = queued_packets_[slot];
+  bool ret;
+  if (SendsToXboard()) {
+    ret = g_xboard_logic.SendIRPacket(&(pckt.data[0]), pckt.size);
+  } else {
+    ret = irLogic.SendPacket(&(pckt.data[0]), pckt.size);
+  }
+  // If ret is false, irLogic was busy, will try again next RoutineTask
+  // cycle.
+  if (!ret) return false;
+  // Packet successfully queued for transmission by irLogic.
+  current_tx_slot = slot;  // Mark this slot as currently being transmitted.
+  // Update status to Waiting for ACK.
+  pckt.status =
+      (pckt.status & ~kRetransmitStatusMask) | kRetransmitStatusWaitAck;
+  // Set the timer for waiting for an acknowledgment packet.
+  pckt.time_to_retry = retx_wait_base_;
+  if (retx_wait_jitter_) {
+    pckt.time_to_retry += retx_wait_jitter_ / 2 -
+                          (g_fast_random_pool.GetRandom() % retx_wait_jitter_);
+  }
+  return true;
+}
+
+// - if the same packet is already queued, leave it be
 // - if there's empty slot, use it
 // - else if there are same packet_type: replaced with the new one  (only
 // RequestScore, SavePet)
@@ -172,6 +315,12 @@ bool IrController::SendPacketWithRetransmit(uint8_t* data, size_t len,
     } else {
       const IrData* queued_ir_data =
           reinterpret_cast<IrData*>(queued_packets_[i].data);
+      // The ttl byte differs once it's numbered for acks by ID. Acks by hash
+      // would take care of both copies at once, do the same with IDs.
+      if (queued_packets_[i].size == len &&
+          memcmp(queued_packets_[i].data + 1, data + 1, len - 1) == 0) {
+        return true;
+      }
       if ((input_ir_data->type == packet_type::kRequestScore ||
            input_ir_data->type == packet_type::kSavePet) &&
           queued_ir_data->type == input_ir_data->type) {
@@ -189,18 +338,30 @@ bool IrController::SendPacketWithRetransmit(uint8_t* data, size_t len,
   }
 
   if (available_index < RETX_QUEUE_SIZE) {
+    uint8_t replaced_status =
+        queued_packets_[available_index].status & kRetransmitStatusMask;
     // stop hash if the replaced slot is waiting for hash done
-    if ((queued_packets_[available_index].status & kRetransmitStatusMask) ==
-        kRetransmitStatusWaitHashDone) {
-      hash::g_hash_service.StopHash();
+    if (replaced_status == kRetransmitStatusWaitHashDone) {
+      hash::g_hash_service.StopHash(this);
+      // The callback won't come, let the next slot have the hash service.
+      current_hashing_slot = -1;
+    } else if (replaced_status == kRetransmitStatusWaitTxSlot ||
+               replaced_status == kRetransmitStatusWaitAck) {
+      RemoveFromAckIndex(available_index);
     }
 
     memcpy(&(queued_packets_[available_index].data[0]), data, len);
     queued_packets_[available_index].size = len;
-    // Set status to Waiting for hashing processor and store retry limit
-    queued_packets_[available_index].status =
-        kRetransmitStatusWaitHashAvail | (retries & kRetransmitLimitMask);
+    // Store the retry limit, then wait for the hashing processor or the tx
+    // slot.
+    queued_packets_[available_index].status = retries & kRetransmitLimitMask;
     queued_packets_[available_index].ack_tag = ack_tag;
+    PrepareSlot(available_index);
+    if (ack_by_id_) {
+      // Straight on air if nothing else is being sent.
+      if (irLogic.AvailableToSend()) current_tx_slot = -1;
+      TransmitSlot(available_index);
+    }
     return true;
   }
   return false;  // No available slot found
@@ -221,7 +382,6 @@ void IrController::MaintainQueued() {
 
     // Get the current status and other packet info.
     uint8_t current_status = queued_packets_[i].status & kRetransmitStatusMask;
-    uint8_t pckt_size = queued_packets_[i].size;
     // This is the payload data within the struct.
     uint8_t* pckt_data = &(queued_packets_[i].data[0]);
 
@@ -229,66 +389,29 @@ void IrController::MaintainQueued() {
       // Slot is unused. Do nothing.
     } else if (current_status == kRetransmitStatusWaitHashAvail) {
       // Waiting for hash processor to be available.
-      if (current_hashing_slot == -1) {
-        // Start hashing the payload.
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wpmf-conversions"
-        bool ret = hitcon::hash::g_hash_service.StartHash(
-            pckt_data, pckt_size, (callback_t)&IrController::OnPacketHashResult,
-            this);
-#pragma GCC diagnostic pop
-        if (ret) {
-          // Hashing started successfully. Update status to Waiting for hash
-          // processor to finish.
-          queued_packets_[i].status =
-              (queued_packets_[i].status & ~kRetransmitStatusMask) |
-              kRetransmitStatusWaitHashDone;
-          current_hashing_slot =
-              i;  // Mark this slot as being currently hashed.
-        }
-        // If ret is false, hash service was busy, will try again next
-        // RoutineTask cycle.
-      }
+      StartSlotHash(i);
     } else if (current_status == kRetransmitStatusWaitHashDone) {
       // Waiting for hash processor to finish.
       // The OnPacketHashResult callback will change the status to
       // kRetransmitStatusWaitTxSlot once hashing is complete and the hash is
       // stored. Do nothing here.
     } else if (current_status == kRetransmitStatusWaitTxSlot) {
-      // Waiting for IrController's tx slot to open up. (Hash is ready)
-      if (current_tx_slot == -1) {
-        bool ret;
-        if (g_xboard_logic.GetConnectState() ==
-            UsartConnectState::ConnectBaseStn2025) {
-          ret = g_xboard_logic.SendIRPacket(&(queued_packets_[i].data[0]),
-                                            queued_packets_[i].size);
-        } else {
-          ret = irLogic.SendPacket(&(queued_packets_[i].data[0]),
-                                   queued_packets_[i].size);
-        }
-        if (ret) {
-          // Packet successfully queued for transmission by irLogic.
-          current_tx_slot =
-              i;  // Mark this slot as currently being transmitted.
-          // Update status to Waiting for ACK.
-          queued_packets_[i].status =
-              (queued_packets_[i].status & ~kRetransmitStatusMask) |
-              kRetransmitStatusWaitAck;
-          // Set the timer for waiting for an acknowledgment packet.
-          queued_packets_[i].time_to_retry =
-              600 + 200 - (g_fast_random_pool.GetRandom() % 400);
-        }
-        // If ret is false, irLogic was busy, will try again next RoutineTask
-        // cycle.
-      }
+      // Waiting for IrController's tx slot to open up. (Hash or ID is ready)
+      TransmitSlot(i);
     } else if (current_status == kRetransmitStatusWaitAck) {
       // Waiting for ACK. Check the retry timer.
       if (queued_packets_[i].time_to_retry == 0) {
         // Timer elapsed, no ACK received. Check if retries are left.
+        if (!SendsToXboard()) irService.mac.OnAckTimeout();
+        if (ack_by_id_ && ++ack_by_id_timeouts_ >= kAckByIdMaxTimeouts) {
+          // The base stations around might not know packet IDs after all.
+          ack_by_id_ = false;
+        }
         uint8_t counts = queued_packets_[i].status &
                          kRetransmitLimitMask;  // Get remaining retry count.
         if (counts == 0) {
           // No more retries left. Mark this slot as unused.
+          RemoveFromAckIndex(i);
           queued_packets_[i].status = kRetransmitStatusSlotUnused;
         } else {
           // Retries left. Decrement the count and transition back to waiting
@@ -301,6 +424,11 @@ void IrController::MaintainQueued() {
           queued_packets_[i].status =
               (queued_packets_[i].status & ~kRetransmitStatusMask) |
               kRetransmitStatusWaitTxSlot;  // Update status.
+          if (((pckt_data[0] & IR_TTL_ACK_BY_ID) != 0) != ack_by_id_) {
+            // Acks are matched the other way now, identify it again.
+            RemoveFromAckIndex(i);
+            PrepareSlot(i);
+          }
         }
       } else {
         // Timer is still counting down. Decrement it.
@@ -369,6 +497,11 @@ uint16_t IrController::GetSlotTimeToRetryForDebug(uint8_t slot_index) const {
   return queued_packets_[slot_index].time_to_retry;
 }
 
+uint8_t IrController::GetSlotSeqForDebug(uint8_t slot_index) const {
+  if (slot_index >= RETX_QUEUE_SIZE) return 0;
+  return queued_packets_[slot_index].data[0];
+}
+
 void IrController::ForceRetransmitForDebug(uint8_t slot_index) {
   if (slot_index >= RETX_QUEUE_SIZE) return;
   if ((queued_packets_[slot_index].status & kRetransmitStatusMask) ==
@@ -30,6 +30,7 @@ enum class packet_type : uint8_t {
   kRequestScore = 11,
   kSavePet = 12,
   kRestorePet = 13,
+  kAcknowledgeBatch = 14,
 };
 
 // smaller value means higher priority
@@ -37,7 +38,7 @@ enum class packet_type : uint8_t {
 constexpr uint8_t RETX_LOWEST_PKT_PRIORITY = 0xF0;
 constexpr uint8_t RETX_EMPTY_PKT_PRIORITY = 0xF1;
 constexpr uint8_t RETX_REPLACEMENT_PKT_PRIORITY = 0xF2;
-constexpr uint8_t packet_priority[14] = {
+constexpr uint8_t packet_priority[15] = {
     RETX_LOWEST_PKT_PRIORITY,  // kGame
     RETX_LOWEST_PKT_PRIORITY,  // kShow
     RETX_LOWEST_PKT_PRIORITY,  // kTest
@@ -51,10 +52,11 @@ constexpr uint8_t packet_priority[14] = {
     RETX_LOWEST_PKT_PRIORITY,  // kShowMsg
     4,                         // kRequestScore
     5,                         // kSavePet
-    RETX_LOWEST_PKT_PRIORITY   // kRestorePet
+    RETX_LOWEST_PKT_PRIORITY,  // kRestorePet
+    RETX_LOWEST_PKT_PRIORITY   // kAcknowledgeBatch
 };
 constexpr uint8_t GetPriority(packet_type type) {
-  if (type < packet_type::kGame || type > packet_type::kRestorePet)
+  if (type < packet_type::kGame || type > packet_type::kAcknowledgeBatch)
     return RETX_LOWEST_PKT_PRIORITY;
   return packet_priority[static_cast<uint8_t>(type)];
 }
@@ -76,6 +78,13 @@ struct ShowPacket {
 };
 
 constexpr size_t PACKET_HASH_LEN = 6;
+// The ttl byte of packets that wait for an ack. Set on a packet, it's acked
+// by its ID instead of the hash: the CRC-32 of the packet in little-endian,
+// then the ttl byte and the size. The low bits number the packets of a badge,
+// so that a retransmit sent again as a new packet doesn't share an ID with
+// the old one. Base stations that know packet IDs set it on their acks.
+constexpr uint8_t IR_TTL_ACK_BY_ID = 0x80;
+constexpr uint8_t IR_TTL_SEQ_MASK = 0x7F;
 // Currently we set the username to be the lower 32 bit (first 4 bytes in
 // little-endian) of public key. Might switch to the hash of pubkey if there's
 // concerns of collisions.
@@ -83,10 +92,22 @@ constexpr size_t IR_USERNAME_LEN = 4;
 
 // This packet acknowledges a particular packet has been received.
 struct AcknowledgePacket {
-  // Hash of the packet being acknowledge.
+  // Hash or ID of the packet being acknowledge.
   uint8_t packet_hash[PACKET_HASH_LEN];
 };
 
+constexpr size_t ACK_BATCH_HASH_LEN = 4;
+constexpr size_t ACK_BATCH_MAX = 6;
+
+// This packet acknowledges up to ACK_BATCH_MAX packets at once, possibly from
+// different badges. The base station sends it instead of several
+// AcknowledgePacket when it has more than one ack pending.
+struct AcknowledgeBatchPacket {
+  uint8_t count;
+  // The first ACK_BATCH_HASH_LEN bytes of each hash, count of them.
+  uint8_t packet_hash[ACK_BATCH_MAX][ACK_BATCH_HASH_LEN];
+};
+
 // This packet is from the badge, saying I'm here to the base station.
 struct ProximityPacket {
   uint8_t user[IR_USERNAME_LEN];
@@ -183,6 +204,7 @@ struct IrData {
     struct GamePacket game;
     struct ShowPacket show;
     struct AcknowledgePacket acknowledge;
+    struct AcknowledgeBatchPacket acknowledge_batch;
     struct ProximityPacket proximity;
     struct PubAnnouncePacket pub_announce;
     struct TwoBadgeActivityPacket two_activity;
@@ -197,7 +219,12 @@ struct IrData {
 };
 static_assert(sizeof(IrData) < 32);
 
-constexpr size_t RETX_QUEUE_SIZE = 4;
+// Packets can wait for their acks at the same time, each with its own
+// retransmit timer.
+constexpr size_t RETX_QUEUE_SIZE = 8;
+// Buckets of slots by the first byte of their hash, to find the slot an ack
+// is for. A power of 2.
+constexpr size_t RETX_ACK_INDEX_SIZE = 16;
 
 constexpr uint8_t kRetransmitLimitMask = 0x07;
 constexpr uint8_t kRetransmitStatusMask = 0xe0;
@@ -227,7 +254,10 @@ struct RetransmittableIrPacket {
   // In units of IR Retry task calls.
   uint8_t size;
   uint8_t data[MAX_PACKET_PAYLOAD_BYTES + 4];
+  // The hash or the ID of data, whichever the acks will carry.
   uint8_t hash[PACKET_HASH_LEN];
+  // The next slot in the same ack index bucket, or -1.
+  int8_t ack_next;
 };
 
 class IrController {
@@ -255,14 +285,24 @@ class IrController {
   uint8_t GetSlotPacketTypeForDebug(uint8_t slot_index) const;
   uint8_t GetSlotRetryCountForDebug(uint8_t slot_index) const;
   uint16_t GetSlotTimeToRetryForDebug(uint8_t slot_index) const;
+  // The ttl byte, which changes whenever the packet gets a new ID.
+  uint8_t GetSlotSeqForDebug(uint8_t slot_index) const;
+  // Packets are acked by ID rather than hash.
+  bool AcksByIdForDebug() const { return ack_by_id_; }
 
   void ForceRetransmitForDebug(uint8_t slot_index);
 
+  // Tuning knobs, mainly for trying out values in the network simulator.
+  void SetProbParams(uint8_t a, uint8_t b, uint8_t c);
+  // Wait for an ack for base +/- jitter/2 RoutineTask() calls before
+  // retransmitting.
+  void SetRetransmitTiming(uint16_t base, uint16_t jitter);
+
  private:
   bool send_lock = true;
   bool recv_lock = true;
-  // TODO: Tune the quadratic function parameters
-  uint8_t v[3] = {1, 27, 111};
+  uint16_t retx_wait_base_ = 600;
+  uint16_t retx_wait_jitter_ = 400;
   bool disable_broadcast = false;
 
   // Number of packets received, primarily for debugging.
@@ -275,8 +315,16 @@ class IrController {
   size_t priority_data_len_ = 0;
 
   RetransmittableIrPacket queued_packets_[RETX_QUEUE_SIZE];
+  // The first slot of each bucket, or -1. Slots are in here from when their
+  // hash is done until they're unused or replaced.
+  int8_t ack_index_[RETX_ACK_INDEX_SIZE];
   int current_hashing_slot = -1;
   int current_tx_slot = -1;
+  // A base station nearby acks packets by their ID, so there's no need to
+  // hash them.
+  bool ack_by_id_ = false;
+  uint8_t ack_by_id_timeouts_ = 0;
+  uint8_t tx_seq_ = 0;
 
   // Called every 1s.
   void RoutineTask(void* unused);
@@ -284,7 +332,8 @@ class IrController {
   // Called on every packet.
   void OnPacketReceived(void* arg);
 
-  int prob_f(int);
+  // Packets go to the base station over the xboard instead of IR.
+  bool SendsToXboard();
 
   void BroadcastIr(void* unused);
   void SendShowPacket(char* msg);
@@ -296,6 +345,23 @@ class IrController {
 
   // Called when we received an acknowledgment packet.
   void OnAcknowledgePacket(AcknowledgePacket* pckt);
+  void OnAcknowledgeBatchPacket(AcknowledgeBatchPacket* pckt);
+  // The packet whose hash starts with the `len` bytes at `hash` is
+  // acknowledged, if it's still waiting for one.
+  void OnAcknowledgeHash(const uint8_t* hash, size_t len);
+  void AddToAckIndex(int slot);
+  void RemoveFromAckIndex(int slot);
+  // Got an ack from a base station that knows packet IDs.
+  void OnAckByIdSupported();
+  // Number the packet in slot and work out its ID if acks are by ID, then
+  // it's ready to send. Otherwise it waits for the hash.
+  void PrepareSlot(int slot);
+  // Hash the packet in slot if no other slot is being hashed, returns true if
+  // it's started.
+  bool StartSlotHash(int slot);
+  // Send the packet in slot if nothing else is being sent, returns true if
+  // it's on its way.
+  bool TransmitSlot(int slot);
   // Called by HashProcessor when hashing finished.
   void OnPacketHashResult(void* hash_result);
 
@@ -0,0 +1,363 @@
+#include <Logic/IrDecoder.h>
+#include <Logic/IrFec.h>
+#include <Service/Sched/Checks.h>
+
+#include <cstring>
+
+using hitcon::service::sched::my_assert;
+
+namespace hitcon {
+namespace ir {
+
+namespace {
+
+enum PACKET_STATE {
+  STATE_START = 0,
+  STATE_SIZE = 1,
+  STATE_DATA = 2,
+  STATE_CHKSUM = 3,
+  STATE_RESET = 4,
+  STATE_PARITY = 5,
+};
+
+enum BIT_STATE {
+  BIT_OFF = 0,
+  BIT_ON = 1,
+  BIT_INVALID = 2,
+};
+
+static_assert(DECODE_SAMPLE_RATIO == 4, "A byte of samples is two bits.");
+
+constexpr uint8_t DecodeNibble(uint8_t x) {
+  uint8_t cnt = (x & 1) + ((x >> 1) & 1) + ((x >> 2) & 1) + ((x >> 3) & 1);
+  return cnt < 2 ? BIT_OFF : (cnt > 2 ? BIT_ON : BIT_INVALID);
+}
+
+// The two bits of a byte of samples: the low nibble's in bit 0-1 and the
+// high nibble's in bit 2-3, each a BIT_STATE.
+struct MajorityTable {
+  uint8_t bits[256];
+  constexpr MajorityTable() : bits() {
+    for (int i = 0; i < 256; i++) {
+      bits[i] = DecodeNibble(i & 0xF) | (DecodeNibble(i >> 4) << 2);
+    }
+  }
+};
+
+constexpr MajorityTable kMajority;
+
+constexpr uint32_t Reverse32(uint32_t x) {
+  uint32_t ret = 0;
+  for (int i = 0; i < 32; i++) {
+    ret = (ret << 1) | ((x >> i) & 1);
+  }
+  return ret;
+}
+
+// The header in window order, the latest sample in bit 31.
+constexpr uint32_t kHeaderMask = Reverse32(IR_PACKET_HEADER_MASK);
+constexpr uint32_t kHeaderPattern =
+    Reverse32(IR_PACKET_HEADER_PACKED & IR_PACKET_HEADER_MASK);
+constexpr uint32_t kFecHeaderMask = Reverse32(IR_PACKET_HEADER_FEC_MASK);
+constexpr uint32_t kFecHeaderPattern =
+    Reverse32(IR_PACKET_HEADER_FEC_PACKED & IR_PACKET_HEADER_FEC_MASK);
+// The earliest sample of the FEC header.
+constexpr uint32_t kFecHeaderFirst = kFecHeaderMask & -kFecHeaderMask;
+static_assert(IR_PACKET_HEADER_MASK <= UINT32_MAX);
+static_assert(IR_PACKET_HEADER_FEC_MASK <= UINT32_MAX);
+
+}  // namespace
+
+IrDecoder::IrDecoder()
+    : state_(STATE_START),
+      bits_(0),
+      bits_cnt_(0),
+      field_cnt_(0),
+      window_(0),
+      soft_(false),
+      soft_repair_(false),
+      fec_receive_(true),
+      fec_(false),
+      prev_(0),
+      phase_err_(0),
+      erasure_cnt_(0) {
+  memset(packet_.data_, 0, sizeof(packet_.data_));
+  packet_.size_ = 0;
+}
+
+void IrDecoder::Reset() {
+  state_ = STATE_START;
+  bits_ = 0;
+  bits_cnt_ = 0;
+  field_cnt_ = 0;
+  window_ = 0;
+}
+
+uint8_t IrDecoder::OnBit(uint8_t bit) {
+  if (bit == BIT_INVALID) {
+    uint8_t pos = packet_.size_ - 1;
+    if (state_ == STATE_DATA) pos = field_cnt_ / 8 + 1;
+    if (state_ == STATE_PARITY) pos = packet_.size_ + field_cnt_ / 8;
+    if (fec_) {
+      // Hamming takes care of the size, Reed-Solomon of a byte at a time
+      // and of the bad bits it is not told about.
+      if (state_ != STATE_SIZE && erasure_cnt_ < IR_FEC_PARITY_BYTES &&
+          (!erasure_cnt_ || erasures_[erasure_cnt_ - 1] / 8 != pos)) {
+        erasures_[erasure_cnt_++] = pos * 8 + field_cnt_ % 8;
+      }
+      bit = BIT_OFF;
+    } else if (soft_ && soft_repair_ && state_ != STATE_SIZE &&
+               erasure_cnt_ < kMaxErasures) {
+      erasures_[erasure_cnt_++] = pos * 8 + field_cnt_ % 8;
+      bit = BIT_OFF;
+    } else {
+      // decode error, which costs the rest of the buffer in the size.
+      uint8_t ret = state_ == STATE_SIZE && !soft_ ? kDropBuffer : 0;
+      state_ = STATE_RESET;
+      return ret;
+    }
+  }
+  switch (state_) {
+    case STATE_SIZE:
+      packet_.size_ |= bit << field_cnt_;
+      field_cnt_++;
+      if (field_cnt_ == (fec_ ? 16 : 8)) {
+        if (fec_) {
+          const uint8_t low = fec::HammingDecode(packet_.size_ & 0xFF);
+          const uint8_t high = fec::HammingDecode(packet_.size_ >> 8);
+          if (low == fec::kHammingInvalid || high == fec::kHammingInvalid) {
+            state_ = STATE_RESET;
+            break;
+          }
+          packet_.size_ = low | high << 4;
+        }
+        if (packet_.size_ >= MAX_PACKET_PAYLOAD_BYTES) {
+          // Packet too large.
+          state_ = STATE_RESET;
+        } else if (packet_.size_ < (2 + IR_CHKSUM_SZ / 8)) {
+          // Packet size cannot be lower than 3 because we need the size,
+          // type and checksum.
+          state_ = STATE_RESET;
+        } else {
+          packet_.data_[0] = packet_.size_;
+          state_ = STATE_DATA;
+          field_cnt_ = 0;
+        }
+      }
+      break;
+    case STATE_DATA: {
+      const uint8_t pos = field_cnt_ / 8 + 1;
+      const uint8_t bitpos = field_cnt_ % 8;
+      my_assert(pos < MAX_PACKET_PAYLOAD_BYTES + 4);
+      packet_.data_[pos] |= bit << bitpos;
+      field_cnt_++;
+      if (pos == packet_.size_ - 2 && bitpos == 7) {
+        // The checksum follows, its bits keep counting from here.
+        state_ = STATE_CHKSUM;
+        break;
+      }
+      my_assert(pos <= packet_.size_ - 2);
+      break;
+    }
+    case STATE_CHKSUM: {
+      const uint8_t bitpos = field_cnt_ % IR_CHKSUM_SZ;
+      packet_.data_[packet_.size_ - 1] |= bit << bitpos;
+      field_cnt_++;
+      if (bitpos == IR_CHKSUM_SZ - 1) {
+        if (fec_) {
+          state_ = STATE_PARITY;
+          field_cnt_ = 0;
+          break;
+        }
+        state_ = STATE_RESET;
+        return kFrame;
+      }
+      break;
+    }
+    case STATE_PARITY:
+      packet_.data_[packet_.size_ + field_cnt_ / 8] |= bit << (field_cnt_ % 8);
+      field_cnt_++;
+      if (field_cnt_ == IR_FEC_PARITY_BYTES * 8) {
+        state_ = STATE_RESET;
+        return kFrame;
+      }
+      break;
+    default:
+      break;
+  }
+  return 0;
+}
+
+uint8_t IrDecoder::Decode(uint8_t samples) {
+  uint8_t events = 0;
+  uint8_t pos = 0;
+  while (pos < 8) {
+    switch (state_) {
+      case STATE_START: {
+        // Slide the header over every sample left in the byte at once.
+        const uint8_t n = 8 - pos;
+        const uint64_t w =
+            (static_cast<uint64_t>(samples >> pos) << 32) | window_;
+        uint8_t j = 1;
+        bool fec = false;
+        for (; j <= n; j++) {
+          const uint32_t v = w >> j;
+          if ((v & kHeaderMask) == kHeaderPattern) break;
+          // The FEC header may have a bad sample, the size and the parity
+          // will tell if it was no header after all. Not its first, or it
+          // would match a sample early.
+          const uint32_t diff = (v & kFecHeaderMask) ^ kFecHeaderPattern;
+          fec = fec_receive_ && (diff & (diff - 1)) == 0 &&
+                !(diff & kFecHeaderFirst);
+          if (fec) break;
+        }
+        if (j > n) {
+          window_ = static_cast<uint32_t>(w >> n);
+          return events;
+        }
+        pos += j;
+        state_ = STATE_SIZE;
+        bits_ = 0;
+        bits_cnt_ = 0;
+        field_cnt_ = 0;
+        memset(packet_.data_, 0, sizeof(packet_.data_));
+        packet_.size_ = 0;
+        fec_ = fec;
+        prev_ = (w >> (j + 31)) & 1;
+        phase_err_ = 0;
+        erasure_cnt_ = 0;
+        events |= kHeader;
+        break;
+      }
+      case STATE_RESET:
+        Reset();
+        pos++;
+        events |= kIdle;
+        break;
+      default: {
+        if (soft_) {
+          events |= SoftDecode(samples, pos);
+          break;
+        }
+        if (pos == 0) {
+          // A whole byte completes two bits.
+          const uint16_t word = bits_ | (samples << bits_cnt_);
+          const uint8_t pair = kMajority.bits[word & 0xFF];
+          const uint8_t byte = field_cnt_ / 8 + 1;
+          const uint8_t bitpos = field_cnt_ % 8;
+          if (state_ == STATE_DATA && (pair & 0b1010) == 0 && bitpos < 7 &&
+              !(byte == packet_.size_ - 2 && bitpos == 6)) {
+            // Both land in the same data byte and the second doesn't end the
+            // data.
+            packet_.data_[byte] |= ((pair & 1) | ((pair >> 1) & 2)) << bitpos;
+            field_cnt_ += 2;
+            bits_ = word >> 8;
+            return events;
+          }
+          uint8_t e = OnBit(pair & 3);
+          if (state_ == STATE_RESET || (e & kDropBuffer)) {
+            pos = 4 - bits_cnt_;
+          } else {
+            e |= OnBit(pair >> 2);
+            if (state_ != STATE_RESET) {
+              bits_ = word >> 8;
+              return events | e;
+            }
+            pos = 8 - bits_cnt_;
+          }
+          events |= e;
+          if (e & kDropBuffer) return events;
+          bits_ = 0;
+          bits_cnt_ = 0;
+          break;
+        }
+        // The rest of a byte, a bit at a time.
+        const uint8_t need = 4 - bits_cnt_;
+        if (8 - pos < need) {
+          bits_ |= (samples >> pos) << bits_cnt_;
+          bits_cnt_ += 8 - pos;
+          return events;
+        }
+        const uint8_t nibble = (bits_ | (samples >> pos) << bits_cnt_) & 0xF;
+        pos += need;
+        bits_ = 0;
+        bits_cnt_ = 0;
+        events |= OnBit(kMajority.bits[nibble] & 3);
+        if (events & kDropBuffer) return events;
+        break;
+      }
+    }
+  }
+  return events;
+}
+
+uint8_t IrDecoder::SoftDecode(uint8_t samples, uint8_t &pos) {
+  uint8_t events = 0;
+  for (; pos < 8; pos++) {
+    const uint8_t sample = (samples >> pos) & 1;
+    if (sample != prev_) {
+      // Transitions belong between two bits.
+      prev_ = sample;
+      if (bits_cnt_ == 0) {
+        phase_err_ = 0;
+      } else if (bits_cnt_ == 1) {
+        phase_err_++;
+      } else if (bits_cnt_ == 3 && --phase_err_ <= -kPhaseSlip) {
+        // The sender is ahead, this sample starts the next bit already.
+        phase_err_ = 0;
+        events |= OnBit(__builtin_popcount(bits_) >= 2 ? BIT_ON : BIT_OFF);
+        bits_ = 0;
+        bits_cnt_ = 0;
+        if (state_ == STATE_RESET) return events;
+      }
+    }
+    bits_ |= sample << bits_cnt_;
+    bits_cnt_++;
+    if (bits_cnt_ < 4 || (bits_cnt_ == 4 && phase_err_ >= kPhaseSlip)) {
+      continue;
+    }
+    if (bits_cnt_ == 5) {
+      // The sender is behind, the first sample was still the last bit's.
+      bits_ >>= 1;
+      phase_err_ = 0;
+    }
+    events |= OnBit(kMajority.bits[bits_] & 3);
+    bits_ = 0;
+    bits_cnt_ = 0;
+    if (state_ == STATE_RESET) {
+      pos++;
+      return events;
+    }
+  }
+  return events;
+}
+
+bool IrDecoder::Repair(bool (*valid)(const IrPacket &packet)) {
+  if (fec_) {
+    // Reed-Solomon takes erasures by the byte.
+    uint8_t bytes[IR_FEC_PARITY_BYTES];
+    for (uint8_t i = 0; i < erasure_cnt_; i++) bytes[i] = erasures_[i] / 8;
+    if (fec::RsDecode(packet_.data_, packet_.size_ + IR_FEC_PARITY_BYTES,
+                      bytes, erasure_cnt_) < 0) {
+      return false;
+    }
+    // A corrected size would mean the frame was cut in the wrong place.
+    return packet_.data_[0] == packet_.size_ && valid(packet_);
+  }
+  for (uint8_t fill = 0; fill < (1 << erasure_cnt_); fill++) {
+    for (uint8_t i = 0; i < erasure_cnt_; i++) {
+      uint8_t &byte = packet_.data_[erasures_[i] / 8];
+      const uint8_t mask = 1 << (erasures_[i] % 8);
+      if ((fill >> i) & 1) {
+        byte |= mask;
+      } else {
+        byte &= ~mask;
+      }
+    }
+    if (valid(packet_)) return true;
+  }
+  return false;
+}
+
+}  // namespace ir
+}  // namespace hitcon
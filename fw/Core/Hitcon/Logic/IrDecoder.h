@@ -0,0 +1,129 @@
+#ifndef HITCON_LOGIC_IR_DECODER_H_
+#define HITCON_LOGIC_IR_DECODER_H_
+
+#include <Service/IrParam.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace hitcon {
+
+namespace ir {
+
+struct IrPacket {
+  // IR Packet
+  // | header | data (1 byte size + n bytes data + 1 byte checksum) |
+
+  IrPacket() : size_(0) {}
+
+  // We need to add 3 bytes because we need
+  // at least 1 byte to accomodate the size.
+  // at least 1 byte to accomodate the chksum.
+  uint8_t data_[MAX_PACKET_PAYLOAD_BYTES + 4];
+  size_t size_;
+};
+
+// A frame with FEC, size codes and parity included, still fits.
+static_assert(MAX_PACKET_PAYLOAD_BYTES - 1 + IR_FEC_OVERHEAD <=
+              sizeof(IrPacket::data_));
+
+// Finds IR_PACKET_HEADER in the received samples and collects the frame
+// after it. Takes a whole byte of samples (least significant bit first, as
+// IrService stores them) per call: the header is searched for in all eight
+// positions of a 64 bit window at once, and the two bits in a byte are
+// decoded with one lookup of a nibble majority table.
+//
+// In soft decision mode the frame is taken a sample at a time instead: the
+// bit clock is recovered from the transitions in the frame, so that a sender
+// running slightly fast or slow doesn't walk out of the four sample window,
+// and, with SetSoftRepair(), a bit that is still ambiguous becomes an
+// erasure for Repair() rather than the end of the frame.
+//
+// Frames behind IR_PACKET_HEADER_FEC carry their size in Hamming(8,4) and
+// Reed-Solomon parity after the checksum, see IR_FEC_PARITY_BYTES. Their
+// header is found with a bad sample in it too, bits that don't decode are
+// erasures by the byte, and Repair() corrects the frame with the parity.
+class IrDecoder {
+ public:
+  enum Event : uint8_t {
+    // Header found, a frame may follow.
+    kHeader = 0x01,
+    // A frame is complete in Frame(), its checksum is not checked.
+    kFrame = 0x02,
+    // Looking for a header again.
+    kIdle = 0x04,
+    // A bit of the size didn't decode. The caller skips the rest of the
+    // receive buffer, as IrLogic always has.
+    kDropBuffer = 0x08,
+  };
+
+  // Erasures a frame without FEC may have with soft repair. Repair() tries
+  // all 2^kMaxErasures fillings against an 8 bit checksum, each a 1/256
+  // chance of passing a wrong frame, so this is kept low.
+  static constexpr uint8_t kMaxErasures = 2;
+  // Transitions off by a sample in the same direction before the bit clock
+  // is moved by a sample.
+  static constexpr int8_t kPhaseSlip = 2;
+  static_assert(kMaxErasures <= IR_FEC_PARITY_BYTES);
+
+  IrDecoder();
+
+  // Set before the first Decode().
+  void SetSoftDecision(bool soft) { soft_ = soft; }
+  // In soft decision mode, make ambiguous bits of frames without FEC
+  // erasures for Repair() instead of ending the frame. Off by default: up to
+  // 2^kMaxErasures fillings make a wrong frame that many times likelier to
+  // pass the checksum.
+  void SetSoftRepair(bool repair) { soft_repair_ = repair; }
+  // Look for IR_PACKET_HEADER_FEC as well, on by default.
+  void SetFecReceive(bool fec) { fec_receive_ = fec; }
+
+  // Decode one byte of samples, returns the Events that happened in it.
+  uint8_t Decode(uint8_t samples);
+
+  // The frame of the last kFrame, until the next kHeader.
+  const IrPacket &Frame() const { return packet_; }
+  // Whether Frame() came with forward error correction. Its parity follows
+  // the checksum in data_, beyond size_.
+  bool Fec() const { return fec_; }
+  // Erasures in Frame(), always 0 without soft repair or FEC.
+  uint8_t Erasures() const { return erasure_cnt_; }
+  // Fill in the erased bits of Frame() until `valid` accepts it, returns
+  // false if no filling does. Without erasures, just checks Frame(). With
+  // FEC, corrects Frame() with its parity first, which takes a few thousand
+  // cycles on the badge if there is anything to correct.
+  bool Repair(bool (*valid)(const IrPacket &packet));
+
+ private:
+  // Feed one decoded bit to the frame, BIT_INVALID included.
+  uint8_t OnBit(uint8_t bit);
+  // Soft decision from sample `pos` on, until the end of the byte or the
+  // frame. Advances `pos` past the samples taken.
+  uint8_t SoftDecode(uint8_t samples, uint8_t &pos);
+  void Reset();
+
+  uint8_t state_;
+  // Samples of the next bit so far, and how many there are.
+  uint8_t bits_;
+  uint8_t bits_cnt_;
+  // Bits of the current field so far.
+  uint16_t field_cnt_;
+  // Last samples while looking for the header, latest in the top bit.
+  uint32_t window_;
+  IrPacket packet_;
+
+  bool soft_;
+  bool soft_repair_;
+  bool fec_receive_;
+  bool fec_;
+  // Soft decision: the last sample, how far the transitions have been off
+  // (late positive) and the bit positions in packet_.data_ of erasures.
+  uint8_t prev_;
+  int8_t phase_err_;
+  uint8_t erasure_cnt_;
+  uint16_t erasures_[IR_FEC_PARITY_BYTES];
+};
+
+}  // namespace ir
+}  // namespace hitcon
+
+#endif  // HITCON_LOGIC_IR_DECODER_H_
@@ -0,0 +1,191 @@
+#include <Logic/IrFec.h>
+
+namespace hitcon {
+namespace ir {
+namespace fec {
+
+namespace {
+
+constexpr size_t kParity = IR_FEC_PARITY_BYTES;
+
+// GF(2^8) with the primitive polynomial x^8 + x^4 + x^3 + x^2 + 1, exp is
+// doubled so that a sum of two logs needs no modulo.
+struct GaloisTables {
+  uint8_t exp[512];
+  uint8_t log[256];
+  constexpr GaloisTables() : exp(), log() {
+    unsigned x = 1;
+    for (int i = 0; i < 255; i++) {
+      exp[i] = x;
+      log[x] = i;
+      x <<= 1;
+      if (x & 0x100) x ^= 0x11D;
+    }
+    for (int i = 255; i < 512; i++) exp[i] = exp[i - 255];
+  }
+};
+
+constexpr GaloisTables kGf;
+
+constexpr uint8_t Mul(uint8_t a, uint8_t b) {
+  return a && b ? kGf.exp[kGf.log[a] + kGf.log[b]] : 0;
+}
+
+constexpr uint8_t Div(uint8_t a, uint8_t b) {
+  return a ? kGf.exp[kGf.log[a] + 255 - kGf.log[b]] : 0;
+}
+
+// Powers of the primitive element, a^n for n in [0, 255).
+constexpr uint8_t Pow(unsigned n) { return kGf.exp[n % 255]; }
+
+// (x - a^0)(x - a^1)...(x - a^(kParity-1)), highest power first.
+struct Generator {
+  uint8_t poly[kParity + 1];
+  constexpr Generator() : poly() {
+    poly[0] = 1;
+    for (size_t i = 0; i < kParity; i++) {
+      // Multiply by (x + a^i).
+      for (size_t j = i + 1; j > 0; j--) {
+        poly[j] ^= Mul(poly[j - 1], Pow(i));
+      }
+    }
+  }
+};
+
+constexpr Generator kGenerator;
+
+// The 16 codewords, data in the low nibble and parity in the high one.
+struct HammingTables {
+  uint8_t encode[16];
+  uint8_t decode[256];
+  constexpr HammingTables() : encode(), decode() {
+    for (int i = 0; i < 256; i++) decode[i] = kHammingInvalid;
+    for (int d = 0; d < 16; d++) {
+      const int d0 = d & 1, d1 = (d >> 1) & 1, d2 = (d >> 2) & 1,
+                d3 = (d >> 3) & 1;
+      const int p1 = d0 ^ d1 ^ d3, p2 = d0 ^ d2 ^ d3, p3 = d1 ^ d2 ^ d3;
+      const int p0 = d0 ^ d1 ^ d2 ^ d3 ^ p1 ^ p2 ^ p3;
+      const uint8_t code = d | p1 << 4 | p2 << 5 | p3 << 6 | p0 << 7;
+      encode[d] = code;
+      decode[code] = d;
+      for (int b = 0; b < 8; b++) decode[code ^ (1 << b)] = d;
+    }
+  }
+};
+
+constexpr HammingTables kHamming;
+
+// p(x) at x, highest power first.
+uint8_t Eval(const uint8_t *p, size_t len, uint8_t x) {
+  uint8_t y = 0;
+  for (size_t i = 0; i < len; i++) y = Mul(y, x) ^ p[i];
+  return y;
+}
+
+// p(x) at x, lowest power first.
+uint8_t EvalLow(const uint8_t *p, size_t len, uint8_t x) {
+  uint8_t y = 0;
+  for (size_t i = len; i > 0; i--) y = Mul(y, x) ^ p[i - 1];
+  return y;
+}
+
+}  // namespace
+
+uint8_t HammingEncode(uint8_t nibble) { return kHamming.encode[nibble & 0xF]; }
+
+uint8_t HammingDecode(uint8_t code) { return kHamming.decode[code]; }
+
+void RsEncode(const uint8_t *data, size_t len, uint8_t *parity) {
+  for (size_t j = 0; j < kParity; j++) parity[j] = 0;
+  for (size_t i = 0; i < len; i++) {
+    const uint8_t feedback = data[i] ^ parity[0];
+    for (size_t j = 0; j + 1 < kParity; j++) {
+      parity[j] = parity[j + 1] ^ Mul(feedback, kGenerator.poly[j + 1]);
+    }
+    parity[kParity - 1] = Mul(feedback, kGenerator.poly[kParity]);
+  }
+}
+
+int RsDecode(uint8_t *codeword, size_t len, const uint8_t *erasures,
+             size_t erasure_cnt) {
+  if (len > 255 || len <= kParity || erasure_cnt > kParity) return -1;
+
+  // Syndromes, the codeword at the roots of the generator.
+  uint8_t syndromes[kParity];
+  uint8_t any = 0;
+  for (size_t j = 0; j < kParity; j++) {
+    syndromes[j] = Eval(codeword, len, Pow(j));
+    any |= syndromes[j];
+  }
+  if (!any) return 0;
+
+  // Byte i is the coefficient of x^(len-1-i), its locator a^(len-1-i).
+  // Polynomials from here on are lowest power first.
+  uint8_t lambda[kParity + 1] = {1};
+  for (size_t e = 0; e < erasure_cnt; e++) {
+    if (erasures[e] >= len) return -1;
+    const uint8_t x = Pow(len - 1 - erasures[e]);
+    // Multiply by (1 + x z).
+    for (size_t j = e + 1; j > 0; j--) lambda[j] ^= Mul(lambda[j - 1], x);
+  }
+
+  // Berlekamp-Massey, starting from the erasure locator.
+  uint8_t prev[kParity + 1];
+  for (size_t j = 0; j <= kParity; j++) prev[j] = lambda[j];
+  size_t degree = erasure_cnt;
+  for (size_t r = erasure_cnt; r < kParity; r++) {
+    uint8_t delta = 0;
+    for (size_t j = 0; j <= r; j++) {
+      delta ^= Mul(lambda[j], syndromes[r - j]);
+    }
+    // prev *= z.
+    for (size_t j = kParity; j > 0; j--) prev[j] = prev[j - 1];
+    prev[0] = 0;
+    if (!delta) continue;
+    uint8_t next[kParity + 1];
+    for (size_t j = 0; j <= kParity; j++) {
+      next[j] = lambda[j] ^ Mul(delta, prev[j]);
+    }
+    if (2 * degree <= r + erasure_cnt) {
+      for (size_t j = 0; j <= kParity; j++) prev[j] = Div(lambda[j], delta);
+      degree = r + 1 + erasure_cnt - degree;
+    }
+    for (size_t j = 0; j <= kParity; j++) lambda[j] = next[j];
+  }
+  if (degree > kParity) return -1;
+
+  // Error evaluator, syndromes times the locator mod z^kParity.
+  uint8_t omega[kParity] = {};
+  for (size_t i = 0; i < kParity; i++) {
+    for (size_t j = 0; j <= i; j++) {
+      omega[i] ^= Mul(syndromes[j], lambda[i - j]);
+    }
+  }
+  // Formal derivative of the locator, only the odd powers survive.
+  uint8_t derivative[kParity] = {};
+  for (size_t j = 1; j <= kParity; j += 2) derivative[j - 1] = lambda[j];
+
+  // Chien search over the bytes of the shortened code, Forney for the values.
+  size_t found = 0;
+  for (size_t i = 0; i < len; i++) {
+    const uint8_t x = Pow(len - 1 - i);
+    const uint8_t x_inv = Pow(255 - (len - 1 - i) % 255);
+    if (EvalLow(lambda, kParity + 1, x_inv)) continue;
+    const uint8_t denominator = EvalLow(derivative, kParity, x_inv);
+    if (!denominator) return -1;
+    codeword[i] ^= Mul(x, Div(EvalLow(omega, kParity, x_inv), denominator));
+    found++;
+  }
+  if (found != degree) return -1;
+
+  // A codeword beyond the correction capability may still have been moved to
+  // the wrong one, but never to a non-codeword.
+  for (size_t j = 0; j < kParity; j++) {
+    if (Eval(codeword, len, Pow(j))) return -1;
+  }
+  return found;
+}
+
+}  // namespace fec
+}  // namespace ir
+}  // namespace hitcon
@@ -0,0 +1,34 @@
+#ifndef HITCON_LOGIC_IR_FEC_H_
+#define HITCON_LOGIC_IR_FEC_H_
+
+#include <Service/IrParam.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace hitcon {
+namespace ir {
+namespace fec {
+
+// Extended Hamming(8,4) code of the low nibble of `nibble`. Corrects a bad
+// bit and detects two.
+uint8_t HammingEncode(uint8_t nibble);
+// The nibble of `code`, or kHammingInvalid if it has two bad bits.
+uint8_t HammingDecode(uint8_t code);
+constexpr uint8_t kHammingInvalid = 0xFF;
+
+// Reed-Solomon code over GF(2^8), shortened to the frame, with
+// IR_FEC_PARITY_BYTES parity bytes after `len` bytes of data.
+void RsEncode(const uint8_t *data, size_t len, uint8_t *parity);
+
+// Correct a codeword of `len` bytes, data and parity, in place. `erasures`
+// are the indices of `erasure_cnt` bytes known to be bad. Up to 2 * errors
+// + erasures <= IR_FEC_PARITY_BYTES are corrected. Returns the number of
+// bytes corrected, or -1 if the codeword has more bad bytes than that.
+int RsDecode(uint8_t *codeword, size_t len, const uint8_t *erasures,
+             size_t erasure_cnt);
+
+}  // namespace fec
+}  // namespace ir
+}  // namespace hitcon
+
+#endif  // HITCON_LOGIC_IR_FEC_H_
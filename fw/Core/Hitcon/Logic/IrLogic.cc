@@ -1,5 +1,6 @@
 #include "IrLogic.h"
 
+#include <Logic/IrFec.h>
 #include <Logic/IrLogic.h>
 #include <Logic/XBoardLogic.h>
 #include <Logic/XBoardRecvFn.h>
@@ -25,9 +26,14 @@ service::sched::Task OnBufferReceivedTask(
 #pragma GCC diagnostic pop
 
 IrLogic::IrLogic()
-    : lf_total_period(0), lf_nonzero_period(0), lowpass_loadfactor(0) {}
+    : lf_total_period(0),
+      lf_nonzero_period(0),
+      lowpass_loadfactor(0),
+      tx_fec(IR_TX_FEC) {}
 
 void IrLogic::Init() {
+  decoder.SetSoftDecision(IR_RX_SOFT_DECISION);
+  decoder.SetSoftRepair(IR_RX_SOFT_REPAIR);
   // Set callback
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
@@ -36,38 +42,6 @@ void IrLogic::Init() {
 #pragma GCC diagnostic pop
 }
 
-size_t packet_buf{0};
-uint8_t packet_state{0};
-
-enum PACKET_STATE {
-  STATE_START = 0,
-  STATE_SIZE = 1,
-  STATE_DATA = 2,
-  STATE_CHKSUM = 3,
-  STATE_RESET = 4,
-};
-
-enum BIT_STATE {
-  BIT_OFF = 0,
-  BIT_ON = 1,
-  BIT_INVALID = 2,
-};
-
-static uint8_t decode_bit(uint8_t x) {
-  uint8_t cnt = __builtin_popcount(x & 0b1111);
-  switch (cnt) {
-    case 0:
-    case 1:
-      return BIT_OFF;
-    case 3:
-    case 4:
-      return BIT_ON;
-    case 2:
-    default:
-      return BIT_INVALID;
-  }
-}
-
 static uint8_t merge_chksum(uint32_t x) {
   uint8_t ret = 0;
   for (int i = 0; i < 32; i += 8) {
@@ -76,6 +50,11 @@ static uint8_t merge_chksum(uint32_t x) {
   return ret;
 }
 
+static bool ChecksumValid(const IrPacket &packet) {
+  const uint8_t chksum = merge_chksum(crc32(packet.data_, packet.size_ - 1));
+  return chksum == packet.data_[packet.size_ - 1];
+}
+
 void IrLogic::OnBufferReceivedEnqueueTask(uint8_t *buffer) {
   buffer_received_ctr = 0;
   service::sched::scheduler.Queue(&OnBufferReceivedTask, buffer);
@@ -103,6 +82,7 @@ void IrLogic::OnBufferReceivedEnqueueTask(uint8_t *buffer) {
     // Apply a low pass filter.
     lowpass_loadfactor =
         ((LF_ALPHA_COMPL * lowpass_loadfactor) + (LF_ALPHA * current_lf)) >> 10;
+    irService.mac.SetLoad(GetLoadFactor());
     // Reset the counters.
     lf_nonzero_period = 0;
     lf_total_period = 0;
@@ -115,128 +95,33 @@ void IrLogic::OnBufferReceived(uint8_t *buffer) {
 
   // Here is a DOS feature that if someone send a packet_header
   // then it can cause decode + receive fail
-  static uint8_t bit{0};
   for (size_t i = 0; i < IR_SERVICE_RX_BUFFER_PER_RUN &&
                      buffer_received_ctr < IR_SERVICE_RX_ON_BUFFER_SIZE;
        i++, buffer_received_ctr++) {
     my_assert(buffer_received_ctr < IR_SERVICE_RX_ON_BUFFER_SIZE);
-    uint8_t current_byte = buffer[buffer_received_ctr];
-    for (uint8_t j = 0; j < 8; j++) {
-      uint8_t is_on = current_byte & 0x01;
-      current_byte = current_byte >> 1;
-      switch (packet_state) {
-        case STATE_START:
-          packet_buf <<= 1;
-          packet_buf |= is_on;
-          if ((packet_buf & IR_PACKET_HEADER_MASK) ==
-              (IR_PACKET_HEADER_PACKED & IR_PACKET_HEADER_MASK)) {
-            packet_state = STATE_SIZE;
-            g_suspender.IncBlocker();
-            rx_packet.size_ = 0;
-            packet_buf = 0;
-            bit = 0;
-          }
-          break;
-        case STATE_SIZE:
-          // here, denote packet_buf as n of consumed size bit
-          packet_buf++;
-          bit <<= 1;
-          bit |= is_on;
-          if ((packet_buf & 3) == 0) {
-            if (decode_bit(bit) == BIT_INVALID) {
-              // decode error
-              packet_state = STATE_RESET;
-              return;
-            }
-            const uint8_t bitpos = (packet_buf / DECODE_SAMPLE_RATIO - 1);
-            rx_packet.size_ |= decode_bit(bit) << bitpos;
-            bit = 0;
-          }
-          // end of size section (decode ratio * 1 byte)
-          if (packet_buf == DECODE_SAMPLE_RATIO * 8) {
-            if (rx_packet.size_ >= MAX_PACKET_PAYLOAD_BYTES) {
-              // Packet too large.
-              packet_state = STATE_RESET;
-            } else if (rx_packet.size_ < (2 + IR_CHKSUM_SZ / 8)) {
-              // Packet size cannot be lower than 3 because we need the size,
-              // type and checksum.
-              packet_state = STATE_RESET;
-            } else {
-              rx_packet.data_[0] = rx_packet.size_;
-              packet_state = STATE_DATA;
-              packet_buf = 0;
-            }
-          }
-          break;
-        case STATE_DATA:
-          // here, denote packet_buf as n of consumed data bit
-          packet_buf++;
-          bit <<= 1;
-          bit |= is_on;
-          if ((packet_buf % DECODE_SAMPLE_RATIO) == 0) {
-            if (decode_bit(bit) == BIT_INVALID) {
-              // decode error
-              packet_state = STATE_RESET;
-              break;
-            }
-            const uint8_t pos = (packet_buf / DECODE_SAMPLE_RATIO - 1) / 8 + 1;
-            const uint8_t bitpos = (packet_buf / DECODE_SAMPLE_RATIO - 1) % 8;
-            my_assert(pos < MAX_PACKET_PAYLOAD_BYTES + 4);
-            rx_packet.data_[pos] |= decode_bit(bit) << bitpos;
-            if (pos == rx_packet.size_ - 2 && bitpos == 7) {
-              // packet data end
-              // double buffering
-              // Full packet found, restarting.
-              packet_state = STATE_CHKSUM;
-              break;
-            }
-            my_assert(pos <= rx_packet.size_ - 2);
-          }
-          break;
-        case STATE_CHKSUM:
-          packet_buf++;
-          bit <<= 1;
-          bit |= is_on;
-          if ((packet_buf % DECODE_SAMPLE_RATIO) == 0) {
-            if (decode_bit(bit) == BIT_INVALID) {
-              packet_state = STATE_RESET;
-              break;
-            }
-            const uint8_t bitpos =
-                (packet_buf / DECODE_SAMPLE_RATIO - 1) % IR_CHKSUM_SZ;
-            rx_packet.data_[rx_packet.size_ - 1] |= decode_bit(bit) << bitpos;
-            if (bitpos == IR_CHKSUM_SZ - 1) {
-              // packet_end
-              packet_buf = 0;
-              packet_state = STATE_RESET;
-
-              // if valid packet
-              const uint32_t chksum =
-                  merge_chksum(crc32(rx_packet.data_, rx_packet.size_ - 1));
-              if (chksum == rx_packet.data_[rx_packet.size_ - 1]) {
-                // pop checksum
-                rx_packet.data_[rx_packet.size_ - 1] = '\0';
-                rx_packet.size_--;
-                rx_packet.data_[0] = rx_packet.size_;
-                rx_packet_ctrler = rx_packet;
-                callback(callback_arg,
-                         reinterpret_cast<void *>(&rx_packet_ctrler));
-              }
-            }
-          }
-          break;
-        case STATE_RESET:
-          packet_state = STATE_START;
-          g_suspender.DecBlocker();
-          packet_buf = 0;
-          bit = 0;
-          memset(&rx_packet, 0, sizeof(IrPacket));
-          break;
-
-        default:
-          break;
+    uint8_t events = decoder.Decode(buffer[buffer_received_ctr]);
+    if (!events) continue;
+    // A frame usually ends mid-byte, with kIdle in the same events.
+    if (events & IrDecoder::kHeader) g_suspender.IncBlocker();
+    if (events & IrDecoder::kIdle) g_suspender.DecBlocker();
+    if (events & IrDecoder::kFrame) {
+      // if valid packet
+      const IrPacket &rx_packet = decoder.Frame();
+      if (decoder.Repair(&ChecksumValid)) {
+        // pop checksum, double buffering
+        rx_packet_ctrler = rx_packet;
+        rx_packet_ctrler.data_[rx_packet_ctrler.size_ - 1] = '\0';
+        rx_packet_ctrler.size_--;
+        rx_packet_ctrler.data_[0] = rx_packet_ctrler.size_;
+        callback(callback_arg, reinterpret_cast<void *>(&rx_packet_ctrler));
       }
     }
+    if (events & IrDecoder::kDropBuffer) return;
+    if ((events & IrDecoder::kFrame) && decoder.Fec()) {
+      // Reed-Solomon took its time, leave the rest to the next run.
+      buffer_received_ctr++;
+      break;
+    }
   }
   if (buffer_received_ctr < IR_SERVICE_RX_ON_BUFFER_SIZE) {
     service::sched::scheduler.Queue(&OnBufferReceivedTask, buffer);
@@ -257,6 +142,17 @@ void IrLogic::EncodePacket(uint8_t *data, size_t len, IrPacket &packet) {
   packet.data_[len + 1] = chksum;
 }
 
+void IrLogic::EncodeFecPacket(uint8_t *data, size_t len, IrPacket &packet) {
+  IrPacket plain;
+  EncodePacket(data, len, plain);
+  // The size goes out as two Hamming codes, the codeword keeps it as is.
+  packet.size_ = plain.size_ + IR_FEC_OVERHEAD;
+  packet.data_[0] = fec::HammingEncode(plain.size_);
+  packet.data_[1] = fec::HammingEncode(plain.size_ >> 4);
+  memcpy(packet.data_ + 2, plain.data_ + 1, plain.size_ - 1);
+  fec::RsEncode(plain.data_, plain.size_, packet.data_ + plain.size_ + 1);
+}
+
 bool IrLogic::SendPacket(uint8_t *data, size_t len) {
   if (len >= MAX_PACKET_PAYLOAD_BYTES) {
     // Packet too large.
@@ -265,8 +161,14 @@ bool IrLogic::SendPacket(uint8_t *data, size_t len) {
   }
   if (!irService.CanSendBufferNow()) return false;
   // TODO: Check if tx_packet is in use.
-  EncodePacket(data, len, tx_packet);
-  bool ret = irService.SendBuffer(tx_packet.data_, tx_packet.size_, true);
+  // Only frames a receiver would take get the parity, it doesn't fit others.
+  const bool fec = tx_fec && len + 2 < MAX_PACKET_PAYLOAD_BYTES;
+  if (fec) {
+    EncodeFecPacket(data, len, tx_packet);
+  } else {
+    EncodePacket(data, len, tx_packet);
+  }
+  bool ret = irService.SendBuffer(tx_packet.data_, tx_packet.size_, true, fec);
   my_assert(ret);
   return ret;
 }
@@ -1,6 +1,7 @@
 #ifndef HITCON_LOGIC_IR_LOGIC_H_
 #define HITCON_LOGIC_IR_LOGIC_H_
 
+#include <Logic/IrDecoder.h>
 #include <Service/IrParam.h>
 #include <Service/Sched/Scheduler.h>
 #include <Service/Sched/Task.h>
@@ -12,19 +13,6 @@ namespace hitcon {
 
 namespace ir {
 
-struct IrPacket {
-  // IR Packet
-  // | header | data (1 byte size + n bytes data + 1 byte checksum) |
-
-  IrPacket() : size_(0) {}
-
-  // We need to add 3 bytes because we need
-  // at least 1 byte to accomodate the size.
-  // at least 1 byte to accomodate the chksum.
-  uint8_t data_[MAX_PACKET_PAYLOAD_BYTES + 4];
-  size_t size_;
-};
-
 class IrLogic {
  public:
   IrLogic();
@@ -46,6 +34,12 @@ class IrLogic {
   bool AvailableToSend();
 
   void EncodePacket(uint8_t *data, size_t len, IrPacket &packet);
+  // Same as EncodePacket, but with the size in Hamming code and Reed-Solomon
+  // parity after the checksum, to be sent after IR_PACKET_HEADER_FEC.
+  void EncodeFecPacket(uint8_t *data, size_t len, IrPacket &packet);
+  // Send packets with forward error correction, IR_TX_FEC by default. Every
+  // badge receives them either way.
+  void SetFec(bool fec) { tx_fec = fec; }
   // Enqueue the task and reset the counter
   void OnBufferReceivedEnqueueTask(uint8_t *buffer);
 
@@ -58,7 +52,7 @@ class IrLogic {
   // OnPacketReceived callback
   callback_t callback;
   void *callback_arg;
-  IrPacket rx_packet;
+  IrDecoder decoder;
   // double buffering to avoid RW same time
   IrPacket rx_packet_ctrler;
   IrPacket tx_packet;
@@ -78,6 +72,8 @@ class IrLogic {
 
   // To split OnBufferReceived into pieces
   size_t buffer_received_ctr;
+
+  bool tx_fec;
 };
 
 extern IrLogic irLogic;
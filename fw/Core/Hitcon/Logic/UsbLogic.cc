@@ -4,6 +4,7 @@
 #include <Logic/crc32.h>
 #include <Service/FlashService.h>
 #include <Service/Sched/Scheduler.h>
+#include <Service/Sched/SysTimer.h>
 #include <Service/UsbService.h>
 #include <main.h>
 #include <usbd_def.h>
@@ -20,7 +21,17 @@ UsbLogic::UsbLogic()
     : _routine_task(810, (task_callback_t)&UsbLogic::Routine, (void*)this,
                     DELAY_INTERVAL),
       _write_routine_task(810, (task_callback_t)&UsbLogic::WriteRoutine,
-                          (void*)this, WAIT_INTERVAL) {}
+                          (void*)this, WAIT_INTERVAL),
+      _reply_task(810, (task_callback_t)&UsbLogic::ReplyRoutine, (void*)this,
+                  0),
+      _reply_pending(false)
+#ifdef SCHED_PROFILING
+      ,
+      _profile_task(810, (task_callback_t)&UsbLogic::ProfileRoutine,
+                    (void*)this, 0),
+      _profile_running(false)
+#endif
+{}
 #pragma GCC diagnostic pop
 
 void UsbLogic::Init() {
@@ -117,15 +128,103 @@ void UsbLogic::OnDataRecv(void* arg2) {
               *reinterpret_cast<uint32_t*>(packet.addr);
           break;
       }
-      g_usb_service.SendCustomReport(report);
+      SendReply(report);
       _state = USB_STATE_IDLE;
       break;
     }
+    case USB_STATE_SCHED_PROFILE: {
+#ifdef SCHED_PROFILING
+      // The profiler isn't interrupt safe, let the task do the work.
+      if (_profile_running) break;
+      _profile_running = true;
+      if (data[2] == SCHED_PROFILE_RESET) {
+        // Skip straight to the final report.
+        _profile_slot = 0xFF;
+      } else {
+        _profile_slot = 0;
+        _profile_chunk = 0;
+      }
+      _profile_task.SetWakeTime(SysTimer::GetTime());
+      scheduler.Queue(&_profile_task, nullptr);
+#else
+      // Nothing to dump, just the final report of an empty profile.
+      uint8_t report[REPORT_LEN - 1] = {CODE_ACTION_DONE};
+      SendReply(report);
+      _state = USB_STATE_IDLE;
+#endif
+      break;
+    }
+    case USB_STATE_IDLE:
+    case USB_STATE_WAITING:
+    case USB_STATE_WAIT_ERASE:
+      break;
     default:
+      // Unknown command, don't wait for a packet that never ends it.
+      _state = USB_STATE_IDLE;
       break;
   }
 }
 
+#ifdef SCHED_PROFILING
+void UsbLogic::ProfileRoutine(void* unused) {
+  uint8_t report[REPORT_LEN - 1] = {0};
+  if (_profile_slot == 0xFF) {
+    profiler.Reset();
+    _profile_slot = profiler.size();
+  }
+  if (_profile_slot < profiler.size()) {
+    if (_profile_chunk == 0) {
+      profiler.Serialize(_profile_slot, &_profile_record);
+    }
+    unsigned offset = _profile_chunk * PROFILE_CHUNK_LEN;
+    unsigned len = MIN(PROFILE_CHUNK_LEN, sizeof(_profile_record) - offset);
+    report[0] = _profile_slot;
+    report[1] = _profile_chunk;
+    memcpy(&report[2], reinterpret_cast<uint8_t*>(&_profile_record) + offset,
+           len);
+    if (g_usb_service.SendCustomReport(report)) {
+      _profile_chunk++;
+      if (_profile_chunk == PROFILE_CHUNKS) {
+        _profile_chunk = 0;
+        _profile_slot++;
+      }
+    }
+  } else {
+    uint32_t dropped = profiler.GetDropped();
+    report[0] = CODE_ACTION_DONE;
+    report[1] = profiler.size();
+    memcpy(&report[2], &dropped, sizeof(dropped));
+    if (g_usb_service.SendCustomReport(report)) {
+      _profile_running = false;
+      _state = USB_STATE_IDLE;
+      return;
+    }
+  }
+  // The host only polls every CUSTOM_HID_FS_BINTERVAL ms, sending faster
+  // just finds the endpoint busy.
+  _profile_task.SetWakeTime(SysTimer::GetTime() + CUSTOM_HID_FS_BINTERVAL);
+  scheduler.Queue(&_profile_task, nullptr);
+}
+#endif
+
+void UsbLogic::SendReply(uint8_t* data) {
+  if (!_reply_pending && g_usb_service.SendCustomReport(data)) return;
+  memcpy(_reply, data, sizeof(_reply));
+  if (_reply_pending) return;
+  _reply_pending = true;
+  _reply_task.SetWakeTime(SysTimer::GetTime() + CUSTOM_HID_FS_BINTERVAL);
+  scheduler.Queue(&_reply_task, nullptr);
+}
+
+void UsbLogic::ReplyRoutine(void* unused) {
+  if (g_usb_service.SendCustomReport(_reply)) {
+    _reply_pending = false;
+    return;
+  }
+  _reply_task.SetWakeTime(SysTimer::GetTime() + CUSTOM_HID_FS_BINTERVAL);
+  scheduler.Queue(&_reply_task, nullptr);
+}
+
 // 1. check for erase done
 // 2. program the script
 void UsbLogic::WriteRoutine(void* unused) {
@@ -139,12 +238,12 @@ void UsbLogic::WriteRoutine(void* unused) {
       _state = USB_STATE_IDLE;
       scheduler.DisablePeriodic(&_write_routine_task);
       uint8_t data[] = {CODE_ACTION_DONE, 0, 0, 0, 0, 0, 0, 0};
-      g_usb_service.SendCustomReport(data);
+      SendReply(data);
     }
   } else if (_state == USB_STATE_WRITING) {
     if (!g_flash_service.IsBusy() && _new_data) {
       uint8_t data[] = {CODE_ACTION_DONE, 0, 0, 0, 0, 0, 0, 0};
-      g_usb_service.SendCustomReport(data);
+      SendReply(data);
       g_flash_service.ProgramOnly(SCRIPT_FLASH_INDEX, _program_index,
                                   reinterpret_cast<uint32_t*>(_script_temp),
                                   sizeof(_script_temp));
@@ -4,6 +4,7 @@
 #include <Logic/NvStorage.h>
 #include <Service/FlashService.h>
 #include <Service/Sched/PeriodicTask.h>
+#include <Service/Sched/Profiler.h>
 #include <Service/UsbService.h>
 
 namespace hitcon {
@@ -47,6 +48,14 @@ enum usb_state_t {
   USB_STATE_WRITING,
   USB_STATE_WAITING,     // waiting flash service done program
   USB_STATE_WAIT_ERASE,  // waiting erase done
+  // Dump or reset the scheduler profile, an empty one without SCHED_PROFILING.
+  USB_STATE_SCHED_PROFILE,
+};
+
+// Arguments for USB_STATE_SCHED_PROFILE, in data[2].
+enum sched_profile_cmd_t {
+  SCHED_PROFILE_DUMP = 0,
+  SCHED_PROFILE_RESET,
 };
 
 enum {  // script code definition
@@ -85,6 +94,29 @@ class UsbLogic {
   hitcon::service::sched::PeriodicTask _write_routine_task;
   void Routine(void* unused);
   void WriteRoutine(void* unused);
+  // Replies the host waits for before its next command, so there's at most
+  // one pending; it's resent every poll interval while the endpoint is busy.
+  hitcon::service::sched::DelayedTask _reply_task;
+  uint8_t _reply[REPORT_LEN - 1];
+  volatile bool _reply_pending;
+  void SendReply(uint8_t* data);
+  void ReplyRoutine(void* unused);
+#ifdef SCHED_PROFILING
+  // Sends one ProfileRecord per task, split into reports of
+  // {slot, chunk, 6 bytes of record}, then
+  // {CODE_ACTION_DONE, task count, dropped runs (4 bytes)}.
+  static constexpr unsigned PROFILE_CHUNK_LEN = REPORT_LEN - 3;
+  static constexpr unsigned PROFILE_CHUNKS =
+      (sizeof(hitcon::service::sched::ProfileRecord) + PROFILE_CHUNK_LEN - 1) /
+      PROFILE_CHUNK_LEN;
+  // Queued from the USB interrupt, requeues itself until the dump is out.
+  hitcon::service::sched::DelayedTask _profile_task;
+  hitcon::service::sched::ProfileRecord _profile_record;
+  uint8_t _profile_slot;
+  uint8_t _profile_chunk;
+  volatile bool _profile_running;
+  void ProfileRoutine(void* unused);
+#endif
   callback_t _on_finish_cb;
   void* _on_finish_arg1;
   callback_t _on_err_cb;
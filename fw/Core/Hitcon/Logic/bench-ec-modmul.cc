@@ -0,0 +1,122 @@
+#ifdef HITCON_TEST_MODE
+
+// Host-side benchmark of the modular multiplication behind EcLogic.
+// Checks the Montgomery multiplication in EcModMul.h against __uint128_t
+// remainders for both curve moduli, with and without the constant time
+// option, and on the 32 bit path the badge takes as well as the host's. Then
+// times each of them against the shift-and-add ModMulService used to run,
+// 64 modadd()s to a product.
+//
+// Build and run with `make bench` in this directory.
+
+#include <Logic/EcModMul.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace hitcon::ecc::internal;
+
+namespace {
+
+constexpr uint64_t kField = 0xbcffb098340493;
+constexpr uint64_t kOrder = 0xbcffb09c43733d;
+constexpr size_t kInputs = 1 << 12;
+constexpr int kRounds = 64;
+
+// What ModMulService::routineFunc() does over its four runs.
+uint64_t ShiftAdd(uint64_t a, uint64_t b, uint64_t m) {
+  uint64_t res = 0;
+  for (int i = 0; i < 64; i++) {
+    res = modadd(res, res, m);
+    if (b & (1ULL << 63)) res = modadd(res, a, m);
+    b <<= 1;
+  }
+  return res;
+}
+
+uint64_t Reference(uint64_t a, uint64_t b, uint64_t m) {
+  return static_cast<__uint128_t>(a) * b % m;
+}
+
+std::vector<uint64_t> Inputs(uint64_t m, uint32_t seed) {
+  std::mt19937_64 rng(seed);
+  std::vector<uint64_t> inputs = {0, 1, 2, m - 1, m - 2, m >> 1};
+  while (inputs.size() < kInputs) inputs.push_back(rng() % m);
+  return inputs;
+}
+
+void TestCorrect(const MontModulus &mod) {
+  const std::vector<uint64_t> a = Inputs(mod.m, 1), b = Inputs(mod.m, 2);
+  for (size_t i = 0; i < kInputs; i++) {
+    for (size_t j = 0; j < 16; j++) {
+      const uint64_t x = a[i], y = b[(i + j * 97) % kInputs];
+      const uint64_t expected = Reference(x, y, mod.m);
+      assert(ShiftAdd(x, y, mod.m) == expected);
+      for (int ct = 0; ct < 2; ct++) {
+        for (int limbs = 0; limbs < 2; limbs++) {
+          assert(modMul(x, y, mod, ct, limbs) == expected);
+        }
+      }
+    }
+  }
+  // R^2 and -m^-1 are what they should be.
+  const __uint128_t r = static_cast<__uint128_t>(1) << 64;
+  assert(mod.r2 == r % mod.m * (r % mod.m) % mod.m);
+  assert(mod.m * mod.mNegInv == UINT64_MAX);
+}
+
+volatile uint64_t g_sink;
+
+template <typename Mul>
+double NsPerMul(uint64_t m, Mul mul) {
+  const std::vector<uint64_t> a = Inputs(m, 3), b = Inputs(m, 4);
+  uint64_t acc = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < kRounds; round++) {
+    for (size_t i = 0; i < kInputs; i++) {
+      // Chained, so the products aren't overlapped.
+      acc = mul(a[i] ^ (acc & 1), b[i]);
+    }
+  }
+  const auto end = std::chrono::steady_clock::now();
+  g_sink = acc;
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         (kRounds * kInputs);
+}
+
+void Bench(const char *name, const MontModulus &mod) {
+  const uint64_t m = mod.m;
+  const double shift_add =
+      NsPerMul(m, [m](uint64_t a, uint64_t b) { return ShiftAdd(a, b, m); });
+  printf("%-6s  %10.1f", name, shift_add);
+  for (int limbs = 0; limbs < 2; limbs++) {
+    for (int ct = 0; ct < 2; ct++) {
+      const double ns = NsPerMul(m, [&mod, ct, limbs](uint64_t a, uint64_t b) {
+        return modMul(a, b, mod, ct, limbs);
+      });
+      printf("  %6.1f (%4.0fx)", ns, shift_add / ns);
+    }
+  }
+  printf("\n");
+}
+
+}  // namespace
+
+int main() {
+  static constexpr MontModulus field(kField);
+  static constexpr MontModulus order(kOrder);
+  TestCorrect(field);
+  TestCorrect(order);
+  printf("modmul: Montgomery matches __uint128_t on both moduli\n");
+  printf("ns/mul  shift-add    128 bit       128 bit ct    32 bit"
+         "        32 bit ct\n");
+  Bench("field", field);
+  Bench("order", order);
+  printf("bench-ec-modmul done.\n");
+  return 0;
+}
+
+#endif  // HITCON_TEST_MODE
@@ -0,0 +1,274 @@
+#ifdef HITCON_TEST_MODE
+
+// Host test of EcLogic on the scheduler and the virtual SysTimer.
+// Cross-checks PointMultService against double-and-add with the affine
+// PointAddService, for scalars around 0, the group order and random ones:
+// the generator's comb, wNAF with the tables made at compile time and
+// without one, and two terms at once. Then checks a signature from
+// StartSign() against the public key from SetPrivateKey(), that
+// StartVerify() turns down a bad one, and signs and verifies on all the
+// EC_LOGIC_CONTEXTS at once.
+//
+// Build and run with `make check` in this directory.
+
+#include <Logic/EcLogic.h>
+#include <Service/Sched/Scheduler.h>
+#include <Service/Sched/SysTimer.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using namespace hitcon;
+using namespace hitcon::ecc;
+using namespace hitcon::ecc::internal;
+using namespace hitcon::service::sched;
+
+namespace {
+
+constexpr uint64_t kField = 0xbcffb098340493;
+constexpr uint64_t kOrder = 0xbcffb09c43733d;
+const EcPoint kGenerator({0x9a77dc33b36acc, kField},
+                         {0x279be90a95dbdd, kField});
+const EcPoint kServerPubKey({0x05cb6b63de507e, kField},
+                            {0x4df751a1388b25, kField});
+
+EcEngine g_engine;
+EcPoint g_point;
+bool g_done;
+
+void OnPoint(void *, void *arg2) {
+  g_point = *static_cast<EcPoint *>(arg2);
+  g_done = true;
+}
+
+// Tasks ran until the callback.
+size_t RunUntilDone() {
+  const size_t start = scheduler.GetTotalTasksRan();
+  while (!g_done) {
+    scheduler.RunOnce();
+    SysTimer::AdvanceCycles(1000);
+  }
+  g_done = false;
+  return scheduler.GetTotalTasksRan() - start;
+}
+
+size_t g_add_tasks;
+
+EcPoint Add(const EcPoint &a, const EcPoint &b) {
+  g_done = false;
+  g_engine.pointAdd.start(a, b, &OnPoint, nullptr);
+  g_add_tasks += RunUntilDone();
+  return g_point;
+}
+
+// p * times the way PointMultService used to, in affine coordinates.
+EcPoint AffineMult(const EcPoint &p, uint64_t times) {
+  EcPoint res;
+  for (int i = 63; i >= 0; i--) {
+    res = Add(res, res);
+    if ((times >> i) & 1) res = Add(res, p);
+  }
+  return res;
+}
+
+size_t g_mult_tasks;
+
+EcPoint Mult(const EcPoint &p, uint64_t times) {
+  g_done = false;
+  g_engine.pointMult.start(p, times, &OnPoint, nullptr);
+  g_mult_tasks += RunUntilDone();
+  return g_point;
+}
+
+EcPoint Mult(const EcPoint &p, uint64_t p_times, const EcPoint &q,
+             uint64_t q_times) {
+  g_done = false;
+  g_engine.pointMult.start(p, p_times, q, q_times, &OnPoint, nullptr);
+  RunUntilDone();
+  return g_point;
+}
+
+const uint64_t kScalars[] = {0,          1,      2,          3,
+                             kOrder - 1, kOrder, kOrder + 1, 1ULL << 63,
+                             UINT64_MAX, 0x1234, 0xfedcba9876543210};
+
+void TestMult() {
+  // Without a table of its own.
+  const EcPoint other = AffineMult(kGenerator, 5);
+  std::mt19937_64 rng(1);
+  size_t mults = 0, affine_mults = 1;
+  for (const EcPoint &p : {kGenerator, kServerPubKey, other}) {
+    for (uint64_t times : kScalars) {
+      const EcPoint expected = AffineMult(p, times);
+      affine_mults++;
+      assert(Mult(p, times) == expected);
+      mults++;
+    }
+    for (int i = 0; i < 4; i++) {
+      const uint64_t times = rng();
+      assert(Mult(p, times) == AffineMult(p, times));
+      affine_mults++;
+      mults++;
+    }
+    assert(Mult(p, kOrder - 1) == -p);
+    assert(Mult(p, 1) == p);
+    mults += 2;
+  }
+  // The identity times anything.
+  assert(Mult(EcPoint(), 12345).identity());
+  printf("mult: matches affine, %zu tasks a multiply, %zu before\n",
+         g_mult_tasks / (mults + 1), g_add_tasks / affine_mults);
+}
+
+void TestSum() {
+  std::mt19937_64 rng(2);
+  const EcPoint other = AffineMult(kGenerator, 5);
+  for (int i = 0; i < 8; i++) {
+    const uint64_t a = i < 4 ? kScalars[i * 2] : rng() % kOrder;
+    const uint64_t b = i < 4 ? kScalars[i * 2 + 1] : rng() % kOrder;
+    const EcPoint &q = i & 1 ? kServerPubKey : other;
+    const EcPoint expected = Add(AffineMult(kGenerator, a), AffineMult(q, b));
+    assert(Mult(kGenerator, a, q, b) == expected);
+  }
+  // Cancelling out.
+  assert(Mult(kGenerator, 7, kGenerator, kOrder - 7).identity());
+  printf("sum: two terms at once match affine\n");
+}
+
+Signature g_signature;
+
+void OnSigned(void *arg1, void *arg2) {
+  Signature *signature = arg1 ? static_cast<Signature *>(arg1) : &g_signature;
+  *signature = *static_cast<Signature *>(arg2);
+  g_done = true;
+}
+
+uint64_t PowMod(uint64_t a, uint64_t e, uint64_t m) {
+  uint64_t res = 1;
+  for (; e; e >>= 1) {
+    if (e & 1) res = static_cast<__uint128_t>(res) * a % m;
+    a = static_cast<__uint128_t>(a) * a % m;
+  }
+  return res;
+}
+
+const uint64_t kPrivKey = 0x123456789abcd;
+EcPoint g_pubkey;
+
+// Whether signature is message's, checked the way the server does.
+bool Check(const uint8_t *message, size_t len, const Signature &signature) {
+  uint8_t digest[hash::SHA3_BIT_SIZE / 8];
+  sha3_HashBuffer(hash::SHA3_BIT_SIZE, SHA3_FLAGS_NONE, message, len, digest,
+                  sizeof(digest));
+  uint64_t z;
+  memcpy(&z, digest, sizeof(z));
+  z %= kOrder;
+  const uint64_t s_inv = PowMod(signature.s, kOrder - 2, kOrder);
+  const uint64_t u1 = static_cast<__uint128_t>(z) * s_inv % kOrder;
+  const uint64_t u2 = static_cast<__uint128_t>(signature.r) * s_inv % kOrder;
+  // u1 * G + u2 * Q has to come out at r.
+  const EcPoint p = Mult(kGenerator, u1, g_pubkey, u2);
+  return !p.identity() && p.xval() == signature.r;
+}
+
+void TestSign() {
+  const uint64_t privkey = kPrivKey;
+  g_ec_logic.SetPrivateKey(privkey);
+  // There's no callback for the public key.
+  for (int i = 0; i < 10000; i++) {
+    scheduler.RunOnce();
+    SysTimer::AdvanceCycles(1000);
+  }
+  uint8_t pubkey[ECC_PUBKEY_SIZE];
+  assert(g_ec_logic.GetPublicKey());
+  memcpy(pubkey, g_ec_logic.GetPublicKey(), sizeof(pubkey));
+  g_pubkey = Mult(kGenerator, privkey);
+  uint8_t expected[ECC_PUBKEY_SIZE];
+  assert(g_pubkey.getCompactForm(expected, sizeof(expected)));
+  assert(!memcmp(pubkey, expected, sizeof(pubkey)));
+
+  uint8_t message[] = "signed by a badge";
+  g_done = false;
+  assert(g_ec_logic.StartSign(message, sizeof(message), &OnSigned, nullptr));
+  const size_t tasks = RunUntilDone();
+
+  assert(Check(message, sizeof(message), g_signature));
+  printf("sign: the signature checks out, %zu tasks\n", tasks);
+}
+
+bool g_verified;
+
+void OnVerified(void *, void *arg2) {
+  g_verified = arg2 != nullptr;
+  g_done = true;
+}
+
+void TestVerify() {
+  // Not the server's.
+  uint8_t message[] = "signed by a badge";
+  uint8_t signature[ECC_SIGNATURE_SIZE];
+  g_signature.toBuffer(signature);
+  g_done = false;
+  assert(g_ec_logic.StartVerify(message, sizeof(message), signature,
+                                &OnVerified, nullptr));
+  const size_t tasks = RunUntilDone();
+  assert(!g_verified);
+  printf("verify: a badge's signature isn't the server's, %zu tasks\n",
+         tasks);
+}
+
+size_t g_verify_done;
+
+void OnConcurrentVerified(void *, void *arg2) {
+  assert(!arg2);
+  g_verify_done++;
+}
+
+void TestConcurrent() {
+  uint8_t messages[EC_LOGIC_CONTEXTS][8];
+  Signature signatures[EC_LOGIC_CONTEXTS] = {};
+  for (size_t i = 0; i < EC_LOGIC_CONTEXTS; i++) {
+    memset(messages[i], i, sizeof(messages[i]));
+    assert(g_ec_logic.StartSign(messages[i], sizeof(messages[i]), &OnSigned,
+                                &signatures[i]));
+  }
+  // All taken.
+  uint8_t signature[ECC_SIGNATURE_SIZE] = {};
+  assert(!g_ec_logic.StartSign(messages[0], 8, &OnSigned, nullptr));
+  assert(!g_ec_logic.StartVerify(messages[0], 8, signature,
+                                 &OnConcurrentVerified, nullptr));
+  size_t tasks = 0;
+  for (size_t i = 0; i < EC_LOGIC_CONTEXTS; i++) tasks += RunUntilDone();
+  for (size_t i = 0; i < EC_LOGIC_CONTEXTS; i++) {
+    assert(signatures[i].r && Check(messages[i], 8, signatures[i]));
+  }
+
+  // A sign next to a verify, of a signature of zeros.
+  assert(g_ec_logic.StartSign(messages[0], 8, &OnSigned, &signatures[0]));
+  assert(g_ec_logic.StartVerify(messages[1], 8, signature,
+                                &OnConcurrentVerified, nullptr));
+  RunUntilDone();
+  while (!g_verify_done) scheduler.RunOnce();
+  assert(Check(messages[0], 8, signatures[0]));
+  printf("concurrent: %zu signs at once in %zu tasks, a sign next to a "
+         "verify\n",
+         EC_LOGIC_CONTEXTS, tasks);
+}
+
+}  // namespace
+
+int main() {
+  SysTimer::Init();
+  hash::g_hash_service.Init();
+  TestMult();
+  TestSum();
+  TestSign();
+  TestVerify();
+  TestConcurrent();
+  printf("test-ec-logic PASSED.\n");
+  return 0;
+}
+
+#endif  // HITCON_TEST_MODE
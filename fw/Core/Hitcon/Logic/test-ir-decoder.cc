@@ -0,0 +1,405 @@
+#ifdef HITCON_TEST_MODE
+
+// Equivalence test for IrDecoder.
+// Feeds the same random sample streams, clean packets, noise, bit errors,
+// collisions and truncated packets, to IrDecoder and to a copy of the bit at
+// a time state machine IrLogic::OnBufferReceived() used before it, in receive
+// buffers the way IrLogic does, and checks that they find the same headers
+// and frames at the same bytes. Then compares their speed.
+//
+// Build and run with `make check` in this directory.
+
+#include <Logic/IrDecoder.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace hitcon::ir;
+
+namespace {
+
+// IrLogic::OnBufferReceived() before IrDecoder, with the IrLogic bits taken
+// out and the same events reported.
+class ReferenceDecoder {
+ public:
+  enum PACKET_STATE {
+    STATE_START = 0,
+    STATE_SIZE = 1,
+    STATE_DATA = 2,
+    STATE_CHKSUM = 3,
+    STATE_RESET = 4,
+  };
+
+  enum BIT_STATE {
+    BIT_OFF = 0,
+    BIT_ON = 1,
+    BIT_INVALID = 2,
+  };
+
+  // IrLogic is a global, zeroed at startup.
+  ReferenceDecoder() { memset(rx_packet.data_, 0, sizeof(rx_packet.data_)); }
+
+  static uint8_t decode_bit(uint8_t x) {
+    uint8_t cnt = __builtin_popcount(x & 0b1111);
+    switch (cnt) {
+      case 0:
+      case 1:
+        return BIT_OFF;
+      case 3:
+      case 4:
+        return BIT_ON;
+      case 2:
+      default:
+        return BIT_INVALID;
+    }
+  }
+
+  uint8_t Decode(uint8_t current_byte) {
+    uint8_t events = 0;
+    for (uint8_t j = 0; j < 8; j++) {
+      uint8_t is_on = current_byte & 0x01;
+      current_byte = current_byte >> 1;
+      switch (packet_state) {
+        case STATE_START:
+          packet_buf <<= 1;
+          packet_buf |= is_on;
+          if ((packet_buf & IR_PACKET_HEADER_MASK) ==
+              (IR_PACKET_HEADER_PACKED & IR_PACKET_HEADER_MASK)) {
+            packet_state = STATE_SIZE;
+            events |= IrDecoder::kHeader;
+            rx_packet.size_ = 0;
+            packet_buf = 0;
+            bit = 0;
+          }
+          break;
+        case STATE_SIZE:
+          packet_buf++;
+          bit <<= 1;
+          bit |= is_on;
+          if ((packet_buf & 3) == 0) {
+            if (decode_bit(bit) == BIT_INVALID) {
+              packet_state = STATE_RESET;
+              return events | IrDecoder::kDropBuffer;
+            }
+            const uint8_t bitpos = (packet_buf / DECODE_SAMPLE_RATIO - 1);
+            rx_packet.size_ |= decode_bit(bit) << bitpos;
+            bit = 0;
+          }
+          if (packet_buf == DECODE_SAMPLE_RATIO * 8) {
+            if (rx_packet.size_ >= MAX_PACKET_PAYLOAD_BYTES) {
+              packet_state = STATE_RESET;
+            } else if (rx_packet.size_ < (2 + IR_CHKSUM_SZ / 8)) {
+              packet_state = STATE_RESET;
+            } else {
+              rx_packet.data_[0] = rx_packet.size_;
+              packet_state = STATE_DATA;
+              packet_buf = 0;
+            }
+          }
+          break;
+        case STATE_DATA:
+          packet_buf++;
+          bit <<= 1;
+          bit |= is_on;
+          if ((packet_buf % DECODE_SAMPLE_RATIO) == 0) {
+            if (decode_bit(bit) == BIT_INVALID) {
+              packet_state = STATE_RESET;
+              break;
+            }
+            const uint8_t pos = (packet_buf / DECODE_SAMPLE_RATIO - 1) / 8 + 1;
+            const uint8_t bitpos = (packet_buf / DECODE_SAMPLE_RATIO - 1) % 8;
+            assert(pos < MAX_PACKET_PAYLOAD_BYTES + 4);
+            rx_packet.data_[pos] |= decode_bit(bit) << bitpos;
+            if (pos == rx_packet.size_ - 2 && bitpos == 7) {
+              packet_state = STATE_CHKSUM;
+              break;
+            }
+            assert(pos <= rx_packet.size_ - 2);
+          }
+          break;
+        case STATE_CHKSUM:
+          packet_buf++;
+          bit <<= 1;
+          bit |= is_on;
+          if ((packet_buf % DECODE_SAMPLE_RATIO) == 0) {
+            if (decode_bit(bit) == BIT_INVALID) {
+              packet_state = STATE_RESET;
+              break;
+            }
+            const uint8_t bitpos =
+                (packet_buf / DECODE_SAMPLE_RATIO - 1) % IR_CHKSUM_SZ;
+            rx_packet.data_[rx_packet.size_ - 1] |= decode_bit(bit) << bitpos;
+            if (bitpos == IR_CHKSUM_SZ - 1) {
+              packet_buf = 0;
+              packet_state = STATE_RESET;
+              frame = rx_packet;
+              events |= IrDecoder::kFrame;
+            }
+          }
+          break;
+        case STATE_RESET:
+          packet_state = STATE_START;
+          events |= IrDecoder::kIdle;
+          packet_buf = 0;
+          bit = 0;
+          memset(rx_packet.data_, 0, sizeof(rx_packet.data_));
+          rx_packet.size_ = 0;
+          break;
+        default:
+          break;
+      }
+    }
+    return events;
+  }
+
+  const IrPacket &Frame() const { return frame; }
+
+ private:
+  size_t packet_buf = 0;
+  uint8_t packet_state = 0;
+  uint8_t bit = 0;
+  IrPacket rx_packet;
+  IrPacket frame;
+};
+
+struct Record {
+  size_t offset;
+  uint8_t events;
+  std::vector<uint8_t> frame;
+
+  bool operator==(const Record &other) const {
+    return offset == other.offset && events == other.events &&
+           frame == other.frame;
+  }
+};
+
+// The old state machine knew no FEC header, which noise can look like.
+void Configure(IrDecoder &decoder) { decoder.SetFecReceive(false); }
+void Configure(ReferenceDecoder &) {}
+
+// Decode `stream` a receive buffer at a time like IrLogic, which skips the
+// rest of the buffer on kDropBuffer.
+template <typename Decoder>
+std::vector<Record> Run(const std::vector<uint8_t> &stream) {
+  Decoder decoder;
+  Configure(decoder);
+  std::vector<Record> records;
+  for (size_t base = 0; base < stream.size();
+       base += IR_SERVICE_RX_ON_BUFFER_SIZE) {
+    for (size_t i = 0; i < IR_SERVICE_RX_ON_BUFFER_SIZE; i++) {
+      uint8_t events = decoder.Decode(stream[base + i]);
+      if (!events) continue;
+      Record r = {base + i, events, {}};
+      if (events & IrDecoder::kFrame) {
+        const IrPacket &frame = decoder.Frame();
+        r.frame.assign(frame.data_, frame.data_ + frame.size_);
+      }
+      records.push_back(r);
+      if (events & IrDecoder::kDropBuffer) break;
+    }
+  }
+  return records;
+}
+
+// Builds a sample stream, a sample per bit.
+class Stream {
+ public:
+  explicit Stream(std::mt19937 &rng) : rng_(rng) {}
+
+  void Quiet(size_t n) { samples_.resize(samples_.size() + n, 0); }
+
+  void Noise(size_t n) {
+    for (size_t i = 0; i < n; i++) samples_.push_back(rng_() & 1);
+  }
+
+  // The frame IrLogic::EncodePacket() and IrService would send for a frame
+  // of `size` bytes, size byte and checksum included.
+  std::vector<uint8_t> Packet(uint8_t size) {
+    std::vector<uint8_t> frame(size);
+    frame[0] = size;
+    for (size_t i = 1; i < size; i++) frame[i] = rng_();
+    int header_bits = 32 - __builtin_clz(IR_PACKET_HEADER_PACKED);
+    for (int i = header_bits - 1; i >= 0; i--) {
+      samples_.push_back((IR_PACKET_HEADER_PACKED >> i) & 1);
+    }
+    for (uint8_t byte : frame) {
+      for (int i = 0; i < 8; i++) {
+        for (size_t j = 0; j < DECODE_SAMPLE_RATIO; j++) {
+          samples_.push_back((byte >> i) & 1);
+        }
+      }
+    }
+    return frame;
+  }
+
+  // Damage the last `n` samples.
+  void Flip(size_t n, double ber) {
+    std::bernoulli_distribution flip(ber);
+    for (size_t i = samples_.size() - n; i < samples_.size(); i++) {
+      if (flip(rng_)) samples_[i] ^= 1;
+    }
+  }
+
+  // Overlay another packet `shift` samples into the last `n` samples.
+  void Collide(size_t n, size_t shift) {
+    Stream other(rng_);
+    other.Packet(rng_() % 28 + 3);
+    for (size_t i = 0; i + shift < n && i < other.samples_.size(); i++) {
+      samples_[samples_.size() - n + shift + i] |= other.samples_[i];
+    }
+  }
+
+  void Truncate(size_t n) { samples_.resize(samples_.size() - n); }
+
+  size_t Size() const { return samples_.size(); }
+
+  std::vector<uint8_t> Bytes() const {
+    std::vector<uint8_t> bytes(samples_.size() / 8 + 1);
+    for (size_t i = 0; i < samples_.size(); i++) {
+      bytes[i / 8] |= samples_[i] << (i % 8);
+    }
+    bytes.resize((bytes.size() + IR_SERVICE_RX_ON_BUFFER_SIZE - 1) /
+                 IR_SERVICE_RX_ON_BUFFER_SIZE * IR_SERVICE_RX_ON_BUFFER_SIZE);
+    return bytes;
+  }
+
+ private:
+  std::mt19937 &rng_;
+  std::vector<uint8_t> samples_;
+};
+
+std::vector<uint8_t> RandomStream(std::mt19937 &rng, size_t packets) {
+  Stream s(rng);
+  for (size_t i = 0; i < packets; i++) {
+    s.Quiet(rng() % 80);
+    switch (rng() % 8) {
+      case 0:
+        s.Noise(rng() % 200);
+        break;
+      case 1: {
+        // Any size byte, including the ones that are dropped.
+        size_t before = s.Size();
+        s.Packet(rng() % 40 + 1);
+        s.Flip(s.Size() - before, 0.002);
+        break;
+      }
+      case 2: {
+        size_t before = s.Size();
+        s.Packet(rng() % 29 + 3);
+        s.Flip(s.Size() - before, 0.02);
+        break;
+      }
+      case 3: {
+        size_t before = s.Size();
+        s.Packet(rng() % 29 + 3);
+        s.Collide(s.Size() - before, rng() % (s.Size() - before));
+        break;
+      }
+      case 4: {
+        size_t before = s.Size();
+        s.Packet(rng() % 29 + 3);
+        s.Truncate(rng() % (s.Size() - before));
+        break;
+      }
+      default:
+        s.Packet(rng() % 29 + 3);
+        break;
+    }
+  }
+  return s.Bytes();
+}
+
+void TestCleanPackets() {
+  std::mt19937 rng(1);
+  Stream s(rng);
+  std::vector<std::vector<uint8_t>> sent;
+  for (int i = 0; i < 2000; i++) {
+    s.Quiet(rng() % 64 + 1);
+    sent.push_back(s.Packet(rng() % 29 + 3));
+  }
+  std::vector<Record> records = Run<IrDecoder>(s.Bytes());
+  size_t frames = 0;
+  for (const Record &r : records) {
+    if (!(r.events & IrDecoder::kFrame)) continue;
+    assert(frames < sent.size());
+    assert(r.frame == sent[frames]);
+    frames++;
+  }
+  assert(frames == sent.size());
+  printf("clean: %zu/%zu frames decoded\n", frames, sent.size());
+}
+
+void TestEquivalence() {
+  std::mt19937 rng(2);
+  size_t bytes = 0, records = 0, frames = 0, drops = 0;
+  for (int round = 0; round < 400; round++) {
+    std::vector<uint8_t> stream = RandomStream(rng, 50);
+    std::vector<Record> expected = Run<ReferenceDecoder>(stream);
+    std::vector<Record> actual = Run<IrDecoder>(stream);
+    if (expected != actual) {
+      size_t i = 0;
+      while (i < expected.size() && i < actual.size() &&
+             expected[i] == actual[i]) {
+        i++;
+      }
+      printf("round %d: mismatch at record %zu\n", round, i);
+      if (i < expected.size()) {
+        printf("  expected offset %zu events %02x\n", expected[i].offset,
+               expected[i].events);
+        for (uint8_t b : expected[i].frame) printf(" %02x", b);
+        printf("\n");
+      }
+      if (i < actual.size()) {
+        printf("  actual   offset %zu events %02x\n", actual[i].offset,
+               actual[i].events);
+        for (uint8_t b : actual[i].frame) printf(" %02x", b);
+        printf("\n");
+      }
+      assert(false);
+    }
+    bytes += stream.size();
+    records += expected.size();
+    for (const Record &r : expected) {
+      frames += !r.frame.empty();
+      drops += !!(r.events & IrDecoder::kDropBuffer);
+    }
+  }
+  printf("random: %zu bytes, %zu events, %zu frames, %zu drops identical\n",
+         bytes, records, frames, drops);
+}
+
+template <typename Decoder>
+double Throughput(const std::vector<uint8_t> &stream, int rounds) {
+  auto start = std::chrono::steady_clock::now();
+  size_t events = 0;
+  for (int i = 0; i < rounds; i++) events += Run<Decoder>(stream).size();
+  auto end = std::chrono::steady_clock::now();
+  assert(events);
+  double s = std::chrono::duration<double>(end - start).count();
+  return stream.size() * rounds / s / 1e6;
+}
+
+void Benchmark() {
+  std::mt19937 rng(3);
+  std::vector<uint8_t> stream = RandomStream(rng, 2000);
+  double ref = Throughput<ReferenceDecoder>(stream, 20);
+  double table = Throughput<IrDecoder>(stream, 20);
+  printf("bit at a time: %7.1f MB/s\n", ref);
+  printf("IrDecoder:     %7.1f MB/s (%.1fx)\n", table, table / ref);
+}
+
+}  // namespace
+
+int main() {
+  TestCleanPackets();
+  TestEquivalence();
+  Benchmark();
+  printf("test-ir-decoder PASSED.\n");
+  return 0;
+}
+
+#endif  // HITCON_TEST_MODE
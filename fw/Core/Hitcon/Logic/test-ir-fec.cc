@@ -0,0 +1,146 @@
+#ifdef HITCON_TEST_MODE
+
+// Tests and benchmarks the forward error correction of IR frames: the
+// Hamming(8,4) code of the size and the Reed-Solomon code of the frame.
+// Every pattern of bad bytes within the correction capability has to be
+// corrected, and nothing beyond it may come out as anything but a codeword.
+//
+// Build and run with `make check` in this directory.
+
+#include <Logic/IrFec.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace hitcon::ir;
+using namespace hitcon::ir::fec;
+
+namespace {
+
+constexpr size_t kMaxLen = MAX_PACKET_PAYLOAD_BYTES - 1 + IR_FEC_PARITY_BYTES;
+
+void TestHamming() {
+  for (int d = 0; d < 16; d++) {
+    uint8_t code = HammingEncode(d);
+    assert(HammingDecode(code) == d);
+    for (int i = 0; i < 8; i++) {
+      assert(HammingDecode(code ^ (1 << i)) == d);
+      for (int j = i + 1; j < 8; j++) {
+        assert(HammingDecode(code ^ (1 << i) ^ (1 << j)) == kHammingInvalid);
+      }
+    }
+  }
+  printf("hamming: all single bit errors corrected, double detected\n");
+}
+
+std::vector<uint8_t> Codeword(std::mt19937 &rng, size_t len) {
+  std::vector<uint8_t> word(len);
+  for (size_t i = 0; i + IR_FEC_PARITY_BYTES < len; i++) word[i] = rng();
+  RsEncode(word.data(), len - IR_FEC_PARITY_BYTES,
+           word.data() + len - IR_FEC_PARITY_BYTES);
+  return word;
+}
+
+// Damage `bad` distinct bytes of `word`, the first `erased` of them reported
+// as erasures.
+void Damage(std::mt19937 &rng, std::vector<uint8_t> &word, size_t bad,
+            size_t erased, uint8_t *erasures) {
+  std::vector<uint8_t> positions;
+  while (positions.size() < bad) {
+    uint8_t pos = rng() % word.size();
+    bool dup = false;
+    for (uint8_t p : positions) dup |= p == pos;
+    if (dup) continue;
+    positions.push_back(pos);
+    // Erased bytes may still happen to be right.
+    word[pos] ^= positions.size() <= erased ? rng() : rng() % 255 + 1;
+  }
+  for (size_t i = 0; i < erased; i++) erasures[i] = positions[i];
+}
+
+void TestReedSolomon() {
+  std::mt19937 rng(1);
+  size_t corrected = 0, detected = 0, miscorrected = 0;
+  for (int round = 0; round < 200000; round++) {
+    // A frame is at least the size, a payload byte and the checksum.
+    const size_t len = rng() % (kMaxLen - IR_FEC_PARITY_BYTES - 2) + 3 +
+                       IR_FEC_PARITY_BYTES;
+    std::vector<uint8_t> sent = Codeword(rng, len);
+    std::vector<uint8_t> word = sent;
+    const size_t erased = rng() % (IR_FEC_PARITY_BYTES + 1);
+    const size_t errors = rng() % (IR_FEC_PARITY_BYTES + 2);
+    uint8_t erasures[IR_FEC_PARITY_BYTES];
+    Damage(rng, word, std::min(erased + errors, len), erased, erasures);
+    int ret = RsDecode(word.data(), len, erasures, erased);
+    if (2 * errors + erased <= IR_FEC_PARITY_BYTES) {
+      assert(ret >= 0);
+      assert(word == sent);
+      corrected++;
+    } else if (ret < 0) {
+      detected++;
+    } else {
+      // Must at least be a codeword.
+      std::vector<uint8_t> check = word;
+      RsEncode(check.data(), len - IR_FEC_PARITY_BYTES,
+               check.data() + len - IR_FEC_PARITY_BYTES);
+      assert(check == word);
+      miscorrected++;
+    }
+  }
+  printf("reed-solomon: %zu corrected, beyond capability %zu detected, %zu "
+         "miscorrected\n",
+         corrected, detected, miscorrected);
+}
+
+void Benchmark() {
+  std::mt19937 rng(2);
+  const size_t len = kMaxLen;
+  std::vector<uint8_t> sent = Codeword(rng, len);
+  const int rounds = 200000;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    sent[i % (len - IR_FEC_PARITY_BYTES)] = i;
+    RsEncode(sent.data(), len - IR_FEC_PARITY_BYTES,
+             sent.data() + len - IR_FEC_PARITY_BYTES);
+  }
+  auto end = std::chrono::steady_clock::now();
+  double s = std::chrono::duration<double>(end - start).count();
+  printf("encode:          %6.2f us per frame\n", s / rounds * 1e6);
+
+  for (size_t errors : {0, 1, 2}) {
+    std::vector<std::vector<uint8_t>> words;
+    for (int i = 0; i < 1000; i++) {
+      words.push_back(sent);
+      Damage(rng, words.back(), errors, 0, nullptr);
+    }
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+      std::vector<uint8_t> &word = words[i % words.size()];
+      uint8_t copy[kMaxLen];
+      memcpy(copy, word.data(), len);
+      int ret = RsDecode(copy, len, nullptr, 0);
+      assert(ret == static_cast<int>(errors));
+    }
+    end = std::chrono::steady_clock::now();
+    s = std::chrono::duration<double>(end - start).count();
+    printf("decode, %zu bad:  %6.2f us per frame\n", errors,
+           s / rounds * 1e6);
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestHamming();
+  TestReedSolomon();
+  Benchmark();
+  printf("test-ir-fec PASSED.\n");
+  return 0;
+}
+
+#endif  // HITCON_TEST_MODE
@@ -0,0 +1,264 @@
+#ifdef HITCON_TEST_MODE
+
+// Benchmark of IrDecoder's soft decision mode against the hard decision one,
+// and of frames with forward error correction.
+// Packets are sent over a synthetic channel by badges whose clocks are a bit
+// off from the receiver's, with a random sampling phase, noisy edges and bit
+// errors, and received the way IrLogic does, checksum and Repair() included.
+// Prints the share of packets that got through for each channel and checks
+// that soft decision is never worse and copes with the clock drift, and that
+// FEC gets more of them through noise.
+//
+// Build and run with `make check` in this directory.
+
+#include <Logic/IrDecoder.h>
+#include <Logic/IrFec.h>
+
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace hitcon::ir;
+
+namespace {
+
+uint32_t Crc32(const uint8_t *buffer, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= buffer[i];
+    for (int j = 0; j < 8; j++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+// IrLogic's merge_chksum() of the frame without its last byte.
+uint8_t Checksum(const uint8_t *frame, size_t len) {
+  uint32_t crc = Crc32(frame, len);
+  return crc ^ (crc >> 8) ^ (crc >> 16) ^ (crc >> 24);
+}
+
+bool ChecksumValid(const IrPacket &packet) {
+  return Checksum(packet.data_, packet.size_ - 1) ==
+         packet.data_[packet.size_ - 1];
+}
+
+struct Channel {
+  // Largest difference between a sender's and the receiver's clock, each
+  // packet is from a sender somewhere in between.
+  double drift;
+  // Samples this close to a transition of the signal, in sample periods,
+  // are a coin toss.
+  double jitter;
+  double ber;
+};
+
+struct Result {
+  size_t sent;
+  size_t good;
+  size_t bad;
+};
+
+// The levels of a frame, a sample per entry at the receiver's rate. With
+// FEC, the way IrLogic::EncodeFecPacket() lays it out.
+std::vector<uint8_t> Waveform(const std::vector<uint8_t> &frame, bool fec) {
+  std::vector<uint8_t> levels;
+  const uint32_t header =
+      fec ? IR_PACKET_HEADER_FEC_PACKED : IR_PACKET_HEADER_PACKED;
+  int header_bits = 32 - __builtin_clz(header);
+  for (int i = header_bits - 1; i >= 0; i--) {
+    levels.push_back((header >> i) & 1);
+  }
+  std::vector<uint8_t> bytes = frame;
+  if (fec) {
+    uint8_t parity[IR_FEC_PARITY_BYTES];
+    fec::RsEncode(frame.data(), frame.size(), parity);
+    bytes.insert(bytes.end(), parity, parity + IR_FEC_PARITY_BYTES);
+    bytes[0] = fec::HammingEncode(frame[0]);
+    bytes.insert(bytes.begin() + 1, fec::HammingEncode(frame[0] >> 4));
+  }
+  for (uint8_t byte : bytes) {
+    for (int i = 0; i < 8; i++) {
+      for (size_t j = 0; j < DECODE_SAMPLE_RATIO; j++) {
+        levels.push_back((byte >> i) & 1);
+      }
+    }
+  }
+  return levels;
+}
+
+class Link {
+ public:
+  Link(const Channel &channel, uint32_t seed, bool fec = false)
+      : channel_(channel), rng_(seed), fec_(fec) {}
+
+  // Sample `packets` random frames from senders with random clocks.
+  std::vector<uint8_t> Transmit(size_t packets) {
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::vector<uint8_t> samples;
+    // Receiver time of the first sample not taken yet.
+    double t = unit(rng_);
+    for (size_t p = 0; p < packets; p++) {
+      std::vector<uint8_t> frame(rng_() % 29 + 3);
+      frame[0] = frame.size();
+      for (size_t i = 1; i + 1 < frame.size(); i++) frame[i] = rng_();
+      frame.back() = Checksum(frame.data(), frame.size() - 1);
+      sent_.insert(frame);
+      sent_cnt_++;
+      std::vector<uint8_t> levels = Waveform(frame, fec_);
+      // Sample periods of the sender per sample period of the receiver.
+      const double scale = 1 + channel_.drift * (2 * unit(rng_) - 1);
+      const double start = t + 10 + rng_() % 50;
+      const double end = start + levels.size() * scale;
+      for (; t < end + 8; t += 1) {
+        uint8_t level = 0;
+        if (t >= start && t < end) {
+          double x = (t - start) / scale;
+          size_t i = static_cast<size_t>(x);
+          level = levels[i];
+          bool rising = i > 0 && levels[i - 1] != level;
+          bool falling = i + 1 < levels.size() && levels[i + 1] != level;
+          if ((rising && (x - i) * scale < channel_.jitter) ||
+              (falling && (i + 1 - x) * scale < channel_.jitter)) {
+            level = rng_() & 1;
+          }
+        }
+        if (unit(rng_) < channel_.ber) level ^= 1;
+        samples.push_back(level);
+      }
+    }
+    std::vector<uint8_t> bytes(
+        (samples.size() / 8 / IR_SERVICE_RX_ON_BUFFER_SIZE + 1) *
+        IR_SERVICE_RX_ON_BUFFER_SIZE);
+    for (size_t i = 0; i < samples.size(); i++) {
+      bytes[i / 8] |= samples[i] << (i % 8);
+    }
+    return bytes;
+  }
+
+  // Receive like IrLogic::OnBufferReceived().
+  Result Receive(const std::vector<uint8_t> &stream, bool soft,
+                 bool repair = false) {
+    IrDecoder decoder;
+    decoder.SetSoftDecision(soft);
+    decoder.SetSoftRepair(repair);
+    Result result = {sent_cnt_, 0, 0};
+    for (size_t base = 0; base < stream.size();
+         base += IR_SERVICE_RX_ON_BUFFER_SIZE) {
+      for (size_t i = 0; i < IR_SERVICE_RX_ON_BUFFER_SIZE; i++) {
+        uint8_t events = decoder.Decode(stream[base + i]);
+        if ((events & IrDecoder::kFrame) && decoder.Repair(&ChecksumValid)) {
+          const IrPacket &frame = decoder.Frame();
+          std::vector<uint8_t> bytes(frame.data_, frame.data_ + frame.size_);
+          if (sent_.count(bytes)) {
+            result.good++;
+          } else {
+            result.bad++;
+          }
+        }
+        if (events & IrDecoder::kDropBuffer) break;
+      }
+    }
+    return result;
+  }
+
+ private:
+  Channel channel_;
+  std::mt19937 rng_;
+  bool fec_;
+  std::set<std::vector<uint8_t>> sent_;
+  size_t sent_cnt_ = 0;
+};
+
+constexpr size_t kPackets = 2000;
+
+double Percent(size_t n, size_t total) { return 100.0 * n / total; }
+
+void TestChannels() {
+  const double drifts[] = {0, 0.005, 0.01, 0.02, 0.03};
+  const Channel noises[] = {{0, 0, 0}, {0, 0.2, 0}, {0, 0.2, 0.005},
+                            {0, 0.3, 0.01}};
+  printf("drift  jitter  ber    | hard ok  bad | soft ok  bad |"
+         " repair ok  bad |  fec ok  bad\n");
+  size_t total_bad = 0, total_sent = 0;
+  size_t soft_bad = 0, repair_bad = 0;
+  for (double drift : drifts) {
+    for (Channel channel : noises) {
+      channel.drift = drift;
+      const uint32_t seed = 1000 * drift + 10 * channel.jitter + channel.ber;
+      Link link(channel, seed);
+      std::vector<uint8_t> stream = link.Transmit(kPackets);
+      Result hard = link.Receive(stream, false);
+      Result soft = link.Receive(stream, true);
+      Result repair = link.Receive(stream, true, true);
+      Link fec_link(channel, seed, true);
+      Result fec = fec_link.Receive(fec_link.Transmit(kPackets), true);
+      printf("%4.1f%%  %5.2f  %4.1f%%  | %5.1f%%  %3zu | %5.1f%%  %3zu |"
+             "   %5.1f%%  %3zu | %5.1f%%  %3zu\n",
+             drift * 100, channel.jitter, channel.ber * 100,
+             Percent(hard.good, hard.sent), hard.bad,
+             Percent(soft.good, soft.sent), soft.bad,
+             Percent(repair.good, repair.sent), repair.bad,
+             Percent(fec.good, fec.sent), fec.bad);
+      // The parity bytes make frames longer, but should more than pay for
+      // themselves once bits go bad.
+      if (channel.ber > 0 && drift <= 0.01) {
+        assert(fec.good > soft.good);
+      }
+      if (drift == 0 && channel.ber == 0 && channel.jitter == 0) {
+        assert(fec.good == fec.sent);
+      }
+      total_bad += fec.bad;
+      total_sent += fec.sent;
+      // Never worse than hard decision, give or take a packet to a false
+      // repair.
+      assert(soft.good + kPackets / 200 >= hard.good);
+      if (drift == 0 && channel.ber == 0 && channel.jitter == 0) {
+        assert(soft.good == soft.sent);
+      }
+      if (drift <= 0.01 && channel.ber == 0) {
+        assert(Percent(soft.good, soft.sent) > 99);
+      }
+      // Repair only ever adds frames, the right ones mostly.
+      assert(repair.good >= soft.good);
+      total_bad += soft.bad;
+      total_sent += soft.sent;
+      soft_bad += soft.bad;
+      repair_bad += repair.bad;
+    }
+  }
+  // Each filling tried is another 1/256 chance for a wrong frame.
+  printf("wrong frames: %zu soft, %zu with repair\n", soft_bad, repair_bad);
+  assert(repair_bad >= soft_bad);
+  // Erasures and corrections are tried against the checksum, which should
+  // hardly ever let a wrong frame through.
+  assert(Percent(total_bad, total_sent) < 0.5);
+}
+
+void Benchmark() {
+  Link link({0.01, 0.2, 0.005}, 7);
+  std::vector<uint8_t> stream = link.Transmit(kPackets);
+  for (bool soft : {false, true}) {
+    auto start = std::chrono::steady_clock::now();
+    const int rounds = 20;
+    for (int i = 0; i < rounds; i++) link.Receive(stream, soft);
+    auto end = std::chrono::steady_clock::now();
+    double s = std::chrono::duration<double>(end - start).count();
+    printf("%s decision: %6.1f MB/s\n", soft ? "soft" : "hard",
+           stream.size() * rounds / s / 1e6);
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestChannels();
+  Benchmark();
+  printf("test-ir-soft PASSED.\n");
+  return 0;
+}
+
+#endif  // HITCON_TEST_MODE
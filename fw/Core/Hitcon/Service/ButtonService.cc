@@ -26,15 +26,15 @@ void TransferComplete(DMA_HandleTypeDef* hdma) {
   // transfer non order raw gpio data to 0~7
   // after callback finish, start new dma request
 
-  HAL_DMA_Start_IT(&hdma_tim4_ch2, (uint32_t)&GPIOA->IDR,
-                   (uint32_t)g_button_service.raw_data, kDatasetSize);
+  HAL_DMA_Start_IT(&hdma_tim4_ch2, (uintptr_t)&GPIOA->IDR,
+                   (uintptr_t)g_button_service.raw_data, kDatasetSize);
 }
 
 void ButtonService::Init() {
   __HAL_TIM_ENABLE_DMA(&htim4, TIM_DMA_CC2);
   HAL_TIM_PWM_Start(&htim4, TIM_CHANNEL_2);
   hdma_tim4_ch2.XferCpltCallback = &TransferComplete;
-  HAL_DMA_Start_IT(&hdma_tim4_ch2, (uint32_t)&GPIOA->IDR, (uint32_t)raw_data,
+  HAL_DMA_Start_IT(&hdma_tim4_ch2, (uintptr_t)&GPIOA->IDR, (uintptr_t)raw_data,
                    kDatasetSize);
 
   //  HAL_DMA_Start_IT(&hdma_tim2_ch1, (uint32_t) this->double_buffer,
@@ -70,8 +70,8 @@ void DisplayService::Init() {
   htim1.hdma[TIM_DMA_ID_UPDATE]->XferHalfCpltCallback =
       &DisplayTransferHalfComplete;
   htim1.hdma[TIM_DMA_ID_UPDATE]->XferCpltCallback = &DisplayTransferComplete;
-  HAL_DMA_Start_IT(htim1.hdma[TIM_DMA_ID_UPDATE], (uint32_t)this->double_buffer,
-                   (uint32_t)&GPIOB->BSRR,
+  HAL_DMA_Start_IT(htim1.hdma[TIM_DMA_ID_UPDATE], (uintptr_t)this->double_buffer,
+                   (uintptr_t)&GPIOB->BSRR,
                    DISPLAY_FRAME_SIZE * DISPLAY_FRAME_BATCH * 2);
 
   current_buffer_index = 0;
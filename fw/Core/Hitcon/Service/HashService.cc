@@ -1,6 +1,8 @@
 #include <Logic/keccak.h>
 #include <Service/HashService.h>
+#include <Service/Sched/SysTimer.h>
 #include <Service/Sched/Task.h>
+#include <string.h>
 
 using namespace hitcon::service::sched;
 using namespace hitcon::hash::internal;
@@ -28,7 +30,11 @@ void HashStatus::NewState(enum state state) {
 }
 
 ServiceContext::ServiceContext()
-    : message(nullptr), len(0), callback(nullptr), callbackArg1(nullptr) {}
+    : message(nullptr),
+      len(0),
+      callback(nullptr),
+      callbackArg1(nullptr),
+      startTime(0) {}
 
 void ServiceContext::Init(uint8_t const *message, size_t len,
                           callback_t callback, void *callbackArg1) {
@@ -36,55 +42,133 @@ void ServiceContext::Init(uint8_t const *message, size_t len,
   this->len = len;
   this->callback = callback;
   this->callbackArg1 = callbackArg1;
+  this->startTime = SysTimer::GetTime();
 }
 
+HashJob::HashJob() : active(false) {}
+
 }  // namespace internal
 
-void HashService::Init() { scheduler.Queue(&hashTask, nullptr); }
+void HashService::Init() {
+  SetBudget(HASH_SERVICE_BUDGET_US);
+  scheduler.Queue(&hashTask, nullptr);
+}
 
 bool HashService::StartHash(uint8_t const *message, size_t len,
                             callback_t callback, void *callbackArg1) {
-  if (hashTask.IsEnabled()) return false;
-  scheduler.EnablePeriodic(&hashTask);
-  status.Init();
+  ServiceContext serviceContext;
   serviceContext.Init(message, len, callback, callbackArg1);
-  sha3_Init(&sha3Context, SHA3_BIT_SIZE);
+  if (!queue.PushBack(serviceContext)) {
+    stats.rejected++;
+    return false;
+  }
+  if (++stats.depth > stats.maxDepth) stats.maxDepth = stats.depth;
+  StartQueued();
+  if (!hashTask.IsEnabled()) scheduler.EnablePeriodic(&hashTask);
   return true;
 }
 
-void HashService::StopHash() {
-  if (hashTask.IsEnabled()) scheduler.DisablePeriodic(&hashTask);
+void HashService::StopHash(void *callbackArg1) {
+  for (HashJob &job : jobs) {
+    if (job.active && job.serviceContext.callbackArg1 == callbackArg1) {
+      job.active = false;
+      stats.depth--;
+      stats.cancelled++;
+    }
+  }
+  // Keep the rest of the queue in order.
+  for (size_t i = queue.Size(); i > 0; i--) {
+    ServiceContext serviceContext = queue.Front();
+    queue.PopFront();
+    if (serviceContext.callbackArg1 == callbackArg1) {
+      stats.depth--;
+      stats.cancelled++;
+    } else {
+      queue.PushBack(serviceContext);
+    }
+  }
+  StartQueued();
+  if (!stats.depth && hashTask.IsEnabled()) {
+    scheduler.DisablePeriodic(&hashTask);
+  }
 }
 
-void HashService::doHash(void *unused) {
-  switch (status.state) {
-    case status.kUpdateState:
-      doHashUpdate();
-      break;
-    case status.kFinalizeState:
-      doHashFinalize();
-      break;
-    case status.kDoneState:
-      doHashDone();
-      break;
+void HashService::StartQueued() {
+  for (HashJob &job : jobs) {
+    if (queue.IsEmpty()) return;
+    if (job.active) continue;
+    StartJob(job, queue.Front());
+    queue.PopFront();
+  }
+}
+
+void HashService::StartJob(HashJob &job, const ServiceContext &serviceContext) {
+  job.serviceContext = serviceContext;
+  job.status.Init();
+  job.active = true;
+  sha3_Init(&job.sha3Context, SHA3_BIT_SIZE);
+  uint32_t wait = SysTimer::GetTime() - serviceContext.startTime;
+  stats.totalWait += wait;
+  if (wait > stats.maxWait) stats.maxWait = wait;
+}
+
+void HashService::SetBudget(unsigned us) {
+  budgetCycles = us * (SysTimer::CyclesPerMs() / 1000);
+}
+
+void HashService::doHash(void *) {
+  unsigned start = SysTimer::GetCycles();
+  stats.dispatches++;
+  do {
+    if (!doStep()) {
+      // Nothing left.
+      if (hashTask.IsEnabled()) scheduler.DisablePeriodic(&hashTask);
+      return;
+    }
+    // A callback may have stopped the last job.
+  } while (hashTask.IsEnabled() &&
+           SysTimer::GetCycles() - start < budgetCycles &&
+           !scheduler.ShouldYield(hashTask.GetPrio()));
+}
+
+bool HashService::doStep() {
+  // One step for the next job after the last one, round robin.
+  for (size_t i = 1; i <= HASH_SERVICE_CONTEXTS; i++) {
+    size_t index = (lastJob + i) % HASH_SERVICE_CONTEXTS;
+    HashJob &job = jobs[index];
+    if (!job.active) continue;
+    lastJob = index;
+    stats.steps++;
+    switch (job.status.state) {
+      case job.status.kUpdateState:
+        doHashUpdate(job);
+        break;
+      case job.status.kFinalizeState:
+        doHashFinalize(job);
+        break;
+      case job.status.kDoneState:
+        doHashDone(job);
+        break;
+    }
+    return true;
   }
+  return false;
 }
 
-void HashService::doHashUpdate() {
-  size_t i;
-  uint64_t word;
-  // TODO: the performance of UpdateWord can be optimized.
-  // sha3_UpdateWord_split often does a "fast return", so we can analyze how
-  // much each "fast return" takes, and do multiple of them each round.
+void HashService::doHashUpdate(HashJob &job) {
+  HashStatus &status = job.status;
+  const ServiceContext &serviceContext = job.serviceContext;
   if (status.progress + 8 > serviceContext.len) {
     // final block, needs padding
-    sha3_UpdateFinalWord(&sha3Context, serviceContext.message + status.progress,
+    sha3_UpdateFinalWord(&job.sha3Context,
+                         serviceContext.message + status.progress,
                          serviceContext.len - status.progress);
     status.NewState(status.kFinalizeState);
   } else {
     // just do this block without padding
     status.round = sha3_UpdateWord_split(
-        &sha3Context, serviceContext.message + status.progress, status.round);
+        &job.sha3Context, serviceContext.message + status.progress,
+        status.round);
 
     if (status.round == 0) {
       status.progress += 8;
@@ -96,26 +180,40 @@ void HashService::doHashUpdate() {
   }
 }
 
-void HashService::doHashFinalize() {
-  uint8_t *digest = (uint8_t *)sha3_Finalize_split(&sha3Context, status.round);
+void HashService::doHashFinalize(HashJob &job) {
+  HashStatus &status = job.status;
+  sha3_Finalize_split(&job.sha3Context, status.round);
   if (++status.round == KECCAK_ROUNDS + 2) {
-    result.digest = digest;
-    result.size = SHA3_BIT_SIZE / 8;
     status.NewState(status.kDoneState);
   }
 }
 
-void HashService::doHashDone() {
+void HashService::doHashDone(HashJob &job) {
+  const ServiceContext serviceContext = job.serviceContext;
+  stats.jobs++;
+  stats.bytes += serviceContext.len;
+  uint32_t latency = SysTimer::GetTime() - serviceContext.startTime;
+  stats.totalLatency += latency;
+  if (latency > stats.maxLatency) stats.maxLatency = latency;
+  stats.depth--;
+  // Free the context first, the callback may well start another job.
+  memcpy(digestBuffer, job.sha3Context.u.sb, sizeof(digestBuffer));
+  job.active = false;
+  StartQueued();
+  result.digest = digestBuffer;
+  result.size = sizeof(digestBuffer);
   serviceContext.callback(serviceContext.callbackArg1, &result);
-  // Be careful that the callback MUST start before disabling the periodic task,
-  // or we may have race condition due to Stop().
-  scheduler.DisablePeriodic(&hashTask);
 }
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
 HashService::HashService()
-    : hashTask(880, (task_callback_t)&HashService::doHash, (void *)this, 0) {}
+    : hashTask(880, (task_callback_t)&HashService::doHash, (void *)this, 0),
+      lastJob(0),
+      budgetCycles(0),
+      digestBuffer{0},
+      result{nullptr, 0},
+      stats{} {}
 #pragma GCC diagnostic pop
 
 }  // namespace hash
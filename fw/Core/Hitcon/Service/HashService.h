@@ -3,6 +3,7 @@
 
 #include <Logic/keccak.h>
 #include <Service/Sched/Scheduler.h>
+#include <Util/CircularQueue.h>
 #include <Util/callback.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -13,6 +14,13 @@ namespace hash {
 
 constexpr size_t SHA3_BIT_SIZE = 256;
 
+// Messages hashed at the same time, each with a sha3_context of its own.
+constexpr size_t HASH_SERVICE_CONTEXTS = 2;
+// Messages waiting for one of the contexts.
+constexpr size_t HASH_SERVICE_QUEUE_SIZE = 4;
+// Microseconds of hashing per scheduler dispatch, see SetBudget().
+constexpr unsigned HASH_SERVICE_BUDGET_US = 1000;
+
 namespace internal {
 
 struct HashStatus {
@@ -30,12 +38,23 @@ struct ServiceContext {
   size_t len;
   callback_t callback;
   void *callbackArg1;
+  // SysTimer::GetTime() at StartHash().
+  unsigned startTime;
 
   ServiceContext();
   void Init(uint8_t const *message, size_t len, callback_t callback,
             void *callbackArg1);
 };
 
+struct HashJob {
+  ServiceContext serviceContext;
+  HashStatus status;
+  sha3_context sha3Context;
+  bool active;
+
+  HashJob();
+};
+
 }  // namespace internal
 
 struct HashResult {
@@ -45,36 +64,84 @@ struct HashResult {
 
 class HashService {
  public:
+  struct Stats {
+    // Jobs accepted by StartHash() and not done yet, and the most there's
+    // been.
+    uint8_t depth;
+    uint8_t maxDepth;
+    // StartHash() calls turned down because everything's taken.
+    uint32_t rejected;
+    uint32_t cancelled;
+    // Jobs done, the bytes hashed and the hash steps run for them, over this
+    // many scheduler dispatches.
+    uint32_t jobs;
+    uint32_t bytes;
+    uint32_t steps;
+    uint32_t dispatches;
+    // Milliseconds from StartHash() to a context, and to the callback.
+    uint32_t totalWait;
+    uint32_t maxWait;
+    uint32_t totalLatency;
+    uint32_t maxLatency;
+  };
+
   void Init();
 
   // Call StartHash() to hash the message of size len.
-  // Return false if HashService is busy and cannot take this request. In that
-  // case the caller should retry later.
+  // Return false if HashService is busy and cannot take this request, that is
+  // all HASH_SERVICE_CONTEXTS contexts and HASH_SERVICE_QUEUE_SIZE places in
+  // the queue are taken. In that case the caller should retry later.
   // Return true if HashService has accepted this request, in that case the
   // callback will be called once the hashing is done. The argument to the
   // callback will be a uint8_t pointer to the hash result, it'll only be valid
   // during the callback.
+  // Jobs get a context in the order they're started, and the contexts take
+  // turns with a step each, so a short message isn't stuck behind a long one.
   // It is guaranteed that the callback will only be called after StartHash()
   // returns.
   bool StartHash(uint8_t const *message, size_t len, callback_t callback,
                  void *callbackArg1);
-  void StopHash();
+  // Cancel all jobs started with callbackArg1, their callbacks won't be
+  // called.
+  void StopHash(void *callbackArg1);
+
+  // Each dispatch runs hash steps, a word or a keccak round each, until us
+  // microseconds are up or a more urgent task is waiting. At least one step
+  // is run, and 0 runs exactly one like it used to.
+  void SetBudget(unsigned us);
+
+  const Stats &GetStats() const { return stats; }
 
   HashService();
 
  private:
   service::sched::PeriodicTask hashTask;
 
-  internal::ServiceContext serviceContext;
-  internal::HashStatus status;
-  sha3_context sha3Context;
+  internal::HashJob jobs[HASH_SERVICE_CONTEXTS];
+  // One spare place, CircularQueue keeps one empty.
+  CircularQueue<internal::ServiceContext, HASH_SERVICE_QUEUE_SIZE + 1> queue;
+  // The job that had the last step.
+  size_t lastJob;
+  // SetBudget() in SysTimer cycles.
+  unsigned budgetCycles;
+  // The digest of the job that's done, its context may be taken by the
+  // time the callback runs.
+  uint8_t digestBuffer[SHA3_BIT_SIZE / 8];
   HashResult result;
+  Stats stats;
 
   void doHash(void *unused);
+  // Run a step of the next job, returns false if there's none.
+  bool doStep();
+
+  // Give a free context to the first job in the queue, if there's one.
+  void StartQueued();
+  void StartJob(internal::HashJob &job,
+                const internal::ServiceContext &serviceContext);
 
-  void doHashUpdate();
-  void doHashFinalize();
-  void doHashDone();
+  void doHashUpdate(internal::HashJob &job);
+  void doHashFinalize(internal::HashJob &job);
+  void doHashDone(internal::HashJob &job);
 };
 
 extern HashService g_hash_service;
@@ -83,4 +150,4 @@ extern HashService g_hash_service;
 
 }  // namespace hitcon
 
-#endif  // HASH_SERVICE_H
\ No newline at end of file
+#endif  // HASH_SERVICE_H
@@ -0,0 +1,68 @@
+#include <Service/IrMac.h>
+
+namespace hitcon {
+namespace ir {
+
+IrMac::IrMac()
+    : load_(0),
+      quiet_(0),
+      required_(0),
+      exponent_(0),
+      persistence_{0, 4, 0},
+      stats_{0, 0, 0, 0, 0, 0} {}
+
+void IrMac::SetPersistence(uint8_t a, uint8_t b, uint8_t c) {
+  persistence_[0] = a;
+  persistence_[1] = b;
+  persistence_[2] = c;
+}
+
+uint16_t IrMac::Persistence() const {
+  const uint32_t l = load_ < 0 ? 0 : load_ > 100 ? 100 : load_;
+  const uint32_t weight = 256 + persistence_[0] * l * l / 16 +
+                          persistence_[1] * l + persistence_[2];
+  const uint32_t p = 256 * 256 / weight;
+  // Never give up on the channel entirely.
+  return p ? p : 1;
+}
+
+size_t IrMac::QuietPeriod(uint32_t random) const {
+  return IR_MAC_DIFS + random % (IR_MAC_CW_MIN << exponent_);
+}
+
+bool IrMac::Persist(uint32_t random) {
+  if (random % 256 < Persistence()) {
+    stats_.attempts++;
+    return true;
+  }
+  stats_.deferrals++;
+  quiet_ = 0;
+  // With the bits the draw above left alone.
+  required_ = QuietPeriod(random >> 8);
+  return false;
+}
+
+void IrMac::Backoff() {
+  if (exponent_ < IR_MAC_MAX_BACKOFF_EXPONENT) exponent_++;
+}
+
+uint16_t IrMac::OnCollision(uint32_t random) {
+  stats_.collisions++;
+  const uint16_t wait =
+      IR_MAC_COLLISION_WAIT + random % (IR_MAC_COLLISION_CW_MIN << exponent_);
+  Backoff();
+  return wait;
+}
+
+void IrMac::OnAck() {
+  stats_.acks++;
+  exponent_ = 0;
+}
+
+void IrMac::OnAckTimeout() {
+  stats_.ack_timeouts++;
+  Backoff();
+}
+
+}  // namespace ir
+}  // namespace hitcon
@@ -0,0 +1,80 @@
+#ifndef HITCON_SERVICE_IR_MAC_H_
+#define HITCON_SERVICE_IR_MAC_H_
+
+#include <Service/IrParam.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace hitcon {
+namespace ir {
+
+// When IrService may put a frame on the air. Carrier sense with a random
+// quiet period first, then p-persistence: the busier the channel has been
+// (IrLogic's low pass load factor), the more often a quiet channel is passed
+// up for another backoff. The backoffs grow exponentially with every
+// collision or ack that didn't come and shrink back on an ack, so that a
+// crowded hall spreads its badges out instead of colliding over and over.
+class IrMac {
+ public:
+  struct Stats {
+    // Transmissions started.
+    uint32_t attempts;
+    // Transmissions aborted because someone else was sending.
+    uint32_t collisions;
+    // Quiet channels passed up by p-persistence.
+    uint32_t deferrals;
+    uint32_t acks;
+    uint32_t ack_timeouts;
+    // IrService routine runs spent with a frame waiting for the channel.
+    uint32_t backoff_ticks;
+  };
+
+  IrMac();
+
+  // The load factor in percent, see IrLogic::GetLoadFactor().
+  void SetLoad(int load) { load_ = load; }
+  // Transmit probability at load factor l is 256 / (256 + a * l^2 / 16 +
+  // b * l + c), out of 256.
+  void SetPersistence(uint8_t a, uint8_t b, uint8_t c);
+  // The transmit probability at the current load, out of 256.
+  uint16_t Persistence() const;
+
+  // Bytes of quiet samples to wait for before the next attempt.
+  size_t QuietPeriod(uint32_t random) const;
+
+  // Carrier sense, a byte of RX samples at a time.
+  void OnRxByte(uint8_t samples) { quiet_ = samples ? 0 : quiet_ + 1; }
+  // Wait for QuietPeriod(), the quiet so far included.
+  void StartWait(uint32_t random) { required_ = QuietPeriod(random); }
+  // Whether the channel has been quiet for long enough.
+  bool ChannelClear() const { return quiet_ > required_; }
+  // The channel is clear, returns true to transmit. Otherwise it's passed up
+  // and there's another QuietPeriod() to wait from now on, so that a long
+  // idle stretch before doesn't make for an unbroken one after.
+  bool Persist(uint32_t random);
+  // Our transmission collided, returns the IrService routine runs to wait.
+  uint16_t OnCollision(uint32_t random);
+  // The acks for our frames, from IrController.
+  void OnAck();
+  void OnAckTimeout();
+  void OnBackoffTick() { stats_.backoff_ticks++; }
+
+  uint8_t BackoffExponent() const { return exponent_; }
+  const Stats &GetStats() const { return stats_; }
+
+ private:
+  void Backoff();
+
+  int load_;
+  // Bytes of quiet since the last carrier or deferral, and those needed.
+  size_t quiet_;
+  size_t required_;
+  uint8_t exponent_;
+  uint8_t persistence_[3];
+  Stats stats_;
+};
+
+}  // namespace ir
+}  // namespace hitcon
+
+#endif  // HITCON_SERVICE_IR_MAC_H_
@@ -28,8 +28,17 @@ constexpr int16_t IR_PWM_TIM_CCR = 16;
 
 constexpr size_t IR_SERVICE_RX_ON_BUFFER_SIZE = 32;
 
+// Follow the sender's bit clock through a packet, see
+// IrDecoder::SetSoftDecision(). Off until it's been measured on badges, it's
+// only been tried on test-ir-soft's channel and decodes about 3x slower.
+constexpr bool IR_RX_SOFT_DECISION = false;
+// With it, let the 8 bit checksum settle bits that don't decode in packets without
+// FEC. Up to 4 tries per bad packet, so about 4/256 of them would get through
+// instead of 1/256, see IrDecoder::SetSoftRepair().
+constexpr bool IR_RX_SOFT_REPAIR = false;
+
 // How many rx buffer is processed per task run in IrLogic?
-constexpr size_t IR_SERVICE_RX_BUFFER_PER_RUN = 4;
+constexpr size_t IR_SERVICE_RX_BUFFER_PER_RUN = 16;
 static_assert(IR_SERVICE_RX_ON_BUFFER_SIZE % IR_SERVICE_RX_BUFFER_PER_RUN == 0);
 
 // Two elements represents a data bit, see PULSE_PER_HEADER_BIT.
@@ -46,6 +55,29 @@ constexpr size_t IR_PACKET_HEADER_PACKED = 0b111'111'00000'00000'111'111;
 constexpr size_t IR_PACKET_HEADER_MASK = 0b111'110'01111'11110'011'110;
 constexpr size_t IR_CHKSUM_SZ = 8;
 
+// Header of a frame with forward error correction, 2.5 1.5 2.5 bit times.
+// Neither header can match within the other.
+constexpr uint8_t IR_PACKET_HEADER_FEC[] = {
+    0, 0, 0,        // Pad to boundary.
+    1, 1, 1, 1, 1,  // 2.5x bit time of 1.
+    0, 0, 0,        // 1.5x bit time of 0.
+    1, 1, 1, 1, 1   // 2.5x bit time of 1.
+};
+constexpr size_t IR_PACKET_HEADER_FEC_PACKED =
+    0b1111111111'000000'1111111111;
+constexpr size_t IR_PACKET_HEADER_FEC_MASK = 0b1111111110'011110'0111111110;
+static_assert(sizeof(IR_PACKET_HEADER_FEC) == sizeof(IR_PACKET_HEADER));
+
+// Reed-Solomon parity bytes after the checksum of a frame with forward error
+// correction. Corrects up to half as many bad bytes, or as many erased ones.
+// The size in front of such a frame is sent as two Hamming(8,4) codes, one
+// per nibble, so the frame is IR_FEC_OVERHEAD bytes longer.
+constexpr size_t IR_FEC_PARITY_BYTES = 4;
+constexpr size_t IR_FEC_OVERHEAD = IR_FEC_PARITY_BYTES + 1;
+
+// Send frames with forward error correction. Receiving them is always on.
+constexpr bool IR_TX_FEC = false;
+
 constexpr size_t PULSE_PER_DATA_BIT = 16;
 constexpr size_t PULSE_PER_HEADER_BIT = PULSE_PER_DATA_BIT / 2;
 
@@ -89,6 +121,18 @@ constexpr uint32_t LF_ALPHA_COMPL = (1 << 10) - LF_ALPHA;
 // maximum load to result in load factor = 1.0/LF_MAX_SCALE.
 constexpr uint32_t LF_MAX_SCALE = 5;
 
+// Channel access, see IrMac. The air has to be quiet for IR_MAC_DIFS plus a
+// random backoff of up to IR_MAC_CW_MIN << exponent bytes of samples before
+// a transmission, and after a collision we wait IR_MAC_COLLISION_WAIT plus
+// up to IR_MAC_COLLISION_CW_MIN << exponent IrService routine runs. The
+// exponent goes up on every collision or missing ack and back to 0 on an
+// ack.
+constexpr size_t IR_MAC_DIFS = 20;
+constexpr size_t IR_MAC_CW_MIN = 32;
+constexpr size_t IR_MAC_COLLISION_WAIT = 32;
+constexpr size_t IR_MAC_COLLISION_CW_MIN = 64;
+constexpr uint8_t IR_MAC_MAX_BACKOFF_EXPONENT = 4;
+
 }  // namespace ir
 }  // namespace hitcon
 
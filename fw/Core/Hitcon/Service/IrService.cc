@@ -5,6 +5,8 @@
 #include <stm32f1xx_ll_gpio.h>
 #include <tim.h>
 
+#include <atomic>
+
 void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef *htim) {
   if (htim != &htim3) return;
   HAL_TIM_PWM_Stop_DMA(htim, TIM_CHANNEL_3);
@@ -20,10 +22,9 @@ IrService irService;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
 IrService::IrService()
-    : dma_tx_populate_task(
-          100, (task_callback_t)&IrService::PopulateTxDmaBuffer, this),
+    : dma_tx_done_task(100, (task_callback_t)&IrService::OnTxDmaDone, this),
       dma_rx_pull_task(150, (task_callback_t)&IrService::PullRxDmaBuffer, this),
-      rx_required_quiet_period(500), rx_ctr_since_release(100000),
+      rx_ctr_since_release(100000),
       routine_task(600, (callback_t)&IrService::Routine, this, 22),
       on_rx_callback_runner(500, (callback_t)&IrService::OnBufferRecvWrapper,
                             this) {}
@@ -41,36 +42,18 @@ void ReceiveDmaCplt(DMA_HandleTypeDef *hdma) {
   }
 }
 
+// The schedule makes populating cheap enough to do right here, so no other
+// task can make the DMA run out of pulses.
 void TransmitDmaHalfCplt(DMA_HandleTypeDef *hdma) {
   if (!g_suspender.IsSuspended()) {
-#ifdef IR_ALLOW_TX_OVERRUN
-    if (irService.tx_dma_queued_) {
-      // Overrun happened.
-      irService.tx_dma_overrun_cnt_++;
-      return;
-    }
-#endif
-    irService.tx_dma_queued_ = true;
-    scheduler.Queue(&irService.dma_tx_populate_task,
-                    reinterpret_cast<void *>(0));
+    irService.PopulateTxDmaBuffer(0);
   }
-  //  irService.PopulateTxDmaBuffer(reinterpret_cast<void *>(1));
 }
 
 void TransmitDmaCplt(DMA_HandleTypeDef *hdma) {
   if (!g_suspender.IsSuspended()) {
-#ifdef IR_ALLOW_TX_OVERRUN
-    if (irService.tx_dma_queued_) {
-      // Overrun happened.
-      irService.tx_dma_overrun_cnt_++;
-      return;
-    }
-#endif
-    irService.tx_dma_queued_ = true;
-    scheduler.Queue(&irService.dma_tx_populate_task,
-                    reinterpret_cast<void *>(1));
+    irService.PopulateTxDmaBuffer(1);
   }
-  //  irService.PopulateTxDmaBuffer(reinterpret_cast<void *>(1));
 }
 
 void IrService::PullRxDmaBuffer(void *ptr_side) {
@@ -84,10 +67,7 @@ void IrService::PullRxDmaBuffer(void *ptr_side) {
       bool cbit = !static_cast<bool>(rx_dma_buffer[dma_base + k] & IrRx_Pin);
       rx_buffer[rx_buffer_base] |= (-static_cast<int8_t>(cbit)) & (1 << j);
     }
-    if (rx_buffer[rx_buffer_base])
-      rx_quiet_cnt = 0;
-    else
-      rx_quiet_cnt++;
+    mac.OnRxByte(rx_buffer[rx_buffer_base]);
 
     rx_buffer_base++;
   }
@@ -95,7 +75,9 @@ void IrService::PullRxDmaBuffer(void *ptr_side) {
   if (rx_ctr_since_release == 1) {
     if ((rx_buffer[38] & 0x0F0) != 0 || (rx_buffer[39] & 0x0F) != 0) {
       // Abort transmission.
+      tx_schedule_armed = false;
       tx_state = 0x02000000;
+      tx_collision_wait = mac.OnCollision(g_fast_random_pool.GetRandom());
     }
   }
 
@@ -107,10 +89,17 @@ void IrService::PullRxDmaBuffer(void *ptr_side) {
     // Are we sending the second half to the callback?
     bool is_second = !(rx_buffer_base / IR_SERVICE_RX_ON_BUFFER_SIZE);
 
-    if (!is_second && tx_state >> 24 == 0x01 &&
-        rx_quiet_cnt > rx_required_quiet_period) {
-      tx_state = 0x03000000;
-      rx_ctr_since_release = 0;
+    if (!is_second && tx_state >> 24 == 0x01 && mac.ChannelClear()) {
+      if (mac.Persist(g_fast_random_pool.GetRandom())) {
+        tx_state = 0x03000000;
+        rx_ctr_since_release = 0;
+        tx_schedule.Rewind();
+        // The TX DMA interrupt can preempt us, have the schedule written
+        // before it sees it armed. One core, so keeping the compiler from
+        // reordering is enough.
+        std::atomic_signal_fence(std::memory_order_release);
+        tx_schedule_armed = true;
+      }
     }
 
     // Compute the buffer.
@@ -137,11 +126,11 @@ void IrService::Init() {
   LL_GPIO_AF_RemapPartial2_TIM2();
   __HAL_TIM_ENABLE_DMA(&htim3, TIM_DMA_CC3);
   HAL_TIM_PWM_Start(&htim3, TIM_CHANNEL_3);
-  HAL_DMA_Start_IT(&hdma_tim2_ch3, reinterpret_cast<uint32_t>(&GPIOA->IDR),
-                   reinterpret_cast<uint32_t>(rx_dma_buffer),
+  HAL_DMA_Start_IT(&hdma_tim2_ch3, reinterpret_cast<uintptr_t>(&GPIOA->IDR),
+                   reinterpret_cast<uintptr_t>(rx_dma_buffer),
                    IR_SERVICE_RX_SIZE * 2);
-  HAL_DMA_Start_IT(&hdma_tim3_ch3, reinterpret_cast<uint32_t>(tx_dma_buffer),
-                   reinterpret_cast<uint32_t>(&(htim3.Instance->CCR3)),
+  HAL_DMA_Start_IT(&hdma_tim3_ch3, reinterpret_cast<uintptr_t>(tx_dma_buffer),
+                   reinterpret_cast<uintptr_t>(&(htim3.Instance->CCR3)),
                    IR_SERVICE_TX_SIZE * 2);
   scheduler.Queue(&routine_task, nullptr);
   scheduler.EnablePeriodic(&routine_task);
@@ -149,17 +138,18 @@ void IrService::Init() {
 
 bool IrService::CanSendBufferNow() { return tx_state == 0x00000000; }
 
-bool IrService::SendBuffer(const uint8_t *data, size_t len, bool send_header) {
+bool IrService::SendBuffer(const uint8_t *data, size_t len, bool send_header,
+                           bool fec) {
   if (tx_state != 0x00000000) {
     // Can't send buffer now, we're handling another buffer.
     return false;
   }
 
-  tx_pending_buffer = data;
-  tx_pending_buffer_len = len;
-  tx_pending_send_header = send_header;
+  const uint8_t *header = fec ? IR_PACKET_HEADER_FEC : IR_PACKET_HEADER;
+  tx_schedule.Build(send_header ? header : nullptr, data, len);
 
   g_suspender.IncBlocker();
+  mac.StartWait(g_fast_random_pool.GetRandom());
   tx_state = 0x01000000;
 
   return true;
@@ -170,65 +160,44 @@ void IrService::SetOnBufferReceived(callback_t callback, void *callback_arg1) {
   on_rx_buffer_arg = callback_arg1;
 }
 
-void IrService::PopulateTxDmaBuffer(void *ptr_side) {
-  irService.tx_dma_queued_ = false;
-  int side = reinterpret_cast<intptr_t>(ptr_side);
-
-  uint32_t cstate = tx_state >> 24;
-  int dma_base = (-side) & static_cast<int>(IR_SERVICE_TX_SIZE);
-  if (cstate <= 2) {
+void IrService::PopulateTxDmaBuffer(int side) {
+  uint16_t *half = &tx_dma_buffer[side * IR_SERVICE_TX_SIZE];
+  if (!tx_schedule_armed) {
     // Not transmitting.
-    for (int i = 0; i < IR_SERVICE_TX_SIZE; i++) {
-      tx_dma_buffer[dma_base + i] = 0;
-    }
-  } else if (cstate == 3) {
-    // Send header.
-    size_t ctr = tx_state & 0x00FFFFFF;
-    size_t base = ctr * IR_PACKET_PER_RUN;
-    for (int i = 0; i < IR_SERVICE_TX_SIZE; i++) {
-      tx_dma_buffer[dma_base + i] =
-          (-static_cast<int16_t>(IR_PACKET_HEADER[base + i / 8])) &
-          IR_PWM_TIM_CCR;
-    }
-    tx_state++;
-    if (ctr == IR_PACKET_RUN_COUNT - 1) {
-      // Done.
-      tx_state = 0x04000000;
-    }
-  } else if (cstate == 4) {
-    // Send body.
-    size_t ctr = tx_state & 0x00FFFFFF;
-    size_t base_bit = ctr * IR_BITS_PER_TX_RUN;
-    int i = 0;
-    for (int j = 0; j < IR_BITS_PER_TX_RUN; j++, base_bit++) {
-      int cbit = (tx_pending_buffer[base_bit / 8] >> (base_bit % 8)) & 0x01;
-      int16_t ccr_val = (-static_cast<int16_t>(cbit)) & IR_PWM_TIM_CCR;
-      for (int k = 0; k < PULSE_PER_DATA_BIT; k++, i++) {
-        tx_dma_buffer[dma_base + i] = ccr_val;
-      }
-    }
-    tx_state++;
-    if (ctr + 1 == (tx_pending_buffer_len * 8 / IR_BITS_PER_TX_RUN)) {
-      // Transmission done.
-      tx_state = 0x00000000;
-      g_suspender.DecBlocker();
-      tx_packet_cnt++;
+    if (!tx_dma_idle[side]) {
+      for (size_t i = 0; i < IR_SERVICE_TX_SIZE; i++) half[i] = 0;
+      tx_dma_idle[side] = true;
     }
-  } else {
-    my_assert(false);
+    return;
+  }
+  // Pairs with the release in the RX interrupt.
+  std::atomic_signal_fence(std::memory_order_acquire);
+  tx_dma_idle[side] = false;
+  if (tx_schedule.Fill(half)) {
+    tx_schedule_armed = false;
+    scheduler.Queue(&dma_tx_done_task, nullptr);
   }
 }
 
+void IrService::OnTxDmaDone(void *unused) {
+  if (tx_state >> 24 != 0x03) return;
+  // Transmission done.
+  tx_state = 0x00000000;
+  g_suspender.DecBlocker();
+  tx_packet_cnt++;
+}
+
 void IrService::Routine(void *arg1) {
-  rx_required_quiet_period = 20 + g_fast_random_pool.GetRandom() % 32;
   if (rx_ctr_since_release >= 100000) rx_ctr_since_release = 100000;
 
-  if (tx_state >> 24 == 0x02) {
-    // Collision, let's wait randomly.
+  const uint8_t state = tx_state >> 24;
+  if (state == 0x01 || state == 0x02) mac.OnBackoffTick();
+  if (state == 0x02) {
+    // Collision, wait for as long as the MAC told us to.
     tx_state++;
-    int collision_wait = tx_state & 0x00FFFFFF;
-    if (collision_wait >= (32 + g_fast_random_pool.GetRandom() % 64)) {
+    if ((tx_state & 0x00FFFFFF) >= tx_collision_wait) {
       // Wait's over, retransmit.
+      mac.StartWait(g_fast_random_pool.GetRandom());
       tx_state = 0x01000000;
     }
   }
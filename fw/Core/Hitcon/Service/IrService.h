@@ -1,15 +1,15 @@
 #ifndef HITCON_SERVICE_IR_SERVICE_H_
 #define HITCON_SERVICE_IR_SERVICE_H_
 
+#include <Service/IrMac.h>
 #include <Service/IrParam.h>
+#include <Service/IrTxSchedule.h>
 #include <Service/Sched/PeriodicTask.h>
 #include <Service/Sched/Scheduler.h>
 #include <Util/callback.h>
 #include <stddef.h>
 #include <stdint.h>
 
-#define IR_ALLOW_TX_OVERRUN
-
 namespace hitcon {
 namespace ir {
 
@@ -31,13 +31,18 @@ class IrService {
   // Return true if the IrService is free to send a buffer now.
   bool CanSendBufferNow();
 
+  // How many buffers have been sent out completely.
+  size_t GetTxPacketCount() { return tx_packet_cnt; }
+
   // Call to send an IR packet.
   // This is a packed bit array, each bit is PULSE_PER_DATA_BIT pulse at 38kHz.
   // The least significant bit of a byte is the first transmitted bit.
-  // Caller must guarantee that the buffer is valid and not changed during the
-  // whole transmission process.
-  // If send_header is true, we'll prepend the header during transmission.
-  bool SendBuffer(const uint8_t* data, size_t len, bool send_header);
+  // The buffer is turned into pulses right away, the caller may reuse it once
+  // this returns.
+  // If send_header is true, we'll prepend the header during transmission,
+  // IR_PACKET_HEADER_FEC instead of IR_PACKET_HEADER if fec is true.
+  bool SendBuffer(const uint8_t* data, size_t len, bool send_header,
+                  bool fec = false);
 
   // Whenever we've collected of IR_SERVICE_RX_ON_BUFFER_SIZE bytes of receive
   // buffer, we'll call the specified function.
@@ -49,7 +54,8 @@ class IrService {
   void SetOnBufferReceived(callback_t callback, void* callback_arg1);
 
   uint16_t rx_dma_buffer[2 * IR_SERVICE_RX_SIZE];
-  uint16_t tx_dma_buffer[2 * IR_SERVICE_TX_SIZE];
+  // Filled a word at a time.
+  alignas(4) uint16_t tx_dma_buffer[2 * IR_SERVICE_TX_SIZE];
   uint8_t rx_buffer[2 * IR_SERVICE_RX_ON_BUFFER_SIZE];
   size_t rx_buffer_base = 0;
 
@@ -59,20 +65,28 @@ class IrService {
   void* on_rx_buffer_arg;
 
   // Need to be public to be queued by the callback.
-  hitcon::service::sched::Task dma_tx_populate_task;
+  hitcon::service::sched::Task dma_tx_done_task;
 
   // Need to be public to be queued by the callback.
   hitcon::service::sched::Task dma_rx_pull_task;
 
+  // Called from the TX DMA interrupts to populate a half of the buffer.
+  // side is 0 or 1.
+  void PopulateTxDmaBuffer(int side);
+
  private:
-  const uint8_t* tx_pending_buffer;
-  uint32_t tx_pending_buffer_len;
-  // If false, will skip sending header.
-  bool tx_pending_send_header;
+  // The pending buffer, header included.
+  IrTxSchedule tx_schedule;
+  // Set while tx_schedule is being sent out, cleared by the interrupt once
+  // it's all in the DMA buffer.
+  volatile bool tx_schedule_armed = false;
+  // The halves of the DMA buffer that are all carrier off already.
+  bool tx_dma_idle[2] = {false, false};
 
  public:
-  bool tx_dma_queued_ = false;
-  uint16_t tx_dma_overrun_cnt_ = 0;
+  // When to transmit, fed with the load and the acks by IrLogic and
+  // IrController.
+  IrMac mac;
 
  private:
   /*
@@ -80,17 +94,12 @@ class IrService {
   0x00 - Ready to accept the next buffer.
   0x01 - Waiting for air space to silent.
   0x02 - Waiting for collision to finish.
-  0x03 - Sending header.
-  0x04 - Sending body.
+  0x03 - Sending header and body.
   */
   uint32_t tx_state;
 
-  // How long has rx been quiet?
-  // This is in units of 8/DECODE_SAMPLE_RATIO bit time.
-  size_t rx_quiet_cnt = 0;
-
-  // How long should we wait until we transmit?
-  size_t rx_required_quiet_period;
+  // Routine runs to wait out in state 0x02, from IrMac::OnCollision().
+  uint16_t tx_collision_wait = 0;
 
   // How many RX DMA Run since the tx is released?
   size_t rx_ctr_since_release;
@@ -105,9 +114,8 @@ class IrService {
 
   bool rx_on_buffer_callback_finished = true;
 
-  // Call to populate TX DMA Buffer.
-  // ptr_side is to be reinterpret_cast<int>(), and will be 0 or 1.
-  void PopulateTxDmaBuffer(void* ptr_side);
+  // Bookkeeping once the whole buffer is in the TX DMA Buffer.
+  void OnTxDmaDone(void* unused);
 
   // Call to pull RX DMA Buffer.
   // ptr_side is to be reinterpret_cast<int>(), and will be 0 or 1.
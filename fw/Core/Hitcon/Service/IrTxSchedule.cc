@@ -0,0 +1,83 @@
+#include <Service/IrTxSchedule.h>
+#include <Service/Sched/Checks.h>
+
+using hitcon::service::sched::my_assert;
+
+namespace hitcon {
+namespace ir {
+
+namespace {
+
+// Two CCR values at once, carrier off and on.
+constexpr uint32_t kWordOff = 0;
+constexpr uint32_t kWordOn =
+    static_cast<uint16_t>(IR_PWM_TIM_CCR) * 0x00010001u;
+constexpr size_t kWordsPerUnit = PULSE_PER_HEADER_BIT / 2;
+
+}  // namespace
+
+IrTxSchedule::IrTxSchedule() : runs_{0}, run_cnt_(1), pos_(0), left_(0) {}
+
+void IrTxSchedule::Append(uint8_t level, size_t units) {
+  while (units) {
+    if ((run_cnt_ - 1) % 2 != level) {
+      my_assert(run_cnt_ < kMaxRuns);
+      runs_[run_cnt_++] = 0;
+    }
+    uint8_t &run = runs_[run_cnt_ - 1];
+    const size_t n = units < 255u - run ? units : 255u - run;
+    run += n;
+    units -= n;
+    if (units) {
+      // Full, carry on after an empty run of the other level.
+      my_assert(run_cnt_ < kMaxRuns);
+      runs_[run_cnt_++] = 0;
+    }
+  }
+}
+
+void IrTxSchedule::Build(const uint8_t *header, const uint8_t *data,
+                         size_t len) {
+  my_assert(len <= kMaxBytes);
+  runs_[0] = 0;
+  run_cnt_ = 1;
+  if (header) {
+    for (size_t i = 0; i < IR_PACKET_HEADER_SIZE; i++) Append(header[i], 1);
+  }
+  // A run of equal bits at a time.
+  for (size_t i = 0; i < len * 8;) {
+    const uint8_t level = (data[i / 8] >> (i % 8)) & 1;
+    size_t j = i + 1;
+    while (j < len * 8 && ((data[j / 8] >> (j % 8)) & 1) == level) j++;
+    Append(level, (j - i) * kUnitsPerDataBit);
+    i = j;
+  }
+  Rewind();
+}
+
+void IrTxSchedule::Rewind() {
+  pos_ = 0;
+  left_ = runs_[0];
+}
+
+bool IrTxSchedule::Fill(uint16_t *out) {
+  uint32_t *words = reinterpret_cast<uint32_t *>(out);
+  size_t units = kUnitsPerFill;
+  while (units) {
+    if (!left_) {
+      if (pos_ + 1 >= run_cnt_) break;
+      left_ = runs_[++pos_];
+      continue;
+    }
+    const size_t n = units < left_ ? units : left_;
+    const uint32_t word = pos_ % 2 ? kWordOn : kWordOff;
+    for (size_t i = 0; i < n * kWordsPerUnit; i++) *words++ = word;
+    units -= n;
+    left_ -= n;
+  }
+  for (size_t i = 0; i < units * kWordsPerUnit; i++) *words++ = kWordOff;
+  return !left_ && pos_ + 1 >= run_cnt_;
+}
+
+}  // namespace ir
+}  // namespace hitcon
@@ -0,0 +1,64 @@
+#ifndef HITCON_SERVICE_IR_TX_SCHEDULE_H_
+#define HITCON_SERVICE_IR_TX_SCHEDULE_H_
+
+#include <Service/IrParam.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace hitcon {
+namespace ir {
+
+// The pulses of a frame as runs of the carrier being off and on, built once
+// when the frame is handed to IrService. Refilling half of the TX DMA buffer
+// is then a few 32 bit fills per run instead of a CCR value per pulse, cheap
+// enough for the DMA interrupt.
+class IrTxSchedule {
+ public:
+  // Largest frame in bytes, an IrPacket with FEC.
+  static constexpr size_t kMaxBytes = MAX_PACKET_PAYLOAD_BYTES + 4;
+
+  IrTxSchedule();
+
+  // The frame is `header`, IR_PACKET_HEADER_SIZE elements or nullptr for
+  // none, then `len` bytes of `data`, least significant bit first. `data`
+  // isn't needed after this returns. Rewinds.
+  void Build(const uint8_t *header, const uint8_t *data, size_t len);
+
+  // Start over from the first pulse, to send the frame again.
+  void Rewind();
+
+  // Fill IR_SERVICE_TX_SIZE CCR values at `out`, which is 4 byte aligned,
+  // from where the last Fill() stopped, and with the carrier off past the
+  // end. Returns true once the whole frame has been filled in.
+  bool Fill(uint16_t *out);
+
+ private:
+  // A run is a count of PULSE_PER_HEADER_BIT pulses.
+  static constexpr size_t kUnitsPerFill =
+      IR_SERVICE_TX_SIZE / PULSE_PER_HEADER_BIT;
+  static constexpr size_t kUnitsPerDataBit =
+      PULSE_PER_DATA_BIT / PULSE_PER_HEADER_BIT;
+  static constexpr size_t kMaxUnits =
+      IR_PACKET_HEADER_SIZE + kMaxBytes * 8 * kUnitsPerDataBit;
+  // A run per header element and data bit at most, and another two where a
+  // run longer than 255 is split by an empty one.
+  static constexpr size_t kMaxRuns =
+      1 + IR_PACKET_HEADER_SIZE + kMaxBytes * 8 + 2 * (kMaxUnits / 255);
+  static_assert(IR_SERVICE_TX_SIZE % PULSE_PER_HEADER_BIT == 0);
+  static_assert(PULSE_PER_DATA_BIT % PULSE_PER_HEADER_BIT == 0);
+  static_assert(PULSE_PER_HEADER_BIT % 2 == 0);
+
+  void Append(uint8_t level, size_t units);
+
+  // Even runs are off, odd ones on.
+  uint8_t runs_[kMaxRuns];
+  uint16_t run_cnt_;
+  // The run being filled and its units not filled yet.
+  uint16_t pos_;
+  uint8_t left_;
+};
+
+}  // namespace ir
+}  // namespace hitcon
+
+#endif  // HITCON_SERVICE_IR_TX_SCHEDULE_H_
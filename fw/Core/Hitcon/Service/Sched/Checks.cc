@@ -1,6 +1,10 @@
 #include <Service/Sched/Checks.h>
 
+#ifdef HITCON_TEST_MODE
+#include <cassert>
+#else
 #include "main.h"
+#endif
 
 namespace hitcon {
 namespace service {
@@ -9,7 +13,9 @@ namespace sched {
 #pragma GCC push_options
 #pragma GCC optimize("O0")
 void my_assert(bool expr) {
-#ifdef ASSERTION_ENABLED
+#if defined(HITCON_TEST_MODE)
+  assert(expr);
+#elif defined(ASSERTION_ENABLED)
   if (!expr) {
     __disable_irq();
     for (int i = 0; i < 32; i++) {
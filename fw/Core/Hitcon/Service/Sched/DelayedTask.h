@@ -8,6 +8,7 @@
 #ifndef HITCON_SERVICE_SCHED_DELAYEDTASK_H_
 #define HITCON_SERVICE_SCHED_DELAYEDTASK_H_
 
+#include "Ds/TimerWheel.h"
 #include "Task.h"
 
 namespace hitcon {
@@ -18,11 +19,21 @@ class DelayedTask : public Task {
  protected:
   unsigned wakeTime;
 
+ private:
+  template <class T, unsigned kSlots>
+  friend class TimerWheel;
+
+  // Links for the scheduler's TimerWheel.
+  DelayedTask *wheelNext;
+  DelayedTask *wheelPrev;
+  unsigned wheelSlot;
+
  public:
   // For prio, see Scheduler.h
   constexpr DelayedTask(unsigned prio, task_callback_t callback, void *thisptr,
                         unsigned wakeTime)
-      : Task(prio, callback, thisptr), wakeTime(wakeTime) {}
+      : Task(prio, callback, thisptr), wakeTime(wakeTime), wheelNext(nullptr),
+        wheelPrev(nullptr), wheelSlot(0) {}
 
   virtual ~DelayedTask();
 
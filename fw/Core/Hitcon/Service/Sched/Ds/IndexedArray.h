@@ -0,0 +1,55 @@
+/*
+ * IndexedArray.h
+ *
+ *  Unordered set of pointers where every element remembers its own slot, so
+ *  removal is O(1).
+ */
+
+#ifndef HITCON_SERVICE_SCHED_DS_INDEXED_ARRAY_H_
+#define HITCON_SERVICE_SCHED_DS_INDEXED_ARRAY_H_
+
+#include <Common.h>
+
+namespace hitcon {
+namespace service {
+namespace sched {
+
+// T must provide:
+//   unsigned GetArrayIdx();
+//   void SetArrayIdx(unsigned idx);
+// An element can only be in one IndexedArray at a time.
+template <class T, unsigned capacity>
+class IndexedArray {
+  unsigned sz = 0;
+  T *storage[capacity];
+
+ public:
+  bool Add(T *t) {
+    if (sz >= capacity) return false;
+    storage[sz] = t;
+    t->SetArrayIdx(sz);
+    sz++;
+    return true;
+  }
+
+  bool Contains(T *t) {
+    unsigned idx = t->GetArrayIdx();
+    return idx < sz && storage[idx] == t;
+  }
+
+  bool Remove(T *t) {
+    if (!Contains(t)) return false;
+    unsigned idx = t->GetArrayIdx();
+    storage[idx] = storage[--sz];
+    storage[idx]->SetArrayIdx(idx);
+    return true;
+  }
+
+  unsigned size() { return sz; }
+};
+
+} /* namespace sched */
+} /* namespace service */
+} /* namespace hitcon */
+
+#endif /* HITCON_SERVICE_SCHED_DS_INDEXED_ARRAY_H_ */
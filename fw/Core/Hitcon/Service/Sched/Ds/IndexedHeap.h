@@ -0,0 +1,120 @@
+/*
+ * IndexedHeap.h
+ *
+ *  Min-heap that keeps every element informed of its own position, so that
+ *  removal and reprioritization don't need a linear search.
+ */
+
+#ifndef HITCON_SERVICE_SCHED_DS_INDEXED_HEAP_H_
+#define HITCON_SERVICE_SCHED_DS_INDEXED_HEAP_H_
+
+#include <Common.h>
+
+#include "Heap.h"
+
+namespace hitcon {
+namespace service {
+namespace sched {
+
+// T must provide:
+//   unsigned GetHeapIdx();
+//   void SetHeapIdx(unsigned idx);
+//   bool operator<(T &);
+// An element can only be in one IndexedHeap at a time, since it only has room
+// for a single index.
+template <class T, unsigned capacity>
+class IndexedHeap {
+  unsigned sz = 0;
+  T *storage[capacity];
+
+ private:
+  void Place(unsigned i, T *t) {
+    storage[i] = t;
+    t->SetHeapIdx(i);
+  }
+
+  // Move the element at i towards the root, returns its final position.
+  unsigned SiftUp(unsigned i) {
+    T *t = storage[i];
+    while (i > 0) {
+      unsigned parIdx = heap::ParentIdx(i);
+      if (!(*t < *storage[parIdx])) break;
+      Place(i, storage[parIdx]);
+      i = parIdx;
+    }
+    Place(i, t);
+    return i;
+  }
+
+  // Move the element at i towards the leaves.
+  void SiftDown(unsigned i) {
+    T *t = storage[i];
+    while (heap::ChildIdx1(i) < sz) {
+      unsigned child = heap::ChildIdx1(i);
+      unsigned i2 = heap::ChildIdx2(i);
+      if (i2 < sz && *storage[i2] < *storage[child]) child = i2;
+      if (!(*storage[child] < *t)) break;
+      Place(i, storage[child]);
+      i = child;
+    }
+    Place(i, t);
+  }
+
+  void Fix(unsigned i) {
+    if (SiftUp(i) == i) SiftDown(i);
+  }
+
+  void RemoveAt(unsigned idx) {
+    T *last = storage[--sz];
+    storage[sz] = nullptr;
+    if (idx == sz) return;
+    storage[idx] = last;
+    Fix(idx);
+  }
+
+ public:
+  bool Add(T *t) {
+    if (sz >= capacity) return false;
+    Place(sz, t);
+    sz++;
+    SiftUp(sz - 1);
+    return true;
+  }
+
+  // O(1), only trusts the index stored in t if it points back to t.
+  bool Contains(T *t) {
+    unsigned idx = t->GetHeapIdx();
+    return idx < sz && storage[idx] == t;
+  }
+
+  bool Remove(T *t) {
+    if (!Contains(t)) return false;
+    RemoveAt(t->GetHeapIdx());
+    return true;
+  }
+
+  // Remove and return the top element, nullptr if empty.
+  T *PopTop() {
+    if (!sz) return nullptr;
+    T *top = storage[0];
+    RemoveAt(0);
+    return top;
+  }
+
+  // Call after the ordering key of t has changed while in the heap.
+  bool Update(T *t) {
+    if (!Contains(t)) return false;
+    Fix(t->GetHeapIdx());
+    return true;
+  }
+
+  T &Top() { return *storage[0]; }
+
+  unsigned size() { return sz; }
+};
+
+} /* namespace sched */
+} /* namespace service */
+} /* namespace hitcon */
+
+#endif /* HITCON_SERVICE_SCHED_DS_INDEXED_HEAP_H_ */
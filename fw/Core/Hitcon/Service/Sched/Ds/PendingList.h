@@ -0,0 +1,62 @@
+/*
+ * PendingList.h
+ *
+ *  Lock-free intrusive list used to hand tasks from interrupts over to the
+ *  scheduler loop without masking interrupts.
+ */
+
+#ifndef HITCON_SERVICE_SCHED_DS_PENDING_LIST_H_
+#define HITCON_SERVICE_SCHED_DS_PENDING_LIST_H_
+
+#include <Common.h>
+
+#include <atomic>
+
+namespace hitcon {
+namespace service {
+namespace sched {
+
+// Any number of producers (main loop and nested interrupts), one consumer.
+// Producers push with a compare-and-swap on the head, which GCC lowers to an
+// LDREX/STREX loop on Cortex-M3, so an interrupt that preempts another push
+// simply makes it retry. The consumer detaches the whole list at once.
+//
+// Links are stored in the elements themselves, so there's no capacity to
+// overflow. T must provide GetPendingNext() and SetPendingNext(). An element
+// must not be pushed again before it's been taken, which the scheduler
+// guarantees through Task's pending flag.
+template <class T>
+class PendingList {
+  std::atomic<T *> head{nullptr};
+
+ public:
+  void Push(T *t) {
+    T *old = head.load(std::memory_order_relaxed);
+    do {
+      t->SetPendingNext(old);
+    } while (!head.compare_exchange_weak(old, t, std::memory_order_release,
+                                         std::memory_order_relaxed));
+  }
+
+  // Detach everything pushed so far and return it oldest first, linked
+  // through GetPendingNext().
+  T *TakeAll() {
+    T *list = head.exchange(nullptr, std::memory_order_acquire);
+    T *fifo = nullptr;
+    while (list) {
+      T *next = static_cast<T *>(list->GetPendingNext());
+      list->SetPendingNext(fifo);
+      fifo = list;
+      list = next;
+    }
+    return fifo;
+  }
+
+  bool IsEmpty() { return head.load(std::memory_order_relaxed) == nullptr; }
+};
+
+} /* namespace sched */
+} /* namespace service */
+} /* namespace hitcon */
+
+#endif /* HITCON_SERVICE_SCHED_DS_PENDING_LIST_H_ */
@@ -0,0 +1,145 @@
+/*
+ * TimerWheel.h
+ *
+ *  Hashed timer wheel with one slot per SysTimer tick (1ms). Tasks are filed
+ *  under WakeTime() modulo the wheel size, so insertion and cancellation are
+ *  O(1) and an expiry pass only looks at the slots for the ticks that have
+ *  elapsed since the last pass.
+ */
+
+#ifndef HITCON_SERVICE_SCHED_DS_TIMER_WHEEL_H_
+#define HITCON_SERVICE_SCHED_DS_TIMER_WHEEL_H_
+
+#include <Common.h>
+
+namespace hitcon {
+namespace service {
+namespace sched {
+
+// T must provide unsigned WakeTime() and the intrusive members wheelNext,
+// wheelPrev and wheelSlot (declare TimerWheel as a friend).
+// Tasks that wake more than kSlots ticks in the future simply stay in their
+// slot for another revolution.
+template <class T, unsigned kSlots>
+class TimerWheel {
+  static_assert((kSlots & (kSlots - 1)) == 0, "kSlots must be a power of 2");
+
+  T *slots[kSlots] = {};
+  // All ticks up to and including cursor have been expired.
+  unsigned cursor = 0;
+  // Set when an already due task was filed under cursor's slot, so the next
+  // Expire() must look at that slot again even if no tick has elapsed.
+  bool cursorDirty = false;
+  unsigned sz = 0;
+
+ private:
+  void Link(unsigned slot, T *t) {
+    t->wheelSlot = slot;
+    t->wheelPrev = nullptr;
+    t->wheelNext = slots[slot];
+    if (slots[slot]) slots[slot]->wheelPrev = t;
+    slots[slot] = t;
+    sz++;
+  }
+
+  void Unlink(T *t) {
+    if (t->wheelPrev) {
+      t->wheelPrev->wheelNext = t->wheelNext;
+    } else {
+      slots[t->wheelSlot] = t->wheelNext;
+    }
+    if (t->wheelNext) t->wheelNext->wheelPrev = t->wheelPrev;
+    t->wheelNext = nullptr;
+    t->wheelPrev = nullptr;
+    sz--;
+  }
+
+ public:
+  void Add(T *t) {
+    unsigned when = t->WakeTime();
+    // Anything already due goes into the cursor's slot, otherwise it'd wait a
+    // whole revolution.
+    if (when <= cursor) {
+      when = cursor;
+      cursorDirty = true;
+    }
+    Link(when & (kSlots - 1), t);
+  }
+
+  bool Contains(T *t) {
+    if (t->wheelPrev) return t->wheelPrev->wheelNext == t;
+    return slots[t->wheelSlot] == t;
+  }
+
+  bool Remove(T *t) {
+    if (!Contains(t)) return false;
+    Unlink(t);
+    return true;
+  }
+
+  // Unlink every task with WakeTime() <= now and pass it to onExpire.
+  // Visits one slot per tick elapsed since the last call, capped at one full
+  // revolution, and returns immediately if no tick has elapsed and nothing
+  // already due has been added.
+  template <class F>
+  void Expire(unsigned now, F &&onExpire) {
+    if (now == cursor && !cursorDirty) return;
+    if (!sz) {
+      cursor = now;
+      cursorDirty = false;
+      return;
+    }
+    unsigned first = cursorDirty ? cursor : cursor + 1;
+    unsigned ticks = now - first + 1;
+    if (ticks > kSlots) ticks = kSlots;
+    for (unsigned tick = now - ticks + 1; ticks; ticks--, tick++) {
+      T *t = slots[tick & (kSlots - 1)];
+      while (t) {
+        T *next = t->wheelNext;
+        if (t->WakeTime() <= now) {
+          Unlink(t);
+          onExpire(t);
+        }
+        t = next;
+      }
+    }
+    cursor = now;
+    cursorDirty = false;
+  }
+
+  // Earliest WakeTime() in the wheel, returns false if empty.
+  bool NextWakeTime(unsigned *wakeTime) {
+    if (!sz) return false;
+    if (cursorDirty) {
+      *wakeTime = cursor;
+      return true;
+    }
+    // Walking forward from cursor, the first task due within this revolution
+    // is the earliest one.
+    for (unsigned tick = cursor + 1; tick != cursor + 1 + kSlots; tick++) {
+      for (T *t = slots[tick & (kSlots - 1)]; t; t = t->wheelNext) {
+        if (t->WakeTime() <= tick) {
+          *wakeTime = t->WakeTime();
+          return true;
+        }
+      }
+    }
+    // Everything is at least a revolution away.
+    bool found = false;
+    for (unsigned i = 0; i < kSlots; i++) {
+      for (T *t = slots[i]; t; t = t->wheelNext) {
+        if (!found || t->WakeTime() < *wakeTime) *wakeTime = t->WakeTime();
+        found = true;
+      }
+    }
+    return found;
+  }
+
+  unsigned size() { return sz; }
+};
+
+} /* namespace sched */
+} /* namespace service */
+} /* namespace hitcon */
+
+#endif /* HITCON_SERVICE_SCHED_DS_TIMER_WHEEL_H_ */
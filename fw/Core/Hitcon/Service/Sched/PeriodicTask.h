@@ -18,6 +18,8 @@ class PeriodicTask : public DelayedTask {
  private:
   bool enabled;
   unsigned interval;
+  // Slot in the scheduler's enabled/disabled periodic task array.
+  unsigned array_idx;
   void *savedThisptr;
   task_callback_t savedCallback;
   void AutoRequeueCb(void *arg);
@@ -30,14 +32,18 @@ class PeriodicTask : public DelayedTask {
                          unsigned interval)
       : DelayedTask(prio, (task_callback_t)&PeriodicTask::AutoRequeueCb,
                     (void *)this, 0),
-        enabled(false), interval(interval), savedThisptr(thisptr),
-        savedCallback(callback) {}
+        enabled(false), interval(interval), array_idx(0),
+        savedThisptr(thisptr), savedCallback(callback) {}
 #pragma GCC diagnostic pop
 
   virtual ~PeriodicTask();
   void Enable();
   void Disable();
   bool IsEnabled() { return enabled; }
+
+  // Maintained by IndexedArray.
+  unsigned GetArrayIdx() { return array_idx; }
+  void SetArrayIdx(unsigned idx) { array_idx = idx; }
 };
 
 } /* namespace sched */
@@ -0,0 +1,93 @@
+/*
+ * Profiler.cpp
+ */
+
+#include "Profiler.h"
+
+#ifdef SCHED_PROFILING
+
+#include <cstring>
+
+#include "SysTimer.h"
+
+namespace hitcon {
+namespace service {
+namespace sched {
+
+Profiler profiler;
+
+unsigned Profiler::CyclesToUs(uint64_t cycles) {
+  unsigned cyclesPerUs = SysTimer::CyclesPerMs() / 1000;
+  if (!cyclesPerUs) cyclesPerUs = 1;
+  uint64_t us = cycles / cyclesPerUs;
+  return us > UINT32_MAX ? UINT32_MAX : us;
+}
+
+unsigned Profiler::LatencyBucket(unsigned us) {
+  if (!us) return 0;
+  unsigned bucket = 32 - __builtin_clz(us);
+  return bucket < kLatencyBuckets ? bucket : kLatencyBuckets - 1;
+}
+
+void Profiler::OnRun(Task *task, unsigned readyCycles, unsigned startCycles,
+                     unsigned endCycles) {
+  unsigned slot = task->GetProfileSlot();
+  if (!slot) {
+    if (used == kSlots) {
+      dropped++;
+      return;
+    }
+    profiles[used] = {};
+    profiles[used].task = task;
+    profiles[used].minCycles = UINT32_MAX;
+    used++;
+    slot = used;
+    task->SetProfileSlot(slot);
+  }
+  TaskProfile &p = profiles[slot - 1];
+
+  unsigned cycles = endCycles - startCycles;
+  p.runs++;
+  p.totalCycles += cycles;
+  if (cycles < p.minCycles) p.minCycles = cycles;
+  if (cycles > p.maxCycles) p.maxCycles = cycles;
+
+  unsigned latencyUs = CyclesToUs(startCycles - readyCycles);
+  uint16_t &bucket = p.latencyHist[LatencyBucket(latencyUs)];
+  if (bucket != UINT16_MAX) bucket++;
+  unsigned prio = task->GetPrio();
+  if (prio >= kHardDeadlinePrioMin && prio <= kHardDeadlinePrioMax &&
+      latencyUs > kHardDeadlineUs && p.lateStarts != UINT16_MAX) {
+    p.lateStarts++;
+  }
+}
+
+void Profiler::Reset() {
+  for (unsigned i = 0; i < used; i++) {
+    Task *task = profiles[i].task;
+    profiles[i] = {};
+    profiles[i].task = task;
+    profiles[i].minCycles = UINT32_MAX;
+  }
+  dropped = 0;
+}
+
+void Profiler::Serialize(unsigned i, ProfileRecord *out) {
+  const TaskProfile &p = profiles[i];
+  out->callback = reinterpret_cast<uintptr_t>(p.task->GetCallback());
+  out->thisptr = reinterpret_cast<uintptr_t>(p.task->GetThisptr());
+  out->prio = p.task->GetPrio();
+  out->lateStarts = p.lateStarts;
+  out->runs = p.runs;
+  out->minUs = p.runs ? CyclesToUs(p.minCycles) : 0;
+  out->maxUs = CyclesToUs(p.maxCycles);
+  unsigned cyclesPerUs = SysTimer::CyclesPerMs() / 1000;
+  out->totalUs = p.totalCycles / (cyclesPerUs ? cyclesPerUs : 1);
+  memcpy(out->latencyHist, p.latencyHist, sizeof(out->latencyHist));
+}
+
+} /* namespace sched */
+} /* namespace service */
+} /* namespace hitcon */
+
+#endif  // SCHED_PROFILING
@@ -0,0 +1,93 @@
+/*
+ * Profiler.h
+ *
+ *  Per-task execution statistics collected by the scheduler. Only built when
+ *  SCHED_PROFILING is defined, since the tables cost about 3KB of RAM.
+ */
+
+#ifndef HITCON_SERVICE_SCHED_PROFILER_H_
+#define HITCON_SERVICE_SCHED_PROFILER_H_
+
+#ifdef SCHED_PROFILING
+
+#include <cstdint>
+
+#include "Task.h"
+
+namespace hitcon {
+namespace service {
+namespace sched {
+
+// Fixed layout used to ship one TaskProfile to the PC, little endian.
+// callback and thisptr identify the task, look them up in the .map file.
+struct __attribute__((packed)) ProfileRecord {
+  uint32_t callback;
+  uint32_t thisptr;
+  uint16_t prio;
+  uint16_t lateStarts;
+  uint32_t runs;
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+  uint16_t latencyHist[16];
+};
+
+static_assert(sizeof(ProfileRecord) == 64, "ProfileRecord layout changed");
+
+class Profiler {
+ public:
+  static constexpr unsigned kSlots = 48;
+  // Bucket 0 counts 0us, bucket n counts [2^(n-1), 2^n) us and the last
+  // bucket everything from 2^14 us up.
+  static constexpr unsigned kLatencyBuckets = 16;
+  // Tasks with prio in this range have a hard deadline, see Scheduler.h.
+  static constexpr unsigned kHardDeadlinePrioMin = 100;
+  static constexpr unsigned kHardDeadlinePrioMax = 200;
+  // A hard deadline task that waits longer than this to start is late.
+  static constexpr unsigned kHardDeadlineUs = 1000;
+
+  struct TaskProfile {
+    Task *task;
+    uint32_t runs;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint64_t totalCycles;
+    uint16_t lateStarts;
+    uint16_t latencyHist[kLatencyBuckets];
+  };
+
+  // Called by the scheduler after each task run. readyCycles is when the task
+  // became ready to run, startCycles and endCycles bracket Task::Run().
+  void OnRun(Task *task, unsigned readyCycles, unsigned startCycles,
+             unsigned endCycles);
+
+  // Number of tasks that have a profile, in order of first run.
+  unsigned size() { return used; }
+  const TaskProfile &Get(unsigned i) { return profiles[i]; }
+
+  // Runs that weren't recorded because every slot is taken.
+  unsigned GetDropped() { return dropped; }
+
+  // Clear all statistics. Tasks keep their slots.
+  void Reset();
+
+  void Serialize(unsigned i, ProfileRecord *out);
+
+  static unsigned LatencyBucket(unsigned us);
+  static unsigned CyclesToUs(uint64_t cycles);
+
+ private:
+  TaskProfile profiles[kSlots];
+  unsigned used = 0;
+  unsigned dropped = 0;
+};
+
+extern Profiler profiler;
+
+} /* namespace sched */
+} /* namespace service */
+} /* namespace hitcon */
+
+#endif  // SCHED_PROFILING
+
+#endif /* HITCON_SERVICE_SCHED_PROFILER_H_ */
@@ -12,49 +12,77 @@
 #endif
 #include <Service/Sched/Checks.h>
 
+#include "Profiler.h"
 #include "SysTimer.h"
+
+#ifdef HITCON_TEST_MODE
+// No interrupts on the host.
+#define __disable_irq()
+#define __enable_irq()
+#else
 #include "main.h"
+#endif
 
 namespace hitcon {
 namespace service {
 namespace sched {
 
+namespace {
+
+#ifdef HITCON_TEST_MODE
+// Jump the virtual clock straight to the next deadline.
+void AdvanceToWakeTime(unsigned wakeTime) {
+  unsigned now = SysTimer::GetTime();
+  unsigned ms = 1;
+  if (wakeTime != Scheduler::kNoWakeTime && wakeTime > now) {
+    ms = wakeTime - now;
+  }
+  SysTimer::AdvanceCycles(ms * SysTimer::CyclesPerMs() -
+                          SysTimer::GetCycles() % SysTimer::CyclesPerMs());
+}
+#else
+// Sleep until the next interrupt. SysTick fires every ms, which is the
+// resolution of WakeTime(), so it doubles as the deadline wakeup; IR, display
+// and button interrupts that queue tasks wake us earlier.
+void WaitForInterrupt(unsigned) { __WFI(); }
+#endif
+
+}  // namespace
+
 Scheduler scheduler;
 
-Scheduler::Scheduler() {}
+Scheduler::Scheduler() {
+#ifdef HITCON_TEST_MODE
+  idleHook = &AdvanceToWakeTime;
+#else
+  idleHook = &WaitForInterrupt;
+#endif
+}
 
 Scheduler::~Scheduler() {}
 
 bool Scheduler::Queue(Task *task, void *arg) {
   my_assert(task);
   task->SetArg(arg);
-  bool result = true;
-  // TODO: Disable Interrupt.
-  __disable_irq();
-  if (!tasksAddQueue.PushBack(task)) {
-    // Overflow, we need to drop this request.
-    result = false;
-    AssertOverflow();
+  if (!task->MarkPending()) {
+#ifdef SCHED_PROFILING
+    task->SetReadyCycles(SysTimer::GetCycles());
+#endif
+    tasksAddQueue.Push(task);
   }
-  // TODO: Enable Interrupt.
-  __enable_irq();
-  return result;
+  return true;
 }
 
 bool Scheduler::Queue(DelayedTask *task, void *arg) {
   my_assert(task);
   task->SetArg(arg);
-  bool result = true;
-  // TODO: Disable Interrupt.
-  __disable_irq();
-  if (!delayedTasksAddQueue.PushBack(task)) {
-    // Overflow, we need to drop this request.
-    result = false;
-    AssertOverflow();
+  if (!task->MarkPending()) {
+#ifdef SCHED_PROFILING
+    task->SetReadyCycles(SysTimer::GetCycles());
+#endif
+    delayedTasksAddQueue.Push(task);
   }
-  // TODO: Enable Interrupt.
-  __enable_irq();
-  return result;
+  return true;
 }
 
 bool Scheduler::Queue(PeriodicTask *task, void *arg) {
@@ -72,13 +100,12 @@ bool Scheduler::EnablePeriodic(PeriodicTask *task) {
     AssertOverflow();
     return false;
   }
-  if (currentTask != task) {
-    bool ret = delayedTasks.Add(task);
-    if (!ret) {
-      AssertOverflow();
-    } else {
-      task->EnterQueue();
-    }
+  if (currentTask != task && !task->MarkPending()) {
+#ifdef SCHED_PROFILING
+    task->SetReadyCycles(SysTimer::GetCycles());
+#endif
+    delayedTasks.Add(task);
+    task->EnterQueue();
   }
   task->Enable();
   return true;
@@ -98,10 +125,12 @@ bool Scheduler::DisablePeriodic(PeriodicTask *task) {
     bool removed = tasks.Remove(task);
     if (removed) {
       task->ExitQueue();
+      task->ClearPending();
     }
     removed = delayedTasks.Remove(task);
     if (removed) {
       task->ExitQueue();
+      task->ClearPending();
     }
   }
   task->Disable();
@@ -110,79 +139,132 @@ bool Scheduler::DisablePeriodic(PeriodicTask *task) {
 
 void Scheduler::DelayedHouseKeeping() {
   // Handle all Queue operations.
-  while (!tasksAddQueue.IsEmpty()) {
-    bool ret = tasks.Add(tasksAddQueue.Front());
+  for (Task *task = tasksAddQueue.TakeAll(); task;) {
+    Task *next = task->GetPendingNext();
+    bool ret = tasks.Add(task);
     if (!ret) {
-      // Heap is full.
+      // Heap is full, try again next time.
       AssertOverflow();
-      break;
+      tasksAddQueue.Push(task);
+    } else {
+      task->EnterQueue();
     }
-    tasksAddQueue.Front()->EnterQueue();
-    tasksAddQueue.PopFront();
+    task = next;
   }
-  while (!delayedTasksAddQueue.IsEmpty()) {
-    bool ret = delayedTasks.Add(delayedTasksAddQueue.Front());
-    if (!ret) {
-      // Heap is full.
-      AssertOverflow();
-      break;
-    }
-    delayedTasksAddQueue.Front()->EnterQueue();
-    delayedTasksAddQueue.PopFront();
+  for (DelayedTask *task = delayedTasksAddQueue.TakeAll(); task;) {
+    DelayedTask *next = static_cast<DelayedTask *>(task->GetPendingNext());
+    delayedTasks.Add(task);
+    task->EnterQueue();
+    task = next;
   }
+  // Move everything that's due into the ready heap. This is a no-op unless
+  // SysTimer has ticked since the last pass.
   unsigned now = SysTimer::GetTime();
-  while (delayedTasks.size()) {
-    DelayedTask &top = delayedTasks.Top();
-    unsigned wake = top.WakeTime();
-    if (wake > now) break;
-    bool ret = delayedTasks.Remove(&top);
-    if (!ret) {
-      AssertOverflow();
-    } else {
-      top.ExitQueue();
-    }
-    ret = tasks.Add(&top);
+  houseKeepingTime = now;
+  delayedTasks.Expire(now, [this, now](DelayedTask *task) {
+    task->ExitQueue();
+#ifdef SCHED_PROFILING
+    // The task became ready at WakeTime(), which may be a few ticks ago if a
+    // long task held up this pass, or when it was queued if that's later.
+    unsigned cycles = SysTimer::GetCycles();
+    unsigned sinceWake = (now - task->WakeTime()) * SysTimer::CyclesPerMs();
+    unsigned sinceQueued = cycles - task->GetReadyCycles();
+    task->SetReadyCycles(cycles -
+                         (sinceWake < sinceQueued ? sinceWake : sinceQueued));
+#endif
+    bool ret = tasks.Add(task);
     if (!ret) {
       AssertOverflow();
     } else {
-      top.EnterQueue();
+      task->EnterQueue();
     }
+  });
+}
+
+bool Scheduler::ShouldYield(unsigned prio) {
+  if (!tasksAddQueue.IsEmpty()) return true;
+  if (tasks.size() && tasks.Top().GetPrio() < prio) return true;
+  return delayedTasks.size() && SysTimer::GetTime() != houseKeepingTime;
+}
+
+void Scheduler::Idle() {
+  if (!idleHook) return;
+  unsigned wakeTime = kNoWakeTime;
+  delayedTasks.NextWakeTime(&wakeTime);
+  // CYCCNT stops in WFI sleep along with the CPU clock.
+  unsigned start = SysTimer::GetWallCycles();
+  // With interrupts masked, an interrupt that arrives after the check below
+  // still wakes WFI, and then runs once we unmask.
+  __disable_irq();
+  if (tasksAddQueue.IsEmpty() && delayedTasksAddQueue.IsEmpty()) {
+    idleHook(wakeTime);
   }
+  __enable_irq();
+  idleCycles += SysTimer::GetWallCycles() - start;
 }
 
-void Scheduler::Run() {
-  while (1) {
-    DelayedHouseKeeping();
-    if (!tasks.size()) continue;
-    Task &top = tasks.Top();
-    bool ret = tasks.Remove(&top);
-    if (!ret) {
-      AssertOverflow();
-    } else {
-      top.ExitQueue();
-    }
-    totalTasks++;
+void Scheduler::UpdateIdleStats() {
+  unsigned now = SysTimer::GetTime();
+  if (now - idleWindowStart < kIdleWindowMs) return;
+  unsigned cycles = SysTimer::GetWallCycles();
+  unsigned total = cycles - idleWindowStartCycles;
+  if (total) {
+    idlePercent = static_cast<uint64_t>(idleCycles) * 100 / total;
+  }
+  idleWindowStart = now;
+  idleWindowStartCycles = cycles;
+  idleCycles = 0;
+}
+
+bool Scheduler::RunOnce() {
+  DelayedHouseKeeping();
+  UpdateIdleStats();
+  if (!tasks.size()) {
+    Idle();
+    return false;
+  }
+  Task &top = *tasks.PopTop();
+  top.ExitQueue();
+  // From here on, Queue() on this task queues it again.
+  top.ClearPending();
+  totalTasks++;
 #ifdef DEBUG
-    TaskRecord record;
-    record.startTime = SysTimer::GetTime();
-    record.task = &top;
-#endif DEBUG
+  TaskRecord record;
+  record.startTime = SysTimer::GetTime();
+  record.task = &top;
+#endif  // DEBUG
 
-    currentTask = &top;
+  currentTask = &top;
 #ifdef DEBUG
-    my_assert(hitcon::app::tama::tama_app.IsDataValid());
+  my_assert(hitcon::app::tama::tama_app.IsDataValid());
+#endif
+#ifdef SCHED_PROFILING
+  unsigned readyCycles = top.GetReadyCycles();
+  unsigned startCycles = SysTimer::GetCycles();
+#endif
+  top.Run();
+#ifdef SCHED_PROFILING
+  profiler.OnRun(&top, readyCycles, startCycles, SysTimer::GetCycles());
 #endif
-    top.Run();
 #ifdef DEBUG
-    my_assert(hitcon::app::tama::tama_app.IsDataValid());
+  my_assert(hitcon::app::tama::tama_app.IsDataValid());
 #endif
-    currentTask = nullptr;
+  currentTask = nullptr;
 #ifdef DEBUG
-    record.endTime = SysTimer::GetTime();
-    taskRecords[record_index] = record;
-    record_index++;
-    if (record_index == kRecordSize) record_index = 0;
-#endif DEBUG
+  record.endTime = SysTimer::GetTime();
+  taskRecords[record_index] = record;
+  record_index++;
+  if (record_index == kRecordSize) record_index = 0;
+#endif  // DEBUG
+  return true;
+}
+
+void Scheduler::Run() {
+  SysTimer::Init();
+  idleWindowStart = SysTimer::GetTime();
+  idleWindowStartCycles = SysTimer::GetWallCycles();
+  while (1) {
+    RunOnce();
   }
 }
 
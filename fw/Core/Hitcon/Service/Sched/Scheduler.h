@@ -8,14 +8,15 @@
 #ifndef HITCON_SERVICE_SCHED_SCHEDULER_H_
 #define HITCON_SERVICE_SCHED_SCHEDULER_H_
 
-#include <Util/CircularQueue.h>
 #include <stddef.h>
 
 #include <cstdint>
 
 #include "DelayedTask.h"
-#include "Ds/Array.h"
-#include "Ds/Heap.h"
+#include "Ds/IndexedArray.h"
+#include "Ds/IndexedHeap.h"
+#include "Ds/PendingList.h"
+#include "Ds/TimerWheel.h"
 #include "PeriodicTask.h"
 #include "Scheduler.h"
 #include "Task.h"
@@ -39,6 +40,12 @@ For real time task that has hard deadline, such as display refresh/trigger,
 we use priority 100-200.
 */
 
+// Called by the scheduler when no task is ready, with interrupts disabled.
+// wakeTime is the earliest DelayedTask::WakeTime(), or
+// Scheduler::kNoWakeTime if there's none. The hook should return once that
+// time is reached or an interrupt is pending.
+typedef void (*idle_hook_t)(unsigned wakeTime);
+
 struct TaskRecord {
   Task *task;
   uint32_t startTime;
@@ -47,24 +54,19 @@ struct TaskRecord {
 
 class Scheduler {
  private:
-  static constexpr size_t kAddQueueSize = 10;
   static constexpr size_t kRecordSize = 20;
+  // One slot per ms, tasks further out than this wait extra revolutions.
+  static constexpr unsigned kTimerWheelSlots = 64;
+
+  IndexedHeap<Task, 40> tasks;
+  TimerWheel<DelayedTask, kTimerWheelSlots> delayedTasks;
+  IndexedArray<PeriodicTask, 32> enabledPeriodicTasks, disabledPeriodicTasks;
 
-  Heap<Task, 40> tasks;
-  Heap<DelayedTask, 32> delayedTasks;
-  Array<PeriodicTask, 32> enabledPeriodicTasks, disabledPeriodicTasks;
-
-  // Queue used to temporarily hold calls to Queue() so we can defer heap
-  // operations to later.
-  /* Previous raw queue implementation.
-  Task* tasksAddQueue[kAddQueueSize];
-  size_t tasksAddQueueHead = 0;
-  size_t tasksAddQueueTail = 0;
-  DelayedTask* delayedTasksAddQueue[kAddQueueSize];
-  size_t delayedTasksAddQueueHead = 0;
-  size_t delayedTasksAddQueueTail = 0;*/
-  CircularQueue<Task *, kAddQueueSize> tasksAddQueue;
-  CircularQueue<DelayedTask *, kAddQueueSize> delayedTasksAddQueue;
+  // Lists used to temporarily hold calls to Queue() so we can defer heap
+  // operations to later. These are lock-free so Queue() never has to mask
+  // interrupts, and can't overflow.
+  PendingList<Task> tasksAddQueue;
+  PendingList<DelayedTask> delayedTasksAddQueue;
 
   size_t totalTasks = 0;
 
@@ -75,14 +77,30 @@ class Scheduler {
 
   Task *currentTask = nullptr;
 
+  // Idle time accounting, in SysTimer::GetWallCycles().
+  static constexpr unsigned kIdleWindowMs = 1000;
+  idle_hook_t idleHook;
+  unsigned idleCycles = 0;
+  unsigned idleWindowStart = 0;
+  unsigned idleWindowStartCycles = 0;
+  unsigned idlePercent = 0;
+
+  // SysTimer::GetTime() of the last pass over the delayed tasks.
+  unsigned houseKeepingTime = 0;
+
   void DelayedHouseKeeping();
+  void Idle();
+  void UpdateIdleStats();
 
  public:
+  static constexpr unsigned kNoWakeTime = ~0U;
+
   Scheduler();
   virtual ~Scheduler();
-  // Can be called during interrupt.
+  // Can be called during interrupt. Queueing a task that's already pending
+  // (queued but not yet started) only updates its arg.
   bool Queue(Task *task, void *arg);
-  // Can be called during interrupt.
+  // Can be called during interrupt. Same coalescing as above.
   bool Queue(DelayedTask *task, void *arg);
   // Can NOT be called during interrupt.
   bool Queue(PeriodicTask *task,
@@ -92,12 +110,28 @@ class Scheduler {
   // Can NOT be called during interrupt.
   bool DisablePeriodic(PeriodicTask *task);
   void Run();
+  // Run the next ready task, or idle if there's none. Returns true if a task
+  // ran. Run() just calls this forever.
+  bool RunOnce();
+
+  // nullptr makes the scheduler busy-wait like it used to.
+  void SetIdleHook(idle_hook_t hook) { idleHook = hook; }
+  idle_hook_t GetIdleHook() { return idleHook; }
 
   // Which task is running now? nullptr for nothing's running.
   Task *GetCurrentTask() { return currentTask; }
 
   // How many tasks has run?
   size_t GetTotalTasksRan() { return totalTasks; }
+
+  // Percentage of time spent idle during the last complete second.
+  unsigned GetIdlePercent() { return idlePercent; }
+
+  // For tasks that keep going until they've used up a time budget: returns
+  // true if a task more urgent than prio may be waiting, ie. one is ready,
+  // one's been queued since this task started, or SysTimer has ticked and
+  // delayed tasks may be due.
+  bool ShouldYield(unsigned prio);
 };
 
 extern Scheduler scheduler;
@@ -7,7 +7,11 @@
 
 #include "SysTimer.h"
 
+#ifdef HITCON_TEST_MODE
+#include <cstdint>
+#else
 #include <main.h>
+#endif
 
 namespace hitcon {
 namespace service {
@@ -21,12 +25,58 @@ SysTimer::~SysTimer() {
   // TODO Auto-generated destructor stub
 }
 
+#ifdef HITCON_TEST_MODE
+
+namespace {
+// Same rate as HCLK on the badge.
+constexpr unsigned kHostCyclesPerMs = 12000;
+uint64_t g_virtual_cycles = 0;
+}  // namespace
+
+unsigned SysTimer::GetTime() { return g_virtual_cycles / kHostCyclesPerMs; }
+
+void SysTimer::Init() {}
+
+unsigned SysTimer::GetCycles() { return g_virtual_cycles; }
+
+unsigned SysTimer::CyclesPerMs() { return kHostCyclesPerMs; }
+
+unsigned SysTimer::GetWallCycles() { return g_virtual_cycles; }
+
+void SysTimer::AdvanceCycles(unsigned cycles) { g_virtual_cycles += cycles; }
+
+#else
+
 unsigned SysTimer::GetTime() {
   //	static unsigned x = 0;
   //	return x++;
   return HAL_GetTick();
 }
 
+void SysTimer::Init() {
+  CoreDebug->DEMCR = CoreDebug->DEMCR | CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL = DWT->CTRL | DWT_CTRL_CYCCNTENA_Msk;
+}
+
+unsigned SysTimer::GetCycles() { return DWT->CYCCNT; }
+
+unsigned SysTimer::CyclesPerMs() { return SystemCoreClock / 1000; }
+
+// HAL_InitTick() has SysTick count down HCLK from SystemCoreClock / 1000 - 1
+// and interrupt every ms.
+unsigned SysTimer::GetWallCycles() {
+  unsigned ms, count;
+  // A tick between the reads would pair the old ms with the new count.
+  do {
+    ms = HAL_GetTick();
+    count = SysTick->LOAD - SysTick->VAL;
+  } while (ms != HAL_GetTick());
+  return ms * (SysTick->LOAD + 1) + count;
+}
+
+#endif  // HITCON_TEST_MODE
+
 } /* namespace sched */
 } /* namespace service */
 } /* namespace hitcon */
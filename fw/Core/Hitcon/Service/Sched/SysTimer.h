@@ -17,6 +17,22 @@ class SysTimer {
   SysTimer();
   virtual ~SysTimer();
   static unsigned GetTime();
+
+  // Start the CPU cycle counter. Call once before using GetCycles().
+  static void Init();
+  // Free running CPU cycle counter, wraps around.
+  static unsigned GetCycles();
+  // How many GetCycles() counts in one GetTime() tick.
+  static unsigned CyclesPerMs();
+  // The same count, made up of GetTime() and how far SysTick is into the
+  // current tick, which unlike the CPU cycle counter keep going through
+  // WFI sleep. For measuring time asleep. Call with interrupts enabled.
+  static unsigned GetWallCycles();
+
+#ifdef HITCON_TEST_MODE
+  // On the host, time only moves when the test says so.
+  static void AdvanceCycles(unsigned cycles);
+#endif
 };
 
 } /* namespace sched */
@@ -10,6 +10,8 @@
 
 #include <Service/Sched/Checks.h>
 
+#include <atomic>
+
 namespace hitcon {
 namespace service {
 namespace sched {
@@ -22,12 +24,25 @@ class Task {
   task_callback_t callback;
   void *thisptr, *arg;
   bool in_queue = false;
+  // Position inside the scheduler heap this task is in. Only meaningful while
+  // in_queue is set.
+  unsigned heap_idx = 0;
+  // Set by Scheduler::Queue() and cleared when the task is dispatched, so
+  // queueing a task that's already pending is a no-op.
+  std::atomic<bool> pending{false};
+  Task *pendingNext = nullptr;
+#ifdef SCHED_PROFILING
+  // SysTimer::GetCycles() when the task last became ready to run.
+  unsigned readyCycles = 0;
+  // Index of this task's Profiler slot plus one, 0 if it has none yet.
+  unsigned profileSlot = 0;
+#endif
 
  public:
   // For prio, see Scheduler.h
   constexpr Task(unsigned prio, task_callback_t callback, void *thisptr)
       : prio(prio), callback(callback), thisptr(thisptr), arg(nullptr),
-        in_queue(false) {}
+        in_queue(false), heap_idx(0), pending(false), pendingNext(nullptr) {}
 
   // No copy
   Task(const Task &) = delete;
@@ -42,6 +57,29 @@ class Task {
   virtual bool operator<(Task &task);
   void Run();
   void SetArg(void *arg);
+  unsigned GetPrio() { return prio; }
+  task_callback_t GetCallback() { return callback; }
+  void *GetThisptr() { return thisptr; }
+
+  // Maintained by IndexedHeap.
+  unsigned GetHeapIdx() { return heap_idx; }
+  void SetHeapIdx(unsigned idx) { heap_idx = idx; }
+
+  // Returns true if the task was already pending. Safe from interrupts.
+  bool MarkPending() { return pending.exchange(true); }
+  void ClearPending() { pending.store(false); }
+
+  // Maintained by PendingList.
+  Task *GetPendingNext() { return pendingNext; }
+  void SetPendingNext(Task *next) { pendingNext = next; }
+
+#ifdef SCHED_PROFILING
+  // Maintained by Scheduler and Profiler.
+  unsigned GetReadyCycles() { return readyCycles; }
+  void SetReadyCycles(unsigned cycles) { readyCycles = cycles; }
+  unsigned GetProfileSlot() { return profileSlot; }
+  void SetProfileSlot(unsigned slot) { profileSlot = slot; }
+#endif
 
   // Must be called whenever entering task or delayedTask queue.
   // This is for debugging double Add() or Remove().
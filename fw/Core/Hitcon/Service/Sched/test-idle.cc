@@ -0,0 +1,95 @@
+#ifdef HITCON_TEST_MODE
+
+// Host simulation of the scheduler's idle path.
+// Runs a badge-like set of periodic tasks on the virtual SysTimer, first with
+// the old busy-wait loop and then with the default idle hook, and reports how
+// much of the time the CPU was busy in each case.
+//
+// Build and run with `make test` in this directory.
+
+#include <Service/Sched/PeriodicTask.h>
+#include <Service/Sched/Scheduler.h>
+#include <Service/Sched/SysTimer.h>
+
+#include <cassert>
+#include <cstdio>
+
+using namespace hitcon::service::sched;
+
+namespace {
+
+// Cost of one trip around the busy-wait loop.
+constexpr unsigned kSpinCycles = 120;
+constexpr unsigned kPhaseMs = 5000;
+
+unsigned g_task_cycles = 0;
+idle_hook_t g_default_hook;
+
+struct Load {
+  unsigned cycles;
+};
+
+void Work(void *thisptr, void *) {
+  unsigned cycles = static_cast<Load *>(thisptr)->cycles;
+  SysTimer::AdvanceCycles(cycles);
+  g_task_cycles += cycles;
+}
+
+// Roughly XBoardLogic, NvStorage, XBoardLogic, SignedPacketService and
+// IrController.
+Load loads[] = {{900}, {1500}, {2400}, {3000}, {6000}};
+PeriodicTask tasks[] = {
+    {300, &Work, &loads[0], 20},  {850, &Work, &loads[1], 100},
+    {300, &Work, &loads[2], 200}, {900, &Work, &loads[3], 500},
+    {400, &Work, &loads[4], 1000},
+};
+
+// Run for kPhaseMs and return the fraction of cycles spent in tasks or
+// spinning, ie. not idle.
+double RunPhase(bool tickless) {
+  scheduler.SetIdleHook(tickless ? g_default_hook : nullptr);
+  unsigned start = SysTimer::GetCycles();
+  unsigned end = SysTimer::GetTime() + kPhaseMs;
+  unsigned spin_cycles = 0;
+  g_task_cycles = 0;
+  while (SysTimer::GetTime() < end) {
+    if (!scheduler.RunOnce() && !tickless) {
+      SysTimer::AdvanceCycles(kSpinCycles);
+      spin_cycles += kSpinCycles;
+    }
+  }
+  double total = SysTimer::GetCycles() - start;
+  return (g_task_cycles + spin_cycles) / total;
+}
+
+}  // namespace
+
+int main() {
+  SysTimer::Init();
+  for (auto &task : tasks) {
+    scheduler.Queue(&task, nullptr);
+    scheduler.EnablePeriodic(&task);
+  }
+  g_default_hook = scheduler.GetIdleHook();
+
+  double spin_busy = RunPhase(false);
+  unsigned spin_idle_percent = scheduler.GetIdlePercent();
+  double tickless_busy = RunPhase(true);
+  unsigned tickless_idle_percent = scheduler.GetIdlePercent();
+
+  printf("busy-wait: CPU busy %5.1f%%, reported idle %u%%\n",
+         spin_busy * 100, spin_idle_percent);
+  printf("tickless:  CPU busy %5.1f%%, reported idle %u%%\n",
+         tickless_busy * 100, tickless_idle_percent);
+
+  assert(spin_busy > 0.99);
+  assert(spin_idle_percent == 0);
+  assert(tickless_busy < 0.2);
+  // The reported figure covers the last whole second only, allow some slack.
+  assert(tickless_idle_percent + 2 >= 100 - tickless_busy * 100);
+  assert(tickless_idle_percent <= 100 - tickless_busy * 100 + 2);
+  printf("test-idle PASSED.\n");
+  return 0;
+}
+
+#endif  // HITCON_TEST_MODE
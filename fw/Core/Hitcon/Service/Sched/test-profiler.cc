@@ -0,0 +1,151 @@
+#ifdef HITCON_TEST_MODE
+
+// Host test for the scheduler profiler.
+// A display-like hard deadline task is queued every 5ms, as its interrupt
+// would, while a background task occasionally hogs the CPU for 3ms. The
+// profiler must attribute the late starts to the right task.
+//
+// Build and run with `make test` in this directory.
+
+#include <Service/Sched/DelayedTask.h>
+#include <Service/Sched/PeriodicTask.h>
+#include <Service/Sched/Profiler.h>
+#include <Service/Sched/Scheduler.h>
+#include <Service/Sched/SysTimer.h>
+
+#include <cassert>
+#include <cstdio>
+
+using namespace hitcon::service::sched;
+
+namespace {
+
+constexpr unsigned kRunMs = 1000;
+
+struct Load {
+  unsigned cycles;
+};
+
+void Work(void *thisptr, void *);
+
+// 100us of work each time the frame interrupt fires.
+Load display_load = {1200};
+Task display_task(169, &Work, &display_load);
+unsigned next_frame = 0;
+// 3ms every 50ms.
+Load hog_load = {36000};
+PeriodicTask hog_task(900, &Work, &hog_load, 50);
+// Cheap and only ever queued with a delay.
+Load delayed_load = {12};
+DelayedTask delayed_task(500, &Work, &delayed_load, 0);
+
+// Move the clock forward, firing the frame interrupt every 5ms on the way.
+void Advance(unsigned cycles) {
+  constexpr unsigned kStep = 100;
+  while (cycles) {
+    unsigned step = cycles < kStep ? cycles : kStep;
+    SysTimer::AdvanceCycles(step);
+    cycles -= step;
+    if (SysTimer::GetTime() >= next_frame) {
+      scheduler.Queue(&display_task, nullptr);
+      next_frame += 5;
+    }
+  }
+}
+
+void Work(void *thisptr, void *) {
+  Advance(static_cast<Load *>(thisptr)->cycles);
+}
+
+const Profiler::TaskProfile *Find(Task *task) {
+  for (unsigned i = 0; i < profiler.size(); i++) {
+    if (profiler.Get(i).task == task) return &profiler.Get(i);
+  }
+  return nullptr;
+}
+
+void Print(const char *name, const Profiler::TaskProfile &p) {
+  printf("%-8s runs %4u min %5uus max %5uus late %3u latency:", name,
+         p.runs, Profiler::CyclesToUs(p.minCycles),
+         Profiler::CyclesToUs(p.maxCycles), p.lateStarts);
+  for (unsigned i = 0; i < Profiler::kLatencyBuckets; i++) {
+    printf(" %u", p.latencyHist[i]);
+  }
+  printf("\n");
+}
+
+}  // namespace
+
+int main() {
+  SysTimer::Init();
+  // Spin when idle, so time only moves through Advance().
+  scheduler.SetIdleHook(nullptr);
+  scheduler.Queue(&hog_task, nullptr);
+  scheduler.EnablePeriodic(&hog_task);
+
+  assert(Profiler::LatencyBucket(0) == 0);
+  assert(Profiler::LatencyBucket(1) == 1);
+  assert(Profiler::LatencyBucket(1000) == 10);
+  assert(Profiler::LatencyBucket(1024) == 11);
+  assert(Profiler::LatencyBucket(~0U) == Profiler::kLatencyBuckets - 1);
+
+  unsigned end = SysTimer::GetTime() + kRunMs;
+  unsigned next_delayed = SysTimer::GetTime();
+  while (SysTimer::GetTime() < end) {
+    unsigned now = SysTimer::GetTime();
+    if (now >= next_delayed) {
+      delayed_task.SetWakeTime(now + 10);
+      scheduler.Queue(&delayed_task, nullptr);
+      next_delayed += 20;
+    }
+    if (!scheduler.RunOnce()) Advance(120);
+  }
+
+  const Profiler::TaskProfile *display = Find(&display_task);
+  const Profiler::TaskProfile *hog = Find(&hog_task);
+  const Profiler::TaskProfile *delayed = Find(&delayed_task);
+  assert(display && hog && delayed);
+  Print("display", *display);
+  Print("hog", *hog);
+  Print("delayed", *delayed);
+
+  assert(display->runs == kRunMs / 5);
+  assert(Profiler::CyclesToUs(display->minCycles) == 100);
+  assert(Profiler::CyclesToUs(display->maxCycles) == 100);
+  assert(hog->runs >= kRunMs / 51 && hog->runs <= kRunMs / 50 + 1);
+  assert(Profiler::CyclesToUs(hog->maxCycles) == 3000);
+  assert(delayed->runs == kRunMs / 20);
+  // Only the background hog ever delays the display task, and by at most 3ms.
+  assert(display->lateStarts > 0 && display->lateStarts <= hog->runs);
+  unsigned late = 0;
+  for (unsigned i = Profiler::LatencyBucket(Profiler::kHardDeadlineUs) + 1;
+       i < Profiler::kLatencyBuckets; i++) {
+    late += display->latencyHist[i];
+    if (i > Profiler::LatencyBucket(3000)) assert(!display->latencyHist[i]);
+  }
+  assert(late <= display->lateStarts);
+  // Soft and background tasks never count as late.
+  assert(hog->lateStarts == 0 && delayed->lateStarts == 0);
+  // The delayed task is released on time, so it only ever waits for the hog.
+  for (unsigned i = Profiler::LatencyBucket(3000) + 1;
+       i < Profiler::kLatencyBuckets; i++) {
+    assert(!delayed->latencyHist[i]);
+  }
+
+  ProfileRecord record;
+  profiler.Serialize(display - &profiler.Get(0), &record);
+  assert(record.prio == 169);
+  assert(record.runs == display->runs);
+  assert(record.lateStarts == display->lateStarts);
+  assert(record.minUs == 100 && record.maxUs == 100);
+  assert(record.totalUs == 100ULL * display->runs);
+
+  profiler.Reset();
+  assert(Find(&display_task) == display);
+  assert(display->runs == 0 && display->lateStarts == 0);
+  assert(profiler.GetDropped() == 0);
+  printf("test-profiler PASSED.\n");
+  return 0;
+}
+
+#endif  // HITCON_TEST_MODE
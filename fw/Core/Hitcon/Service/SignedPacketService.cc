@@ -1,5 +1,6 @@
 #include <App/ShowNameApp.h>
 #include <App/TamaApp.h>
+#include <Service/Sched/SysTimer.h>
 #include <Service/SignedPacketService.h>
 #include <string.h>
 
@@ -11,6 +12,20 @@ namespace signed_packet {
 
 SignedPacket::SignedPacket() : status(kFree) {}
 
+void SignedPacket::OnSignFinish(hitcon::ecc::Signature *signature) {
+  signature->toBuffer(sig);
+  status = PacketStatus::kWaitTransmit;
+  g_signed_packet_service.QueueRoutine();
+}
+
+void SignedPacket::OnVerFinish(void *isValid) {
+  if (isValid)
+    status = PacketStatus::kWaitReceive;
+  else
+    status = PacketStatus::kFree;
+  g_signed_packet_service.QueueRoutine();
+}
+
 }  // namespace signed_packet
 
 using namespace hitcon::signed_packet;
@@ -18,17 +33,34 @@ using namespace hitcon::signed_packet;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
 SignedPacketService::SignedPacketService()
-    : sigRoutineTask(950, (callback_t)&SignedPacketService::SigRoutineFunc,
-                     this, 500),
-      verRoutineTask(950, (callback_t)&SignedPacketService::VerRoutineFunc,
-                     this, 500) {}
+    : routineTask(950, (callback_t)&SignedPacketService::RoutineFunc, this),
+      retryTask(950, (callback_t)&SignedPacketService::RetryFunc, this,
+                RETRY_INTERVAL),
+      retryQueued(false) {}
 #pragma GCC diagnostic pop
 
-void SignedPacketService::Init() {
-  hitcon::service::sched::scheduler.Queue(&sigRoutineTask, nullptr);
-  hitcon::service::sched::scheduler.EnablePeriodic(&sigRoutineTask);
-  hitcon::service::sched::scheduler.Queue(&verRoutineTask, nullptr);
-  hitcon::service::sched::scheduler.EnablePeriodic(&verRoutineTask);
+void SignedPacketService::Init() { QueueRoutine(); }
+
+void SignedPacketService::QueueRoutine() {
+  hitcon::service::sched::scheduler.Queue(&routineTask, nullptr);
+}
+
+void SignedPacketService::RetryFunc() {
+  retryQueued = false;
+  RoutineFunc();
+}
+
+void SignedPacketService::RoutineFunc() {
+  // Both, so that a sign and a verify can run at once.
+  bool done = VerRoutine();
+  done = SigRoutine() && done;
+  if (done || retryQueued) return;
+  // EcLogic's other users don't let us know when they're done, nor does
+  // IrController when there's room.
+  retryQueued = true;
+  retryTask.SetWakeTime(hitcon::service::sched::SysTimer::GetTime() +
+                        RETRY_INTERVAL);
+  hitcon::service::sched::scheduler.Queue(&retryTask, nullptr);
 }
 
 static bool getPacketSigInfo(packet_type packetType, size_t &sigOffset,
@@ -116,13 +148,14 @@ bool SignedPacketService::VerifyAndReceivePacket(
   packet.dataSize = sizeReq;
   memcpy(packet.sig, opaq_start + sigOffset, ECC_SIGNATURE_SIZE);
   packet.status = PacketStatus::kWaitVerStart;
+  QueueRoutine();
   return true;
 }
 
 /**
  * Find an empty slot and send it for singing.
- * The signing doesn't occur instantly. Instead, GameController waits until ECC
- * is ready and queues the job.
+ * The signing doesn't occur instantly. Instead, the routine starts it as soon
+ * as EcLogic has a free context.
  */
 bool SignedPacketService::SignAndSendData(packet_type packetType,
                                           const uint8_t *data, size_t size) {
@@ -140,24 +173,10 @@ bool SignedPacketService::SignAndSendData(packet_type packetType,
   memcpy(packet.data, data, size);
   packet.dataSize = size;
   packet.status = kWaitSignStart;
+  QueueRoutine();
   return true;
 }
 
-void SignedPacketService::OnPacketSignFinish(
-    hitcon::ecc::Signature *signature) {
-  SignedPacket &packet = sig_packet_queue_[signingPacketId];
-  signature->toBuffer(packet.sig);
-  packet.status = PacketStatus::kWaitTransmit;
-}
-
-void SignedPacketService::OnPacketVerFinish(void *isValid) {
-  SignedPacket &packet = ver_packet_queue_[verifyingPacketId];
-  if (isValid)
-    packet.status = PacketStatus::kWaitReceive;
-  else
-    packet.status = PacketStatus::kFree;
-}
-
 void SignedPacketService::ReceivePacket(SignedPacket &packet) {
   switch (packet.type) {
     case packet_type::kScoreAnnounce:
@@ -173,61 +192,60 @@ void SignedPacketService::ReceivePacket(SignedPacket &packet) {
   }
 }
 
-void SignedPacketService::VerRoutineFunc() {
-  size_t packetId;
-  if (FindPacketOfState(ver_packet_queue_, PacketStatus::kWaitVerStart,
-                        packetId)) {
-    SignedPacket &packet = ver_packet_queue_[packetId];
+bool SignedPacketService::VerRoutine() {
+  bool done = true;
+  for (SignedPacket &packet : ver_packet_queue_) {
+    if (packet.status == PacketStatus::kWaitVerStart) {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-    bool ret = hitcon::ecc::g_ec_logic.StartVerify(
-        packet.data, packet.dataSize, packet.sig,
-        (callback_t)&SignedPacketService::OnPacketVerFinish, this);
+      bool ret = hitcon::ecc::g_ec_logic.StartVerify(
+          packet.data, packet.dataSize, packet.sig,
+          (callback_t)&SignedPacket::OnVerFinish, &packet);
 #pragma GCC diagnostic pop
-    if (ret) {
-      packet.status = PacketStatus::kWaitVerDone;
-      verifyingPacketId = packetId;
+      if (ret)
+        packet.status = PacketStatus::kWaitVerDone;
+      else
+        done = false;
+    } else if (packet.status == PacketStatus::kWaitReceive) {
+      ReceivePacket(packet);
+      packet.status = PacketStatus::kFree;
     }
   }
-
-  if (FindPacketOfState(ver_packet_queue_, PacketStatus::kWaitReceive,
-                        packetId)) {
-    ReceivePacket(ver_packet_queue_[packetId]);
-    ver_packet_queue_[packetId].status = PacketStatus::kFree;
-  }
+  return done;
 }
 
-void SignedPacketService::SigRoutineFunc() {
-  size_t packetId;
-  if (FindPacketOfState(sig_packet_queue_, PacketStatus::kWaitSignStart,
-                        packetId)) {
-    SignedPacket &packet = sig_packet_queue_[packetId];
+bool SignedPacketService::SigRoutine() {
+  bool done = true;
+  for (SignedPacket &packet : sig_packet_queue_) {
+    if (packet.status == PacketStatus::kWaitSignStart) {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
-    bool ret = hitcon::ecc::g_ec_logic.StartSign(
-        packet.data, packet.dataSize,
-        (callback_t)&SignedPacketService::OnPacketSignFinish, this);
+      bool ret = hitcon::ecc::g_ec_logic.StartSign(
+          packet.data, packet.dataSize,
+          (callback_t)&SignedPacket::OnSignFinish, &packet);
 #pragma GCC diagnostic pop
-    if (ret) {
-      packet.status = PacketStatus::kWaitSignDone;
-      signingPacketId = packetId;
+      if (ret)
+        packet.status = PacketStatus::kWaitSignDone;
+      else
+        done = false;
+    } else if (packet.status == PacketStatus::kWaitTransmit) {
+      // Transmit signed packets if possible
+      hitcon::ir::IrData irdata = {.ttl = 0, .type = packet.type};
+      memcpy(&irdata.opaq, packet.data, packet.dataSize);
+      memcpy(
+          reinterpret_cast<uint8_t *>(&irdata.opaq) + packet.signatureOffset,
+          packet.sig, sizeof(packet.sig));
+      bool ret = hitcon::ir::irController.SendPacketWithRetransmit(
+          reinterpret_cast<uint8_t *>(&irdata),
+          packet.dataSize + ECC_SIGNATURE_SIZE + ir::IR_DATA_HEADER_SIZE, 3,
+          ::hitcon::ir::AckTag::ACK_TAG_NONE);
+      if (ret)
+        packet.status = PacketStatus::kFree;
+      else
+        done = false;
     }
   }
-
-  // Find signed packets and transmit if possible
-  if (FindPacketOfState(sig_packet_queue_, PacketStatus::kWaitTransmit,
-                        packetId)) {
-    SignedPacket &packet = sig_packet_queue_[packetId];
-    hitcon::ir::IrData irdata = {.ttl = 0, .type = packet.type};
-    memcpy(&irdata.opaq, packet.data, packet.dataSize);
-    memcpy(reinterpret_cast<uint8_t *>(&irdata.opaq) + packet.signatureOffset,
-           packet.sig, sizeof(packet.sig));
-    bool ret = hitcon::ir::irController.SendPacketWithRetransmit(
-        reinterpret_cast<uint8_t *>(&irdata),
-        packet.dataSize + ECC_SIGNATURE_SIZE + ir::IR_DATA_HEADER_SIZE, 3,
-        ::hitcon::ir::AckTag::ACK_TAG_NONE);
-    if (ret) packet.status = PacketStatus::kFree;
-  }
+  return done;
 }
 
 }  // namespace hitcon
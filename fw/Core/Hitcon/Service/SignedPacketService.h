@@ -3,6 +3,7 @@
 
 #include <Logic/EcLogic.h>
 #include <Logic/IrController.h>
+#include <Service/Sched/DelayedTask.h>
 #include <Service/Sched/Scheduler.h>
 #include <stdint.h>
 
@@ -12,6 +13,9 @@ namespace signed_packet {
 
 constexpr size_t MAX_PACKET_DATA_SIZE = 13;
 constexpr size_t PACKET_QUEUE_SIZE = 4;
+// Milliseconds till another try, when EcLogic or IrController turned a
+// packet down.
+constexpr unsigned RETRY_INTERVAL = 500;
 
 enum PacketStatus : uint8_t {
   kFree,
@@ -32,6 +36,10 @@ struct SignedPacket {
   uint8_t sig[ECC_SIGNATURE_SIZE];
 
   SignedPacket();
+
+  // EcLogic callbacks, with the packet as the first argument.
+  void OnSignFinish(hitcon::ecc::Signature *signature);
+  void OnVerFinish(void *isValid);
 };
 
 }  // namespace signed_packet
@@ -49,20 +57,24 @@ class SignedPacketService {
   void Init();
 
  private:
-  hitcon::service::sched::PeriodicTask sigRoutineTask;
-  hitcon::service::sched::PeriodicTask verRoutineTask;
-  size_t signingPacketId;
-  size_t verifyingPacketId;
+  friend struct signed_packet::SignedPacket;
+
+  // Queued when a packet comes in or EcLogic is done with one.
+  hitcon::service::sched::Task routineTask;
+  hitcon::service::sched::DelayedTask retryTask;
+  bool retryQueued;
   signed_packet::SignedPacket
       sig_packet_queue_[signed_packet::PACKET_QUEUE_SIZE];
   signed_packet::SignedPacket
       ver_packet_queue_[signed_packet::PACKET_QUEUE_SIZE];
 
-  void VerRoutineFunc();
-  void SigRoutineFunc();
-  void OnPacketVerFinish(void *isValid);
+  void QueueRoutine();
+  void RoutineFunc();
+  void RetryFunc();
+  // Return false if a packet has to wait for a retry.
+  bool VerRoutine();
+  bool SigRoutine();
   void ReceivePacket(signed_packet::SignedPacket &packet);
-  void OnPacketSignFinish(hitcon::ecc::Signature *signature);
   bool FindPacketOfState(signed_packet::SignedPacket *queue,
                          signed_packet::PacketStatus status, size_t &packetId);
 };
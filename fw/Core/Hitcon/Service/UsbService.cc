@@ -63,11 +63,17 @@ void UsbService::SendKeyCode(uint8_t keycode, uint8_t modifier) {
 }
 
 // TODO: add retry
-void UsbService::SendCustomReport(uint8_t* data) {
+bool UsbService::SendCustomReport(uint8_t* data) {
+  // _report is the buffer being transmitted, don't touch it until the
+  // previous report or keyboard retry is out.
+  auto* hhid =
+      static_cast<USBD_CUSTOM_HID_HandleTypeDef*>(hUsbDeviceFS.pClassData);
+  if (_retrying || (hhid && hhid->state != CUSTOM_HID_IDLE)) return false;
   _report.report_id = CUSTOM_REPORT_ID;
   memcpy(_report.u8, data, REPORT_LEN - 1);
-  USBD_CUSTOM_HID_SendReport(&hUsbDeviceFS,
-                             reinterpret_cast<uint8_t*>(&_report), REPORT_LEN);
+  return USBD_CUSTOM_HID_SendReport(&hUsbDeviceFS,
+                                    reinterpret_cast<uint8_t*>(&_report),
+                                    REPORT_LEN) == USBD_OK;
 }
 
 void UsbService::RetryHandler(void* unused) {
@@ -72,7 +72,8 @@ class UsbService {
   void SendKeyCode(uint8_t keycode, uint8_t modifier);
 
   // The data should be REPORT_LEN bytes long.
-  void SendCustomReport(uint8_t* data);
+  // Returns false if the previous report is still being sent.
+  bool SendCustomReport(uint8_t* data);
   bool IsBusy() { return _retrying; }
   bool IsConnected() { return _connected; }
 
@@ -0,0 +1,138 @@
+#ifdef HITCON_TEST_MODE
+
+// Host-side benchmark for HashService's time budget.
+// Keeps every context busy with a mix of ack sized and signed packet sized
+// messages next to a 1ms display task, and reports hashes per second and the
+// gaps between display task runs for a range of budgets. SysTimer is the
+// host's clock here rather than the virtual one, so the budget is real time;
+// the host hashes far faster than the badge, but the dispatch overhead saved
+// and the latency added to other tasks show the same way.
+//
+// Build and run with `make bench` in this directory.
+
+#include <Service/HashService.h>
+#include <Service/Sched/SysTimer.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace hitcon;
+using namespace hitcon::hash;
+using namespace hitcon::service::sched;
+
+namespace hitcon {
+namespace service {
+namespace sched {
+
+namespace {
+std::chrono::steady_clock::time_point g_epoch;
+}  // namespace
+
+// A cycle is a nanosecond.
+unsigned SysTimer::GetTime() { return GetCycles() / CyclesPerMs(); }
+
+void SysTimer::Init() { g_epoch = std::chrono::steady_clock::now(); }
+
+unsigned SysTimer::GetCycles() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - g_epoch)
+      .count();
+}
+
+unsigned SysTimer::CyclesPerMs() { return 1000000; }
+
+unsigned SysTimer::GetWallCycles() { return GetCycles(); }
+
+// The scheduler's idle hook on the host, just wait.
+void SysTimer::AdvanceCycles(unsigned cycles) {
+  unsigned start = GetCycles();
+  while (GetCycles() - start < cycles) {
+  }
+}
+
+}  // namespace sched
+}  // namespace service
+}  // namespace hitcon
+
+namespace {
+
+constexpr unsigned kRunMs = 500;
+// An ack hash and a signed packet.
+constexpr size_t kLengths[] = {20, 180};
+
+uint8_t g_messages[2][180];
+unsigned g_started = 0;
+unsigned g_hashes = 0;
+
+void OnHashDone(void *arg1, void *) {
+  g_hashes++;
+  // Keep the context busy.
+  size_t len = kLengths[g_started++ % 2];
+  bool started = g_hash_service.StartHash(g_messages[g_started % 2], len,
+                                          &OnHashDone, arg1);
+  assert(started);
+  (void)started;
+}
+
+unsigned g_last_display = 0;
+std::vector<unsigned> g_gaps;
+
+void Display(void *, void *) {
+  unsigned now = SysTimer::GetCycles();
+  if (g_last_display) g_gaps.push_back(now - g_last_display);
+  g_last_display = now;
+}
+
+double GapUs(double percentile) {
+  std::sort(g_gaps.begin(), g_gaps.end());
+  return g_gaps[(g_gaps.size() - 1) * percentile] / 1000.0;
+}
+
+PeriodicTask g_display(150, &Display, nullptr, 1);
+
+void Run(unsigned budget_us) {
+  g_hash_service.SetBudget(budget_us);
+  const HashService::Stats before = g_hash_service.GetStats();
+  g_hashes = 0;
+  g_gaps.clear();
+  g_last_display = 0;
+  unsigned start = SysTimer::GetTime();
+  while (SysTimer::GetTime() - start < kRunMs) scheduler.RunOnce();
+  const HashService::Stats &after = g_hash_service.GetStats();
+  const double seconds = kRunMs / 1000.0;
+  printf("%9u  %9.0f  %14.1f  %12.0f  %12.0f\n", budget_us,
+         g_hashes / seconds,
+         static_cast<double>(after.steps - before.steps) /
+             (after.dispatches - before.dispatches),
+         GapUs(0.5), GapUs(0.99));
+}
+
+}  // namespace
+
+int main() {
+  SysTimer::Init();
+  for (size_t i = 0; i < sizeof(g_messages); i++) {
+    g_messages[i / 180][i % 180] = i * 13;
+  }
+  g_hash_service.Init();
+  scheduler.Queue(&g_display, nullptr);
+  scheduler.EnablePeriodic(&g_display);
+  for (size_t i = 0; i < HASH_SERVICE_CONTEXTS; i++) {
+    size_t len = kLengths[g_started++ % 2];
+    bool started = g_hash_service.StartHash(g_messages[g_started % 2], len,
+                                            &OnHashDone, nullptr);
+    assert(started);
+    (void)started;
+  }
+  printf("budget us  hashes/s  steps/dispatch  display gap us p50 / p99\n");
+  const unsigned budgets[] = {0, 10, 50, 200, 1000, 5000};
+  for (unsigned budget : budgets) Run(budget);
+  printf("bench-hash-service done.\n");
+  return 0;
+}
+
+#endif  // HITCON_TEST_MODE
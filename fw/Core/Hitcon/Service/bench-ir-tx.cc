@@ -0,0 +1,146 @@
+#ifdef HITCON_TEST_MODE
+
+// Host-side microbenchmark for refilling the IR TX DMA buffer.
+// Compares IrTxSchedule, built once per frame, against expanding the frame a
+// bit at a time into CCR values for every half of the buffer, the way
+// IrService::PopulateTxDmaBuffer() used to, and checks that both give the
+// same pulses. Built without auto-vectorization, which the badge doesn't
+// have either.
+//
+// Build and run with `make bench` in this directory.
+
+#include <Service/IrTxSchedule.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace hitcon::ir;
+
+namespace {
+
+constexpr unsigned kFrames = 20000;
+
+struct Frame {
+  const uint8_t *header;
+  std::vector<uint8_t> data;
+};
+
+// The old PopulateTxDmaBuffer() for half `ctr` of the frame, header first.
+// Returns true after the last one.
+bool ReferenceFill(const Frame &frame, size_t ctr, uint16_t *out) {
+  if (frame.header) {
+    if (ctr < IR_PACKET_RUN_COUNT) {
+      size_t base = ctr * IR_PACKET_PER_RUN;
+      for (size_t i = 0; i < IR_SERVICE_TX_SIZE; i++) {
+        out[i] = (-static_cast<int16_t>(frame.header[base + i / 8])) &
+                 IR_PWM_TIM_CCR;
+      }
+      return false;
+    }
+    ctr -= IR_PACKET_RUN_COUNT;
+  }
+  size_t base_bit = ctr * IR_BITS_PER_TX_RUN;
+  size_t i = 0;
+  for (size_t j = 0; j < IR_BITS_PER_TX_RUN; j++, base_bit++) {
+    int cbit = (frame.data[base_bit / 8] >> (base_bit % 8)) & 0x01;
+    int16_t ccr_val = (-static_cast<int16_t>(cbit)) & IR_PWM_TIM_CCR;
+    for (size_t k = 0; k < PULSE_PER_DATA_BIT; k++, i++) {
+      out[i] = ccr_val;
+    }
+  }
+  return ctr + 1 == frame.data.size() * 8 / IR_BITS_PER_TX_RUN;
+}
+
+std::vector<Frame> MakeFrames() {
+  const uint8_t *headers[] = {IR_PACKET_HEADER, IR_PACKET_HEADER_FEC,
+                              nullptr};
+  std::vector<Frame> frames;
+  for (unsigned i = 0; i < kFrames; i++) {
+    Frame frame = {headers[rand() % 3],
+                   std::vector<uint8_t>(rand() % IrTxSchedule::kMaxBytes + 1)};
+    // Long runs of one level as well as random bits.
+    const int kind = rand() % 4;
+    for (uint8_t &byte : frame.data) {
+      byte = kind == 0 ? 0x00 : kind == 1 ? 0xFF : rand();
+    }
+    frames.push_back(frame);
+  }
+  return frames;
+}
+
+void TestSameWaveform(const std::vector<Frame> &frames) {
+  IrTxSchedule schedule;
+  alignas(4) uint16_t expected[IR_SERVICE_TX_SIZE];
+  alignas(4) uint16_t actual[IR_SERVICE_TX_SIZE];
+  for (const Frame &frame : frames) {
+    schedule.Build(frame.header, frame.data.data(), frame.data.size());
+    // Twice, the second time as a retransmit after a collision.
+    for (int round = 0; round < 2; round++) {
+      bool done = false;
+      for (size_t ctr = 0; !done; ctr++) {
+        done = ReferenceFill(frame, ctr, expected);
+        assert(schedule.Fill(actual) == done);
+        assert(!memcmp(expected, actual, sizeof(actual)));
+      }
+      // Carrier off after the end.
+      assert(schedule.Fill(actual));
+      for (uint16_t value : actual) assert(value == 0);
+      schedule.Rewind();
+    }
+  }
+}
+
+double NsPerHalf(std::chrono::steady_clock::time_point start, size_t halves) {
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / halves;
+}
+
+void Benchmark(const std::vector<Frame> &frames) {
+  alignas(4) static uint16_t out[IR_SERVICE_TX_SIZE];
+  size_t halves = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const Frame &frame : frames) {
+    for (size_t ctr = 0; !ReferenceFill(frame, ctr, out); ctr++) halves++;
+    halves++;
+    asm volatile("" : : "r"(out) : "memory");
+  }
+  printf("per bit refill:  %6.1f ns per half buffer\n",
+         NsPerHalf(start, halves));
+
+  std::vector<IrTxSchedule> schedules(frames.size());
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < frames.size(); i++) {
+    schedules[i].Build(frames[i].header, frames[i].data.data(),
+                       frames[i].data.size());
+  }
+  printf("schedule build:  %6.1f ns per frame\n",
+         NsPerHalf(start, frames.size()));
+
+  size_t schedule_halves = 0;
+  start = std::chrono::steady_clock::now();
+  for (IrTxSchedule &schedule : schedules) {
+    schedule_halves++;
+    while (!schedule.Fill(out)) schedule_halves++;
+    asm volatile("" : : "r"(out) : "memory");
+  }
+  printf("schedule refill: %6.1f ns per half buffer\n",
+         NsPerHalf(start, schedule_halves));
+  assert(schedule_halves == halves);
+}
+
+}  // namespace
+
+int main() {
+  srand(1);
+  std::vector<Frame> frames = MakeFrames();
+  TestSameWaveform(frames);
+  Benchmark(frames);
+  printf("bench-ir-tx PASSED.\n");
+  return 0;
+}
+
+#endif  // HITCON_TEST_MODE
@@ -0,0 +1,226 @@
+#ifdef HITCON_TEST_MODE
+
+// Host test of HashService on the scheduler and the virtual SysTimer.
+// Checks the digests against sha3_HashBuffer() with every context and place
+// in the queue taken, that a short message started behind a long one is done
+// first, cancelling, and starting a hash from a callback, a step per dispatch.
+// Then that a time budget gets a hash done in one dispatch, but gives way to
+// a more urgent task.
+//
+// Build and run with `make test` in this directory.
+
+#include <Service/HashService.h>
+#include <Service/Sched/SysTimer.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace hitcon;
+using namespace hitcon::hash;
+using namespace hitcon::service::sched;
+
+namespace {
+
+// Roughly what a keccak round takes on the badge.
+constexpr unsigned kStepCycles = 8000;
+
+struct Job {
+  std::vector<uint8_t> message;
+  uint8_t digest[SHA3_BIT_SIZE / 8];
+  bool done;
+  // Tasks run when it was done.
+  size_t done_at;
+  // Started from the callback, if set.
+  Job *next;
+  // Queued from the callback, if set.
+  Task *urgent;
+};
+
+size_t g_order = 0;
+
+void OnHashDone(void *arg1, void *arg2) {
+  Job *job = static_cast<Job *>(arg1);
+  HashResult *result = static_cast<HashResult *>(arg2);
+  assert(!job->done);
+  assert(result->size == sizeof(job->digest));
+  memcpy(job->digest, result->digest, result->size);
+  job->done = true;
+  job->done_at = g_order++;
+  if (job->urgent) scheduler.Queue(job->urgent, nullptr);
+  if (job->next) {
+    assert(g_hash_service.StartHash(job->next->message.data(),
+                                    job->next->message.size(), &OnHashDone,
+                                    job->next));
+  }
+}
+
+Job MakeJob(size_t len, uint8_t seed) {
+  Job job = {std::vector<uint8_t>(len), {}, false, 0, nullptr, nullptr};
+  for (size_t i = 0; i < len; i++) job.message[i] = seed + i * 7;
+  return job;
+}
+
+bool Start(Job &job) {
+  return g_hash_service.StartHash(job.message.data(), job.message.size(),
+                                  &OnHashDone, &job);
+}
+
+void CheckDigest(const Job &job) {
+  uint8_t expected[SHA3_BIT_SIZE / 8];
+  sha3_HashBuffer(SHA3_BIT_SIZE, SHA3_FLAGS_NONE, job.message.data(),
+                  job.message.size(), expected, sizeof(expected));
+  assert(job.done);
+  assert(!memcmp(job.digest, expected, sizeof(expected)));
+}
+
+void RunSteps(int steps) {
+  for (int i = 0; i < steps; i++) {
+    scheduler.RunOnce();
+    SysTimer::AdvanceCycles(kStepCycles);
+  }
+}
+
+void RunUntilIdle() {
+  size_t last = scheduler.GetTotalTasksRan();
+  for (int idle = 0; idle < 1000;) {
+    scheduler.RunOnce();
+    SysTimer::AdvanceCycles(kStepCycles);
+    if (scheduler.GetTotalTasksRan() == last) {
+      idle++;
+    } else {
+      idle = 0;
+      last = scheduler.GetTotalTasksRan();
+    }
+  }
+}
+
+void TestFull() {
+  // Sizes around the 8 byte words and the 136 byte blocks.
+  const size_t sizes[] = {0, 7, 8, 135, 136, 137, 200};
+  std::vector<Job> jobs;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    jobs.push_back(MakeJob(sizes[i], i));
+  }
+  const size_t capacity = HASH_SERVICE_CONTEXTS + HASH_SERVICE_QUEUE_SIZE;
+  assert(jobs.size() > capacity);
+  for (size_t i = 0; i < jobs.size(); i++) {
+    assert(Start(jobs[i]) == (i < capacity));
+  }
+  assert(g_hash_service.GetStats().rejected == jobs.size() - capacity);
+  assert(g_hash_service.GetStats().depth == capacity);
+  RunUntilIdle();
+  for (size_t i = 0; i < capacity; i++) CheckDigest(jobs[i]);
+  assert(!jobs[capacity].done);
+  // Taken now that there's room.
+  assert(Start(jobs[capacity]));
+  RunUntilIdle();
+  CheckDigest(jobs[capacity]);
+  assert(g_hash_service.GetStats().depth == 0);
+  printf("full: %zu jobs at once, one more turned down\n", capacity);
+}
+
+void TestFairness() {
+  // A signed packet, then an ack hash.
+  Job long_job = MakeJob(180, 1);
+  Job short_job = MakeJob(20, 2);
+  const HashService::Stats before = g_hash_service.GetStats();
+  assert(Start(long_job));
+  // Well into its first block.
+  RunSteps(20);
+  assert(Start(short_job));
+  RunUntilIdle();
+  CheckDigest(long_job);
+  CheckDigest(short_job);
+  assert(short_job.done_at < long_job.done_at);
+  const HashService::Stats &after = g_hash_service.GetStats();
+  printf("fairness: %u steps for both, the short one isn't kept waiting\n",
+         after.steps - before.steps);
+}
+
+void TestStop() {
+  Job jobs[HASH_SERVICE_CONTEXTS + 2];
+  Job other = MakeJob(30, 9);
+  for (size_t i = 0; i < HASH_SERVICE_CONTEXTS + 2; i++) {
+    jobs[i] = MakeJob(50, i);
+    assert(Start(jobs[i]));
+  }
+  assert(Start(other));
+  const uint32_t cancelled = g_hash_service.GetStats().cancelled;
+  // One with a context, one in the queue.
+  g_hash_service.StopHash(&jobs[0]);
+  g_hash_service.StopHash(&jobs[HASH_SERVICE_CONTEXTS]);
+  assert(g_hash_service.GetStats().cancelled == cancelled + 2);
+  RunUntilIdle();
+  assert(!jobs[0].done && !jobs[HASH_SERVICE_CONTEXTS].done);
+  for (size_t i = 1; i < HASH_SERVICE_CONTEXTS + 2; i++) {
+    if (i != HASH_SERVICE_CONTEXTS) CheckDigest(jobs[i]);
+  }
+  CheckDigest(other);
+  assert(g_hash_service.GetStats().depth == 0);
+  printf("stop: cancelled jobs never call back, the rest are done\n");
+}
+
+void TestChained() {
+  Job first = MakeJob(40, 3);
+  Job second = MakeJob(60, 4);
+  first.next = &second;
+  assert(Start(first));
+  RunUntilIdle();
+  CheckDigest(first);
+  CheckDigest(second);
+  printf("chained: a hash started from a callback\n");
+}
+
+size_t g_urgent_at = 0;
+
+void OnUrgent(void *, void *) { g_urgent_at = g_order++; }
+
+void TestBudget() {
+  // Time stands still during a dispatch here, so the budget never runs out.
+  g_hash_service.SetBudget(HASH_SERVICE_BUDGET_US);
+  Job alone = MakeJob(180, 5);
+  uint32_t dispatches = g_hash_service.GetStats().dispatches;
+  assert(Start(alone));
+  RunUntilIdle();
+  CheckDigest(alone);
+  // And one more to find there's nothing left.
+  assert(g_hash_service.GetStats().dispatches - dispatches <= 2);
+
+  // Display refresh, say.
+  Task urgent(150, &OnUrgent, nullptr);
+  Job first = MakeJob(10, 6);
+  Job second = MakeJob(180, 7);
+  first.urgent = &urgent;
+  assert(Start(first));
+  assert(Start(second));
+  RunUntilIdle();
+  CheckDigest(first);
+  CheckDigest(second);
+  assert(first.done_at < g_urgent_at && g_urgent_at < second.done_at);
+  printf("budget: a hash in one dispatch, an urgent task still gets in\n");
+}
+
+}  // namespace
+
+int main() {
+  SysTimer::Init();
+  g_hash_service.Init();
+  g_hash_service.SetBudget(0);
+  TestFull();
+  TestFairness();
+  TestStop();
+  TestChained();
+  TestBudget();
+  const HashService::Stats &stats = g_hash_service.GetStats();
+  printf("stats: %u jobs, %u bytes, %u steps, max depth %u, max wait %ums, "
+         "max latency %ums\n",
+         stats.jobs, stats.bytes, stats.steps, stats.maxDepth, stats.maxWait,
+         stats.maxLatency);
+  assert(stats.maxDepth == HASH_SERVICE_CONTEXTS + HASH_SERVICE_QUEUE_SIZE);
+  printf("test-hash-service PASSED.\n");
+  return 0;
+}
+
+#endif  // HITCON_TEST_MODE
@@ -0,0 +1,237 @@
+#ifdef HITCON_TEST_MODE
+
+// Tests IrMac, and compares it against the fixed waits IrService had before
+// in a model of badges sharing one room: every badge has a frame to send
+// every 10s on average, the channel is sensed a DMA buffer pair at a time
+// the way IrService does, and badges that start in the same slot collide.
+// Once there are more frames than air time, the frames that make it have
+// to degrade gracefully instead of collapsing.
+//
+// Build and run with `make test` in this directory.
+
+#include <Service/IrMac.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace hitcon::ir;
+
+namespace {
+
+// All times are in bytes of RX samples, 8 samples of 4 pulses at 38kHz.
+constexpr size_t kSlotBytes = 2 * IR_SERVICE_RX_ON_BUFFER_SIZE;
+// An IrService routine run, every 22ms.
+constexpr size_t kTickBytes = 26;
+// A frame with the largest payload.
+constexpr size_t kFrameBytes =
+    (IR_PACKET_HEADER_SIZE * PULSE_PER_HEADER_BIT +
+     MAX_PACKET_PAYLOAD_BYTES * 8 * PULSE_PER_DATA_BIT) /
+    (8 * DECODE_SAMPLE_RATIO);
+// A collision is noticed after the first RX DMA run.
+constexpr size_t kDetectBytes = IR_BYTE_PER_RUN;
+constexpr size_t kSeconds = 600;
+constexpr size_t kSlotsPerSecond = 38000 / 32 / kSlotBytes;
+constexpr size_t kSlots = kSeconds * kSlotsPerSecond;
+constexpr size_t kFrameInterval = 10 * kSlotsPerSecond;
+
+void TestBackoff() {
+  IrMac mac;
+  std::mt19937 rng(1);
+  for (int i = 0; i <= IR_MAC_MAX_BACKOFF_EXPONENT + 2; i++) {
+    const size_t cw = IR_MAC_CW_MIN << mac.BackoffExponent();
+    for (int j = 0; j < 1000; j++) {
+      const size_t quiet = mac.QuietPeriod(rng());
+      assert(quiet >= IR_MAC_DIFS && quiet < IR_MAC_DIFS + cw);
+    }
+    const uint8_t exponent = mac.BackoffExponent();
+    const size_t cw_collision = IR_MAC_COLLISION_CW_MIN << exponent;
+    const uint16_t wait = mac.OnCollision(rng());
+    assert(wait >= IR_MAC_COLLISION_WAIT &&
+           wait < IR_MAC_COLLISION_WAIT + cw_collision);
+    assert(mac.BackoffExponent() ==
+           (exponent < IR_MAC_MAX_BACKOFF_EXPONENT ? exponent + 1 : exponent));
+  }
+  assert(mac.BackoffExponent() == IR_MAC_MAX_BACKOFF_EXPONENT);
+  mac.OnAck();
+  assert(mac.BackoffExponent() == 0);
+  mac.OnAckTimeout();
+  mac.OnAckTimeout();
+  assert(mac.BackoffExponent() == 2);
+  assert(mac.GetStats().collisions == IR_MAC_MAX_BACKOFF_EXPONENT + 3);
+  assert(mac.GetStats().acks == 1 && mac.GetStats().ack_timeouts == 2);
+  printf("backoff: grows to 2^%d on collisions and ack timeouts, resets on "
+         "ack\n",
+         IR_MAC_MAX_BACKOFF_EXPONENT);
+}
+
+void TestPersistence() {
+  IrMac mac;
+  mac.SetLoad(0);
+  assert(mac.Persistence() == 256);
+  for (uint32_t r = 0; r < 256; r++) assert(mac.Persist(r));
+  uint16_t last = 256;
+  for (int load = 0; load <= 120; load++) {
+    mac.SetLoad(load);
+    assert(mac.Persistence() <= last && mac.Persistence() >= 1);
+    last = mac.Persistence();
+  }
+  mac.SetLoad(100);
+  const uint16_t busy = mac.Persistence();
+  assert(busy < 128);
+  int sent = 0;
+  for (uint32_t r = 0; r < 256; r++) sent += mac.Persist(r);
+  assert(sent == busy);
+  assert(mac.GetStats().attempts == 256u + busy);
+  assert(mac.GetStats().deferrals == 256u - busy);
+  mac.SetPersistence(0, 0, 0);
+  assert(mac.Persistence() == 256);
+  mac.SetPersistence(255, 255, 255);
+  assert(mac.Persistence() >= 1);
+  printf("persistence: 256/256 on a quiet channel, %u/256 at full load\n",
+         busy);
+}
+
+// A badge that passes up a channel idle for a long time, and then hears
+// traffic, has to wait for no more than a quiet period after it.
+void TestDeferral() {
+  IrMac mac;
+  mac.SetLoad(100);
+  const size_t cw_max = IR_MAC_CW_MIN << IR_MAC_MAX_BACKOFF_EXPONENT;
+  for (size_t i = 0; i < 100000; i++) mac.OnRxByte(0);
+  mac.StartWait(0);
+  assert(mac.ChannelClear());
+  // A draw whose low byte is over Persistence() at full load.
+  uint32_t random = 0xFF;
+  assert(!mac.Persist(random));
+  assert(!mac.ChannelClear());
+
+  for (int frame = 0; frame < 3; frame++) {
+    for (size_t i = 0; i < 100; i++) mac.OnRxByte(0xFF);
+    size_t waited = 0;
+    while (!mac.ChannelClear()) {
+      mac.OnRxByte(0);
+      waited++;
+      assert(waited <= IR_MAC_DIFS + cw_max);
+    }
+    // Passed up again at high load, after traffic and the quiet it took.
+    assert(!mac.Persist(random));
+  }
+  assert(mac.GetStats().deferrals == 4);
+  printf("deferral: waits a quiet period after traffic, however long the "
+         "idle before\n");
+}
+
+struct Badge {
+  bool pending = false;
+  bool colliding = false;
+  size_t required = 0;
+  // The quiet before a deferral doesn't count, see IrMac::Persist().
+  size_t deferred_at = 0;
+  size_t wait_until = 0;
+  IrMac mac;
+};
+
+// The collision wait before IrMac, redrawn on every routine run.
+size_t FixedCollisionWait(std::mt19937 &rng) {
+  size_t wait = 0;
+  do {
+    wait++;
+  } while (wait < 32 + rng() % 64);
+  return wait;
+}
+
+// Frames per second that made it.
+double Goodput(size_t badge_cnt, bool use_mac, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<Badge> badges(badge_cnt);
+  size_t busy_end = 0;
+  size_t delivered = 0;
+  // Busy fraction with a low pass, roughly IrLogic::GetLoadFactor().
+  double busy_lp = 0;
+  std::vector<Badge *> senders;
+  for (size_t slot = 0; slot < kSlots; slot++) {
+    const size_t now = slot * kSlotBytes;
+    const int load = busy_lp * 100 * LF_MAX_SCALE;
+    senders.clear();
+    for (Badge &badge : badges) {
+      if (!badge.pending) {
+        if (rng() % kFrameInterval) continue;
+        badge.pending = true;
+        badge.required = use_mac ? badge.mac.QuietPeriod(rng()) : 0;
+      }
+      if (badge.colliding) {
+        if (now < badge.wait_until) continue;
+        badge.colliding = false;
+        badge.required = use_mac ? badge.mac.QuietPeriod(rng()) : 0;
+      }
+      if (!use_mac) badge.required = 20 + rng() % 32;
+      const size_t quiet_from = std::max(busy_end, badge.deferred_at);
+      if (now < quiet_from || now - quiet_from <= badge.required) continue;
+      if (!use_mac) {
+        senders.push_back(&badge);
+        continue;
+      }
+      badge.mac.SetLoad(load);
+      if (badge.mac.Persist(rng())) {
+        senders.push_back(&badge);
+      } else {
+        badge.required = badge.mac.QuietPeriod(rng());
+        badge.deferred_at = now;
+      }
+    }
+    if (senders.size() == 1) {
+      Badge &badge = *senders[0];
+      busy_end = now + kFrameBytes;
+      delivered++;
+      badge.pending = false;
+      if (use_mac) badge.mac.OnAck();
+    } else if (senders.size() > 1) {
+      busy_end = now + kDetectBytes;
+      for (Badge *badge : senders) {
+        const size_t ticks = use_mac ? badge->mac.OnCollision(rng())
+                                     : FixedCollisionWait(rng);
+        badge->colliding = true;
+        badge->wait_until = now + ticks * kTickBytes;
+      }
+    }
+    const size_t busy =
+        busy_end > now ? std::min(busy_end - now, kSlotBytes) : 0;
+    busy_lp += (static_cast<double>(busy) / kSlotBytes - busy_lp) / 32;
+  }
+  return static_cast<double>(delivered) / kSeconds;
+}
+
+void TestContention() {
+  const size_t counts[] = {1, 10, 30, 100, 300, 1000, 3000};
+  double mac_at_10 = 0;
+  printf("badges  frames/s  fixed waits  IrMac\n");
+  for (size_t n : counts) {
+    double fixed = 0, mac = 0;
+    for (uint32_t seed = 1; seed <= 3; seed++) {
+      fixed += Goodput(n, false, seed) / 3;
+      mac += Goodput(n, true, seed) / 3;
+    }
+    printf("%6zu  %8.1f  %11.2f  %5.2f\n", n, n / 10.0, fixed, mac);
+    if (n == 10) mac_at_10 = mac;
+    if (n >= 100) {
+      assert(mac > fixed);
+      assert(mac > mac_at_10 / 2);
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestBackoff();
+  TestPersistence();
+  TestDeferral();
+  TestContention();
+  printf("test-ir-mac PASSED.\n");
+  return 0;
+}
+
+#endif  // HITCON_TEST_MODE
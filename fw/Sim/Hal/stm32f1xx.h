@@ -0,0 +1,197 @@
+/*
+ * stm32f1xx.h
+ *
+ *  Host stand-in for the CMSIS device header. Peripheral instances are plain
+ *  structs owned by the simulator instead of memory mapped registers, and the
+ *  cycle counter reads the simulator's virtual clock.
+ */
+
+#ifndef HITCON_SIM_STM32F1XX_H_
+#define HITCON_SIM_STM32F1XX_H_
+
+#ifndef __cplusplus
+#error "The simulated HAL can only be used from C++"
+#endif
+
+#include <stdint.h>
+
+extern "C" {
+
+#define __IO volatile
+#define __I volatile const
+#define __O volatile
+
+#define SET_BIT(REG, BIT) ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT) ((REG) &= ~(BIT))
+#define READ_BIT(REG, BIT) ((REG) & (BIT))
+#define WRITE_REG(REG, VAL) ((REG) = (VAL))
+#define READ_REG(REG) ((REG))
+
+typedef enum {
+  EXTI3_IRQn = 9,
+  EXTI15_10_IRQn = 40,
+} IRQn_Type;
+
+typedef struct {
+  __IO uint32_t CRL;
+  __IO uint32_t CRH;
+  __IO uint32_t IDR;
+  __IO uint32_t ODR;
+  __IO uint32_t BSRR;
+  __IO uint32_t BRR;
+  __IO uint32_t LCKR;
+} GPIO_TypeDef;
+
+typedef struct {
+  __IO uint32_t CR1;
+  __IO uint32_t CR2;
+  __IO uint32_t SMCR;
+  __IO uint32_t DIER;
+  __IO uint32_t SR;
+  __IO uint32_t EGR;
+  __IO uint32_t CCMR1;
+  __IO uint32_t CCMR2;
+  __IO uint32_t CCER;
+  __IO uint32_t CNT;
+  __IO uint32_t PSC;
+  __IO uint32_t ARR;
+  __IO uint32_t RCR;
+  __IO uint32_t CCR1;
+  __IO uint32_t CCR2;
+  __IO uint32_t CCR3;
+  __IO uint32_t CCR4;
+  __IO uint32_t BDTR;
+  __IO uint32_t DCR;
+  __IO uint32_t DMAR;
+  __IO uint32_t OR;
+} TIM_TypeDef;
+
+typedef struct {
+  __IO uint32_t CR1;
+  __IO uint32_t CR2;
+  __IO uint32_t OAR1;
+  __IO uint32_t OAR2;
+  __IO uint32_t DR;
+  __IO uint32_t SR1;
+  __IO uint32_t SR2;
+  __IO uint32_t CCR;
+  __IO uint32_t TRISE;
+} I2C_TypeDef;
+
+typedef struct {
+  __IO uint32_t SR;
+  __IO uint32_t DR;
+  __IO uint32_t BRR;
+  __IO uint32_t CR1;
+  __IO uint32_t CR2;
+  __IO uint32_t CR3;
+  __IO uint32_t GTPR;
+} USART_TypeDef;
+
+typedef struct {
+  __IO uint32_t SR;
+  __IO uint32_t CR1;
+  __IO uint32_t CR2;
+  __IO uint32_t DR;
+} ADC_TypeDef;
+
+typedef struct {
+  __IO uint32_t DR;
+  __IO uint8_t IDR;
+  __IO uint32_t CR;
+} CRC_TypeDef;
+
+typedef struct {
+  __IO uint32_t CCR;
+  __IO uint32_t CNDTR;
+  __IO uint32_t CPAR;
+  __IO uint32_t CMAR;
+} DMA_Channel_TypeDef;
+
+// DWT->CYCCNT is the virtual cycle counter. Reading it is a point where the
+// simulator may deliver pending interrupts, just like on the real core.
+struct SimCycleCounter {
+  operator uint32_t() const;
+  SimCycleCounter &operator=(uint32_t value);
+};
+
+typedef struct {
+  __IO uint32_t CTRL;
+  SimCycleCounter CYCCNT;
+} DWT_Type;
+
+// SysTick->VAL counts down the virtual cycles of the current HAL_GetTick()
+// ms, as HAL_InitTick() sets it up on the badge.
+struct SimSysTickValue {
+  operator uint32_t() const;
+};
+
+typedef struct {
+  __IO uint32_t CTRL;
+  __IO uint32_t LOAD;
+  SimSysTickValue VAL;
+  __IO uint32_t CALIB;
+} SysTick_Type;
+
+typedef struct {
+  __IO uint32_t DHCSR;
+  __IO uint32_t DCRSR;
+  __IO uint32_t DCRDR;
+  __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define I2C_CR1_SWRST (1UL << 15)
+#define USART_SR_RXNE (1UL << 5)
+#define USART_SR_TC (1UL << 6)
+#define USART_SR_ORE (1UL << 3)
+
+#define FLASH_BASE 0x08000000UL
+#define FLASH_BANK1_END 0x0801FFFFUL
+
+extern GPIO_TypeDef sim_gpio[3];
+extern TIM_TypeDef sim_tim[4];
+extern I2C_TypeDef sim_i2c1;
+extern USART_TypeDef sim_usart2;
+extern ADC_TypeDef sim_adc1;
+extern CRC_TypeDef sim_crc;
+extern DMA_Channel_TypeDef sim_dma1_channel[7];
+extern DWT_Type sim_dwt;
+extern SysTick_Type sim_systick;
+extern CoreDebug_Type sim_core_debug;
+
+#define GPIOA (&sim_gpio[0])
+#define GPIOB (&sim_gpio[1])
+#define GPIOC (&sim_gpio[2])
+#define TIM1 (&sim_tim[0])
+#define TIM2 (&sim_tim[1])
+#define TIM3 (&sim_tim[2])
+#define TIM4 (&sim_tim[3])
+#define I2C1 (&sim_i2c1)
+#define USART2 (&sim_usart2)
+#define ADC1 (&sim_adc1)
+#define CRC (&sim_crc)
+#define DMA1_Channel1 (&sim_dma1_channel[0])
+#define DMA1_Channel2 (&sim_dma1_channel[1])
+#define DMA1_Channel3 (&sim_dma1_channel[2])
+#define DMA1_Channel4 (&sim_dma1_channel[3])
+#define DMA1_Channel5 (&sim_dma1_channel[4])
+#define DMA1_Channel6 (&sim_dma1_channel[5])
+#define DMA1_Channel7 (&sim_dma1_channel[6])
+#define DWT (&sim_dwt)
+#define SysTick (&sim_systick)
+#define CoreDebug (&sim_core_debug)
+
+extern uint32_t SystemCoreClock;
+
+// Core intrinsics. Masking interrupts holds back simulated interrupts, WFI
+// moves the virtual clock to the next one.
+void __disable_irq(void);
+void __enable_irq(void);
+void __WFI(void);
+void __NOP(void);
+
+}  // extern "C"
+
+#endif /* HITCON_SIM_STM32F1XX_H_ */
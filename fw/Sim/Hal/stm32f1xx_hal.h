@@ -0,0 +1,360 @@
+/*
+ * stm32f1xx_hal.h
+ *
+ *  Host stand-in for the STM32F1 HAL. Only the handles, constants and calls
+ *  that Core/Hitcon uses are provided, with the same names and layout as the
+ *  real driver so the firmware compiles unchanged. The implementations live
+ *  in fw/Sim/Sim and drive the simulated peripherals.
+ */
+
+#ifndef HITCON_SIM_STM32F1XX_HAL_H_
+#define HITCON_SIM_STM32F1XX_HAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stm32f1xx.h"
+
+extern "C" {
+
+typedef enum {
+  HAL_OK = 0x00U,
+  HAL_ERROR = 0x01U,
+  HAL_BUSY = 0x02U,
+  HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum { RESET = 0U, SET = !RESET } FlagStatus, ITStatus;
+
+typedef enum { HAL_UNLOCKED = 0x00U, HAL_LOCKED = 0x01U } HAL_LockTypeDef;
+
+#define __HAL_LINKDMA(__HANDLE__, __PPP_DMA_FIELD__, __DMA_HANDLE__) \
+  do {                                                                \
+    (__HANDLE__)->__PPP_DMA_FIELD__ = &(__DMA_HANDLE__);              \
+    (__DMA_HANDLE__).Parent = (__HANDLE__);                           \
+  } while (0U)
+
+void HAL_Init(void);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+
+/* GPIO --------------------------------------------------------------------*/
+
+#define GPIO_PIN_0 ((uint16_t)0x0001)
+#define GPIO_PIN_1 ((uint16_t)0x0002)
+#define GPIO_PIN_2 ((uint16_t)0x0004)
+#define GPIO_PIN_3 ((uint16_t)0x0008)
+#define GPIO_PIN_4 ((uint16_t)0x0010)
+#define GPIO_PIN_5 ((uint16_t)0x0020)
+#define GPIO_PIN_6 ((uint16_t)0x0040)
+#define GPIO_PIN_7 ((uint16_t)0x0080)
+#define GPIO_PIN_8 ((uint16_t)0x0100)
+#define GPIO_PIN_9 ((uint16_t)0x0200)
+#define GPIO_PIN_10 ((uint16_t)0x0400)
+#define GPIO_PIN_11 ((uint16_t)0x0800)
+#define GPIO_PIN_12 ((uint16_t)0x1000)
+#define GPIO_PIN_13 ((uint16_t)0x2000)
+#define GPIO_PIN_14 ((uint16_t)0x4000)
+#define GPIO_PIN_15 ((uint16_t)0x8000)
+#define GPIO_PIN_All ((uint16_t)0xFFFF)
+
+typedef enum { GPIO_PIN_RESET = 0u, GPIO_PIN_SET } GPIO_PinState;
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin,
+                       GPIO_PinState PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+
+/* DMA ---------------------------------------------------------------------*/
+
+#define DMA_PERIPH_TO_MEMORY 0x00000000U
+#define DMA_MEMORY_TO_PERIPH 0x00000010U
+#define DMA_PDATAALIGN_BYTE 0x00000000U
+#define DMA_PDATAALIGN_HALFWORD 0x00000100U
+#define DMA_PDATAALIGN_WORD 0x00000200U
+#define DMA_NORMAL 0x00000000U
+#define DMA_CIRCULAR 0x00000020U
+
+typedef struct {
+  uint32_t Direction;
+  uint32_t PeriphInc;
+  uint32_t MemInc;
+  uint32_t PeriphDataAlignment;
+  uint32_t MemDataAlignment;
+  uint32_t Mode;
+  uint32_t Priority;
+} DMA_InitTypeDef;
+
+typedef enum {
+  HAL_DMA_STATE_RESET = 0x00U,
+  HAL_DMA_STATE_READY = 0x01U,
+  HAL_DMA_STATE_BUSY = 0x02U,
+  HAL_DMA_STATE_TIMEOUT = 0x03U
+} HAL_DMA_StateTypeDef;
+
+typedef struct __DMA_HandleTypeDef {
+  DMA_Channel_TypeDef *Instance;
+  DMA_InitTypeDef Init;
+  HAL_LockTypeDef Lock;
+  HAL_DMA_StateTypeDef State;
+  void *Parent;
+  void (*XferCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+  void (*XferHalfCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+  void (*XferErrorCallback)(struct __DMA_HandleTypeDef *hdma);
+  void (*XferAbortCallback)(struct __DMA_HandleTypeDef *hdma);
+  uint32_t ErrorCode;
+} DMA_HandleTypeDef;
+
+// Addresses are uintptr_t rather than uint32_t so that they survive a 64 bit
+// host. The two are the same type on the badge.
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uintptr_t SrcAddress,
+                                   uintptr_t DstAddress, uint32_t DataLength);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma);
+
+/* TIM ---------------------------------------------------------------------*/
+
+#define TIM_CHANNEL_1 0x00000000U
+#define TIM_CHANNEL_2 0x00000004U
+#define TIM_CHANNEL_3 0x00000008U
+#define TIM_CHANNEL_4 0x0000000CU
+
+#define TIM_DMA_ID_UPDATE ((uint16_t)0x0000)
+#define TIM_DMA_ID_CC1 ((uint16_t)0x0001)
+#define TIM_DMA_ID_CC2 ((uint16_t)0x0002)
+#define TIM_DMA_ID_CC3 ((uint16_t)0x0003)
+#define TIM_DMA_ID_CC4 ((uint16_t)0x0004)
+#define TIM_DMA_ID_COMMUTATION ((uint16_t)0x0005)
+#define TIM_DMA_ID_TRIGGER ((uint16_t)0x0006)
+
+#define TIM_DMA_UPDATE (1UL << 8)
+#define TIM_DMA_CC1 (1UL << 9)
+#define TIM_DMA_CC2 (1UL << 10)
+#define TIM_DMA_CC3 (1UL << 11)
+#define TIM_DMA_CC4 (1UL << 12)
+
+#define TIM_COUNTERMODE_UP 0x00000000U
+
+typedef struct {
+  uint32_t Prescaler;
+  uint32_t CounterMode;
+  uint32_t Period;
+  uint32_t ClockDivision;
+  uint32_t RepetitionCounter;
+  uint32_t AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef enum {
+  HAL_TIM_STATE_RESET = 0x00U,
+  HAL_TIM_STATE_READY = 0x01U,
+  HAL_TIM_STATE_BUSY = 0x02U
+} HAL_TIM_StateTypeDef;
+
+typedef struct __TIM_HandleTypeDef {
+  TIM_TypeDef *Instance;
+  TIM_Base_InitTypeDef Init;
+  uint32_t Channel;
+  DMA_HandleTypeDef *hdma[7];
+  HAL_LockTypeDef Lock;
+  HAL_TIM_StateTypeDef State;
+} TIM_HandleTypeDef;
+
+#define __HAL_TIM_ENABLE_DMA(__HANDLE__, __DMA__) \
+  ((__HANDLE__)->Instance->DIER |= (__DMA__))
+#define __HAL_TIM_DISABLE_DMA(__HANDLE__, __DMA__) \
+  ((__HANDLE__)->Instance->DIER &= ~(__DMA__))
+#define __HAL_TIM_SET_COMPARE(__HANDLE__, __CHANNEL__, __COMPARE__) \
+  (*(&(__HANDLE__)->Instance->CCR1 + ((__CHANNEL__) >> 2U)) = (__COMPARE__))
+#define __HAL_TIM_GET_COMPARE(__HANDLE__, __CHANNEL__) \
+  (*(&(__HANDLE__)->Instance->CCR1 + ((__CHANNEL__) >> 2U)))
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop_DMA(TIM_HandleTypeDef *htim,
+                                       uint32_t Channel);
+void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef *htim);
+
+/* I2C ---------------------------------------------------------------------*/
+
+#define I2C_MEMADD_SIZE_8BIT 0x00000001U
+#define I2C_MEMADD_SIZE_16BIT 0x00000010U
+
+#define I2C_FLAG_BUSY 0x00100002U
+
+#define HAL_I2C_ERROR_NONE 0x00000000U
+#define HAL_I2C_ERROR_AF 0x00000004U
+
+typedef struct {
+  uint32_t ClockSpeed;
+  uint32_t DutyCycle;
+  uint32_t OwnAddress1;
+  uint32_t AddressingMode;
+  uint32_t DualAddressMode;
+  uint32_t OwnAddress2;
+  uint32_t GeneralCallMode;
+  uint32_t NoStretchMode;
+} I2C_InitTypeDef;
+
+typedef enum {
+  HAL_I2C_STATE_RESET = 0x00U,
+  HAL_I2C_STATE_READY = 0x20U,
+  HAL_I2C_STATE_BUSY = 0x24U,
+  HAL_I2C_STATE_BUSY_TX = 0x21U,
+  HAL_I2C_STATE_BUSY_RX = 0x22U
+} HAL_I2C_StateTypeDef;
+
+typedef struct __I2C_HandleTypeDef {
+  I2C_TypeDef *Instance;
+  I2C_InitTypeDef Init;
+  uint8_t *pBuffPtr;
+  uint16_t XferSize;
+  HAL_LockTypeDef Lock;
+  HAL_I2C_StateTypeDef State;
+  uint32_t ErrorCode;
+  void (*MasterTxCpltCallback)(struct __I2C_HandleTypeDef *hi2c);
+  void (*MasterRxCpltCallback)(struct __I2C_HandleTypeDef *hi2c);
+  void (*MemTxCpltCallback)(struct __I2C_HandleTypeDef *hi2c);
+  void (*MemRxCpltCallback)(struct __I2C_HandleTypeDef *hi2c);
+  void (*ErrorCallback)(struct __I2C_HandleTypeDef *hi2c);
+} I2C_HandleTypeDef;
+
+typedef enum {
+  HAL_I2C_MASTER_TX_COMPLETE_CB_ID = 0x00U,
+  HAL_I2C_MASTER_RX_COMPLETE_CB_ID = 0x01U,
+  HAL_I2C_SLAVE_TX_COMPLETE_CB_ID = 0x02U,
+  HAL_I2C_SLAVE_RX_COMPLETE_CB_ID = 0x03U,
+  HAL_I2C_LISTEN_COMPLETE_CB_ID = 0x04U,
+  HAL_I2C_MEM_TX_COMPLETE_CB_ID = 0x05U,
+  HAL_I2C_MEM_RX_COMPLETE_CB_ID = 0x06U,
+  HAL_I2C_ERROR_CB_ID = 0x07U,
+  HAL_I2C_ABORT_CB_ID = 0x08U
+} HAL_I2C_CallbackIDTypeDef;
+
+typedef void (*pI2C_CallbackTypeDef)(I2C_HandleTypeDef *hi2c);
+
+#define __HAL_I2C_GET_FLAG(__HANDLE__, __FLAG__)                      \
+  ((((uint8_t)((__FLAG__) >> 16U)) == 0x01U)                          \
+       ? (((((__HANDLE__)->Instance->SR1) & ((__FLAG__) & 0xFFFFU)) == \
+           ((__FLAG__) & 0xFFFFU))                                    \
+              ? SET                                                   \
+              : RESET)                                                \
+       : (((((__HANDLE__)->Instance->SR2) & ((__FLAG__) & 0xFFFFU)) == \
+           ((__FLAG__) & 0xFFFFU))                                    \
+              ? SET                                                   \
+              : RESET))
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_RegisterCallback(I2C_HandleTypeDef *hi2c,
+                                           HAL_I2C_CallbackIDTypeDef CallbackID,
+                                           pI2C_CallbackTypeDef pCallback);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c,
+                                       uint16_t DevAddress, uint16_t MemAddress,
+                                       uint16_t MemAddSize, uint8_t *pData,
+                                       uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c,
+                                      uint16_t DevAddress, uint16_t MemAddress,
+                                      uint16_t MemAddSize, uint8_t *pData,
+                                      uint16_t Size);
+
+/* UART --------------------------------------------------------------------*/
+
+typedef enum {
+  HAL_UART_STATE_RESET = 0x00U,
+  HAL_UART_STATE_READY = 0x20U,
+  HAL_UART_STATE_BUSY = 0x24U,
+  HAL_UART_STATE_BUSY_TX = 0x21U,
+  HAL_UART_STATE_BUSY_RX = 0x22U,
+  HAL_UART_STATE_ERROR = 0xE0U
+} HAL_UART_StateTypeDef;
+
+#define HAL_UART_ERROR_NONE 0x00000000U
+#define HAL_UART_ERROR_ORE 0x00000008U
+
+typedef struct {
+  uint32_t BaudRate;
+  uint32_t WordLength;
+  uint32_t StopBits;
+  uint32_t Parity;
+  uint32_t Mode;
+  uint32_t HwFlowCtl;
+  uint32_t OverSampling;
+} UART_InitTypeDef;
+
+typedef struct __UART_HandleTypeDef {
+  USART_TypeDef *Instance;
+  UART_InitTypeDef Init;
+  const uint8_t *pTxBuffPtr;
+  uint16_t TxXferSize;
+  __IO uint16_t TxXferCount;
+  uint8_t *pRxBuffPtr;
+  uint16_t RxXferSize;
+  __IO uint16_t RxXferCount;
+  HAL_LockTypeDef Lock;
+  __IO HAL_UART_StateTypeDef gState;
+  __IO HAL_UART_StateTypeDef RxState;
+  __IO uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart,
+                                       const uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart,
+                                      uint8_t *pData, uint16_t Size);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+void HAL_UART_AbortCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_AbortReceiveCpltCallback(UART_HandleTypeDef *huart);
+
+/* ADC ---------------------------------------------------------------------*/
+
+typedef struct __ADC_HandleTypeDef {
+  ADC_TypeDef *Instance;
+  HAL_LockTypeDef Lock;
+  __IO uint32_t State;
+  __IO uint32_t ErrorCode;
+  void (*ConvCpltCallback)(struct __ADC_HandleTypeDef *hadc);
+} ADC_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_ADC_Start_IT(ADC_HandleTypeDef *hadc);
+uint32_t HAL_ADC_GetValue(ADC_HandleTypeDef *hadc);
+
+/* CRC ---------------------------------------------------------------------*/
+
+typedef struct {
+  CRC_TypeDef *Instance;
+  HAL_LockTypeDef Lock;
+  __IO uint32_t State;
+} CRC_HandleTypeDef;
+
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[],
+                           uint32_t BufferLength);
+
+/* FLASH -------------------------------------------------------------------*/
+
+#define FLASH_PAGE_SIZE 0x400U
+#define FLASH_TYPEERASE_PAGES 0x00U
+#define FLASH_TYPEERASE_MASSERASE 0x02U
+#define FLASH_TYPEPROGRAM_HALFWORD 0x01U
+#define FLASH_TYPEPROGRAM_WORD 0x02U
+#define FLASH_TYPEPROGRAM_DOUBLEWORD 0x03U
+
+typedef struct {
+  uint32_t TypeErase;
+  uint32_t Banks;
+  uint32_t PageAddress;
+  uint32_t NbPages;
+} FLASH_EraseInitTypeDef;
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASHEx_Erase_IT(FLASH_EraseInitTypeDef *pEraseInit);
+HAL_StatusTypeDef HAL_FLASH_Program_IT(uint32_t TypeProgram, uint32_t Address,
+                                       uint64_t Data);
+void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue);
+void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue);
+
+}  // extern "C"
+
+#endif /* HITCON_SIM_STM32F1XX_HAL_H_ */
@@ -0,0 +1,12 @@
+/*
+ * stm32f1xx_hal_i2c.h
+ *
+ *  The simulated HAL declares every module in stm32f1xx_hal.h.
+ */
+
+#ifndef HITCON_SIM_STM32F1XX_HAL_I2C_H_
+#define HITCON_SIM_STM32F1XX_HAL_I2C_H_
+
+#include "stm32f1xx_hal.h"
+
+#endif /* HITCON_SIM_STM32F1XX_HAL_I2C_H_ */
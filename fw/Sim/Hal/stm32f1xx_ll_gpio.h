@@ -0,0 +1,14 @@
+/*
+ * stm32f1xx_ll_gpio.h
+ *
+ *  Pin remapping has no effect on the simulated peripherals.
+ */
+
+#ifndef HITCON_SIM_STM32F1XX_LL_GPIO_H_
+#define HITCON_SIM_STM32F1XX_LL_GPIO_H_
+
+#include "stm32f1xx.h"
+
+static inline void LL_GPIO_AF_RemapPartial2_TIM2(void) {}
+
+#endif /* HITCON_SIM_STM32F1XX_LL_GPIO_H_ */
@@ -0,0 +1,51 @@
+#include <Net/Air.h>
+
+#include <algorithm>
+
+namespace hitcon {
+namespace net {
+
+Air::Air() : ring_(kBuckets) {}
+
+int Air::AddTransmitter() {
+  marked_.push_back(-1);
+  return marked_.size() - 1;
+}
+
+void Air::Emit(int tx, uint64_t begin, uint64_t end) {
+  if (end <= begin) return;
+  int64_t first = std::max<int64_t>(begin / kBucketCycles, marked_[tx] + 1);
+  int64_t last = (end - 1) / kBucketCycles;
+  first = std::max<int64_t>(first, retired_);
+  if (last >= static_cast<int64_t>(retired_ + kBuckets)) {
+    stats_.overruns++;
+    last = retired_ + kBuckets - 1;
+  }
+  for (int64_t b = first; b <= last; b++) ring_[b % kBuckets]++;
+  marked_[tx] = std::max(marked_[tx], last);
+}
+
+bool Air::Carrier(uint64_t at) {
+  if (at > read_limit_) stats_.late_reads++;
+  uint64_t b = at / kBucketCycles;
+  if (b < retired_) {
+    stats_.stale_reads++;
+    return false;
+  }
+  if (b >= retired_ + kBuckets) return false;
+  return ring_[b % kBuckets] != 0;
+}
+
+void Air::Retire(uint64_t floor) {
+  uint64_t until = floor / kBucketCycles;
+  for (; retired_ < until; retired_++) {
+    uint16_t &count = ring_[retired_ % kBuckets];
+    stats_.buckets++;
+    if (count) stats_.busy++;
+    if (count > 1) stats_.overlap++;
+    count = 0;
+  }
+}
+
+}  // namespace net
+}  // namespace hitcon
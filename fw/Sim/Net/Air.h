@@ -0,0 +1,72 @@
+/*
+ * Air.h
+ *
+ *  The IR medium shared by the badges of one cell. Every transmitter in a
+ *  cell reaches every receiver in it, so the medium only needs to know how
+ *  many transmitters have their carrier on at any time: one is a signal, two
+ *  or more is a collision, none is quiet.
+ *
+ *  Time is in cycles of the network clock and cut into buckets of
+ *  kBucketCycles, a fraction of the receivers' sample period. Transmitters
+ *  announce their waveform a little ahead (see Dma::SetLookahead()) and
+ *  receivers sample it slightly behind, the buckets in between live in a
+ *  ring.
+ */
+
+#ifndef HITCON_NET_AIR_H_
+#define HITCON_NET_AIR_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace hitcon {
+namespace net {
+
+class Air {
+ public:
+  static constexpr unsigned kBucketCycles = 128;
+  static constexpr unsigned kBuckets = 1 << 18;
+
+  struct Stats {
+    // Buckets retired with the carrier on, and with more than one on.
+    uint64_t busy;
+    uint64_t overlap;
+    uint64_t buckets;
+    // Samples taken ahead of what every transmitter has announced, or after
+    // the bucket was retired. Either is a bug in the network's scheduling.
+    uint64_t late_reads;
+    uint64_t stale_reads;
+    // Waveform dropped because it was too far ahead of the ring.
+    uint64_t overruns;
+  };
+
+  Air();
+
+  int AddTransmitter();
+  // Transmitter `tx` has its carrier on over [begin, end). Calls of one
+  // transmitter must come in order.
+  void Emit(int tx, uint64_t begin, uint64_t end);
+  // Whether anyone's carrier is on at `at`.
+  bool Carrier(uint64_t at);
+
+  // Reads beyond `limit` count as late, see Stats.
+  void SetReadLimit(uint64_t limit) { read_limit_ = limit; }
+  // Nobody will read or write before `floor` anymore.
+  void Retire(uint64_t floor);
+
+  const Stats &GetStats() const { return stats_; }
+
+ private:
+  std::vector<uint16_t> ring_;
+  // Last bucket each transmitter has marked, so that elements sharing a
+  // bucket only count once.
+  std::vector<int64_t> marked_;
+  uint64_t retired_ = 0;
+  uint64_t read_limit_ = UINT64_MAX;
+  Stats stats_ = {};
+};
+
+}  // namespace net
+}  // namespace hitcon
+
+#endif  // HITCON_NET_AIR_H_
@@ -0,0 +1,206 @@
+#include <Logic/IrController.h>
+#include <Logic/IrFec.h>
+#include <Logic/crc32.h>
+#include <Logic/keccak.h>
+#include <Net/BaseStation.h>
+#include <Service/IrParam.h>
+
+#include <cstring>
+
+using namespace hitcon::ir;
+
+namespace hitcon {
+namespace net {
+
+namespace {
+
+uint8_t MergeChksum(uint32_t x) {
+  return x ^ (x >> 8) ^ (x >> 16) ^ (x >> 24);
+}
+
+bool ChecksumValid(const IrPacket &packet) {
+  return MergeChksum(crc32(packet.data_, packet.size_ - 1)) ==
+         packet.data_[packet.size_ - 1];
+}
+
+constexpr size_t kSamplesPerBuffer = IR_SERVICE_RX_ON_BUFFER_SIZE * 8;
+
+}  // namespace
+
+BaseStation::BaseStation(Air *air, const Options &options)
+    : air_(air),
+      options_(options),
+      tx_(air->AddTransmitter()),
+      next_sample_(options.phase),
+      rng_(options.seed | 1),
+      ber_threshold_(static_cast<uint64_t>(options.ber * 18446744073709551615.0)),
+      required_quiet_(20) {
+  decoder_.SetSoftDecision(IR_RX_SOFT_DECISION);
+}
+
+uint64_t BaseStation::NextRandom() {
+  rng_ ^= rng_ << 13;
+  rng_ ^= rng_ >> 7;
+  rng_ ^= rng_ << 17;
+  return rng_;
+}
+
+void BaseStation::Run(uint64_t until) {
+  for (; next_sample_ < until; next_sample_ += options_.sample_period) {
+    uint64_t at = next_sample_;
+    bool on = Sample(at);
+    byte_ |= on << (sample_count_ % 8);
+    sample_count_++;
+    if (sample_count_ % 8 == 0) {
+      Decode(at, byte_);
+      quiet_bytes_ = byte_ ? 0 : quiet_bytes_ + 1;
+      byte_ = 0;
+      MaybeTransmit(at);
+    }
+  }
+}
+
+bool BaseStation::Sample(uint64_t at) {
+  bool on = air_->Carrier(at);
+  if (ber_threshold_ && NextRandom() < ber_threshold_) on = !on;
+  return on;
+}
+
+void BaseStation::Decode(uint64_t at, uint8_t samples) {
+  if ((sample_count_ - 8) % kSamplesPerBuffer == 0) drop_buffer_ = false;
+  if (drop_buffer_) return;
+  uint8_t events = decoder_.Decode(samples);
+  if (events & IrDecoder::kHeader) {
+    stats_.headers++;
+    in_frame_ = true;
+  }
+  if ((events & IrDecoder::kFrame) && decoder_.Repair(&ChecksumValid)) {
+    in_frame_ = false;
+    OnPacket(at);
+  }
+  if (events & IrDecoder::kIdle) {
+    if (in_frame_) stats_.bad++;
+    in_frame_ = false;
+  }
+  if (events & IrDecoder::kDropBuffer) drop_buffer_ = true;
+}
+
+void BaseStation::OnPacket(uint64_t at) {
+  stats_.packets++;
+  // Without the size and checksum bytes.
+  const IrPacket &frame = decoder_.Frame();
+  const uint8_t *payload = frame.data_ + 1;
+  size_t len = frame.size_ - 2;
+  // Acks aren't acked.
+  if (len >= IR_DATA_HEADER_SIZE &&
+      (payload[1] == static_cast<uint8_t>(packet_type::kAcknowledge) ||
+       payload[1] == static_cast<uint8_t>(packet_type::kAcknowledgeBatch))) {
+    return;
+  }
+  Ack ack = {at + options_.ack_delay, {}};
+  if (options_.ack_by_id && (payload[0] & IR_TTL_ACK_BY_ID)) {
+    const uint32_t crc = crc32(payload, len);
+    memcpy(ack.hash, &crc, sizeof(crc));
+    ack.hash[4] = payload[0];
+    ack.hash[5] = len;
+  } else {
+    uint8_t digest[SHA3_256_HASH_SIZE];
+    sha3_HashBuffer(256, SHA3_FLAGS_NONE, payload, len, digest,
+                    sizeof(digest));
+    memcpy(ack.hash, digest, PACKET_HASH_LEN);
+  }
+  acks_.push_back(ack);
+
+  // The same packet numbered again is still the same packet.
+  uint8_t digest[SHA3_256_HASH_SIZE];
+  sha3_HashBuffer(256, SHA3_FLAGS_NONE, payload + 1, len - 1, digest,
+                  sizeof(digest));
+  uint64_t key = 0;
+  memcpy(&key, digest, sizeof(key));
+  if (seen_.insert(key).second) {
+    stats_.unique++;
+    stats_.unique_bytes += len;
+  }
+}
+
+void BaseStation::MaybeTransmit(uint64_t at) {
+  if (acks_.empty() || acks_.front().ready_at > at || at < tx_busy_until_) {
+    return;
+  }
+  // Hold on to a partial batch for a while for more acks to join it.
+  if (acks_.size() < options_.ack_batch &&
+      acks_.front().ready_at + options_.ack_hold > at) {
+    return;
+  }
+  if (quiet_bytes_ <= required_quiet_) return;
+  required_quiet_ = 20 + NextRandom() % 32;
+
+  size_t count = 1;
+  while (count < options_.ack_batch && count < acks_.size() &&
+         acks_[count].ready_at <= at) {
+    count++;
+  }
+  IrData data = {};
+  data.ttl = options_.ack_by_id ? IR_TTL_ACK_BY_ID : 0;
+  size_t len;
+  if (count == 1) {
+    data.type = packet_type::kAcknowledge;
+    memcpy(data.opaq.acknowledge.packet_hash, acks_.front().hash,
+           PACKET_HASH_LEN);
+    len = IR_DATA_HEADER_SIZE + sizeof(AcknowledgePacket);
+  } else {
+    data.type = packet_type::kAcknowledgeBatch;
+    data.opaq.acknowledge_batch.count = count;
+    for (size_t i = 0; i < count; i++) {
+      memcpy(data.opaq.acknowledge_batch.packet_hash[i], acks_[i].hash,
+             ACK_BATCH_HASH_LEN);
+    }
+    len = IR_DATA_HEADER_SIZE + 1 + count * ACK_BATCH_HASH_LEN;
+  }
+  acks_.erase(acks_.begin(), acks_.begin() + count);
+  Transmit(at + options_.turnaround, reinterpret_cast<uint8_t *>(&data), len);
+  stats_.acks_sent++;
+  stats_.acked += count;
+}
+
+void BaseStation::Transmit(uint64_t at, const uint8_t *data, size_t len) {
+  // Same framing as IrLogic::EncodePacket() and EncodeFecPacket(), and
+  // pulses as IrService::PopulateTxDmaBuffer().
+  uint8_t packet[MAX_PACKET_PAYLOAD_BYTES + 2 + IR_FEC_OVERHEAD];
+  packet[0] = len + 2;
+  memcpy(packet + 1, data, len);
+  packet[len + 1] = MergeChksum(crc32(packet, len + 1));
+  size_t size = len + 2;
+  if (options_.fec) {
+    fec::RsEncode(packet, size, packet + size);
+    memmove(packet + 2, packet + 1, size - 1 + IR_FEC_PARITY_BYTES);
+    packet[0] = fec::HammingEncode(size);
+    packet[1] = fec::HammingEncode(size >> 4);
+    size += IR_FEC_OVERHEAD;
+  }
+
+  std::vector<bool> pulses;
+  const uint8_t *header = options_.fec ? IR_PACKET_HEADER_FEC : IR_PACKET_HEADER;
+  for (size_t i = 0; i < IR_PACKET_HEADER_SIZE; i++) {
+    pulses.insert(pulses.end(), PULSE_PER_HEADER_BIT, header[i]);
+  }
+  for (size_t i = 0; i < size * 8; i++) {
+    pulses.insert(pulses.end(), PULSE_PER_DATA_BIT,
+                  (packet[i / 8] >> (i % 8)) & 1);
+  }
+  uint64_t period = options_.pulse_period;
+  for (size_t i = 0; i < pulses.size();) {
+    if (!pulses[i]) {
+      i++;
+      continue;
+    }
+    size_t j = i;
+    while (j < pulses.size() && pulses[j]) j++;
+    air_->Emit(tx_, at + i * period, at + j * period);
+    i = j;
+  }
+  tx_busy_until_ = at + pulses.size() * period;
+}
+
+}  // namespace net
+}  // namespace hitcon
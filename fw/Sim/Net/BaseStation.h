@@ -0,0 +1,117 @@
+/*
+ * BaseStation.h
+ *
+ *  The receiving end of a cell: listens to the air the way a badge does,
+ *  acknowledges every good packet the way the base station backend does
+ *  (kAcknowledge with the first PACKET_HASH_LEN bytes of the payload's
+ *  SHA3-256, or its ID if the badge asked for IR_TTL_ACK_BY_ID) and sends
+ *  the ack over the air again, after carrier sense.
+ *  Acks that are ready at the same time go out together in a
+ *  kAcknowledgeBatch, like the base station does.
+ */
+
+#ifndef HITCON_NET_BASE_STATION_H_
+#define HITCON_NET_BASE_STATION_H_
+
+#include <Logic/IrDecoder.h>
+#include <Net/Air.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_set>
+#include <vector>
+
+namespace hitcon {
+namespace net {
+
+class BaseStation {
+ public:
+  struct Options {
+    // Cycles between two samples, and the offset of the first one.
+    uint64_t sample_period;
+    uint64_t phase;
+    // Cycles of one carrier pulse on the transmit side.
+    uint64_t pulse_period;
+    // From the end of a packet to its ack being ready, like the round trip
+    // over the cross board link and the backend.
+    uint64_t ack_delay;
+    // From deciding the air is quiet to the first pulse.
+    uint64_t turnaround;
+    double ber;
+    uint64_t seed;
+    // Send acks with forward error correction.
+    bool fec;
+    // Most packets acknowledged by one ack, 1 for a kAcknowledge each, and
+    // how long to wait for a batch to fill up.
+    size_t ack_batch;
+    uint64_t ack_hold;
+    // Knows packet IDs, like a base station from before them if not.
+    bool ack_by_id;
+  };
+
+  struct Stats {
+    uint64_t headers;
+    uint64_t packets;
+    uint64_t bad;
+    // Packets not seen before, apart from the ttl byte.
+    uint64_t unique;
+    uint64_t unique_bytes;
+    uint64_t acks_sent;
+    // Packets acknowledged by them.
+    uint64_t acked;
+  };
+
+  BaseStation(Air *air, const Options &options);
+
+  // Take every sample before `until`. The air must be complete up to there.
+  void Run(uint64_t until);
+  // Samples before this have been taken.
+  uint64_t Heard() const { return next_sample_; }
+  // Nothing this base station sends starts before this.
+  uint64_t Horizon() const { return next_sample_ + options_.turnaround; }
+
+  const Stats &GetStats() const { return stats_; }
+
+ private:
+  struct Ack {
+    uint64_t ready_at;
+    uint8_t hash[6];
+  };
+
+  bool Sample(uint64_t at);
+  // Feed a byte of samples to the decoder the way IrLogic does.
+  void Decode(uint64_t at, uint8_t samples);
+  void OnPacket(uint64_t at);
+  void MaybeTransmit(uint64_t at);
+  void Transmit(uint64_t at, const uint8_t *data, size_t len);
+  uint64_t NextRandom();
+
+  Air *air_;
+  Options options_;
+  int tx_;
+  ir::IrDecoder decoder_;
+  // IrLogic gives up on the rest of its receive buffer after a bad bit in
+  // the size field, and so do we until the next buffer.
+  bool drop_buffer_ = false;
+  // A header was seen and no good frame after it yet.
+  bool in_frame_ = false;
+  uint64_t next_sample_;
+  uint64_t sample_count_ = 0;
+  uint64_t rng_;
+  uint64_t ber_threshold_;
+  // Samples of the current byte, and consecutive quiet bytes, see
+  // IrService::PullRxDmaBuffer().
+  uint8_t byte_ = 0;
+  unsigned quiet_bytes_ = 0;
+  unsigned required_quiet_;
+  uint64_t tx_busy_until_ = 0;
+  std::deque<Ack> acks_;
+  std::unordered_set<uint64_t> seen_;
+  Stats stats_ = {};
+};
+
+}  // namespace net
+}  // namespace hitcon
+
+#endif  // HITCON_NET_BASE_STATION_H_
@@ -0,0 +1,489 @@
+#include <Hitcon.h>
+#include <Logic/IrController.h>
+#include <Net/Network.h>
+#include <Service/IrService.h>
+#include <Service/Sched/Scheduler.h>
+#include <Sim/Board.h>
+#include <Sim/Flash.h>
+#include <Sim/Machine.h>
+#include <Sim/Peripherals.h>
+#include <Sim/Uart.h>
+#include <main.h>
+#include <sys/mman.h>
+#include <tim.h>
+#include <unistd.h>
+#include <usart.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace hitcon::ir;
+using namespace hitcon::sim;
+using hitcon::service::sched::scheduler;
+using hitcon::service::sched::Task;
+using hitcon::service::sched::task_callback_t;
+
+namespace hitcon {
+namespace net {
+
+namespace {
+
+constexpr size_t kStackSize = 256 * 1024;
+// Above the traffic of the firmware's own apps, below IR and display.
+constexpr unsigned kTrafficPriority = 960;
+// More than a badge overshoots its end time by, see Machine::Poll().
+constexpr uint64_t kInterruptGuard = 256;
+
+uint64_t MsToCycles(double ms) {
+  return static_cast<uint64_t>(ms * Machine::kCyclesPerMs);
+}
+
+uint64_t BerThreshold(double ber) {
+  return static_cast<uint64_t>(ber * 18446744073709551615.0);
+}
+
+void PrintLatency(const char *name, std::vector<uint32_t> &ms) {
+  if (ms.empty()) {
+    printf("  %-14s none\n", name);
+    return;
+  }
+  std::sort(ms.begin(), ms.end());
+  auto at = [&ms](double q) { return ms[static_cast<size_t>(q * (ms.size() - 1))]; };
+  printf("  %-14s p50 %u ms, p90 %u ms, p99 %u ms, max %u ms\n", name,
+         at(0.5), at(0.9), at(0.99), ms.back());
+}
+
+void PrintHistogram(const std::vector<uint32_t> &ms) {
+  // Log2 buckets of milliseconds, ms is sorted.
+  size_t i = 0;
+  for (uint32_t bucket = 1; i < ms.size(); bucket <<= 1) {
+    size_t n = 0;
+    while (i < ms.size() && ms[i] < bucket) i++, n++;
+    if (!n) continue;
+    printf("    < %6u ms %8zu %5.1f%%\n", bucket, n, 100.0 * n / ms.size());
+  }
+}
+
+}  // namespace
+
+Network::Network(const Options &options)
+    : options_(options),
+      end_(MsToCycles(options.seconds * 1000)) {}
+
+bool Network::Init() {
+  if (!Snapshot::Locate(&g_machine)) {
+    fprintf(stderr, "can't find the firmware library's data segment\n");
+    return false;
+  }
+  flash_fd_ = memfd_create("hitcon-net-flash", 0);
+  if (flash_fd_ < 0 ||
+      ftruncate(flash_fd_, static_cast<off_t>(Flash::kSize) * options_.badges)) {
+    perror("flash");
+    return false;
+  }
+  // Everything from here on is per badge.
+  pristine_ = std::make_unique<Snapshot>();
+
+  // The carrier and sample timing come from the board's timers.
+  if (!InitBoard(flash_fd_, 0)) return false;
+  pulse_period_ = static_cast<uint64_t>(htim3.Init.Prescaler + 1) *
+                  (htim3.Init.Period + 1);
+  sample_period_ = pulse_period_ * (htim2.Init.Prescaler + 1) *
+                   (htim2.Init.Period + 1);
+  pristine_->Restore();
+
+  uint64_t rng = options_.seed * 0x9E3779B97F4A7C15ULL + 1;
+  cells_.resize(options_.cells);
+  for (unsigned c = 0; c < options_.cells; c++) {
+    Cell &cell = cells_[c];
+    cell.air = std::make_unique<Air>();
+    BaseStation::Options bs = {};
+    bs.sample_period = sample_period_;
+    bs.phase = NextRandom(rng) % sample_period_;
+    bs.pulse_period = pulse_period_;
+    bs.ack_delay = MsToCycles(options_.ack_delay_ms);
+    bs.turnaround = MsToCycles(options_.turnaround_ms);
+    bs.ber = options_.ber;
+    bs.seed = NextRandom(rng);
+    bs.fec = options_.fec;
+    bs.ack_batch = options_.ack_batch;
+    bs.ack_hold = MsToCycles(options_.ack_batch > 1 ? options_.ack_hold_ms : 0);
+    bs.ack_by_id = options_.ack_by_id;
+    cell.base_station = std::make_unique<BaseStation>(cell.air.get(), bs);
+  }
+  if (!options_.turnaround_ms) {
+    fprintf(stderr, "turnaround can't be 0\n");
+    return false;
+  }
+
+  uint64_t stagger = MsToCycles(options_.stagger_ms);
+  for (unsigned i = 0; i < options_.badges; i++) {
+    auto badge = std::make_unique<Badge>();
+    badge->network = this;
+    badge->id = i;
+    badge->cell = i % options_.cells;
+    badge->tx = cells_[badge->cell].air->AddTransmitter();
+    badge->offset = stagger ? NextRandom(rng) % stagger : 0;
+    badge->now = badge->offset;
+    badge->announced = badge->offset;
+    badge->rng = NextRandom(rng);
+    badge->ber_threshold = BerThreshold(options_.ber);
+    badge->stack = mmap(nullptr, kStackSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+                        -1, 0);
+    if (badge->stack == MAP_FAILED) {
+      perror("stack");
+      return false;
+    }
+    cells_[badge->cell].badges.push_back(badge.get());
+    badges_.push_back(std::move(badge));
+  }
+  return true;
+}
+
+uint64_t Network::NextRandom(uint64_t &state) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+uint64_t Network::Now() const {
+  return current_ ? current_->offset + g_machine.Now() : 0;
+}
+
+void Network::BadgeMain(unsigned hi, unsigned lo) {
+  Badge *badge = reinterpret_cast<Badge *>(
+      (static_cast<uintptr_t>(hi) << 32) | static_cast<uintptr_t>(lo));
+  badge->network->Boot(badge);
+  hitcon_run();
+}
+
+void Network::Boot(Badge *badge) {
+  g_machine.SetOnEnd([this]() { Yield(); });
+  InitBoard(flash_fd_, static_cast<off_t>(Flash::kSize) * badge->id);
+  SetAdcSeed(badge->rng);
+  g_uart.Init(&huart2, false);
+  irLogic.SetFec(options_.fec);
+  if (options_.set_prob) {
+    irController.SetProbParams(options_.prob[0], options_.prob[1],
+                               options_.prob[2]);
+  }
+  if (options_.set_retx) {
+    irController.SetRetransmitTiming(options_.retx_base, options_.retx_jitter);
+  }
+
+  Air *air = cells_[badge->cell].air.get();
+  uint64_t period = pulse_period_;
+  g_bus.OnWrite(&htim3.Instance->CCR3, [air, badge, period](uint32_t value,
+                                                             uint64_t at) {
+    uint64_t begin = badge->offset + at;
+    if (value) air->Emit(badge->tx, begin, begin + period);
+    badge->announced = std::max(badge->announced, begin + period);
+  });
+  g_dma.SetLookahead(&hdma_tim3_ch3, true);
+  // The receiver is active low.
+  g_gpio.SetSource(IrRx_GPIO_Port, IrRx_Pin, [air, badge](uint64_t at) {
+    // Others, like the button DMA, read the port at any time and don't look
+    // at this pin.
+    if (g_dma.Transferring() != &hdma_tim2_ch3) return true;
+    bool carrier = air->Carrier(badge->offset + at);
+    if (badge->ber_threshold &&
+        NextRandom(badge->rng) < badge->ber_threshold) {
+      carrier = !carrier;
+    }
+    return !carrier;
+  });
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpmf-conversions"
+  badge->traffic = new Task(kTrafficPriority,
+                            (task_callback_t)&Network::SendTraffic, badge);
+#pragma GCC diagnostic pop
+  if (options_.rate > 0) ScheduleTraffic(badge);
+}
+
+void Network::Yield() { swapcontext(&current_->context, &driver_); }
+
+void Network::ScheduleTraffic(Badge *badge) {
+  double u = (NextRandom(badge->rng) >> 11) * 0x1.0p-53;
+  double minutes = -std::log1p(-u) / options_.rate;
+  g_machine.Schedule(g_machine.Now() + MsToCycles(minutes * 60000),
+                     [badge]() { scheduler.Queue(badge->traffic, nullptr); });
+}
+
+void Network::SendTraffic(void *self, void *unused) {
+  Badge *badge = static_cast<Badge *>(self);
+  Network *network = badge->network;
+  IrData data = {};
+  data.ttl = 0;
+  data.type = packet_type::kProximity;
+  uint8_t *p = reinterpret_cast<uint8_t *>(&data.opaq.proximity);
+  for (size_t i = 0; i < sizeof(ProximityPacket); i++) {
+    p[i] = NextRandom(badge->rng);
+  }
+  badge->offered++;
+  if (!irController.SendPacketWithRetransmit(
+          reinterpret_cast<uint8_t *>(&data),
+          IR_DATA_HEADER_SIZE + sizeof(ProximityPacket),
+          network->options_.retries, AckTag::ACK_TAG_NONE)) {
+    badge->rejected++;
+  }
+  network->ScheduleTraffic(badge);
+}
+
+uint64_t Network::Until(const Badge *badge, uint64_t limit) const {
+  uint64_t until = std::min(end_, limit);
+  // The receiver only samples the air in its DMA interrupts, the badge can
+  // run up to the first one that would read past `limit`.
+  uint64_t next = badge->rx_interrupt;
+  if (next) {
+    if (next <= limit) {
+      next += ((limit - next) / badge->rx_period + 1) * badge->rx_period;
+    }
+    until = std::min(end_, next - kInterruptGuard);
+  }
+  return until;
+}
+
+void Network::RunBadge(Badge *badge, uint64_t until, uint64_t read_limit) {
+  current_ = badge;
+  stats_.switches++;
+  badge->state.Restore();
+  Flash::Map(flash_fd_, static_cast<off_t>(Flash::kSize) * badge->id);
+  cells_[badge->cell].air->SetReadLimit(read_limit);
+  g_machine.SetEndTime(until - badge->offset);
+  if (!badge->started) {
+    badge->started = true;
+    getcontext(&badge->context);
+    badge->context.uc_stack.ss_sp = badge->stack;
+    badge->context.uc_stack.ss_size = kStackSize;
+    badge->context.uc_link = nullptr;
+    uintptr_t self = reinterpret_cast<uintptr_t>(badge);
+    makecontext(&badge->context, reinterpret_cast<void (*)()>(&BadgeMain), 2,
+                static_cast<unsigned>(self >> 32),
+                static_cast<unsigned>(self));
+  }
+  swapcontext(&driver_, &badge->context);
+  badge->now = badge->offset + g_machine.Now();
+  badge->rx_interrupt = g_dma.NextInterrupt(&hdma_tim2_ch3);
+  if (badge->rx_interrupt) {
+    badge->rx_interrupt += badge->offset;
+    badge->rx_period = g_dma.InterruptPeriod(&hdma_tim2_ch3);
+  }
+  TrackSlots(badge);
+  badge->state.Save();
+  current_ = nullptr;
+}
+
+void Network::TrackSlots(Badge *badge) {
+  uint64_t now = badge->now;
+  auto ms = [](uint64_t cycles) {
+    return static_cast<uint32_t>(cycles / Machine::kCyclesPerMs);
+  };
+  for (uint8_t i = 0; i < RETX_QUEUE_SIZE; i++) {
+    Slot &slot = badge->slots[i];
+    uint8_t status = irController.GetSlotStatusForDebug(i);
+    uint8_t seq = irController.GetSlotSeqForDebug(i);
+    uint8_t retries = irController.GetSlotRetryCountForDebug(i);
+    uint16_t time_to_retry = irController.GetSlotTimeToRetryForDebug(i);
+
+    bool was_used = slot.status != kRetransmitStatusSlotUnused;
+    // A new packet in the slot waits for its hash again, or gets the next
+    // sequence number.
+    bool requeued = (status == kRetransmitStatusWaitHashAvail &&
+                     slot.status != kRetransmitStatusWaitHashAvail) ||
+                    (status != kRetransmitStatusSlotUnused && seq != slot.seq);
+    if (was_used && (status == kRetransmitStatusSlotUnused || requeued)) {
+      if (requeued) {
+        stats_.replaced++;
+      } else if (slot.status == kRetransmitStatusWaitAck &&
+                 slot.time_to_retry == 0 && slot.retries == 0) {
+        stats_.dropped++;
+      } else {
+        stats_.acked++;
+        if (slot.transmissions) {
+          stats_.ack_latency.push_back(ms(now - slot.first_tx_at));
+        }
+        stats_.queue_latency.push_back(ms(now - slot.queued_at));
+      }
+      was_used = false;
+      slot.status = kRetransmitStatusSlotUnused;
+    }
+    if (!was_used && status != kRetransmitStatusSlotUnused) {
+      stats_.queued++;
+      slot.queued_at = now;
+      slot.transmissions = 0;
+    }
+    if (status == kRetransmitStatusWaitAck &&
+        slot.status != kRetransmitStatusWaitAck) {
+      if (!slot.transmissions++) {
+        slot.first_tx_at = now;
+        stats_.tx_latency.push_back(ms(now - slot.queued_at));
+      } else {
+        stats_.retransmits++;
+      }
+      stats_.transmissions++;
+    }
+    slot.status = status;
+    slot.seq = seq;
+    slot.retries = retries;
+    slot.time_to_retry = time_to_retry;
+  }
+}
+
+void Network::Run() {
+  while (true) {
+    bool done = true;
+    for (Cell &cell : cells_) {
+      // Earliest and second earliest horizon in the cell. A badge may run up
+      // to the earliest of the others'.
+      uint64_t first = cell.base_station->Horizon();
+      uint64_t second = UINT64_MAX;
+      const Badge *owner = nullptr;
+      for (const Badge *badge : cell.badges) {
+        uint64_t h = Horizon(badge);
+        if (h < first) {
+          second = first;
+          first = h;
+          owner = badge;
+        } else if (h < second) {
+          second = h;
+        }
+      }
+      bool ran = false;
+      for (Badge *badge : cell.badges) {
+        uint64_t limit = badge == owner ? second : first;
+        uint64_t until = Until(badge, limit);
+        if (until <= badge->now) continue;
+        RunBadge(badge, until, limit);
+        ran = true;
+      }
+      // Every badge can be stuck right before reading what another one
+      // hasn't announced yet. Let the earliest one go ahead.
+      if (!ran && owner && owner->now < end_) {
+        Badge *badge = const_cast<Badge *>(owner);
+        stats_.forced++;
+        RunBadge(badge, std::min(end_, badge->now + pulse_period_), second);
+      }
+
+      uint64_t heard = end_;
+      uint64_t floor = cell.base_station->Heard();
+      for (const Badge *badge : cell.badges) {
+        heard = std::min(heard, Horizon(badge));
+        floor = std::min(floor, badge->now);
+        if (badge->now < end_) done = false;
+      }
+      cell.air->SetReadLimit(heard);
+      cell.base_station->Run(heard);
+      // Receivers look back at most one DMA buffer, keep some more.
+      uint64_t keep = 4 * 2 * IR_SERVICE_RX_SIZE * sample_period_;
+      cell.air->Retire(floor > keep ? floor - keep : 0);
+    }
+    if (done) break;
+  }
+}
+
+void Network::Report(double host_seconds) {
+  printf("%u badges in %u cells, virtual %.3fs, host %.3fs, %.1fx real time\n",
+         options_.badges, options_.cells, options_.seconds, host_seconds,
+         options_.seconds / host_seconds);
+  printf("%llu badge switches, %llu forced\n",
+         static_cast<unsigned long long>(stats_.switches),
+         static_cast<unsigned long long>(stats_.forced));
+
+  uint64_t offered = 0, rejected = 0, tx_packets = 0;
+  IrMac::Stats mac = {};
+  for (auto &badge : badges_) {
+    offered += badge->offered;
+    rejected += badge->rejected;
+    if (!badge->started) continue;
+    badge->state.Restore();
+    tx_packets += irService.GetTxPacketCount();
+    const IrMac::Stats &m = irService.mac.GetStats();
+    mac.attempts += m.attempts;
+    mac.collisions += m.collisions;
+    mac.deferrals += m.deferrals;
+    mac.acks += m.acks;
+    mac.ack_timeouts += m.ack_timeouts;
+    mac.backoff_ticks += m.backoff_ticks;
+  }
+  pristine_->Restore();
+
+  const Stats &s = stats_;
+  printf("traffic: %llu offered, %llu rejected by a full queue\n",
+         static_cast<unsigned long long>(offered),
+         static_cast<unsigned long long>(rejected));
+  printf("retransmit slots: %llu queued, %llu acked, %llu dropped, "
+         "%llu replaced\n",
+         static_cast<unsigned long long>(s.queued),
+         static_cast<unsigned long long>(s.acked),
+         static_cast<unsigned long long>(s.dropped),
+         static_cast<unsigned long long>(s.replaced));
+  printf("transmissions: %llu, %llu of them retransmits (%.1f%%)\n",
+         static_cast<unsigned long long>(s.transmissions),
+         static_cast<unsigned long long>(s.retransmits),
+         s.transmissions ? 100.0 * s.retransmits / s.transmissions : 0.0);
+  printf("ir service: %llu packets sent, %llu aborted on collision\n",
+         static_cast<unsigned long long>(tx_packets),
+         static_cast<unsigned long long>(mac.collisions));
+  printf("mac: %llu attempts, %llu deferrals, %llu acks, %llu ack timeouts, "
+         "%llu routine runs backing off\n",
+         static_cast<unsigned long long>(mac.attempts),
+         static_cast<unsigned long long>(mac.deferrals),
+         static_cast<unsigned long long>(mac.acks),
+         static_cast<unsigned long long>(mac.ack_timeouts),
+         static_cast<unsigned long long>(mac.backoff_ticks));
+
+  BaseStation::Stats bs = {};
+  Air::Stats air = {};
+  for (const Cell &cell : cells_) {
+    const BaseStation::Stats &b = cell.base_station->GetStats();
+    bs.headers += b.headers;
+    bs.packets += b.packets;
+    bs.bad += b.bad;
+    bs.unique += b.unique;
+    bs.unique_bytes += b.unique_bytes;
+    bs.acks_sent += b.acks_sent;
+    bs.acked += b.acked;
+    const Air::Stats &a = cell.air->GetStats();
+    air.busy += a.busy;
+    air.overlap += a.overlap;
+    air.buckets += a.buckets;
+    air.late_reads += a.late_reads;
+    air.stale_reads += a.stale_reads;
+    air.overruns += a.overruns;
+  }
+  printf("base stations: %llu headers, %llu packets, %llu bad (%.1f%%), "
+         "%llu acks sent for %llu packets\n",
+         static_cast<unsigned long long>(bs.headers),
+         static_cast<unsigned long long>(bs.packets),
+         static_cast<unsigned long long>(bs.bad),
+         bs.headers ? 100.0 * bs.bad / bs.headers : 0.0,
+         static_cast<unsigned long long>(bs.acks_sent),
+         static_cast<unsigned long long>(bs.acked));
+  printf("goodput: %llu unique packets, %.1f B/s per cell\n",
+         static_cast<unsigned long long>(bs.unique),
+         bs.unique_bytes / options_.seconds / options_.cells);
+  printf("air: %.1f%% busy, %.1f%% of that overlapping, %llu late reads, "
+         "%llu stale reads, %llu overruns\n",
+         air.buckets ? 100.0 * air.busy / air.buckets : 0.0,
+         air.busy ? 100.0 * air.overlap / air.busy : 0.0,
+         static_cast<unsigned long long>(air.late_reads),
+         static_cast<unsigned long long>(air.stale_reads),
+         static_cast<unsigned long long>(air.overruns));
+  printf("latency to first tx:\n");
+  PrintLatency("queued", stats_.tx_latency);
+  printf("latency to ack:\n");
+  PrintLatency("first tx", stats_.ack_latency);
+  PrintLatency("queued", stats_.queue_latency);
+  if (!stats_.ack_latency.empty()) {
+    printf("  from first tx:\n");
+    PrintHistogram(stats_.ack_latency);
+  }
+}
+
+}  // namespace net
+}  // namespace hitcon
@@ -0,0 +1,172 @@
+/*
+ * Network.h
+ *
+ *  Many badges running the real firmware in one process, talking IR to a
+ *  base station per cell through Air.
+ *
+ *  Each badge is a copy of libhitcon-fw's data (Snapshot), its own stack and
+ *  its own flash. Only one badge is loaded at a time; it runs on its stack
+ *  until its virtual clock reaches the end time it was given and then yields
+ *  back here, where its data is saved and the next badge is loaded.
+ *
+ *  Badges run conservatively: a badge only samples the air up to the time
+ *  every other transmitter in its cell has announced its waveform for, so
+ *  the samples it takes are final. The base station follows behind the badges and only
+ *  transmits a turnaround after what it has listened to, which leaves the
+ *  badges that much room to run ahead of it.
+ */
+
+#ifndef HITCON_NET_NETWORK_H_
+#define HITCON_NET_NETWORK_H_
+
+#include <Logic/IrController.h>
+#include <Net/Air.h>
+#include <Net/BaseStation.h>
+#include <Net/Snapshot.h>
+#include <Service/Sched/Task.h>
+#include <ucontext.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace hitcon {
+namespace net {
+
+class Network {
+ public:
+  struct Options {
+    unsigned badges = 16;
+    unsigned cells = 1;
+    double seconds = 60;
+    // Packets each badge tries to send per minute, Poisson distributed.
+    double rate = 6;
+    unsigned retries = 3;
+    // Probability of a flipped sample at a receiver.
+    double ber = 0;
+    // Badges and base stations send with forward error correction.
+    bool fec = false;
+    unsigned ack_delay_ms = 150;
+    // Most packets a base station acknowledges with one ack, and how long it
+    // waits for more acks before sending a partial batch.
+    unsigned ack_batch = ir::ACK_BATCH_MAX;
+    unsigned ack_hold_ms = 1000;
+    // Base stations ack packets by ID, see IR_TTL_ACK_BY_ID.
+    bool ack_by_id = true;
+    unsigned turnaround_ms = 20;
+    // Badges boot at a random time within the first `stagger_ms`.
+    unsigned stagger_ms = 1000;
+    uint64_t seed = 1;
+    // IrController::SetProbParams(), the MAC's transmit probability, and
+    // SetRetransmitTiming(), if set.
+    bool set_prob = false;
+    uint8_t prob[3] = {};
+    bool set_retx = false;
+    uint16_t retx_base = 0;
+    uint16_t retx_jitter = 0;
+  };
+
+  explicit Network(const Options &options);
+
+  // Returns false if the firmware library can't be set up for swapping.
+  bool Init();
+  void Run();
+  void Report(double host_seconds);
+
+  // Badge being run, -1 while the network itself is.
+  int Current() const { return current_ ? current_->id : -1; }
+  // Network time of the badge being run.
+  uint64_t Now() const;
+
+ private:
+  // What the network saw of one of IrController's retransmit slots.
+  struct Slot {
+    uint8_t status;
+    uint8_t seq;
+    uint8_t retries;
+    uint16_t time_to_retry;
+    uint64_t queued_at;
+    uint64_t first_tx_at;
+    unsigned transmissions;
+  };
+
+  struct Badge {
+    Network *network;
+    int id;
+    unsigned cell;
+    int tx;
+    // Network time of the badge's cycle 0, and how far it has run.
+    uint64_t offset;
+    uint64_t now;
+    // The badge has announced its waveform up to here.
+    uint64_t announced;
+    // The receive DMA's next interrupt and their period, when it runs.
+    uint64_t rx_interrupt;
+    uint64_t rx_period;
+    bool started;
+    Snapshot state;
+    ucontext_t context;
+    void *stack;
+    uint64_t rng;
+    uint64_t ber_threshold;
+    service::sched::Task *traffic;
+    Slot slots[ir::RETX_QUEUE_SIZE];
+    uint64_t offered;
+    uint64_t rejected;
+  };
+
+  struct Cell {
+    std::unique_ptr<Air> air;
+    std::unique_ptr<BaseStation> base_station;
+    std::vector<Badge *> badges;
+  };
+
+  struct Stats {
+    uint64_t queued;
+    uint64_t transmissions;
+    uint64_t retransmits;
+    uint64_t acked;
+    uint64_t dropped;
+    uint64_t replaced;
+    uint64_t switches;
+    // Runs past another badge's horizon to break a tie, see Run().
+    uint64_t forced;
+    // Milliseconds from the first transmission, and from being queued, to
+    // the ack.
+    std::vector<uint32_t> ack_latency;
+    std::vector<uint32_t> queue_latency;
+    // Milliseconds from being queued to the first transmission.
+    std::vector<uint32_t> tx_latency;
+  };
+
+  static void BadgeMain(unsigned hi, unsigned lo);
+  static void SendTraffic(void *self, void *unused);
+  static uint64_t NextRandom(uint64_t &state);
+
+  void Boot(Badge *badge);
+  void Yield();
+  uint64_t Until(const Badge *badge, uint64_t limit) const;
+  void RunBadge(Badge *badge, uint64_t until, uint64_t read_limit);
+  void ScheduleTraffic(Badge *badge);
+  void TrackSlots(Badge *badge);
+  uint64_t Horizon(const Badge *badge) const {
+    return std::max(badge->announced, badge->now);
+  }
+
+  Options options_;
+  uint64_t end_;
+  uint64_t pulse_period_ = 0;
+  uint64_t sample_period_ = 0;
+  int flash_fd_ = -1;
+  std::unique_ptr<Snapshot> pristine_;
+  std::vector<std::unique_ptr<Badge>> badges_;
+  std::vector<Cell> cells_;
+  Badge *current_ = nullptr;
+  ucontext_t driver_;
+  Stats stats_ = {};
+};
+
+}  // namespace net
+}  // namespace hitcon
+
+#endif  // HITCON_NET_NETWORK_H_
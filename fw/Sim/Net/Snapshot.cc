@@ -0,0 +1,89 @@
+#include <Net/Snapshot.h>
+#include <dlfcn.h>
+#include <link.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace hitcon {
+namespace net {
+
+std::vector<Snapshot::Range> Snapshot::ranges_;
+size_t Snapshot::size_ = 0;
+
+namespace {
+
+struct Search {
+  const void *base;
+  std::vector<std::pair<uintptr_t, uintptr_t>> writable;
+  std::pair<uintptr_t, uintptr_t> relro;
+  bool found;
+};
+
+int OnObject(struct dl_phdr_info *info, size_t, void *arg) {
+  Search *search = static_cast<Search *>(arg);
+  if (reinterpret_cast<const void *>(info->dlpi_addr) != search->base) {
+    return 0;
+  }
+  for (int i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr) &ph = info->dlpi_phdr[i];
+    uintptr_t begin = info->dlpi_addr + ph.p_vaddr;
+    if (ph.p_type == PT_LOAD && (ph.p_flags & PF_W)) {
+      search->writable.push_back({begin, begin + ph.p_memsz});
+    } else if (ph.p_type == PT_GNU_RELRO) {
+      search->relro = {begin, begin + ph.p_memsz};
+    }
+  }
+  search->found = true;
+  return 1;
+}
+
+}  // namespace
+
+bool Snapshot::Locate(const void *symbol) {
+  Dl_info dl;
+  if (!dladdr(symbol, &dl)) return false;
+  Search search = {};
+  search.base = dl.dli_fbase;
+  dl_iterate_phdr(&OnObject, &search);
+  if (!search.found) return false;
+
+  ranges_.clear();
+  size_ = 0;
+  for (auto [begin, end] : search.writable) {
+    // The part made read only after relocation is the same for every badge.
+    if (search.relro.first <= begin && begin < search.relro.second) {
+      begin = std::min(end, search.relro.second);
+    }
+    if (search.relro.first < end && end <= search.relro.second) {
+      end = std::max(begin, search.relro.first);
+    }
+    if (begin >= end) continue;
+    ranges_.push_back({reinterpret_cast<uint8_t *>(begin), end - begin});
+    size_ += end - begin;
+  }
+  return size_ != 0;
+}
+
+size_t Snapshot::Size() { return size_; }
+
+Snapshot::Snapshot() : data_(size_) { Save(); }
+
+void Snapshot::Save() {
+  uint8_t *p = data_.data();
+  for (const Range &r : ranges_) {
+    memcpy(p, r.begin, r.size);
+    p += r.size;
+  }
+}
+
+void Snapshot::Restore() const {
+  const uint8_t *p = data_.data();
+  for (const Range &r : ranges_) {
+    memcpy(r.begin, p, r.size);
+    p += r.size;
+  }
+}
+
+}  // namespace net
+}  // namespace hitcon
@@ -0,0 +1,47 @@
+/*
+ * Snapshot.h
+ *
+ *  Copies of the writable data of libhitcon-fw. Everything a badge keeps
+ *  between two instructions lives there, in its heap or on its stack, so
+ *  swapping this data and the stack is enough to switch between badges.
+ */
+
+#ifndef HITCON_NET_SNAPSHOT_H_
+#define HITCON_NET_SNAPSHOT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hitcon {
+namespace net {
+
+class Snapshot {
+ public:
+  // Find the data segment of the library that defines `symbol`. Returns false
+  // if it can't be found.
+  static bool Locate(const void *symbol);
+  static size_t Size();
+
+  // Starts out as a copy of the library's current data.
+  Snapshot();
+
+  void Save();
+  void Restore() const;
+
+ private:
+  struct Range {
+    uint8_t *begin;
+    size_t size;
+  };
+
+  static std::vector<Range> ranges_;
+  static size_t size_;
+
+  std::vector<uint8_t> data_;
+};
+
+}  // namespace net
+}  // namespace hitcon
+
+#endif  // HITCON_NET_SNAPSHOT_H_
@@ -0,0 +1,196 @@
+#include <Sim/Board.h>
+#include <Sim/Flash.h>
+#include <Sim/Imu.h>
+#include <Sim/Machine.h>
+#include <Sim/Peripherals.h>
+#include <Sim/Uart.h>
+#include <adc.h>
+#include <crc.h>
+#include <dma.h>
+#include <gpio.h>
+#include <i2c.h>
+#include <main.h>
+#include <tim.h>
+#include <usart.h>
+#include <usb_device.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+TIM_HandleTypeDef htim1;
+TIM_HandleTypeDef htim2;
+TIM_HandleTypeDef htim3;
+TIM_HandleTypeDef htim4;
+DMA_HandleTypeDef hdma_tim1_up;
+DMA_HandleTypeDef hdma_tim2_ch1;
+DMA_HandleTypeDef hdma_tim2_ch3;
+DMA_HandleTypeDef hdma_tim3_ch3;
+DMA_HandleTypeDef hdma_tim4_ch2;
+I2C_HandleTypeDef hi2c1;
+UART_HandleTypeDef huart2;
+ADC_HandleTypeDef hadc1;
+CRC_HandleTypeDef hcrc;
+
+USART_TypeDef sim_usart2;
+ADC_TypeDef sim_adc1;
+CRC_TypeDef sim_crc;
+
+namespace hitcon {
+namespace sim {
+
+namespace {
+
+// Conversion time at ADCCLK = PCLK2 / 2: 1.5 cycles sampling and 12.5 for
+// the conversion.
+constexpr unsigned kAdcConversionCycles = 28;
+
+uint64_t g_adc_state = 0x2545F4914F6CDD1DULL;
+
+uint16_t NextAdcSample() {
+  // xorshift64*, only the low bits of a floating input are noisy anyway.
+  g_adc_state ^= g_adc_state >> 12;
+  g_adc_state ^= g_adc_state << 25;
+  g_adc_state ^= g_adc_state >> 27;
+  return (g_adc_state * 0x2545F4914F6CDD1DULL) >> 52;
+}
+
+void InitDma(DMA_HandleTypeDef *hdma, DMA_Channel_TypeDef *instance,
+             uint32_t direction, uint32_t align, uint32_t mode) {
+  hdma->Instance = instance;
+  hdma->Init.Direction = direction;
+  hdma->Init.PeriphDataAlignment = align;
+  hdma->Init.MemDataAlignment = align;
+  hdma->Init.Mode = mode;
+  hdma->State = HAL_DMA_STATE_READY;
+}
+
+void InitTim(TIM_HandleTypeDef *htim, TIM_TypeDef *instance,
+             uint32_t prescaler, uint32_t period) {
+  *instance = {};
+  htim->Instance = instance;
+  htim->Init.Prescaler = prescaler;
+  htim->Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim->Init.Period = period;
+  instance->PSC = prescaler;
+  instance->ARR = period;
+  htim->State = HAL_TIM_STATE_READY;
+}
+
+}  // namespace
+
+bool InitBoard(int flash_fd, off_t flash_offset) {
+  if (!g_flash.Init(flash_fd, flash_offset)) return false;
+  HAL_Init();
+  MX_GPIO_Init();
+  MX_DMA_Init();
+  MX_USART2_UART_Init();
+  MX_TIM1_Init();
+  MX_TIM3_Init();
+  MX_TIM2_Init();
+  MX_TIM4_Init();
+  MX_ADC1_Init();
+  MX_CRC_Init();
+  MX_USB_DEVICE_Init();
+#ifndef V1_1
+  MX_I2C1_Init();
+#endif
+  return true;
+}
+
+void SetAdcSeed(uint64_t seed) { g_adc_state = seed ? seed : 1; }
+
+void SetButton(uint16_t pin, bool pressed) {
+  g_gpio.SetInput(GPIOA, pin, !pressed);
+}
+
+}  // namespace sim
+}  // namespace hitcon
+
+using namespace hitcon::sim;
+
+extern "C" {
+
+void Error_Handler(void) {
+  fprintf(stderr, "Error_Handler() at tick %u\n", g_machine.GetTick());
+  abort();
+}
+
+void MX_GPIO_Init(void) { g_gpio.Init(); }
+
+void MX_DMA_Init(void) {}
+
+// Timer settings are the ones in Core/Src/tim.c.
+void MX_TIM1_Init(void) {
+  InitTim(&htim1, TIM1, 5 - 1, 1500 - 1);
+  InitDma(&hdma_tim1_up, DMA1_Channel5, DMA_MEMORY_TO_PERIPH,
+          DMA_PDATAALIGN_WORD, DMA_CIRCULAR);
+  __HAL_LINKDMA(&htim1, hdma[TIM_DMA_ID_UPDATE], hdma_tim1_up);
+}
+
+void MX_TIM2_Init(void) {
+  InitTim(&htim2, TIM2, 0, 4 - 1);
+  // External clock mode 1 from ITR2, which is TIM3's update event.
+  TIM2->SMCR = 0x7U | (0x2U << 4);
+  InitDma(&hdma_tim2_ch3, DMA1_Channel1, DMA_PERIPH_TO_MEMORY,
+          DMA_PDATAALIGN_HALFWORD, DMA_CIRCULAR);
+  __HAL_LINKDMA(&htim2, hdma[TIM_DMA_ID_CC3], hdma_tim2_ch3);
+}
+
+void MX_TIM3_Init(void) {
+  InitTim(&htim3, TIM3, 5 - 1, 63 - 1);
+  InitDma(&hdma_tim3_ch3, DMA1_Channel2, DMA_MEMORY_TO_PERIPH,
+          DMA_PDATAALIGN_HALFWORD, DMA_CIRCULAR);
+  __HAL_LINKDMA(&htim3, hdma[TIM_DMA_ID_CC3], hdma_tim3_ch3);
+}
+
+void MX_TIM4_Init(void) {
+  InitTim(&htim4, TIM4, 12000 - 1, 10 - 1);
+  InitDma(&hdma_tim4_ch2, DMA1_Channel4, DMA_PERIPH_TO_MEMORY,
+          DMA_PDATAALIGN_HALFWORD, DMA_NORMAL);
+  __HAL_LINKDMA(&htim4, hdma[TIM_DMA_ID_CC2], hdma_tim4_ch2);
+}
+
+void MX_USART2_UART_Init(void) {
+  huart2.Instance = USART2;
+  huart2.Init.BaudRate = 28800;
+  g_uart.Init(&huart2, true);
+}
+
+void MX_I2C1_Init(void) {
+  hi2c1.Instance = I2C1;
+  hi2c1.Init.ClockSpeed = 100000;
+  g_imu.Init(&hi2c1);
+}
+
+void MX_ADC1_Init(void) { hadc1.Instance = ADC1; }
+
+void MX_CRC_Init(void) { hcrc.Instance = CRC; }
+
+HAL_StatusTypeDef HAL_ADC_Start_IT(ADC_HandleTypeDef *hadc) {
+  g_machine.Poll();
+  g_machine.Schedule(g_machine.Now() + kAdcConversionCycles, [hadc]() {
+    hadc->Instance->DR = NextAdcSample();
+    if (hadc->ConvCpltCallback) hadc->ConvCpltCallback(hadc);
+  });
+  return HAL_OK;
+}
+
+uint32_t HAL_ADC_GetValue(ADC_HandleTypeDef *hadc) {
+  return hadc->Instance->DR;
+}
+
+// CRC-32/MPEG-2 a word at a time, like the CRC unit.
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[],
+                           uint32_t BufferLength) {
+  uint32_t crc = 0xFFFFFFFFU;
+  for (uint32_t i = 0; i < BufferLength; i++) {
+    crc ^= pBuffer[i];
+    for (int bit = 0; bit < 32; bit++) {
+      crc = (crc & 0x80000000U) ? (crc << 1) ^ 0x04C11DB7U : crc << 1;
+    }
+  }
+  hcrc->Instance->DR = crc;
+  return crc;
+}
+
+}  // extern "C"
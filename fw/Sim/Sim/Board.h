@@ -0,0 +1,36 @@
+/*
+ * Board.h
+ *
+ *  Peripheral handles and the CubeMX style init that main() runs before
+ *  hitcon_run().
+ */
+
+#ifndef HITCON_SIM_BOARD_H_
+#define HITCON_SIM_BOARD_H_
+
+#include <stm32f1xx_hal.h>
+
+#include <cstdint>
+#include <sys/types.h>
+
+// Declared by stm32f1xx_it.c on the badge, the other handles are in tim.h.
+extern DMA_HandleTypeDef hdma_tim1_up;
+
+namespace hitcon {
+namespace sim {
+
+// Same sequence as main() in Core/Src/main.cc. Returns false if the flash
+// can't be mapped, see Flash::Init() for `flash_fd`.
+bool InitBoard(int flash_fd = -1, off_t flash_offset = 0);
+
+// The ADC samples floating pins, which the simulator replaces with a
+// repeatable pseudo random sequence.
+void SetAdcSeed(uint64_t seed);
+
+// Buttons are active low on GPIOA, see btn_pins in ButtonService.h.
+void SetButton(uint16_t pin, bool pressed);
+
+}  // namespace sim
+}  // namespace hitcon
+
+#endif  // HITCON_SIM_BOARD_H_
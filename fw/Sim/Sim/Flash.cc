@@ -0,0 +1,134 @@
+#include <Sim/Flash.h>
+#include <Sim/Machine.h>
+#include <stm32f1xx_hal.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace hitcon {
+namespace sim {
+
+Flash g_flash;
+
+bool Flash::Init(int fd, off_t offset) {
+  if (fd >= 0) {
+    if (!Map(fd, offset)) return false;
+    memset(Data(), 0xFF, kSize);
+    return true;
+  }
+  void *p = mmap(reinterpret_cast<void *>(kBase), kSize,
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+  if (p != reinterpret_cast<void *>(kBase)) {
+    if (p != MAP_FAILED) munmap(p, kSize);
+    return false;
+  }
+  memset(p, 0xFF, kSize);
+  return true;
+}
+
+bool Flash::Map(int fd, off_t offset) {
+  void *p = mmap(reinterpret_cast<void *>(kBase), kSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_FIXED, fd, offset);
+  return p == reinterpret_cast<void *>(kBase);
+}
+
+bool Flash::Load(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return false;
+  size_t n = fread(Data(), 1, kSize, f);
+  fclose(f);
+  return n > 0;
+}
+
+bool Flash::Save(const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (!f) return false;
+  size_t n = fwrite(Data(), 1, kSize, f);
+  fclose(f);
+  return n == kSize;
+}
+
+uint64_t Flash::Reserve(unsigned us) {
+  busy_until_ = std::max(busy_until_, g_machine.Now()) +
+                static_cast<uint64_t>(us) * (Machine::kCyclesPerMs / 1000);
+  return busy_until_;
+}
+
+void Flash::Erase(uintptr_t page, uint32_t done) {
+  g_machine.Schedule(Reserve(kPageEraseUs), [this, page, done]() {
+    memset(reinterpret_cast<void *>(page), 0xFF, FLASH_PAGE_SIZE);
+    stats_.erases++;
+    HAL_FLASH_EndOfOperationCallback(done);
+  });
+}
+
+void Flash::Program(uintptr_t addr, uint64_t data, unsigned halfwords) {
+  g_machine.Schedule(
+      Reserve(kHalfWordProgramUs * halfwords), [this, addr, data, halfwords]() {
+        uint16_t *dst = reinterpret_cast<uint16_t *>(addr);
+        for (unsigned i = 0; i < halfwords; i++) {
+          uint16_t value = data >> (16 * i);
+          // Like PGERR, only an erased half word can take anything but 0.
+          if (dst[i] != 0xFFFF && value != 0) {
+            stats_.errors++;
+            HAL_FLASH_OperationErrorCallback(addr);
+            return;
+          }
+          dst[i] = value;
+        }
+        stats_.programs++;
+        HAL_FLASH_EndOfOperationCallback(addr);
+      });
+}
+
+}  // namespace sim
+}  // namespace hitcon
+
+using hitcon::sim::g_flash;
+
+extern "C" {
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) {
+  g_flash.Unlock();
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void) {
+  g_flash.Lock();
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase_IT(FLASH_EraseInitTypeDef *pEraseInit) {
+  hitcon::sim::g_machine.Poll();
+  size_t len = static_cast<size_t>(pEraseInit->NbPages) * FLASH_PAGE_SIZE;
+  if (g_flash.IsLocked() || pEraseInit->TypeErase != FLASH_TYPEERASE_PAGES ||
+      !pEraseInit->NbPages || pEraseInit->PageAddress % FLASH_PAGE_SIZE ||
+      !g_flash.Contains(pEraseInit->PageAddress, len)) {
+    return HAL_ERROR;
+  }
+  // Like the HAL, report every page but the last by address.
+  for (uint32_t i = 0; i < pEraseInit->NbPages; i++) {
+    uint32_t page = pEraseInit->PageAddress + i * FLASH_PAGE_SIZE;
+    g_flash.Erase(page, i + 1 < pEraseInit->NbPages ? page : 0xFFFFFFFFU);
+  }
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program_IT(uint32_t TypeProgram, uint32_t Address,
+                                       uint64_t Data) {
+  hitcon::sim::g_machine.Poll();
+  unsigned halfwords = TypeProgram == FLASH_TYPEPROGRAM_HALFWORD ? 1
+                       : TypeProgram == FLASH_TYPEPROGRAM_WORD   ? 2
+                                                                 : 4;
+  if (g_flash.IsLocked() || Address % 2 ||
+      !g_flash.Contains(Address, halfwords * 2)) {
+    return HAL_ERROR;
+  }
+  g_flash.Program(Address, Data, halfwords);
+  return HAL_OK;
+}
+
+}  // extern "C"
@@ -0,0 +1,71 @@
+/*
+ * Flash.h
+ *
+ *  RAM backed internal flash, mapped at the badge's flash address so that
+ *  the firmware can keep reading it through plain pointers. Erase and program
+ *  take as long as on the STM32F103 and complete with the HAL callbacks.
+ */
+
+#ifndef HITCON_SIM_FLASH_H_
+#define HITCON_SIM_FLASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+namespace hitcon {
+namespace sim {
+
+class Flash {
+ public:
+  static constexpr uintptr_t kBase = 0x08000000;
+  static constexpr size_t kSize = 128 * 1024;
+  // Typical page erase and half word program times from the datasheet.
+  static constexpr unsigned kPageEraseUs = 20000;
+  static constexpr unsigned kHalfWordProgramUs = 52;
+
+  struct Stats {
+    uint64_t erases;
+    uint64_t programs;
+    uint64_t errors;
+  };
+
+  // Map the flash, erased. Returns false if the address range is taken.
+  // With a file, the flash is `kSize` bytes of it at `offset` instead, which
+  // lets several badges in one process each keep their own.
+  bool Init(int fd = -1, off_t offset = 0);
+  // Put another badge's flash in place, see Init().
+  static bool Map(int fd, off_t offset);
+  bool Load(const char *path);
+  bool Save(const char *path);
+
+  uint8_t *Data() { return reinterpret_cast<uint8_t *>(kBase); }
+  bool Contains(uintptr_t addr, size_t len) {
+    return addr >= kBase && addr - kBase + len <= kSize;
+  }
+
+  void Unlock() { locked_ = false; }
+  void Lock() { locked_ = true; }
+  bool IsLocked() { return locked_; }
+
+  // Operations queue up behind the one in flight and raise
+  // HAL_FLASH_EndOfOperationCallback() when done, with `done` for erases.
+  void Erase(uintptr_t page, uint32_t done);
+  void Program(uintptr_t addr, uint64_t data, unsigned halfwords);
+
+  const Stats &GetStats() { return stats_; }
+
+ private:
+  uint64_t Reserve(unsigned us);
+
+  bool locked_ = true;
+  uint64_t busy_until_ = 0;
+  Stats stats_ = {};
+};
+
+extern Flash g_flash;
+
+}  // namespace sim
+}  // namespace hitcon
+
+#endif  // HITCON_SIM_FLASH_H_
@@ -0,0 +1,249 @@
+#include <Logic/lsm6ds3tr-c_reg.h>
+#include <Sim/Imu.h>
+#include <Sim/Machine.h>
+#include <Sim/Peripherals.h>
+#include <main.h>
+
+#include <cstring>
+
+namespace hitcon {
+namespace sim {
+
+Imu g_imu;
+
+namespace {
+
+constexpr uint32_t kSr2Busy = I2C_FLAG_BUSY & 0xFFFF;
+
+constexpr uint8_t kCtrl3SwReset = 0x01;
+constexpr uint8_t kCtrl3Default = 0x04;
+constexpr uint8_t kCtrl5StXl = 0x03;
+constexpr uint8_t kCtrl5StG = 0x0C;
+constexpr uint8_t kCtrl10PedoRst = 0x02;
+constexpr uint8_t kCtrl10FuncEn = 0x04;
+constexpr uint8_t kCtrl10PedoEn = 0x10;
+constexpr uint8_t kStatusAllReady = 0x07;
+
+// Self test shifts well inside the limits ImuLogic checks: about 500mg at
+// 0.122mg/LSB and 300dps at 70mdps/LSB.
+constexpr int16_t kStShiftXl = 4100;
+constexpr int16_t kStShiftG = 4300;
+// 1g on Z at 0.122mg/LSB.
+constexpr int16_t kGravityZ = 8200;
+
+}  // namespace
+
+void Imu::Init(I2C_HandleTypeDef *hi2c) {
+  hi2c_ = hi2c;
+  hi2c->State = HAL_I2C_STATE_READY;
+  hi2c->Instance->SR2 = 0;
+  PowerOnReset();
+}
+
+void Imu::PowerOnReset() {
+  memset(regs_, 0, sizeof(regs_));
+  regs_[LSM6DS3TR_C_WHO_AM_I] = LSM6DS3TR_C_ID;
+  regs_[LSM6DS3TR_C_CTRL3_C] = kCtrl3Default;
+  steps_ = 0;
+  pedo_since_ = g_machine.Now();
+  reset_done_ = 0;
+}
+
+bool Imu::Powered() {
+#ifdef V2_2
+  // IMU_PWR drives a high side switch, high turns the IMU off.
+  bool powered = !(IMU_PWR_GPIO_Port->ODR & IMU_PWR_Pin);
+#else
+  bool powered = true;
+#endif
+  if (powered && !was_powered_) PowerOnReset();
+  was_powered_ = powered;
+  return powered;
+}
+
+uint16_t Imu::Steps() {
+  uint8_t ctrl10 = regs_[LSM6DS3TR_C_CTRL10_C];
+  if ((ctrl10 & kCtrl10FuncEn) && (ctrl10 & kCtrl10PedoEn)) {
+    uint64_t elapsed = g_machine.Now() - pedo_since_;
+    return steps_ + elapsed * step_rate_ / (60ULL * Machine::kCoreClock);
+  }
+  return steps_;
+}
+
+int16_t Imu::Output(uint8_t reg) {
+  uint8_t ctrl5 = regs_[LSM6DS3TR_C_CTRL5_C];
+  unsigned axis = (reg - LSM6DS3TR_C_OUTX_L_G) / 2 % 3;
+  // A little deterministic noise so averages aren't exactly zero.
+  int16_t value = static_cast<int16_t>((g_machine.Now() >> 10) % 7) - 3;
+  if (reg < LSM6DS3TR_C_OUTX_L_XL) {
+    if (ctrl5 & kCtrl5StG) value += kStShiftG;
+  } else {
+    if (axis == 2) value += kGravityZ;
+    if (ctrl5 & kCtrl5StXl) value += kStShiftXl;
+  }
+  return value;
+}
+
+uint8_t Imu::ReadReg(uint8_t reg) {
+  reg &= 0x7F;
+  switch (reg) {
+    case LSM6DS3TR_C_CTRL3_C:
+      if (g_machine.Now() < reset_done_) {
+        return regs_[reg] | kCtrl3SwReset;
+      }
+      return regs_[reg];
+    case LSM6DS3TR_C_STATUS_REG:
+      return kStatusAllReady;
+    case LSM6DS3TR_C_STEP_COUNTER_L:
+      return Steps() & 0xFF;
+    case LSM6DS3TR_C_STEP_COUNTER_H:
+      return Steps() >> 8;
+    default:
+      break;
+  }
+  if (reg >= LSM6DS3TR_C_OUTX_L_G && reg < LSM6DS3TR_C_OUTX_L_XL + 6) {
+    int16_t value = Output(reg & ~1);
+    return reg & 1 ? static_cast<uint16_t>(value) >> 8 : value & 0xFF;
+  }
+  return regs_[reg];
+}
+
+void Imu::WriteReg(uint8_t reg, uint8_t value) {
+  reg &= 0x7F;
+  switch (reg) {
+    case LSM6DS3TR_C_WHO_AM_I:
+    case LSM6DS3TR_C_STATUS_REG:
+    case LSM6DS3TR_C_STEP_COUNTER_L:
+    case LSM6DS3TR_C_STEP_COUNTER_H:
+      return;
+    case LSM6DS3TR_C_CTRL3_C:
+      if (value & kCtrl3SwReset) {
+        uint16_t steps = Steps();
+        PowerOnReset();
+        // The step counter lives in the embedded functions and survives.
+        steps_ = steps;
+        reset_done_ = g_machine.Now() +
+                      kSwResetUs * (Machine::kCyclesPerMs / 1000);
+        return;
+      }
+      break;
+    case LSM6DS3TR_C_CTRL10_C:
+      steps_ = Steps();
+      pedo_since_ = g_machine.Now();
+      if (value & kCtrl10PedoRst) steps_ = 0;
+      break;
+    default:
+      break;
+  }
+  regs_[reg] = value;
+}
+
+HAL_StatusTypeDef Imu::Start(uint16_t dev, uint16_t reg, uint8_t *data,
+                             uint16_t size, bool read) {
+  g_machine.Poll();
+  if (hi2c_->State != HAL_I2C_STATE_READY) return HAL_BUSY;
+  hi2c_->State = read ? HAL_I2C_STATE_BUSY_RX : HAL_I2C_STATE_BUSY_TX;
+  hi2c_->ErrorCode = HAL_I2C_ERROR_NONE;
+  hi2c_->Instance->SR2 |= kSr2Busy;
+  // Address, register, a repeated start and address for reads, then the
+  // data. Nine clocks per byte plus start and stop.
+  unsigned bytes = 2 + (read ? 1 : 0) + size;
+  uint64_t cycles = static_cast<uint64_t>(bytes * 9 + 2) *
+                    Machine::kCoreClock / hi2c_->Init.ClockSpeed;
+  unsigned generation = ++generation_;
+  g_machine.Schedule(g_machine.Now() + cycles, [this, dev, reg, data, size,
+                                                read, generation]() {
+    if (generation != generation_) return;
+    hi2c_->Instance->SR2 &= ~kSr2Busy;
+    hi2c_->State = HAL_I2C_STATE_READY;
+    if ((dev | 1) != LSM6DS3TR_C_I2C_ADD_L || !Powered()) {
+      stats_.nacks++;
+      hi2c_->ErrorCode |= HAL_I2C_ERROR_AF;
+      if (hi2c_->ErrorCallback) hi2c_->ErrorCallback(hi2c_);
+      return;
+    }
+    // IF_INC is on by default, multi byte transfers walk the registers.
+    for (uint16_t i = 0; i < size; i++) {
+      if (read) {
+        data[i] = ReadReg(reg + i);
+      } else {
+        WriteReg(reg + i, data[i]);
+      }
+    }
+    if (read) {
+      stats_.reads++;
+      if (hi2c_->MemRxCpltCallback) hi2c_->MemRxCpltCallback(hi2c_);
+    } else {
+      stats_.writes++;
+      if (hi2c_->MemTxCpltCallback) hi2c_->MemTxCpltCallback(hi2c_);
+    }
+  });
+  return HAL_OK;
+}
+
+void Imu::Abort() {
+  generation_++;
+  hi2c_->Instance->SR2 &= ~kSr2Busy;
+}
+
+}  // namespace sim
+}  // namespace hitcon
+
+using hitcon::sim::g_imu;
+
+I2C_TypeDef sim_i2c1;
+
+extern "C" {
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c) {
+  hi2c->State = HAL_I2C_STATE_READY;
+  hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c) {
+  g_imu.Abort();
+  hi2c->State = HAL_I2C_STATE_RESET;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_RegisterCallback(I2C_HandleTypeDef *hi2c,
+                                           HAL_I2C_CallbackIDTypeDef CallbackID,
+                                           pI2C_CallbackTypeDef pCallback) {
+  switch (CallbackID) {
+    case HAL_I2C_MASTER_TX_COMPLETE_CB_ID:
+      hi2c->MasterTxCpltCallback = pCallback;
+      break;
+    case HAL_I2C_MASTER_RX_COMPLETE_CB_ID:
+      hi2c->MasterRxCpltCallback = pCallback;
+      break;
+    case HAL_I2C_MEM_TX_COMPLETE_CB_ID:
+      hi2c->MemTxCpltCallback = pCallback;
+      break;
+    case HAL_I2C_MEM_RX_COMPLETE_CB_ID:
+      hi2c->MemRxCpltCallback = pCallback;
+      break;
+    case HAL_I2C_ERROR_CB_ID:
+      hi2c->ErrorCallback = pCallback;
+      break;
+    default:
+      return HAL_ERROR;
+  }
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c,
+                                       uint16_t DevAddress, uint16_t MemAddress,
+                                       uint16_t MemAddSize, uint8_t *pData,
+                                       uint16_t Size) {
+  return g_imu.Start(DevAddress, MemAddress, pData, Size, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c,
+                                      uint16_t DevAddress, uint16_t MemAddress,
+                                      uint16_t MemAddSize, uint8_t *pData,
+                                      uint16_t Size) {
+  return g_imu.Start(DevAddress, MemAddress, pData, Size, true);
+}
+
+}  // extern "C"
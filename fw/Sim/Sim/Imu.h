@@ -0,0 +1,67 @@
+/*
+ * Imu.h
+ *
+ *  I2C1 with an LSM6DS3TR-C on it. Only the registers ImuLogic touches
+ *  behave: identification, software reset, the pedometer and the data
+ *  ready / output registers used by the self tests.
+ */
+
+#ifndef HITCON_SIM_IMU_H_
+#define HITCON_SIM_IMU_H_
+
+#include <stm32f1xx_hal.h>
+
+#include <cstdint>
+
+namespace hitcon {
+namespace sim {
+
+class Imu {
+ public:
+  // Time the chip needs to come out of a software reset.
+  static constexpr unsigned kSwResetUs = 50;
+
+  struct Stats {
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t nacks;
+  };
+
+  void Init(I2C_HandleTypeDef *hi2c);
+  // Steps the pedometer counts while it's enabled.
+  void SetStepRate(unsigned steps_per_minute) { step_rate_ = steps_per_minute; }
+
+  HAL_StatusTypeDef Start(uint16_t dev, uint16_t reg, uint8_t *data,
+                          uint16_t size, bool read);
+  // HAL_I2C_DeInit(), abandons the transfer in flight.
+  void Abort();
+
+  const Stats &GetStats() { return stats_; }
+
+ private:
+  void PowerOnReset();
+  bool Powered();
+  uint8_t ReadReg(uint8_t reg);
+  void WriteReg(uint8_t reg, uint8_t value);
+  uint16_t Steps();
+  int16_t Output(uint8_t reg);
+
+  I2C_HandleTypeDef *hi2c_ = nullptr;
+  uint8_t regs_[128];
+  bool was_powered_ = false;
+  uint64_t reset_done_ = 0;
+  // Pedometer state, the count is steps_ plus whatever accumulated since
+  // pedo_since_ while enabled.
+  unsigned step_rate_ = 0;
+  uint16_t steps_ = 0;
+  uint64_t pedo_since_ = 0;
+  unsigned generation_ = 0;
+  Stats stats_ = {};
+};
+
+extern Imu g_imu;
+
+}  // namespace sim
+}  // namespace hitcon
+
+#endif  // HITCON_SIM_IMU_H_
@@ -0,0 +1,133 @@
+#include <Sim/Machine.h>
+#include <stm32f1xx_hal.h>
+
+#include <algorithm>
+
+namespace hitcon {
+namespace sim {
+
+Machine g_machine;
+
+Machine::Machine() {}
+
+void Machine::Schedule(uint64_t at, Interrupt isr) {
+  pending_.push({at, seq_++, std::move(isr)});
+}
+
+void Machine::Deliver() {
+  if (irq_masked_ || in_isr_) return;
+  while (!pending_.empty() && pending_.top().at <= now_) {
+    // Copy out before popping, the handler may schedule more interrupts.
+    Interrupt isr = std::move(const_cast<Pending &>(pending_.top()).isr);
+    pending_.pop();
+    in_isr_ = true;
+    isr();
+    in_isr_ = false;
+    stats_.interrupts++;
+    // An interrupt handler can't mask interrupts for the code it returns to.
+    if (irq_masked_) break;
+  }
+}
+
+void Machine::CheckEnd() {
+  while (now_ >= end_ && !in_isr_) {
+    if (!on_end_) throw StopSimulation();
+    on_end_();
+  }
+}
+
+void Machine::Poll(unsigned cost) {
+  stats_.polls++;
+  now_ += cost;
+  Deliver();
+  CheckEnd();
+}
+
+void Machine::EnableIrq() {
+  irq_masked_ = false;
+  Deliver();
+}
+
+void Machine::WaitForInterrupt() {
+  stats_.wfi++;
+  // A pending interrupt wakes the core even while masked.
+  if (in_isr_ || (!pending_.empty() && pending_.top().at <= now_)) {
+    Deliver();
+    return;
+  }
+  uint64_t wake = (now_ / kCyclesPerMs + 1) * kCyclesPerMs;
+  if (!pending_.empty()) wake = std::min(wake, pending_.top().at);
+  wake = std::min(wake, std::max(end_, now_));
+  stats_.idle_cycles += wake - now_;
+  now_ = wake;
+  Deliver();
+  CheckEnd();
+}
+
+void Machine::Delay(unsigned ms) {
+  uint64_t until = now_ + static_cast<uint64_t>(ms) * kCyclesPerMs;
+  if (in_isr_) {
+    now_ = until;
+    return;
+  }
+  while (now_ < until) {
+    uint64_t next = until;
+    if (!irq_masked_ && !pending_.empty()) {
+      next = std::min(next, std::max(pending_.top().at, now_));
+    }
+    now_ = std::max(std::min(next, end_), now_);
+    Deliver();
+    CheckEnd();
+  }
+}
+
+}  // namespace sim
+}  // namespace hitcon
+
+using hitcon::sim::g_machine;
+
+uint32_t SystemCoreClock = hitcon::sim::Machine::kCoreClock;
+DWT_Type sim_dwt;
+SysTick_Type sim_systick = {0, hitcon::sim::Machine::kCyclesPerMs - 1, {}, 0};
+CoreDebug_Type sim_core_debug;
+
+namespace {
+// DWT->CYCCNT = x rebases the counter instead of moving time.
+uint32_t g_cyccnt_offset = 0;
+}  // namespace
+
+SimCycleCounter::operator uint32_t() const {
+  g_machine.Poll();
+  return static_cast<uint32_t>(g_machine.Now()) - g_cyccnt_offset;
+}
+
+SimCycleCounter &SimCycleCounter::operator=(uint32_t value) {
+  g_cyccnt_offset = static_cast<uint32_t>(g_machine.Now()) - value;
+  return *this;
+}
+
+SimSysTickValue::operator uint32_t() const {
+  g_machine.Poll();
+  return sim_systick.LOAD - g_machine.Now() % (sim_systick.LOAD + 1);
+}
+
+extern "C" {
+
+void HAL_Init(void) {}
+
+uint32_t HAL_GetTick(void) {
+  g_machine.Poll();
+  return g_machine.GetTick();
+}
+
+void HAL_Delay(uint32_t Delay) { g_machine.Delay(Delay); }
+
+void __disable_irq(void) { g_machine.DisableIrq(); }
+
+void __enable_irq(void) { g_machine.EnableIrq(); }
+
+void __WFI(void) { g_machine.WaitForInterrupt(); }
+
+void __NOP(void) {}
+
+}  // extern "C"
@@ -0,0 +1,108 @@
+/*
+ * Machine.h
+ *
+ *  Virtual clock and interrupt controller of the host simulator.
+ *
+ *  Time is counted in core cycles at the badge's 12MHz HCLK and only moves
+ *  when the firmware gives the simulator control: every HAL call, SysTimer
+ *  read and __enable_irq() is a poll point that charges a fixed number of
+ *  cycles and then takes any interrupt that is due, and __WFI() jumps
+ *  straight to the next interrupt or SysTick. Code between two poll points
+ *  runs in zero virtual time, so the result is deterministic and an idle
+ *  badge runs far faster than real time.
+ */
+
+#ifndef HITCON_SIM_MACHINE_H_
+#define HITCON_SIM_MACHINE_H_
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+namespace hitcon {
+namespace sim {
+
+// Thrown out of the firmware once the simulation reaches its end time.
+struct StopSimulation {};
+
+class Machine {
+ public:
+  static constexpr unsigned kCoreClock = 12000000;
+  static constexpr unsigned kCyclesPerMs = kCoreClock / 1000;
+
+  using Interrupt = std::function<void()>;
+
+  struct Stats {
+    uint64_t polls;
+    uint64_t interrupts;
+    uint64_t wfi;
+    // Cycles skipped over in __WFI().
+    uint64_t idle_cycles;
+  };
+
+  Machine();
+
+  uint64_t Now() const { return now_; }
+  unsigned GetTick() const { return now_ / kCyclesPerMs; }
+
+  // Raise `isr` at cycle `at`, or as soon as interrupts are unmasked if that
+  // is already in the past. Interrupts due at the same cycle run in the order
+  // they were scheduled.
+  void Schedule(uint64_t at, Interrupt isr);
+
+  // Charge `cost` cycles and run every interrupt that is due.
+  void Poll(unsigned cost);
+  // Poll() with the configured default cost.
+  void Poll() { Poll(poll_cost_); }
+  // Sleep until the next interrupt or SysTick, whichever is first.
+  void WaitForInterrupt();
+  // Let `ms` milliseconds pass, taking interrupts on the way.
+  void Delay(unsigned ms);
+
+  void DisableIrq() { irq_masked_ = true; }
+  void EnableIrq();
+  bool InInterrupt() const { return in_isr_; }
+
+  // Stop the firmware by throwing StopSimulation once Now() reaches `cycles`.
+  void SetEndTime(uint64_t cycles) { end_ = cycles; }
+  // Call `on_end` instead of throwing. It runs at a poll point with interrupts
+  // taken care of and is expected to move the end time before it returns.
+  void SetOnEnd(std::function<void()> on_end) { on_end_ = std::move(on_end); }
+  // Cycles charged by Poll(), a rough stand-in for the code executed between
+  // two calls into the HAL.
+  void SetPollCost(unsigned cycles) { poll_cost_ = cycles; }
+
+  const Stats &GetStats() const { return stats_; }
+
+ private:
+  struct Pending {
+    uint64_t at;
+    uint64_t seq;
+    Interrupt isr;
+    bool operator>(const Pending &other) const {
+      return at != other.at ? at > other.at : seq > other.seq;
+    }
+  };
+
+  void Deliver();
+  void CheckEnd();
+
+  uint64_t now_ = 0;
+  uint64_t end_ = UINT64_MAX;
+  uint64_t seq_ = 0;
+  unsigned poll_cost_ = 20;
+  bool irq_masked_ = false;
+  bool in_isr_ = false;
+  std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>>
+      pending_;
+  std::function<void()> on_end_;
+  Stats stats_ = {};
+};
+
+extern Machine g_machine;
+
+}  // namespace sim
+}  // namespace hitcon
+
+#endif  // HITCON_SIM_MACHINE_H_
@@ -0,0 +1,291 @@
+#include <Sim/Machine.h>
+#include <Sim/Peripherals.h>
+#include <tim.h>
+
+#include <cstring>
+
+namespace hitcon {
+namespace sim {
+
+Bus g_bus;
+Gpio g_gpio;
+Dma g_dma;
+
+namespace {
+
+constexpr uint32_t kTimCen = 1U << 0;
+constexpr uint32_t kTimSmsExternal1 = 0x7U;
+
+unsigned PortIndex(GPIO_TypeDef *port) { return port - sim_gpio; }
+
+unsigned DataWidth(DMA_HandleTypeDef *hdma) {
+  switch (hdma->Init.PeriphDataAlignment) {
+    case DMA_PDATAALIGN_BYTE:
+      return 1;
+    case DMA_PDATAALIGN_HALFWORD:
+      return 2;
+    default:
+      return 4;
+  }
+}
+
+}  // namespace
+
+void Bus::OnRead(const volatile void *reg, ReadHook hook) {
+  read_hooks_[reinterpret_cast<uintptr_t>(reg)] = std::move(hook);
+}
+
+void Bus::OnWrite(const volatile void *reg, WriteHook hook) {
+  write_hooks_[reinterpret_cast<uintptr_t>(reg)] = std::move(hook);
+}
+
+uint32_t Bus::Read(uintptr_t addr, unsigned width, uint64_t at) {
+  auto it = read_hooks_.find(addr);
+  if (it != read_hooks_.end()) return it->second(at);
+  uint32_t value = 0;
+  memcpy(&value, reinterpret_cast<const void *>(addr), width);
+  return value;
+}
+
+void Bus::Write(uintptr_t addr, uint32_t value, unsigned width, uint64_t at) {
+  auto it = write_hooks_.find(addr);
+  if (it != write_hooks_.end()) {
+    it->second(value, at);
+    return;
+  }
+  memcpy(reinterpret_cast<void *>(addr), &value, width);
+}
+
+void Gpio::Init() {
+  for (GPIO_TypeDef &port : sim_gpio) {
+    port = {};
+    port.IDR = 0xFFFF;
+    GPIO_TypeDef *p = &port;
+    g_bus.OnRead(&port.IDR, [this, p](uint64_t at) { return ReadIdr(p, at); });
+    g_bus.OnWrite(&port.BSRR, [this, p](uint32_t value, uint64_t) {
+      WriteOdr(p, (p->ODR & ~(value >> 16)) | (value & 0xFFFF));
+    });
+  }
+  sources_.clear();
+  for (uint32_t &mask : exti_) mask = 0;
+}
+
+void Gpio::SetInput(GPIO_TypeDef *port, uint16_t pin, bool level) {
+  bool old = port->IDR & pin;
+  if (level) {
+    port->IDR |= pin;
+  } else {
+    port->IDR &= ~static_cast<uint32_t>(pin);
+  }
+  if (old != level && (exti_[PortIndex(port)] & pin)) {
+    g_machine.Schedule(g_machine.Now(), [pin]() { HAL_GPIO_EXTI_Callback(pin); });
+  }
+}
+
+void Gpio::SetSource(GPIO_TypeDef *port, uint16_t pin, Source source) {
+  sources_.push_back({port, pin, std::move(source)});
+}
+
+void Gpio::EnableExti(GPIO_TypeDef *port, uint16_t pin) {
+  exti_[PortIndex(port)] |= pin;
+}
+
+uint32_t Gpio::ReadIdr(GPIO_TypeDef *port, uint64_t at) {
+  uint32_t value = port->IDR;
+  for (Pin &p : sources_) {
+    if (p.port != port) continue;
+    if (p.source(at)) {
+      value |= p.pin;
+    } else {
+      value &= ~static_cast<uint32_t>(p.pin);
+    }
+  }
+  return value;
+}
+
+void Gpio::WriteOdr(GPIO_TypeDef *port, uint32_t value) { port->ODR = value; }
+
+uint64_t Dma::RequestPeriod(TIM_HandleTypeDef *htim) {
+  if (!htim || !(htim->Instance->CR1 & kTimCen)) return 0;
+  uint64_t ticks = static_cast<uint64_t>(htim->Init.Prescaler + 1) *
+                   (htim->Init.Period + 1);
+  // TIM2 counts TIM3 update events (slave mode, ITR2), see MX_TIM2_Init().
+  if (htim->Instance == TIM2 &&
+      (htim->Instance->SMCR & kTimSmsExternal1) == kTimSmsExternal1) {
+    return ticks * RequestPeriod(&htim3);
+  }
+  return ticks;
+}
+
+HAL_StatusTypeDef Dma::Start(DMA_HandleTypeDef *hdma, uintptr_t src,
+                             uintptr_t dst, uint32_t len) {
+  g_machine.Poll();
+  if (!len || hdma->State == HAL_DMA_STATE_BUSY) return HAL_BUSY;
+  Channel &ch = channels_[hdma];
+  ch.src = src;
+  ch.dst = dst;
+  ch.len = len;
+  ch.generation++;
+  ch.armed = true;
+  ch.running = false;
+  hdma->State = HAL_DMA_STATE_BUSY;
+  Begin(hdma, ch);
+  return HAL_OK;
+}
+
+void Dma::Abort(DMA_HandleTypeDef *hdma) {
+  Channel &ch = channels_[hdma];
+  ch.generation++;
+  ch.armed = false;
+  ch.running = false;
+  hdma->State = HAL_DMA_STATE_READY;
+}
+
+void Dma::OnTimerStart() {
+  for (auto &entry : channels_) {
+    if (entry.second.armed && !entry.second.running) {
+      Begin(entry.first, entry.second);
+    }
+  }
+}
+
+uint64_t Dma::NextInterrupt(DMA_HandleTypeDef *hdma) {
+  Channel &ch = channels_[hdma];
+  return ch.running ? ch.next_interrupt : 0;
+}
+
+uint64_t Dma::InterruptPeriod(DMA_HandleTypeDef *hdma) {
+  Channel &ch = channels_[hdma];
+  return ch.len / 2 * ch.period;
+}
+
+void Dma::Begin(DMA_HandleTypeDef *hdma, Channel &ch) {
+  ch.period =
+      RequestPeriod(static_cast<TIM_HandleTypeDef *>(hdma->Parent));
+  if (!ch.period) return;
+  ch.running = true;
+  ch.pos = 0;
+  ch.base = g_machine.Now();
+  ScheduleNext(hdma, ch);
+}
+
+void Dma::ScheduleNext(DMA_HandleTypeDef *hdma, Channel &ch) {
+  uint32_t until = ch.pos < ch.len / 2 ? ch.len / 2 : ch.len;
+  unsigned generation = ch.generation;
+  ch.next_interrupt = ch.base + until * ch.period;
+  if (ch.lookahead && hdma->Init.Direction == DMA_MEMORY_TO_PERIPH) {
+    Transfer(hdma, ch, until);
+  }
+  g_machine.Schedule(ch.next_interrupt, [this, hdma, until, generation]() {
+    Channel &ch = channels_[hdma];
+    if (ch.generation != generation || !ch.running) return;
+    Transfer(hdma, ch, until);
+    if (until < ch.len) {
+      ch.stats.half_complete++;
+      ScheduleNext(hdma, ch);
+      if (hdma->XferHalfCpltCallback) hdma->XferHalfCpltCallback(hdma);
+      return;
+    }
+    ch.stats.complete++;
+    if (hdma->Init.Mode == DMA_CIRCULAR) {
+      ch.pos = 0;
+      ch.base += ch.len * ch.period;
+      ScheduleNext(hdma, ch);
+    } else {
+      ch.armed = false;
+      ch.running = false;
+      hdma->State = HAL_DMA_STATE_READY;
+    }
+    if (hdma->XferCpltCallback) hdma->XferCpltCallback(hdma);
+  });
+}
+
+void Dma::Transfer(DMA_HandleTypeDef *hdma, Channel &ch, uint32_t until) {
+  unsigned width = DataWidth(hdma);
+  bool to_periph = hdma->Init.Direction == DMA_MEMORY_TO_PERIPH;
+  transferring_ = hdma;
+  for (; ch.pos < until; ch.pos++) {
+    uint64_t at = ch.base + (ch.pos + 1) * ch.period;
+    if (to_periph) {
+      uint32_t value = 0;
+      memcpy(&value, reinterpret_cast<const void *>(ch.src + ch.pos * width),
+             width);
+      g_bus.Write(ch.dst, value, width, at);
+    } else {
+      uint32_t value = g_bus.Read(ch.src, width, at);
+      memcpy(reinterpret_cast<void *>(ch.dst + ch.pos * width), &value, width);
+    }
+    ch.stats.elements++;
+  }
+  transferring_ = nullptr;
+}
+
+}  // namespace sim
+}  // namespace hitcon
+
+using namespace hitcon::sim;
+
+GPIO_TypeDef sim_gpio[3];
+TIM_TypeDef sim_tim[4];
+DMA_Channel_TypeDef sim_dma1_channel[7];
+
+extern "C" {
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+  g_machine.Poll();
+  return (g_gpio.ReadIdr(GPIOx, g_machine.Now()) & GPIO_Pin) ? GPIO_PIN_SET
+                                                             : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin,
+                       GPIO_PinState PinState) {
+  g_machine.Poll();
+  if (PinState == GPIO_PIN_SET) {
+    g_gpio.WriteOdr(GPIOx, GPIOx->ODR | GPIO_Pin);
+  } else {
+    g_gpio.WriteOdr(GPIOx, GPIOx->ODR & ~static_cast<uint32_t>(GPIO_Pin));
+  }
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+  g_machine.Poll();
+  g_gpio.WriteOdr(GPIOx, GPIOx->ODR ^ GPIO_Pin);
+}
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uintptr_t SrcAddress,
+                                   uintptr_t DstAddress, uint32_t DataLength) {
+  return g_dma.Start(hdma, SrcAddress, DstAddress, DataLength);
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma) {
+  g_dma.Abort(hdma);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim) {
+  g_machine.Poll();
+  htim->Instance->CR1 |= kTimCen;
+  htim->State = HAL_TIM_STATE_READY;
+  g_dma.OnTimerStart();
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+  htim->Instance->CCER |= 1U << Channel;
+  return HAL_TIM_Base_Start(htim);
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef *htim, uint32_t Channel) {
+  g_machine.Poll();
+  htim->Instance->CCER &= ~(1U << Channel);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop_DMA(TIM_HandleTypeDef *htim,
+                                       uint32_t Channel) {
+  DMA_HandleTypeDef *hdma = htim->hdma[TIM_DMA_ID_CC1 + (Channel >> 2U)];
+  if (hdma) g_dma.Abort(hdma);
+  return HAL_TIM_PWM_Stop(htim, Channel);
+}
+
+}  // extern "C"
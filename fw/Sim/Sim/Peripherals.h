@@ -0,0 +1,136 @@
+/*
+ * Peripherals.h
+ *
+ *  GPIO, timer triggered DMA and the register bus between them.
+ */
+
+#ifndef HITCON_SIM_PERIPHERALS_H_
+#define HITCON_SIM_PERIPHERALS_H_
+
+#include <stm32f1xx_hal.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace hitcon {
+namespace sim {
+
+// Peripheral registers as seen by the DMA controller. Addresses without a
+// hook are read and written as plain memory.
+class Bus {
+ public:
+  using ReadHook = std::function<uint32_t(uint64_t at)>;
+  using WriteHook = std::function<void(uint32_t value, uint64_t at)>;
+
+  void OnRead(const volatile void *reg, ReadHook hook);
+  // Replaces any previous hook on the same register.
+  void OnWrite(const volatile void *reg, WriteHook hook);
+
+  uint32_t Read(uintptr_t addr, unsigned width, uint64_t at);
+  void Write(uintptr_t addr, uint32_t value, unsigned width, uint64_t at);
+
+ private:
+  std::unordered_map<uintptr_t, ReadHook> read_hooks_;
+  std::unordered_map<uintptr_t, WriteHook> write_hooks_;
+};
+
+class Gpio {
+ public:
+  // Level of an input pin as a function of time, in cycles.
+  using Source = std::function<bool(uint64_t at)>;
+
+  // Inputs float high, like the pulled up buttons and the idle IR receiver.
+  void Init();
+
+  void SetInput(GPIO_TypeDef *port, uint16_t pin, bool level);
+  void SetSource(GPIO_TypeDef *port, uint16_t pin, Source source);
+  // Raise HAL_GPIO_EXTI_Callback() on every edge of this pin.
+  void EnableExti(GPIO_TypeDef *port, uint16_t pin);
+
+  uint32_t ReadIdr(GPIO_TypeDef *port, uint64_t at);
+  void WriteOdr(GPIO_TypeDef *port, uint32_t value);
+
+ private:
+  struct Pin {
+    GPIO_TypeDef *port;
+    uint16_t pin;
+    Source source;
+  };
+
+  std::vector<Pin> sources_;
+  uint32_t exti_[3] = {};
+};
+
+// Timer triggered DMA. Every request of the timer moves one element, the
+// half and complete interrupts are raised at the time of the element that
+// finishes the half.
+class Dma {
+ public:
+  struct Stats {
+    uint64_t elements;
+    uint64_t half_complete;
+    uint64_t complete;
+  };
+
+  HAL_StatusTypeDef Start(DMA_HandleTypeDef *hdma, uintptr_t src,
+                          uintptr_t dst, uint32_t len);
+  void Abort(DMA_HandleTypeDef *hdma);
+  // Move the elements of a memory to peripheral channel as soon as their half
+  // of the buffer starts, with the times they are due at. The firmware has
+  // filled that half by then, so a bus hook gets to see the waveform ahead.
+  void SetLookahead(DMA_HandleTypeDef *hdma, bool lookahead) {
+    channels_[hdma].lookahead = lookahead;
+  }
+  // Channels wait for their timer (DMA_HandleTypeDef::Parent) to run.
+  void OnTimerStart();
+
+  // Cycle of the channel's next half or complete interrupt, 0 if it isn't
+  // running. Elements of a peripheral to memory channel are read then.
+  uint64_t NextInterrupt(DMA_HandleTypeDef *hdma);
+  // Cycles between two of the channel's interrupts.
+  uint64_t InterruptPeriod(DMA_HandleTypeDef *hdma);
+  // The channel moving an element right now, for bus hooks that care who is
+  // asking. nullptr outside of a transfer.
+  DMA_HandleTypeDef *Transferring() const { return transferring_; }
+
+  const Stats &GetStats(DMA_HandleTypeDef *hdma) { return channels_[hdma].stats; }
+
+  // Cycles between two requests of a timer, 0 if it isn't counting.
+  static uint64_t RequestPeriod(TIM_HandleTypeDef *htim);
+
+ private:
+  struct Channel {
+    uintptr_t src;
+    uintptr_t dst;
+    uint32_t len;
+    // Next element to move, and the cycle the element before it moved at.
+    uint32_t pos;
+    uint64_t base;
+    uint64_t period;
+    uint64_t next_interrupt;
+    unsigned generation;
+    bool armed;
+    bool running;
+    bool lookahead;
+    Stats stats;
+  };
+
+  void Begin(DMA_HandleTypeDef *hdma, Channel &ch);
+  void ScheduleNext(DMA_HandleTypeDef *hdma, Channel &ch);
+  void Transfer(DMA_HandleTypeDef *hdma, Channel &ch, uint32_t until);
+
+  std::map<DMA_HandleTypeDef *, Channel> channels_;
+  DMA_HandleTypeDef *transferring_ = nullptr;
+};
+
+extern Bus g_bus;
+extern Gpio g_gpio;
+extern Dma g_dma;
+
+}  // namespace sim
+}  // namespace hitcon
+
+#endif  // HITCON_SIM_PERIPHERALS_H_
@@ -0,0 +1,120 @@
+#include <Sim/Machine.h>
+#include <Sim/Uart.h>
+
+namespace hitcon {
+namespace sim {
+
+Uart g_uart;
+
+void Uart::Init(UART_HandleTypeDef *huart, bool loopback) {
+  huart_ = huart;
+  huart->gState = HAL_UART_STATE_READY;
+  huart->RxState = HAL_UART_STATE_READY;
+  huart->Instance->SR = USART_SR_TC;
+  if (loopback) {
+    sink_ = [this](uint8_t byte) { Receive(byte); };
+  } else {
+    sink_ = nullptr;
+  }
+}
+
+uint64_t Uart::ByteCycles() {
+  return static_cast<uint64_t>(Machine::kCoreClock) * kBitsPerByte /
+         huart_->Init.BaudRate;
+}
+
+HAL_StatusTypeDef Uart::Transmit(const uint8_t *data, uint16_t size) {
+  g_machine.Poll();
+  if (huart_->gState != HAL_UART_STATE_READY) return HAL_BUSY;
+  if (!data || !size) return HAL_ERROR;
+  huart_->pTxBuffPtr = data;
+  huart_->TxXferSize = size;
+  huart_->TxXferCount = size;
+  huart_->gState = HAL_UART_STATE_BUSY_TX;
+  huart_->Instance->SR &= ~USART_SR_TC;
+  TransmitNext(g_machine.Now() + ByteCycles());
+  return HAL_OK;
+}
+
+void Uart::TransmitNext(uint64_t at) {
+  // The byte is copied into DR when it starts, like the TXE interrupt would.
+  uint8_t byte = *huart_->pTxBuffPtr++;
+  g_machine.Schedule(at, [this, byte, at]() {
+    stats_.tx_bytes++;
+    huart_->TxXferCount--;
+    if (huart_->TxXferCount) {
+      TransmitNext(at + ByteCycles());
+    } else {
+      huart_->gState = HAL_UART_STATE_READY;
+      huart_->Instance->SR |= USART_SR_TC;
+    }
+    if (sink_) sink_(byte);
+    if (!huart_->TxXferCount) HAL_UART_TxCpltCallback(huart_);
+  });
+}
+
+void Uart::Receive(uint8_t byte) {
+  stats_.rx_bytes++;
+  if (huart_->RxState != HAL_UART_STATE_BUSY_RX) {
+    // Nobody is reading, the byte waits in DR until the next one overruns it.
+    if (huart_->Instance->SR & USART_SR_RXNE) {
+      huart_->Instance->SR |= USART_SR_ORE;
+      stats_.overruns++;
+    } else {
+      huart_->Instance->DR = byte;
+      huart_->Instance->SR |= USART_SR_RXNE;
+    }
+    return;
+  }
+  *huart_->pRxBuffPtr++ = byte;
+  if (--huart_->RxXferCount == 0) {
+    huart_->RxState = HAL_UART_STATE_READY;
+    HAL_UART_RxCpltCallback(huart_);
+  }
+}
+
+HAL_StatusTypeDef Uart::StartReceive(uint8_t *data, uint16_t size) {
+  g_machine.Poll();
+  if (huart_->RxState != HAL_UART_STATE_READY) return HAL_BUSY;
+  if (!data || !size) return HAL_ERROR;
+  huart_->pRxBuffPtr = data;
+  huart_->RxXferSize = size;
+  huart_->RxXferCount = size;
+  huart_->RxState = HAL_UART_STATE_BUSY_RX;
+  uint32_t sr = huart_->Instance->SR;
+  if (sr & USART_SR_ORE) {
+    // Enabling the interrupt reports the overrun and ends the reception.
+    g_machine.Schedule(g_machine.Now(), [this]() {
+      huart_->ErrorCode |= HAL_UART_ERROR_ORE;
+      huart_->RxState = HAL_UART_STATE_READY;
+      huart_->Instance->SR &= ~(USART_SR_ORE | USART_SR_RXNE);
+      HAL_UART_ErrorCallback(huart_);
+    });
+  } else if (sr & USART_SR_RXNE) {
+    g_machine.Schedule(g_machine.Now(), [this]() {
+      huart_->Instance->SR &= ~USART_SR_RXNE;
+      stats_.rx_bytes--;
+      Receive(huart_->Instance->DR);
+    });
+  }
+  return HAL_OK;
+}
+
+}  // namespace sim
+}  // namespace hitcon
+
+using hitcon::sim::g_uart;
+
+extern "C" {
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart,
+                                       const uint8_t *pData, uint16_t Size) {
+  return g_uart.Transmit(pData, Size);
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart,
+                                      uint8_t *pData, uint16_t Size) {
+  return g_uart.StartReceive(pData, Size);
+}
+
+}  // extern "C"
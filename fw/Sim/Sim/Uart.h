@@ -0,0 +1,58 @@
+/*
+ * Uart.h
+ *
+ *  USART2, the cross board link. Bytes leave at the configured baud rate and
+ *  by default loop straight back into RX, as if the badge were plugged into
+ *  itself.
+ */
+
+#ifndef HITCON_SIM_UART_H_
+#define HITCON_SIM_UART_H_
+
+#include <stm32f1xx_hal.h>
+
+#include <cstdint>
+#include <functional>
+
+namespace hitcon {
+namespace sim {
+
+class Uart {
+ public:
+  // Start bit, 8 data bits and a stop bit.
+  static constexpr unsigned kBitsPerByte = 10;
+
+  using TxSink = std::function<void(uint8_t byte)>;
+
+  struct Stats {
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    uint64_t overruns;
+  };
+
+  void Init(UART_HandleTypeDef *huart, bool loopback);
+  // Called with each byte once it's fully on the wire. Replaces loopback.
+  void SetTxSink(TxSink sink) { sink_ = std::move(sink); }
+  // A byte finished arriving on RX.
+  void Receive(uint8_t byte);
+
+  HAL_StatusTypeDef Transmit(const uint8_t *data, uint16_t size);
+  HAL_StatusTypeDef StartReceive(uint8_t *data, uint16_t size);
+
+  const Stats &GetStats() { return stats_; }
+
+ private:
+  uint64_t ByteCycles();
+  void TransmitNext(uint64_t at);
+
+  UART_HandleTypeDef *huart_ = nullptr;
+  TxSink sink_;
+  Stats stats_ = {};
+};
+
+extern Uart g_uart;
+
+}  // namespace sim
+}  // namespace hitcon
+
+#endif  // HITCON_SIM_UART_H_
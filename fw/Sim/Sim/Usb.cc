@@ -0,0 +1,94 @@
+#include <Sim/Machine.h>
+#include <Sim/Peripherals.h>
+#include <Sim/Usb.h>
+#include <main.h>
+#include <usb_device.h>
+#include <usbd_custom_hid_if.h>
+
+#include <cstring>
+#include <vector>
+
+USBD_HandleTypeDef hUsbDeviceFS;
+
+extern "C" void UsbServiceOnDataReceived(uint8_t *data);
+
+namespace hitcon {
+namespace sim {
+
+Usb g_usb;
+
+namespace {
+USBD_CUSTOM_HID_HandleTypeDef g_hid;
+}  // namespace
+
+void Usb::Init() {
+  hUsbDeviceFS = {};
+  g_hid = {};
+  hUsbDeviceFS.dev_state = USBD_STATE_DEFAULT;
+  hUsbDeviceFS.pClassData = &g_hid;
+  g_gpio.EnableExti(USB_DET_GPIO_Port, USB_DET_Pin);
+  g_gpio.SetInput(USB_DET_GPIO_Port, USB_DET_Pin, false);
+}
+
+void Usb::Plug(bool plugged) {
+  g_gpio.SetInput(USB_DET_GPIO_Port, USB_DET_Pin, plugged);
+  unsigned generation = ++generation_;
+  if (!plugged) {
+    hUsbDeviceFS.dev_state = USBD_STATE_DEFAULT;
+    g_hid.state = CUSTOM_HID_IDLE;
+    return;
+  }
+  g_machine.Schedule(
+      g_machine.Now() + kEnumerationMs * Machine::kCyclesPerMs,
+      [this, generation]() {
+        if (generation == generation_) {
+          hUsbDeviceFS.dev_state = USBD_STATE_CONFIGURED;
+        }
+      });
+}
+
+void Usb::SendToDevice(const uint8_t *report) {
+  std::vector<uint8_t> copy(report, report + USBD_CUSTOMHID_OUTREPORT_BUF_SIZE);
+  g_machine.Schedule(g_machine.Now(), [this, copy]() mutable {
+    if (hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED) return;
+    memcpy(g_hid.Report_buf, copy.data(), copy.size());
+    stats_.reports_out++;
+    UsbServiceOnDataReceived(g_hid.Report_buf);
+  });
+}
+
+uint8_t Usb::SendReport(uint8_t *report, uint16_t len) {
+  g_machine.Poll();
+  if (hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED) return USBD_OK;
+  if (g_hid.state != CUSTOM_HID_IDLE) {
+    stats_.busy++;
+    return USBD_BUSY;
+  }
+  g_hid.state = CUSTOM_HID_BUSY;
+  std::vector<uint8_t> copy(report, report + len);
+  unsigned generation = generation_;
+  // The host polls the IN endpoint every bInterval ms.
+  g_machine.Schedule(
+      g_machine.Now() + CUSTOM_HID_FS_BINTERVAL * Machine::kCyclesPerMs,
+      [this, copy, generation]() {
+        if (generation != generation_) return;
+        g_hid.state = CUSTOM_HID_IDLE;
+        stats_.reports_in++;
+        if (sink_) sink_(copy.data(), copy.size());
+      });
+  return USBD_OK;
+}
+
+}  // namespace sim
+}  // namespace hitcon
+
+extern "C" {
+
+void MX_USB_DEVICE_Init(void) { hitcon::sim::g_usb.Init(); }
+
+uint8_t USBD_CUSTOM_HID_SendReport(USBD_HandleTypeDef *pdev, uint8_t *report,
+                                   uint16_t len) {
+  return hitcon::sim::g_usb.SendReport(report, len);
+}
+
+}  // extern "C"
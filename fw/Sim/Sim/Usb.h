@@ -0,0 +1,52 @@
+/*
+ * Usb.h
+ *
+ *  The custom HID interface as seen from the PC. Plugging in raises USB_DET
+ *  and configures the device, reports then go out one per polling interval.
+ */
+
+#ifndef HITCON_SIM_USB_H_
+#define HITCON_SIM_USB_H_
+
+#include <cstdint>
+#include <functional>
+
+namespace hitcon {
+namespace sim {
+
+class Usb {
+ public:
+  // Time from USB_DET to the host selecting a configuration.
+  static constexpr unsigned kEnumerationMs = 100;
+
+  using HostSink = std::function<void(const uint8_t *report, uint16_t len)>;
+
+  struct Stats {
+    uint64_t reports_in;
+    uint64_t reports_out;
+    uint64_t busy;
+  };
+
+  void Init();
+  void Plug(bool plugged);
+  // Reports the badge sends end up here.
+  void SetHostSink(HostSink sink) { sink_ = std::move(sink); }
+  // Deliver an OUT report to the badge, as usbd_custom_hid_if.c would.
+  void SendToDevice(const uint8_t *report);
+
+  uint8_t SendReport(uint8_t *report, uint16_t len);
+
+  const Stats &GetStats() { return stats_; }
+
+ private:
+  HostSink sink_;
+  unsigned generation_ = 0;
+  Stats stats_ = {};
+};
+
+extern Usb g_usb;
+
+}  // namespace sim
+}  // namespace hitcon
+
+#endif  // HITCON_SIM_USB_H_
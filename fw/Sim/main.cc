@@ -0,0 +1,214 @@
+/*
+ * main.cc
+ *
+ *  Entry point of hitcon-sim: brings the board up the way Core/Src/main.cc
+ *  does, runs hitcon_run() for a given amount of virtual time and prints
+ *  what the peripherals did.
+ */
+
+#include <Hitcon.h>
+#include <Service/Sched/Scheduler.h>
+#include <Sim/Board.h>
+#include <Sim/Flash.h>
+#include <Sim/Imu.h>
+#include <Sim/Machine.h>
+#include <Sim/Peripherals.h>
+#include <Sim/Uart.h>
+#include <Sim/Usb.h>
+#include <main.h>
+#include <tim.h>
+#include <usart.h>
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+using namespace hitcon::sim;
+
+namespace {
+
+struct Press {
+  uint16_t pin;
+  unsigned at_ms;
+  unsigned len_ms;
+};
+
+struct Options {
+  double seconds = 10;
+  unsigned poll_cost = 20;
+  bool usb = false;
+  bool loopback = false;
+  unsigned steps_per_minute = 0;
+  const char *flash_in = nullptr;
+  const char *flash_out = nullptr;
+  std::vector<Press> presses;
+};
+
+void Usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--seconds S] [--poll-cost CYCLES] [--usb] "
+          "[--loopback]\n"
+          "          [--press BTN:AT_MS:LEN_MS]... [--steps PER_MINUTE]\n"
+          "          [--flash-in FILE] [--flash-out FILE]\n"
+          "BTN is one of A-H.\n",
+          argv0);
+  exit(2);
+}
+
+bool ParsePress(const char *arg, Press *press) {
+  static constexpr uint16_t kPins[] = {BtnA_Pin, BtnB_Pin, BtnC_Pin,
+                                       BtnD_Pin, BtnE_Pin, BtnF_Pin,
+                                       BtnG_Pin, BtnH_Pin};
+  char button;
+  if (sscanf(arg, "%c:%u:%u", &button, &press->at_ms, &press->len_ms) != 3 ||
+      button < 'A' || button > 'H') {
+    return false;
+  }
+  press->pin = kPins[button - 'A'];
+  return true;
+}
+
+Options ParseArgs(int argc, char **argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!strcmp(arg, "--usb")) {
+      opt.usb = true;
+    } else if (!strcmp(arg, "--loopback")) {
+      // TX wired to RX, the badge then sees itself as a cross board peer.
+      opt.loopback = true;
+    } else if (!value) {
+      Usage(argv[0]);
+    } else if (!strcmp(arg, "--seconds")) {
+      opt.seconds = atof(value);
+      i++;
+    } else if (!strcmp(arg, "--poll-cost")) {
+      opt.poll_cost = atoi(value);
+      i++;
+    } else if (!strcmp(arg, "--steps")) {
+      opt.steps_per_minute = atoi(value);
+      i++;
+    } else if (!strcmp(arg, "--flash-in")) {
+      opt.flash_in = value;
+      i++;
+    } else if (!strcmp(arg, "--flash-out")) {
+      opt.flash_out = value;
+      i++;
+    } else if (!strcmp(arg, "--press")) {
+      Press press;
+      if (!ParsePress(value, &press)) Usage(argv[0]);
+      opt.presses.push_back(press);
+      i++;
+    } else {
+      Usage(argv[0]);
+    }
+  }
+  if (opt.seconds <= 0) Usage(argv[0]);
+  return opt;
+}
+
+// my_assert() divides by zero in debug builds.
+void OnAssert(int) {
+  char msg[96];
+  int len = snprintf(msg, sizeof(msg), "assertion failed at %.6fs virtual\n",
+                     static_cast<double>(g_machine.Now()) / Machine::kCoreClock);
+  write(STDERR_FILENO, msg, len);
+  _exit(3);
+}
+
+void PrintDma(const char *name, DMA_HandleTypeDef *hdma) {
+  const Dma::Stats &s = g_dma.GetStats(hdma);
+  printf("  %-12s %10llu elements %8llu half %8llu complete\n", name,
+         static_cast<unsigned long long>(s.elements),
+         static_cast<unsigned long long>(s.half_complete),
+         static_cast<unsigned long long>(s.complete));
+}
+
+void PrintStats(double host_seconds) {
+  const Machine::Stats &m = g_machine.GetStats();
+  double virtual_seconds =
+      static_cast<double>(g_machine.Now()) / Machine::kCoreClock;
+  printf("virtual %.3fs, host %.3fs, %.1fx real time\n", virtual_seconds,
+         host_seconds, virtual_seconds / host_seconds);
+  printf("cpu idle %.1f%%, %llu polls, %llu interrupts, %llu wfi\n",
+         100.0 * m.idle_cycles / g_machine.Now(),
+         static_cast<unsigned long long>(m.polls),
+         static_cast<unsigned long long>(m.interrupts),
+         static_cast<unsigned long long>(m.wfi));
+  // What DebugApp shows, over the last whole second.
+  printf("scheduler idle %u%%\n",
+         hitcon::service::sched::scheduler.GetIdlePercent());
+  printf("dma:\n");
+  PrintDma("display", &hdma_tim1_up);
+  PrintDma("ir rx", &hdma_tim2_ch3);
+  PrintDma("ir tx", &hdma_tim3_ch3);
+  PrintDma("buttons", &hdma_tim4_ch2);
+  const Uart::Stats &u = g_uart.GetStats();
+  printf("uart: %llu tx, %llu rx, %llu overruns\n",
+         static_cast<unsigned long long>(u.tx_bytes),
+         static_cast<unsigned long long>(u.rx_bytes),
+         static_cast<unsigned long long>(u.overruns));
+  const Imu::Stats &i = g_imu.GetStats();
+  printf("i2c: %llu reads, %llu writes, %llu nacks\n",
+         static_cast<unsigned long long>(i.reads),
+         static_cast<unsigned long long>(i.writes),
+         static_cast<unsigned long long>(i.nacks));
+  const Flash::Stats &f = g_flash.GetStats();
+  printf("flash: %llu erases, %llu programs, %llu errors\n",
+         static_cast<unsigned long long>(f.erases),
+         static_cast<unsigned long long>(f.programs),
+         static_cast<unsigned long long>(f.errors));
+  const Usb::Stats &b = g_usb.GetStats();
+  printf("usb: %llu reports in, %llu out, %llu busy\n",
+         static_cast<unsigned long long>(b.reports_in),
+         static_cast<unsigned long long>(b.reports_out),
+         static_cast<unsigned long long>(b.busy));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options opt = ParseArgs(argc, argv);
+  signal(SIGFPE, OnAssert);
+
+  if (!InitBoard()) {
+    fprintf(stderr, "can't map the flash at 0x%08lx\n",
+            static_cast<unsigned long>(Flash::kBase));
+    return 1;
+  }
+  if (opt.flash_in && !g_flash.Load(opt.flash_in)) {
+    fprintf(stderr, "can't read %s\n", opt.flash_in);
+    return 1;
+  }
+  g_machine.SetPollCost(opt.poll_cost);
+  g_machine.SetEndTime(static_cast<uint64_t>(opt.seconds * Machine::kCoreClock));
+  g_uart.Init(&huart2, opt.loopback);
+  g_imu.SetStepRate(opt.steps_per_minute);
+  for (const Press &press : opt.presses) {
+    uint64_t at = static_cast<uint64_t>(press.at_ms) * Machine::kCyclesPerMs;
+    uint64_t len = static_cast<uint64_t>(press.len_ms) * Machine::kCyclesPerMs;
+    uint16_t pin = press.pin;
+    g_machine.Schedule(at, [pin]() { SetButton(pin, true); });
+    g_machine.Schedule(at + len, [pin]() { SetButton(pin, false); });
+  }
+  if (opt.usb) g_usb.Plug(true);
+
+  auto start = std::chrono::steady_clock::now();
+  try {
+    hitcon_run();
+  } catch (const StopSimulation &) {
+  }
+  std::chrono::duration<double> host = std::chrono::steady_clock::now() - start;
+
+  PrintStats(host.count());
+  if (opt.flash_out && !g_flash.Save(opt.flash_out)) {
+    fprintf(stderr, "can't write %s\n", opt.flash_out);
+    return 1;
+  }
+  return 0;
+}
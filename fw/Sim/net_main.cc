@@ -0,0 +1,140 @@
+/*
+ * net_main.cc
+ *
+ *  Entry point of hitcon-net: runs many badges against a base station per
+ *  cell over a simulated IR medium and reports how the MAC and the
+ *  retransmit policy hold up, see Net/Network.h.
+ */
+
+#include <Net/Network.h>
+#include <Sim/Machine.h>
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+using hitcon::net::Network;
+using hitcon::sim::Machine;
+
+namespace {
+
+Network *g_network = nullptr;
+
+void Usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--badges N] [--cells N] [--seconds S] "
+          "[--rate PER_MINUTE]\n"
+          "          [--retries N] [--ber P] [--ack-delay MS] "
+          "[--turnaround MS]\n"
+          "          [--stagger MS] [--seed N] [--prob-f A,B,C] "
+          "[--retx BASE,JITTER]\n"
+          "          [--fec 0|1] [--ack-batch N] [--ack-hold MS]\n"
+          "          [--ack-by-id 0|1]\n"
+          "--prob-f is IrMac's transmit probability, 256 / (256 + A * l^2 / 16 "
+          "+ B * l + C)\n"
+          "at load factor l in percent.\n"
+          "--retx is in IrController routine ticks of one second.\n",
+          argv0);
+  exit(2);
+}
+
+Network::Options ParseArgs(int argc, char **argv) {
+  Network::Options opt;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) {
+      Usage(argv[0]);
+    } else if (!strcmp(arg, "--badges")) {
+      opt.badges = atoi(value);
+    } else if (!strcmp(arg, "--cells")) {
+      opt.cells = atoi(value);
+    } else if (!strcmp(arg, "--seconds")) {
+      opt.seconds = atof(value);
+    } else if (!strcmp(arg, "--rate")) {
+      opt.rate = atof(value);
+    } else if (!strcmp(arg, "--retries")) {
+      opt.retries = atoi(value);
+    } else if (!strcmp(arg, "--ber")) {
+      opt.ber = atof(value);
+    } else if (!strcmp(arg, "--fec")) {
+      opt.fec = atoi(value);
+    } else if (!strcmp(arg, "--ack-batch")) {
+      opt.ack_batch = atoi(value);
+      if (opt.ack_batch < 1 || opt.ack_batch > hitcon::ir::ACK_BATCH_MAX) {
+        Usage(argv[0]);
+      }
+    } else if (!strcmp(arg, "--ack-hold")) {
+      opt.ack_hold_ms = atoi(value);
+    } else if (!strcmp(arg, "--ack-by-id")) {
+      opt.ack_by_id = atoi(value);
+    } else if (!strcmp(arg, "--ack-delay")) {
+      opt.ack_delay_ms = atoi(value);
+    } else if (!strcmp(arg, "--turnaround")) {
+      opt.turnaround_ms = atoi(value);
+    } else if (!strcmp(arg, "--stagger")) {
+      opt.stagger_ms = atoi(value);
+    } else if (!strcmp(arg, "--seed")) {
+      opt.seed = strtoull(value, nullptr, 0);
+    } else if (!strcmp(arg, "--prob-f")) {
+      unsigned a, b, c;
+      if (sscanf(value, "%u,%u,%u", &a, &b, &c) != 3 || a > 255 || b > 255 ||
+          c > 255) {
+        Usage(argv[0]);
+      }
+      opt.set_prob = true;
+      opt.prob[0] = a;
+      opt.prob[1] = b;
+      opt.prob[2] = c;
+    } else if (!strcmp(arg, "--retx")) {
+      unsigned base, jitter;
+      if (sscanf(value, "%u,%u", &base, &jitter) != 2 || base > 65535 ||
+          jitter / 2 > base) {
+        Usage(argv[0]);
+      }
+      opt.set_retx = true;
+      opt.retx_base = base;
+      opt.retx_jitter = jitter;
+    } else {
+      Usage(argv[0]);
+    }
+    i++;
+  }
+  if (opt.seconds <= 0 || !opt.badges || !opt.cells || opt.retries > 7 ||
+      opt.ber < 0 || opt.ber > 1) {
+    Usage(argv[0]);
+  }
+  return opt;
+}
+
+// my_assert() divides by zero in debug builds.
+void OnAssert(int) {
+  char msg[96];
+  int len = snprintf(msg, sizeof(msg),
+                     "assertion failed on badge %d at %.6fs virtual\n",
+                     g_network->Current(),
+                     static_cast<double>(g_network->Now()) / Machine::kCoreClock);
+  write(STDERR_FILENO, msg, len);
+  _exit(3);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Network network(ParseArgs(argc, argv));
+  g_network = &network;
+  signal(SIGFPE, OnAssert);
+  if (!network.Init()) return 1;
+
+  auto start = std::chrono::steady_clock::now();
+  network.Run();
+  std::chrono::duration<double> host = std::chrono::steady_clock::now() - start;
+  network.Report(host.count());
+
+  // The badges' stacks are abandoned mid-run, skip the firmware's destructors.
+  fflush(stdout);
+  _exit(0);
+}
@@ -1,4 +1,5 @@
 import math
+import struct
 import time
 import hid
 import crc32
@@ -108,6 +109,29 @@ def send_badusb_script(script):
         #     tmp=device.read(8)
         #     print(tmp)
 
+# Scheduler profile, needs firmware built with SCHED_PROFILING, empty without
+# Returns (records, dropped), see ProfileRecord in Service/Sched/Profiler.h
+def read_sched_profile(reset=False):
+    send_command([0x09, 0x01 if reset else 0x00] + [0x00]*6)
+    chunks = {}
+    while True:
+        r = device.read(8)
+        if r[0] == 0xFF:
+            dropped = int.from_bytes(bytes(r[2:6]), 'little')
+            break
+        chunks.setdefault(r[0], {})[r[1]] = bytes(r[2:8])
+    records = []
+    for slot in sorted(chunks):
+        raw = b''.join(chunks[slot][i] for i in sorted(chunks[slot]))[:64]
+        fields = struct.unpack('<IIHHIIIQ16H', raw)
+        records.append({
+            'callback': fields[0], 'thisptr': fields[1], 'prio': fields[2],
+            'late_starts': fields[3], 'runs': fields[4], 'min_us': fields[5],
+            'max_us': fields[6], 'total_us': fields[7],
+            'latency_hist': list(fields[8:]),
+        })
+    return records, dropped
+
 def send_command(command):
     k=device.write([2] + command)
     return k
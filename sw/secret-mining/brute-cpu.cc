@@ -1,13 +1,18 @@
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <set>
+#include <random>
+#include <string>
 #include <vector>
 
+#include "common.h"
 #include "keccak.h"
+#include "miner.h"
 #include "sha3_cpu.h"
+#include "sha3_lanes.h"
 
 struct bdata_t {
   union {
@@ -15,34 +20,85 @@ struct bdata_t {
     uint8_t u8[16];
   } u;
 };
+// SHA3_lanes::hash16() takes them back to back.
+static_assert(sizeof(bdata_t) == SHA3_lanes::kMessageSize, "no padding");
 
 namespace {
-// Look-up Table for the number of leading zero bits in a nibble
-constexpr int LEADING_ZERO_BITS_LUT[16] = {4, 3, 2, 2, 1, 1, 1, 1,
-                                           0, 0, 0, 0, 0, 0, 0, 0};
+void setPrefix(bdata_t &d, int col) {
+  memset(&d.u.u8[0], 0, 16);
+  memcpy(&d.u.u8[0], "HITCON", 6);
+  d.u.u8[7] = col & 0xFF;
+}
+
+void setNonce(bdata_t &d, uint64_t i) {
+  for (int j = 0; j < 8; j++) {
+    d.u.u8[15 - j] = i & 0x0FF;
+    i = i >> 8;
+  }
+}
 }  // namespace
 
-// Computes the number of leading zero bits in the given binary hash
-int ComputePrefixZero(const uint8_t *bin_hash) {
-  int count = 0;
-  for (size_t i = 0; i < SHA3_256_HASH_SIZE; i++) {
-    uint8_t byte = bin_hash[i];
-    uint8_t high_nibble = (byte & 0xF0) >> 4;
-    if (high_nibble != 0) {
-      return count + LEADING_ZERO_BITS_LUT[high_nibble];
+// Known-answer check of a SHA3_lanes kernel against sha3_Finalize(), on
+// count candidates laid out the way the miner does, from a random column and
+// start.
+bool check_sha3_lanes(const SHA3_lanes &sha3, size_t count) {
+  std::mt19937_64 rng(count);
+  bdata_t d[SHA3_lanes::kMaxLanes];
+  uint8_t hashes[SHA3_lanes::kMaxLanes][SHA3_256_HASH_SIZE];
+  const size_t lanes = sha3.lanes();
+  for (size_t n = 0; n < count; n += lanes) {
+    const int col = rng() % 16;
+    const uint64_t start = n < count / 2 ? n : rng();
+    for (size_t lane = 0; lane < lanes; lane++) {
+      setPrefix(d[lane], col);
+      setNonce(d[lane], start + lane);
     }
-    count += 4;
-
-    uint8_t low_nibble = byte & 0x0F;
-    if (low_nibble != 0) {
-      return count + LEADING_ZERO_BITS_LUT[low_nibble];
+    sha3.hash16(d[0].u.u8, hashes[0]);
+    uint64_t nonces[SHA3_lanes::kMaxLanes], firsts[SHA3_lanes::kMaxLanes];
+    for (size_t lane = 0; lane < lanes; lane++) {
+      nonces[lane] = nonceWord(start + lane);
+    }
+    sha3.firstWords16(prefixWord(col), nonces, firsts);
+    // Which lanes have at least 0, 1, 2, 4 and 8 leading zero bits.
+    const int thresholds[] = {0, 1, 2, 4, 8};
+    unsigned hits[5];
+    for (int t = 0; t < 5; t++) {
+      hits[t] = sha3.firstWords16Zero(prefixWord(col), nonces,
+                                      leadingZerosMask(thresholds[t]), firsts);
+    }
+    for (size_t lane = 0; lane < lanes; lane++) {
+      sha3_context c;
+      sha3_Init256(&c);
+      sha3_UpdateWord(&c, &d[lane].u.u64[0]);
+      sha3_UpdateWord(&c, &d[lane].u.u64[1]);
+      const void *hash = sha3_Finalize(&c);
+      if (memcmp(hash, hashes[lane], SHA3_256_HASH_SIZE)) {
+        printf("%s: mismatch at col %d, %lu\n", sha3.name(), col,
+               start + lane);
+        return false;
+      }
+      uint64_t first;
+      memcpy(&first, hash, sizeof(first));
+      first = toLittleEndian(first);
+      if (firsts[lane] != first ||
+          SHA3_cpu::firstWord16(prefixWord(col), nonces[lane]) != first) {
+        printf("%s: first word mismatch at col %d, %lu\n", sha3.name(), col,
+               start + lane);
+        return false;
+      }
+      const int zeros = ComputePrefixZero(static_cast<const uint8_t *>(hash));
+      bool ok = ComputePrefixZero(first) == std::min(zeros, 64);
+      for (int t = 0; t < 5; t++) {
+        ok = ok && ((hits[t] >> lane) & 1) == (zeros >= thresholds[t]);
+      }
+      if (!ok) {
+        printf("%s: leading zeros mismatch at col %d, %lu\n", sha3.name(),
+               col, start + lane);
+        return false;
+      }
     }
-    count += 4;
   }
-  // All bytes are zero, so return the total number of bits in the hash.
-  // return SHA3_256_HASH_SIZE * 8;
-  // Ah screw it, nobody gets here, might as well **** around.
-  return *reinterpret_cast<int *>(0);
+  return true;
 }
 
 bool check_compatibility_and_speed() {
@@ -113,48 +169,86 @@ bool check_compatibility_and_speed() {
             .count();
     printf("SHA3_cpu: %ld ms\n", duration);
   }
+  {
+    uint64_t sink = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 1000000; ++i) {
+      sink ^= SHA3_cpu::firstWord16(i, i);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    auto duration =
+        std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+            .count();
+    printf("SHA3_cpu::firstWord16: %ld ms (%lx)\n", duration, sink & 1);
+  }
 
-  return true;
-}
+  for (const std::string &name : SHA3_lanes::supported()) {
+    SHA3_lanes sha3(name);
+    if (!check_sha3_lanes(sha3, 100000)) return false;
 
-int john_brute_use_sha3_cpu(int col, uint64_t start) {
-  struct bdata_t d1;
-
-  memset(&d1.u.u8[0], 0, 16);
-  memcpy(&d1.u.u8[0], "HITCON", 6);
-  d1.u.u8[7] = col & 0xFF;
-
-  SHA3_cpu c(256);
-  std::vector<std::set<uint64_t>> res(256);
-  for (uint64_t i = start;; i++) {
-    c.init();
-    uint64_t i2 = i;
-    for (int j = 0; j < 8; j++) {
-      d1.u.u8[15 - j] = i2 & 0x0FF;
-      i2 = i2 >> 8;
+    bdata_t d[SHA3_lanes::kMaxLanes];
+    uint8_t hashes[SHA3_lanes::kMaxLanes][SHA3_256_HASH_SIZE];
+    for (size_t lane = 0; lane < sha3.lanes(); lane++) setPrefix(d[lane], 0);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 1000000; i += sha3.lanes()) {
+      for (size_t lane = 0; lane < sha3.lanes(); lane++) {
+        setNonce(d[lane], i + lane);
+      }
+      sha3.hash16(d[0].u.u8, hashes[0]);
     }
-    c.add(reinterpret_cast<const uint8_t *>(&d1.u.u64[0]), 8);
-    c.add(reinterpret_cast<const uint8_t *>(&d1.u.u64[1]), 8);
-    std::vector<uint8_t> hash = c.digest();
-    // printf("%d %d %d\n", hash[0], hash[1], hash[2]);
-    int cnt = ComputePrefixZero(hash.data());
-    // printf("%llu - %d\n", i, cnt);
-    auto &r = res[cnt];
-    if (r.size() < 65536) {
-      r.insert(i);
-
-      // currently, print it to stdout
-      // TODO: send to DB
-      printf("%d %d %lu\n", col, cnt, i);
+    auto end = std::chrono::high_resolution_clock::now();
+    auto duration =
+        std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+            .count();
+    printf("SHA3_lanes %s x%zu: %ld ms\n", sha3.name(), sha3.lanes(),
+           duration);
+
+    uint64_t nonces[SHA3_lanes::kMaxLanes], firsts[SHA3_lanes::kMaxLanes];
+    uint64_t sink = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 1000000; i += sha3.lanes()) {
+      for (size_t lane = 0; lane < sha3.lanes(); lane++) {
+        nonces[lane] = nonceWord(i + lane);
+      }
+      sha3.firstWords16(prefixWord(0), nonces, firsts);
+      sink ^= firsts[0];
     }
+    end = std::chrono::high_resolution_clock::now();
+    duration =
+        std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+            .count();
+    printf("SHA3_lanes %s x%zu firstWords16: %ld ms (%lx)\n", sha3.name(),
+           sha3.lanes(), duration, sink & 1);
+
+    // The miner's inner loop once buckets 0-7 are full.
+    std::vector<uint64_t> counts(65);
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 1000000; i += sha3.lanes()) {
+      for (size_t lane = 0; lane < sha3.lanes(); lane++) {
+        nonces[lane] = nonceWord(i + lane);
+      }
+      unsigned hits = sha3.firstWords16Zero(prefixWord(0), nonces,
+                                            leadingZerosMask(8), firsts);
+      while (hits) {
+        counts[ComputePrefixZero(firsts[__builtin_ctz(hits)])]++;
+        hits &= hits - 1;
+      }
+    }
+    end = std::chrono::high_resolution_clock::now();
+    duration =
+        std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+            .count();
+    printf("SHA3_lanes %s x%zu firstWords16Zero: %ld ms (%lu at 8)\n",
+           sha3.name(), sha3.lanes(), duration, counts[8]);
   }
-  return 0;
+
+  return true;
 }
 
 int main() {
-  // if (!check_compatibility_and_speed()) {
-  //   return 1;
-  // }
+  if (getenv("CHECK")) {
+    return check_compatibility_and_speed() ? 0 : 1;
+  }
 
   // get environment variable
   const char *col_str = getenv("COL");
@@ -162,15 +256,60 @@ int main() {
     printf("COL not set\n");
     return 1;
   }
-  int col = atoi(col_str);
+  Miner::Config config;
+  config.col = atoi(col_str);
 
   const char *start_str = getenv("START");
-  uint64_t start = 0;
   if (start_str) {
-    start = strtoull(start_str, nullptr, 10);
+    config.start = strtoull(start_str, nullptr, 10);
+  }
+
+  // One thread per core unless set.
+  const char *threads_str = getenv("THREADS");
+  if (threads_str) {
+    config.threads = atoi(threads_str);
+  }
+
+  // Hits per bucket, and the buckets to fill before stopping.
+  const char *quota_str = getenv("QUOTA");
+  if (quota_str) {
+    config.quota = strtoull(quota_str, nullptr, 10);
+  }
+  const char *zeros_str = getenv("ZEROS");
+  if (zeros_str) {
+    config.zeros = atoi(zeros_str);
   }
 
-  return john_brute_use_sha3_cpu(col, start);
+  // Saved every CHECKPOINT_SECS and resumed from if it's there.
+  const char *checkpoint_str = getenv("CHECKPOINT");
+  if (checkpoint_str) {
+    config.checkpoint = checkpoint_str;
+  }
+  const char *secs_str = getenv("CHECKPOINT_SECS");
+  if (secs_str) {
+    config.checkpointSecs = atoi(secs_str);
+  }
+
+  // Hits go to this result store rather than stdout.
+  const char *store_str = getenv("STORE");
+  ResultStore store;
+  if (store_str && !store.open(store_str, true)) {
+    return 1;
+  }
+
+  // The widest the CPU supports, unless SHA3_KERNEL names another.
+  const char *kernel_str = getenv("SHA3_KERNEL");
+  SHA3_lanes sha3 = kernel_str ? SHA3_lanes(kernel_str) : SHA3_lanes();
+  if (!check_sha3_lanes(sha3, 4096)) {
+    return 1;
+  }
+  fprintf(stderr, "sha3 kernel: %s, %zu lanes\n", sha3.name(), sha3.lanes());
+
+  Miner miner(config, sha3, store_str ? &store : nullptr);
+  if (!miner.resume()) {
+    return 1;
+  }
+  miner.run();
 
   return 0;
 }
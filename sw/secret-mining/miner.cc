@@ -0,0 +1,263 @@
+#include "miner.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include "common.h"
+#include "keccak.h"
+
+namespace {
+// Look-up Table for the number of leading zero bits in a nibble
+constexpr int LEADING_ZERO_BITS_LUT[16] = {4, 3, 2, 2, 1, 1, 1, 1,
+                                           0, 0, 0, 0, 0, 0, 0, 0};
+}  // namespace
+
+uint64_t prefixWord(int col) {
+  uint8_t bytes[8] = {};
+  memcpy(bytes, "HITCON", 6);
+  bytes[7] = col & 0xFF;
+  uint64_t word;
+  memcpy(&word, bytes, sizeof(word));
+  return toLittleEndian(word);
+}
+
+int ComputePrefixZero(const uint8_t *bin_hash) {
+  int count = 0;
+  for (size_t i = 0; i < SHA3_256_HASH_SIZE; i++) {
+    uint8_t byte = bin_hash[i];
+    uint8_t high_nibble = (byte & 0xF0) >> 4;
+    if (high_nibble != 0) {
+      return count + LEADING_ZERO_BITS_LUT[high_nibble];
+    }
+    count += 4;
+
+    uint8_t low_nibble = byte & 0x0F;
+    if (low_nibble != 0) {
+      return count + LEADING_ZERO_BITS_LUT[low_nibble];
+    }
+    count += 4;
+  }
+  // All bytes are zero, so return the total number of bits in the hash.
+  return SHA3_256_HASH_SIZE * 8;
+}
+
+Miner::Miner(const Config &config, const SHA3_lanes &sha3,
+             ResultStore *store)
+    : m_config(config),
+      m_sha3(sha3),
+      m_prefix(prefixWord(config.col)),
+      m_store(store),
+      m_next(config.start) {
+  for (auto &live : m_live) live = 0;
+}
+
+// A line per field: "col N", "next N", "range BEGIN END" for every range
+// left to hash and "count ZEROS N" for every bucket with hits.
+bool Miner::resume() {
+  if (m_config.checkpoint.empty()) return true;
+  FILE *f = fopen(m_config.checkpoint.c_str(), "r");
+  if (!f) return true;
+
+  char key[16];
+  uint64_t a, b;
+  bool ok = true, has_col = false;
+  while (ok && fscanf(f, "%15s %" SCNu64, key, &a) == 2) {
+    if (!strcmp(key, "col")) {
+      ok = a == static_cast<uint64_t>(m_config.col);
+      has_col = true;
+    } else if (!strcmp(key, "next")) {
+      m_next = a;
+    } else if (!strcmp(key, "range") && fscanf(f, "%" SCNu64, &b) == 1) {
+      m_pending.push_back({a, b});
+    } else if (!strcmp(key, "count") && a < kBuckets &&
+               fscanf(f, "%" SCNu64, &b) == 1) {
+      m_committed[a] = b;
+      m_live[a] = b;
+    } else {
+      ok = false;
+    }
+  }
+  ok = ok && has_col && feof(f);
+  fclose(f);
+  if (!ok) {
+    fprintf(stderr, "%s: not a checkpoint of column %d\n",
+            m_config.checkpoint.c_str(), m_config.col);
+    return false;
+  }
+  fprintf(stderr, "resumed %s: %zu ranges, next %" PRIu64 "\n",
+          m_config.checkpoint.c_str(), m_pending.size(), m_next);
+  return true;
+}
+
+void Miner::run() {
+  unsigned threads = m_config.threads;
+  if (threads == 0) threads = omp_get_num_procs();
+  threads = threads == 0 ? 2 : threads;
+  m_threads.resize(threads);
+  m_started = m_lastCheckpoint = std::chrono::steady_clock::now();
+  m_stop = full();
+  m_open = open();
+
+#pragma omp parallel num_threads(threads)
+  mine(m_threads[omp_get_thread_num()]);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  writeCheckpoint();
+}
+
+void Miner::mine(Thread &thread) {
+  const size_t lanes = m_sha3.lanes();
+  uint64_t nonces[SHA3_lanes::kMaxLanes], firsts[SHA3_lanes::kMaxLanes];
+  Range range;
+  while (!m_stop.load(std::memory_order_relaxed) && take(thread, &range)) {
+    uint64_t i = range.begin;
+    while (i < range.end && !m_stop.load(std::memory_order_relaxed)) {
+      const uint64_t commit_at = i + std::min(kCommitNonces, range.end - i);
+      // Picks up buckets filled since at the next commit, record() still
+      // turns them down till then.
+      const uint64_t mask =
+          leadingZerosMask(m_open.load(std::memory_order_relaxed));
+      while (i < commit_at) {
+        const size_t n = std::min<uint64_t>(lanes, commit_at - i);
+        for (size_t lane = 0; lane < lanes; lane++) {
+          nonces[lane] = nonceWord(i + lane);
+        }
+        unsigned hits =
+            m_sha3.firstWords16Zero(m_prefix, nonces, mask, firsts) &
+            ((1u << n) - 1);
+        while (hits) {
+          const int lane = __builtin_ctz(hits);
+          hits &= hits - 1;
+          record(thread, ComputePrefixZero(firsts[lane]), i + lane);
+        }
+        i += n;
+      }
+      commit(thread, i);
+    }
+  }
+}
+
+void Miner::record(Thread &thread, int zeros, uint64_t nonce) {
+  // Most land in a full bucket, only read it then.
+  auto &live = m_live[zeros];
+  if (live.load(std::memory_order_relaxed) >= m_config.quota) return;
+  const uint64_t before = live.fetch_add(1, std::memory_order_relaxed);
+  if (before >= m_config.quota) return;
+  thread.counts[zeros]++;
+
+  if (m_store) {
+    std::lock_guard<std::mutex> lock(m_storeMutex);
+    if (!m_store->append(m_config.col, zeros, nonce)) m_stop = true;
+  } else {
+    printf("%d %d %" PRIu64 "\n", m_config.col, zeros, nonce);
+  }
+
+  if (before + 1 != m_config.quota) return;
+  int open = this->open();
+  int expected = m_open.load();
+  while (open > expected && !m_open.compare_exchange_weak(expected, open)) {
+  }
+  if (zeros <= m_config.zeros && full()) m_stop = true;
+}
+
+bool Miner::take(Thread &thread, Range *range) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_pending.empty()) {
+    *range = m_pending.front();
+    m_pending.pop_front();
+  } else if (m_next != UINT64_MAX) {
+    range->begin = m_next;
+    range->end = m_next + std::min(kChunkNonces, UINT64_MAX - m_next);
+    m_next = range->end;
+  } else {
+    return false;
+  }
+  thread.range = *range;
+  return true;
+}
+
+void Miner::commit(Thread &thread, uint64_t pos) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (int i = 0; i < kBuckets; i++) {
+    m_committed[i] += thread.counts[i];
+    thread.counts[i] = 0;
+  }
+  m_hashed += pos - thread.range.begin;
+  thread.range.begin = pos;
+
+  const auto now = std::chrono::steady_clock::now();
+  if (now - m_lastCheckpoint >=
+      std::chrono::seconds(m_config.checkpointSecs)) {
+    writeCheckpoint();
+    m_lastCheckpoint = now;
+  }
+}
+
+bool Miner::full() const {
+  if (m_config.zeros < 0) return false;
+  for (int i = 0; i <= m_config.zeros && i < kBuckets; i++) {
+    if (m_live[i].load(std::memory_order_relaxed) < m_config.quota) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int Miner::open() const {
+  int zeros = 0;
+  while (zeros < kBuckets &&
+         m_live[zeros].load(std::memory_order_relaxed) >= m_config.quota) {
+    zeros++;
+  }
+  return zeros;
+}
+
+bool Miner::writeCheckpoint() {
+  const double secs = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - m_started)
+                          .count();
+  int filled = 0;
+  while (filled < kBuckets && m_committed[filled] >= m_config.quota) filled++;
+  fprintf(stderr, "%" PRIu64 " hashes, %.1f MH/s, buckets below %d full\n",
+          m_hashed, m_hashed / secs / 1e6, filled);
+  if (m_config.checkpoint.empty()) return true;
+
+  // Everything it says was hashed has to be in the log first.
+  if (m_store) {
+    std::lock_guard<std::mutex> lock(m_storeMutex);
+    if (!m_store->sync()) return false;
+  } else {
+    fflush(stdout);
+  }
+  const std::string tmp = m_config.checkpoint + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "w");
+  if (!f) {
+    perror(tmp.c_str());
+    return false;
+  }
+  fprintf(f, "col %d\n", m_config.col);
+  fprintf(f, "next %" PRIu64 "\n", m_next);
+  for (const Range &range : m_pending) {
+    fprintf(f, "range %" PRIu64 " %" PRIu64 "\n", range.begin, range.end);
+  }
+  for (const Thread &thread : m_threads) {
+    if (thread.range.begin < thread.range.end) {
+      fprintf(f, "range %" PRIu64 " %" PRIu64 "\n", thread.range.begin,
+              thread.range.end);
+    }
+  }
+  for (int i = 0; i < kBuckets; i++) {
+    if (m_committed[i]) {
+      fprintf(f, "count %d %" PRIu64 "\n", i, m_committed[i]);
+    }
+  }
+  // Swapped in whole, a crash mid write leaves the last one.
+  bool ok = fclose(f) == 0 &&
+            rename(tmp.c_str(), m_config.checkpoint.c_str()) == 0;
+  if (!ok) perror(m_config.checkpoint.c_str());
+  return ok;
+}
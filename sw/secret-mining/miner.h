@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "result_store.h"
+#include "sha3_lanes.h"
+
+// The first message word of a column, read little endian: "HITCON", a zero
+// byte and the column.
+uint64_t prefixWord(int col);
+
+// The second, the nonce's big endian bytes read little endian.
+constexpr uint64_t nonceWord(uint64_t i) { return __builtin_bswap64(i); }
+
+// Computes the number of leading zero bits in the given binary hash
+int ComputePrefixZero(const uint8_t *bin_hash);
+
+// The same, from the first word of the digest read little endian. Tops out at
+// 64, 2^-64 odds are as good as never.
+constexpr int ComputePrefixZero(uint64_t first_word) {
+  // The digest's first byte is the word's lowest.
+  return first_word ? __builtin_clzll(__builtin_bswap64(first_word)) : 64;
+}
+
+// The bits of a first word read little endian that are zero when the digest
+// has at least `zeros` leading zero bits.
+constexpr uint64_t leadingZerosMask(int zeros) {
+  return zeros <= 0    ? 0
+         : zeros >= 64 ? UINT64_MAX
+                       : __builtin_bswap64(~(UINT64_MAX >> zeros));
+}
+
+// Mines a column on several threads. They take chunks of the nonce space
+// from a shared queue as they go, so a slow thread never holds up the rest,
+// and commit their progress every kCommitNonces. The committed progress is
+// what's saved to the checkpoint file, so a restart picks up where it was
+// saved, hashing again what was past it. Hits from there can be recorded
+// twice, or a bucket end up a few over quota; `results merge` takes care of
+// both.
+// Hits go to a ResultStore, or are printed to stdout, "col zeros nonce",
+// without one, until a bucket has quota of them. Candidates below the lowest
+// bucket that isn't full are dropped in the kernel, by their first word.
+class Miner {
+ public:
+  static constexpr int kBuckets = 65;
+  static constexpr uint64_t kChunkNonces = 1 << 24;
+  static constexpr uint64_t kCommitNonces = 1 << 20;
+
+  struct Config {
+    int col = 0;
+    uint64_t start = 0;
+    // 0 for one per core.
+    unsigned threads = 0;
+    // Hits printed per bucket.
+    uint64_t quota = 65536;
+    // Stop once buckets 0 to zeros each have quota hits, never if -1.
+    int zeros = -1;
+    // Where to save the progress, nowhere if empty.
+    std::string checkpoint;
+    unsigned checkpointSecs = 60;
+  };
+
+  Miner(const Config &config, const SHA3_lanes &sha3, ResultStore *store);
+
+  // Picks up from config.checkpoint if there's one. False if it can't be
+  // read or it's another column's.
+  bool resume();
+
+  // Until the buckets up to config.zeros are full.
+  void run();
+
+ private:
+  struct Range {
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  // Apart, so that the threads don't share cache lines.
+  struct alignas(64) Thread {
+    // What's left of its chunk past the committed progress.
+    Range range = {0, 0};
+    // Hits since the last commit.
+    uint64_t counts[kBuckets] = {};
+  };
+
+  void mine(Thread &thread);
+  void record(Thread &thread, int zeros, uint64_t nonce);
+  // Locks m_mutex.
+  bool take(Thread &thread, Range *range);
+  void commit(Thread &thread, uint64_t pos);
+  bool full() const;
+  // The lowest bucket short of quota.
+  int open() const;
+  // Under m_mutex.
+  bool writeCheckpoint();
+
+  const Config m_config;
+  const SHA3_lanes &m_sha3;
+  const uint64_t m_prefix;
+  ResultStore *const m_store;
+  std::mutex m_storeMutex;
+
+  std::atomic<uint64_t> m_live[kBuckets];
+  std::atomic<bool> m_stop{false};
+  std::atomic<int> m_open{0};
+
+  std::mutex m_mutex;
+  std::vector<Thread> m_threads;
+  // Resumed ranges, handed out before new chunks.
+  std::deque<Range> m_pending;
+  uint64_t m_next;
+  uint64_t m_committed[kBuckets] = {};
+  uint64_t m_hashed = 0;
+  std::chrono::steady_clock::time_point m_started;
+  std::chrono::steady_clock::time_point m_lastCheckpoint;
+};
@@ -0,0 +1,134 @@
+#include "result_store.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+constexpr char g_magic[8] = {'H', 'I', 'T', 'C', 'O', 'N', 'R', 'S'};
+}  // namespace
+
+static_assert(sizeof(ResultStore::Record) == 16, "fixed size records");
+static_assert(sizeof(ResultStore::Header) % sizeof(ResultStore::Record) == 0,
+              "records stay aligned");
+
+ResultStore::~ResultStore() { close(); }
+
+bool ResultStore::open(const std::string &path, bool writable) {
+  close();
+  m_path = path;
+  m_writable = writable;
+  m_fd = ::open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+  if (m_fd < 0) {
+    perror(path.c_str());
+    return false;
+  }
+  if (writable && flock(m_fd, LOCK_EX | LOCK_NB) != 0) {
+    fprintf(stderr, "%s: open for writing elsewhere\n", path.c_str());
+    close();
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(m_fd, &st) != 0) {
+    perror(path.c_str());
+    close();
+    return false;
+  }
+  if (st.st_size == 0 && writable) {
+    if (!mapFile(sizeof(Header) + kMinCapacity * sizeof(Record))) {
+      close();
+      return false;
+    }
+    memcpy(header()->magic, g_magic, sizeof(g_magic));
+    header()->version = kVersion;
+    header()->recordSize = sizeof(Record);
+    return true;
+  }
+
+  if (static_cast<size_t>(st.st_size) < sizeof(Header) ||
+      !mapFile(st.st_size)) {
+    fprintf(stderr, "%s: not a result store\n", path.c_str());
+    close();
+    return false;
+  }
+  const Header *h = header();
+  if (memcmp(h->magic, g_magic, sizeof(g_magic)) || h->version != kVersion ||
+      h->recordSize != sizeof(Record) ||
+      h->records > (m_mapSize - sizeof(Header)) / sizeof(Record)) {
+    fprintf(stderr, "%s: not a result store\n", path.c_str());
+    close();
+    return false;
+  }
+  return true;
+}
+
+void ResultStore::close() {
+  if (m_map) {
+    const size_t used = sizeof(Header) + size() * sizeof(Record);
+    munmap(m_map, m_mapSize);
+    m_map = nullptr;
+    if (m_writable && ftruncate(m_fd, used) != 0) perror(m_path.c_str());
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+}
+
+bool ResultStore::append(int col, int zeros, uint64_t nonce) {
+  if (col < 0 || col >= kColumns || zeros < 0 || zeros >= kBuckets) {
+    return false;
+  }
+  if (!reserve(size() + 1)) return false;
+  Record &record = records()[size()];
+  record = {nonce, static_cast<uint8_t>(col), static_cast<uint8_t>(zeros), {}};
+  // After the record, so that a crash never counts a record that isn't
+  // there.
+  header()->records++;
+  header()->counts[col][zeros]++;
+  return true;
+}
+
+bool ResultStore::sync() {
+  if (msync(m_map, m_mapSize, MS_SYNC) != 0) {
+    perror(m_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool ResultStore::mapFile(size_t size) {
+  if (m_writable && ftruncate(m_fd, size) != 0) {
+    perror(m_path.c_str());
+    return false;
+  }
+  void *map;
+  if (m_map) {
+    map = mremap(m_map, m_mapSize, size, MREMAP_MAYMOVE);
+  } else {
+    int prot = m_writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    map = mmap(nullptr, size, prot, MAP_SHARED, m_fd, 0);
+  }
+  if (map == MAP_FAILED) {
+    perror(m_path.c_str());
+    return false;
+  }
+  m_map = static_cast<uint8_t *>(map);
+  m_mapSize = size;
+  return true;
+}
+
+bool ResultStore::reserve(uint64_t records) {
+  if (!m_writable) return false;
+  uint64_t capacity = (m_mapSize - sizeof(Header)) / sizeof(Record);
+  if (records <= capacity) return true;
+  if (capacity < kMinCapacity) capacity = kMinCapacity;
+  while (capacity < records) capacity *= 2;
+  return mapFile(sizeof(Header) + capacity * sizeof(Record));
+}
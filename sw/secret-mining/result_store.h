@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// The miner's hits in a binary file: a header with the number of hits for
+// every column and leading zero count, then fixed size records, appended to
+// through a shared memory map. Counting or trimming takes the header and a
+// pass over the records, rather than parsing text logs.
+// Only one process may have a store open for writing; it's flock()ed.
+class ResultStore {
+ public:
+  static constexpr int kColumns = 16;
+  static constexpr int kBuckets = 65;
+  static constexpr uint32_t kVersion = 1;
+
+  struct Record {
+    uint64_t nonce;
+    uint8_t col;
+    uint8_t zeros;
+    uint8_t reserved[6];
+  };
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    // Records in the file, the ones past this are free space.
+    uint64_t records;
+    uint64_t reserved;
+    uint64_t counts[kColumns][kBuckets];
+  };
+
+  ResultStore() = default;
+  ResultStore(const ResultStore &) = delete;
+  ResultStore &operator=(const ResultStore &) = delete;
+  ~ResultStore();
+
+  // Opens path, creating it if writable and it's not there. False, with the
+  // reason on stderr, if it can't be mapped or isn't a store.
+  bool open(const std::string &path, bool writable);
+
+  // Drops the free space at the end and unmaps the file.
+  void close();
+
+  // False if col or zeros are out of range or the file can't grow.
+  bool append(int col, int zeros, uint64_t nonce);
+
+  // Flushes the map to disk.
+  bool sync();
+
+  uint64_t size() const { return header()->records; }
+  const Record &operator[](size_t i) const { return records()[i]; }
+  uint64_t count(int col, int zeros) const {
+    return header()->counts[col][zeros];
+  }
+
+ private:
+  static constexpr uint64_t kMinCapacity = 1 << 16;
+
+  bool mapFile(size_t size);
+  bool reserve(uint64_t records);
+
+  Header *header() const { return reinterpret_cast<Header *>(m_map); }
+  Record *records() const {
+    return reinterpret_cast<Record *>(m_map + sizeof(Header));
+  }
+
+  std::string m_path;
+  int m_fd = -1;
+  bool m_writable = false;
+  uint8_t *m_map = nullptr;
+  size_t m_mapSize = 0;
+};
@@ -0,0 +1,236 @@
+// Works on the miner's result stores, see result_store.h.
+//
+//   results stats STORE...          hits per leading zero count and column
+//   results merge [-q QUOTA] OUT STORE...
+//                                   into one, without duplicates and at most
+//                                   QUOTA per bucket, the smallest nonces
+//   results trim QUOTA STORE...     the same in place, one by one
+//   results import OUT LOG...       appends the miner's text logs
+//   results dump STORE...           prints them as the text logs did
+//   results cache STORE...          writes `cache` for calc-num.py
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <unistd.h>
+
+#include "result_store.h"
+
+namespace {
+using Record = ResultStore::Record;
+
+int usage(const char *argv0) {
+  fprintf(stderr,
+          "Usage: %s stats STORE...\n"
+          "       %s merge [-q QUOTA] OUT STORE...\n"
+          "       %s trim QUOTA STORE...\n"
+          "       %s import OUT LOG...\n"
+          "       %s dump STORE...\n"
+          "       %s cache STORE...\n",
+          argv0, argv0, argv0, argv0, argv0, argv0);
+  return 1;
+}
+
+bool less(const Record &a, const Record &b) {
+  return std::tie(a.col, a.zeros, a.nonce) < std::tie(b.col, b.zeros, b.nonce);
+}
+
+bool same(const Record &a, const Record &b) {
+  return a.col == b.col && a.nonce == b.nonce;
+}
+
+bool readAll(char **paths, int n, std::vector<Record> *out) {
+  for (int i = 0; i < n; i++) {
+    ResultStore store;
+    if (!store.open(paths[i], false)) return false;
+    for (uint64_t j = 0; j < store.size(); j++) out->push_back(store[j]);
+  }
+  return true;
+}
+
+// Sorted, without duplicates and at most quota per bucket, to path by way of
+// a temporary file, so path can be one of the inputs.
+bool writeMerged(std::vector<Record> &records, uint64_t quota,
+                 const std::string &path) {
+  std::sort(records.begin(), records.end(), less);
+  const std::string tmp = path + ".tmp";
+  unlink(tmp.c_str());
+  ResultStore out;
+  if (!out.open(tmp, true)) return false;
+  uint64_t in_bucket = 0;
+  for (size_t i = 0; i < records.size(); i++) {
+    const Record &r = records[i];
+    if (i > 0 && same(records[i - 1], r)) continue;
+    if (i > 0 && (records[i - 1].col != r.col ||
+                  records[i - 1].zeros != r.zeros)) {
+      in_bucket = 0;
+    }
+    if (in_bucket++ >= quota) continue;
+    if (!out.append(r.col, r.zeros, r.nonce)) return false;
+  }
+  out.close();
+  if (rename(tmp.c_str(), path.c_str()) != 0) {
+    perror(path.c_str());
+    return false;
+  }
+  return true;
+}
+
+int stats(char **paths, int n) {
+  uint64_t counts[ResultStore::kColumns][ResultStore::kBuckets] = {};
+  uint64_t total = 0;
+  for (int i = 0; i < n; i++) {
+    ResultStore store;
+    if (!store.open(paths[i], false)) return 1;
+    for (int col = 0; col < ResultStore::kColumns; col++) {
+      for (int zeros = 0; zeros < ResultStore::kBuckets; zeros++) {
+        counts[col][zeros] += store.count(col, zeros);
+      }
+    }
+    total += store.size();
+  }
+
+  // The table trim.py printed.
+  printf("\tcol");
+  for (int col = 0; col < ResultStore::kColumns; col++) printf("\t%d", col);
+  printf("\ncount\n");
+  for (int zeros = 0; zeros < ResultStore::kBuckets; zeros++) {
+    printf("%d\t", zeros);
+    for (int col = 0; col < ResultStore::kColumns; col++) {
+      printf("\t%" PRIu64, counts[col][zeros]);
+    }
+    printf("\n");
+  }
+  printf("%" PRIu64 " hits in %d stores\n", total, n);
+  return 0;
+}
+
+int merge(char **args, int n) {
+  uint64_t quota = UINT64_MAX;
+  if (n >= 2 && !strcmp(args[0], "-q")) {
+    quota = strtoull(args[1], nullptr, 10);
+    args += 2;
+    n -= 2;
+  }
+  if (n < 2) return -1;
+  std::vector<Record> records;
+  if (!readAll(args + 1, n - 1, &records)) return 1;
+  return writeMerged(records, quota, args[0]) ? 0 : 1;
+}
+
+int trim(char **args, int n) {
+  if (n < 2) return -1;
+  const uint64_t quota = strtoull(args[0], nullptr, 10);
+  for (int i = 1; i < n; i++) {
+    std::vector<Record> records;
+    if (!readAll(args + i, 1, &records)) return 1;
+    if (!writeMerged(records, quota, args[i])) return 1;
+  }
+  return 0;
+}
+
+int import(char **args, int n) {
+  if (n < 2) return -1;
+  ResultStore out;
+  if (!out.open(args[0], true)) return 1;
+  for (int i = 1; i < n; i++) {
+    FILE *f = fopen(args[i], "r");
+    if (!f) {
+      perror(args[i]);
+      return 1;
+    }
+    int col, zeros;
+    uint64_t nonce;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+      if (sscanf(line, "%d %d %" SCNu64, &col, &zeros, &nonce) != 3 ||
+          !out.append(col, zeros, nonce)) {
+        fprintf(stderr, "Warning %s: %s", args[i], line);
+      }
+    }
+    fclose(f);
+  }
+  return 0;
+}
+
+int dump(char **paths, int n) {
+  for (int i = 0; i < n; i++) {
+    ResultStore store;
+    if (!store.open(paths[i], false)) return 1;
+    for (uint64_t j = 0; j < store.size(); j++) {
+      const Record &r = store[j];
+      printf("%d %d %" PRIu64 "\n", r.col, r.zeros, r.nonce);
+    }
+  }
+  return 0;
+}
+
+// What gen-cache.py made of the text logs: a Python dict of the first 10
+// nonces of every column and leading zero count.
+int cache(char **paths, int n) {
+  constexpr size_t kKeep = 10;
+  std::vector<uint64_t> kept[ResultStore::kColumns][ResultStore::kBuckets];
+  for (int i = 0; i < n; i++) {
+    ResultStore store;
+    if (!store.open(paths[i], false)) return 1;
+    for (uint64_t j = 0; j < store.size(); j++) {
+      const Record &r = store[j];
+      auto &nonces = kept[r.col][r.zeros];
+      if (nonces.size() < kKeep) nonces.push_back(r.nonce);
+    }
+  }
+
+  FILE *f = fopen("cache", "w");
+  if (!f) {
+    perror("cache");
+    return 1;
+  }
+  const char *col_sep = "";
+  fprintf(f, "{");
+  for (int col = 0; col < ResultStore::kColumns; col++) {
+    const char *zeros_sep = "";
+    for (int zeros = 0; zeros < ResultStore::kBuckets; zeros++) {
+      const auto &nonces = kept[col][zeros];
+      if (nonces.empty()) continue;
+      if (!*zeros_sep) fprintf(f, "%s%d: {", col_sep, col);
+      fprintf(f, "%s%d: [", zeros_sep, zeros);
+      for (size_t k = 0; k < nonces.size(); k++) {
+        fprintf(f, "%s%" PRIu64, k ? ", " : "", nonces[k]);
+      }
+      fprintf(f, "]");
+      zeros_sep = ", ";
+      col_sep = ", ";
+    }
+    if (*zeros_sep) fprintf(f, "}");
+  }
+  fprintf(f, "}");
+  return fclose(f) == 0 ? 0 : 1;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 3) return usage(argv[0]);
+  const std::string cmd = argv[1];
+  char **args = argv + 2;
+  const int n = argc - 2;
+  int ret = -1;
+  if (cmd == "stats") {
+    ret = stats(args, n);
+  } else if (cmd == "merge") {
+    ret = merge(args, n);
+  } else if (cmd == "trim") {
+    ret = trim(args, n);
+  } else if (cmd == "import") {
+    ret = import(args, n);
+  } else if (cmd == "dump") {
+    ret = dump(args, n);
+  } else if (cmd == "cache") {
+    ret = cache(args, n);
+  }
+  return ret < 0 ? usage(argv[0]) : ret;
+}
@@ -161,6 +161,13 @@ std::vector<uint8_t> SHA3_cpu::digest() {
   return result;
 }
 
+uint64_t SHA3_cpu::firstWord16(uint64_t word0, uint64_t word1) {
+  uint64_t A[25] = {word0, word1, 0x06};
+  A[16] = 0x8000000000000000UL;
+  updateState(A);
+  return A[0];
+}
+
 void SHA3_cpu::processBlock(const uint8_t *buf) {
   processSingleBlock(m_A, buf, m_bufferSize);
 }
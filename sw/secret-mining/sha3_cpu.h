@@ -12,6 +12,12 @@ class SHA3_cpu {
 
   std::vector<uint8_t> digest();
 
+  // SHA3-256 of a 16 byte message, given as its two words read little
+  // endian, straight into the state with the padding lanes set as
+  // constants: nothing is allocated or copied. Returns just the first word
+  // of the digest, read little endian too.
+  static uint64_t firstWord16(uint64_t word0, uint64_t word1);
+
  private:
   // Argument buf should be at least m_buffer_size.
   void processBlock(const uint8_t *buf);
@@ -0,0 +1,259 @@
+#include "sha3_lanes.h"
+
+#include <immintrin.h>
+
+#include <cstring>
+
+#include "common.h"
+#include "keccak.h"
+
+namespace {
+// GCC vector extensions, the kernels below are compiled for the ISA of the
+// function they're inlined into.
+typedef uint64_t u64x4 __attribute__((vector_size(32)));
+typedef uint64_t u64x8 __attribute__((vector_size(64)));
+
+constexpr unsigned g_rotc[24] = {1,  3,  6,  10, 15, 21, 28, 36,
+                                 45, 55, 2,  14, 27, 41, 56, 8,
+                                 25, 43, 62, 18, 39, 61, 20, 44};
+
+constexpr unsigned g_piln[24] = {10, 7,  11, 17, 18, 3,  5,  16,
+                                 8,  21, 24, 4,  15, 23, 19, 13,
+                                 12, 2,  20, 14, 22, 9,  6,  1};
+
+constexpr uint64_t g_rndc[24] = {
+    0x0000000000000001UL, 0x0000000000008082UL, 0x800000000000808aUL,
+    0x8000000080008000UL, 0x000000000000808bUL, 0x0000000080000001UL,
+    0x8000000080008081UL, 0x8000000000008009UL, 0x000000000000008aUL,
+    0x0000000000000088UL, 0x0000000080008009UL, 0x000000008000000aUL,
+    0x000000008000808bUL, 0x800000000000008bUL, 0x8000000000008089UL,
+    0x8000000000008003UL, 0x8000000000008002UL, 0x8000000000000080UL,
+    0x000000000000800aUL, 0x800000008000000aUL, 0x8000000080008081UL,
+    0x8000000000008080UL, 0x0000000080000001UL, 0x8000000080008008UL};
+
+// Written out rather than a function returning V, which would be a vector
+// return outside the kernel's ISA.
+#define ROTL64(x, y) (((x) << (y)) | ((x) >> (64 - (y))))
+
+// keccakf() from keccak.cc, on V lanes at a time.
+template <typename V>
+__attribute__((always_inline)) inline void keccakfLanes(V s[25]) {
+  for (int round = 0; round < 24; round++) {
+    V bc[5];
+    // Theta
+#pragma GCC unroll 5
+    for (int i = 0; i < 5; i++)
+      bc[i] = s[i] ^ s[i + 5] ^ s[i + 10] ^ s[i + 15] ^ s[i + 20];
+
+#pragma GCC unroll 5
+    for (int i = 0; i < 5; i++) {
+      V t = bc[(i + 4) % 5] ^ ROTL64(bc[(i + 1) % 5], 1);
+#pragma GCC unroll 5
+      for (int j = 0; j < 25; j += 5) s[j + i] ^= t;
+    }
+
+    // Rho Pi
+    V t = s[1];
+#pragma GCC unroll 24
+    for (int i = 0; i < 24; i++) {
+      int j = g_piln[i];
+      bc[0] = s[j];
+      s[j] = ROTL64(t, g_rotc[i]);
+      t = bc[0];
+    }
+
+    // Chi
+#pragma GCC unroll 5
+    for (int j = 0; j < 25; j += 5) {
+#pragma GCC unroll 5
+      for (int i = 0; i < 5; i++) bc[i] = s[j + i];
+#pragma GCC unroll 5
+      for (int i = 0; i < 5; i++)
+        s[j + i] ^= ~bc[(i + 1) % 5] & bc[(i + 2) % 5];
+    }
+
+    // Iota
+    s[0] ^= g_rndc[round];
+  }
+}
+
+// N messages, each a single block: the two message words, the SHA3 padding
+// right after them and at the end of the 136 byte rate.
+template <typename V, size_t N>
+__attribute__((always_inline)) inline void hash16Lanes(const uint8_t *in,
+                                                       uint8_t *out) {
+  static_assert(sizeof(V) == N * sizeof(uint64_t), "a lane per message");
+  uint64_t words[2][N];
+  for (size_t lane = 0; lane < N; lane++) {
+    for (size_t w = 0; w < 2; w++) {
+      memcpy(&words[w][lane], in + lane * 16 + w * 8, sizeof(uint64_t));
+      words[w][lane] = toLittleEndian(words[w][lane]);
+    }
+  }
+  V s[25] = {};
+  memcpy(&s[0], words[0], sizeof(V));
+  memcpy(&s[1], words[1], sizeof(V));
+  s[2] ^= 0x06;
+  s[16] ^= 0x8000000000000000UL;
+
+  keccakfLanes(s);
+
+  uint64_t digest[SHA3_256_HASH_SIZE / 8][N];
+  memcpy(digest, s, sizeof(digest));
+  for (size_t lane = 0; lane < N; lane++) {
+    for (size_t w = 0; w < SHA3_256_HASH_SIZE / 8; w++) {
+      uint64_t word = toLittleEndian(digest[w][lane]);
+      memcpy(out + lane * SHA3_256_HASH_SIZE + w * 8, &word, sizeof(word));
+    }
+  }
+}
+
+// The same for messages that share word0, the words as they are in the
+// state and only the first word of the digests.
+template <typename V>
+__attribute__((always_inline)) inline void firstWords16Lanes(
+    uint64_t word0, const uint64_t *words1, V *first) {
+  V s[25] = {};
+  s[0] ^= word0;
+  memcpy(&s[1], words1, sizeof(V));
+  s[2] ^= 0x06;
+  s[16] ^= 0x8000000000000000UL;
+
+  keccakfLanes(s);
+
+  *first = s[0];
+}
+
+void hash16Scalar(const uint8_t *in, uint8_t *out) {
+  hash16Lanes<uint64_t, 1>(in, out);
+}
+
+void firstWords16Scalar(uint64_t word0, const uint64_t *words1,
+                        uint64_t *out) {
+  firstWords16Lanes(word0, words1, out);
+}
+
+unsigned firstWords16ZeroScalar(uint64_t word0, const uint64_t *words1,
+                                uint64_t mask, uint64_t *out) {
+  firstWords16Lanes(word0, words1, out);
+  return (*out & mask) == 0;
+}
+
+__attribute__((target("avx2"))) void hash16Avx2(const uint8_t *in,
+                                                uint8_t *out) {
+  hash16Lanes<u64x4, 4>(in, out);
+}
+
+__attribute__((target("avx2"))) void firstWords16Avx2(
+    uint64_t word0, const uint64_t *words1, uint64_t *out) {
+  u64x4 first;
+  firstWords16Lanes(word0, words1, &first);
+  memcpy(out, &first, sizeof(first));
+}
+
+__attribute__((target("avx2"))) unsigned firstWords16ZeroAvx2(
+    uint64_t word0, const uint64_t *words1, uint64_t mask, uint64_t *out) {
+  u64x4 first;
+  firstWords16Lanes(word0, words1, &first);
+  memcpy(out, &first, sizeof(first));
+  __m256i zero = _mm256_cmpeq_epi64(reinterpret_cast<__m256i>(first & mask),
+                                    _mm256_setzero_si256());
+  return _mm256_movemask_pd(_mm256_castsi256_pd(zero));
+}
+
+__attribute__((target("avx512f"))) void hash16Avx512(const uint8_t *in,
+                                                     uint8_t *out) {
+  hash16Lanes<u64x8, 8>(in, out);
+}
+
+__attribute__((target("avx512f"))) void firstWords16Avx512(
+    uint64_t word0, const uint64_t *words1, uint64_t *out) {
+  u64x8 first;
+  firstWords16Lanes(word0, words1, &first);
+  memcpy(out, &first, sizeof(first));
+}
+
+__attribute__((target("avx512f"))) unsigned firstWords16ZeroAvx512(
+    uint64_t word0, const uint64_t *words1, uint64_t mask, uint64_t *out) {
+  u64x8 first;
+  firstWords16Lanes(word0, words1, &first);
+  memcpy(out, &first, sizeof(first));
+  return _mm512_testn_epi64_mask(reinterpret_cast<__m512i>(first),
+                                 _mm512_set1_epi64(mask));
+}
+
+bool supportsScalar() { return true; }
+
+bool supportsAvx2() {
+  // Checks the OS saves the YMM registers too.
+  return __builtin_cpu_supports("avx2");
+}
+
+bool supportsAvx512() { return __builtin_cpu_supports("avx512f"); }
+
+}  // namespace
+
+struct SHA3_lanes::Kernel {
+  const char *name;
+  size_t lanes;
+  void (*hash16)(const uint8_t *in, uint8_t *out);
+  void (*firstWords16)(uint64_t word0, const uint64_t *words1,
+                       uint64_t *out);
+  unsigned (*firstWords16Zero)(uint64_t word0, const uint64_t *words1,
+                               uint64_t mask, uint64_t *out);
+  bool (*supported)();
+};
+
+namespace {
+// Narrowest first.
+const SHA3_lanes::Kernel g_kernels[] = {
+    {"scalar", 1, &hash16Scalar, &firstWords16Scalar, &firstWords16ZeroScalar,
+     &supportsScalar},
+    {"avx2", 4, &hash16Avx2, &firstWords16Avx2, &firstWords16ZeroAvx2,
+     &supportsAvx2},
+    {"avx512", 8, &hash16Avx512, &firstWords16Avx512, &firstWords16ZeroAvx512,
+     &supportsAvx512},
+};
+
+const SHA3_lanes::Kernel *widestKernel() {
+  const SHA3_lanes::Kernel *widest = &g_kernels[0];
+  for (const auto &kernel : g_kernels) {
+    if (kernel.supported()) widest = &kernel;
+  }
+  return widest;
+}
+}  // namespace
+
+SHA3_lanes::SHA3_lanes() : m_kernel(widestKernel()) {}
+
+SHA3_lanes::SHA3_lanes(const std::string &name) : m_kernel(widestKernel()) {
+  for (const auto &kernel : g_kernels) {
+    if (name == kernel.name && kernel.supported()) m_kernel = &kernel;
+  }
+}
+
+std::vector<std::string> SHA3_lanes::supported() {
+  std::vector<std::string> names;
+  for (const auto &kernel : g_kernels) {
+    if (kernel.supported()) names.push_back(kernel.name);
+  }
+  return names;
+}
+
+const char *SHA3_lanes::name() const { return m_kernel->name; }
+
+size_t SHA3_lanes::lanes() const { return m_kernel->lanes; }
+
+void SHA3_lanes::hash16(const uint8_t *in, uint8_t *out) const {
+  m_kernel->hash16(in, out);
+}
+
+void SHA3_lanes::firstWords16(uint64_t word0, const uint64_t *words1,
+                              uint64_t *out) const {
+  m_kernel->firstWords16(word0, words1, out);
+}
+
+unsigned SHA3_lanes::firstWords16Zero(uint64_t word0, const uint64_t *words1,
+                                      uint64_t mask, uint64_t *out) const {
+  return m_kernel->firstWords16Zero(word0, words1, mask, out);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// SHA3-256 of several 16 byte messages at once, one per 64 bit SIMD lane of
+// an interleaved Keccak state: 4 with AVX2 and 8 with AVX-512. The kernel is
+// picked at runtime by CPUID, with a scalar one to fall back on.
+class SHA3_lanes {
+ public:
+  static constexpr size_t kMaxLanes = 8;
+  static constexpr size_t kMessageSize = 16;
+
+  // The widest kernel the CPU supports.
+  SHA3_lanes();
+  // The kernel called name, if the CPU supports it, otherwise the widest.
+  explicit SHA3_lanes(const std::string &name);
+
+  // Names of the kernels the CPU supports, narrowest first.
+  static std::vector<std::string> supported();
+
+  const char *name() const;
+  // Messages hashed by a hash16() call.
+  size_t lanes() const;
+
+  // Hashes lanes() messages of kMessageSize bytes, back to back in `in`,
+  // into their digests back to back in `out`.
+  void hash16(const uint8_t *in, uint8_t *out) const;
+
+  // SHA3_cpu::firstWord16() for lanes() messages that share their first
+  // word, such as the miner's prefix for a column. words1 and out hold
+  // lanes() words each.
+  void firstWords16(uint64_t word0, const uint64_t *words1,
+                    uint64_t *out) const;
+
+  // The same, and a bit per lane, lowest first, for the first words with
+  // none of mask's bits set. It's a vector compare and movemask, so that
+  // the lanes that miss are never looked at.
+  unsigned firstWords16Zero(uint64_t word0, const uint64_t *words1,
+                            uint64_t mask, uint64_t *out) const;
+
+  struct Kernel;
+
+ private:
+  const Kernel *m_kernel;
+};